@@ -17,6 +17,9 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/hashtable.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
 #include <linux/if_ether.h>
 #include <linux/ip.h>
 #include <linux/version.h>
@@ -25,10 +28,12 @@
 #include <linux/rmnet_nss.h>
 
 #define RMNET_NSS_HASH_BITS 8
-#define hash_add_ptr(table, node, key) \
-	hlist_add_head(node, &table[hash_ptr(key, HASH_BITS(table))])
+#define hash_add_ptr_rcu(table, node, key) \
+	hlist_add_head_rcu(node, &table[hash_ptr(key, HASH_BITS(table))])
 
+/* Readers walk the table under RCU; writers hold rmnet_nss_ctx_lock */
 static DEFINE_HASHTABLE(rmnet_nss_ctx_hashtable, RMNET_NSS_HASH_BITS);
+static DEFINE_SPINLOCK(rmnet_nss_ctx_lock);
 
 struct rmnet_nss_ctx {
 	struct hlist_node hnode;
@@ -57,12 +62,35 @@ enum __rmnet_nss_stat {
 	RMNET_NSS_NUM_STATS,
 };
 
-static unsigned long rmnet_nss_stats[RMNET_NSS_NUM_STATS];
+static DEFINE_PER_CPU(unsigned long, rmnet_nss_stats[RMNET_NSS_NUM_STATS]);
 extern void qmi_rmnet_mark_skb(struct net_device *dev, struct sk_buff *skb);
 static void (*rmnet_mark_skb)(struct net_device *dev, struct sk_buff *skb);
 
+/* Stats are kept per CPU and summed up when the parameter is read */
+static int rmnet_nss_stat_get(char *buf, const struct kernel_param *kp)
+{
+	unsigned long stat = (unsigned long)kp->arg;
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += per_cpu(rmnet_nss_stats[stat], cpu);
+
+	return scnprintf(buf, PAGE_SIZE, "%lu\n", sum);
+}
+
+static int rmnet_nss_stat_set(const char *val, const struct kernel_param *kp)
+{
+	return -EPERM;
+}
+
+static const struct kernel_param_ops rmnet_nss_stat_ops = {
+	.set = rmnet_nss_stat_set,
+	.get = rmnet_nss_stat_get,
+};
+
 #define RMNET_NSS_STAT(name, counter, desc) \
-	module_param_named(name, rmnet_nss_stats[counter], ulong, 0444); \
+	module_param_cb(name, &rmnet_nss_stat_ops, (void *)(unsigned long)(counter), 0444); \
 	MODULE_PARM_DESC(name, desc)
 
 RMNET_NSS_STAT(rmnet_nss_rx_ethernet, RMNET_NSS_RX_ETH,
@@ -103,9 +131,12 @@ RMNET_NSS_STAT(rmnet_nss_tx_busy_loop, RMNET_NSS_TX_BUSY_LOOP,
 static void rmnet_nss_inc_stat(enum __rmnet_nss_stat stat)
 {
 	if (stat >= 0 && stat < RMNET_NSS_NUM_STATS)
-		rmnet_nss_stats[stat]++;
+		this_cpu_inc(rmnet_nss_stats[stat]);
 }
 
+/* Must be called under rcu_read_lock(). The context stays valid until
+ * rcu_read_unlock(), as rmnet_nss_free_ctx() waits for a grace period.
+ */
 static struct rmnet_nss_ctx *rmnet_nss_find_ctx(struct net_device *dev)
 {
 	struct rmnet_nss_ctx *ctx;
@@ -114,7 +145,7 @@ static struct rmnet_nss_ctx *rmnet_nss_find_ctx(struct net_device *dev)
 
 	hash = hash_ptr(dev, HASH_BITS(rmnet_nss_ctx_hashtable));
 	bucket = &rmnet_nss_ctx_hashtable[hash];
-	hlist_for_each_entry(ctx, bucket, hnode) {
+	hlist_for_each_entry_rcu(ctx, bucket, hnode) {
 		if (ctx->rmnet_dev == dev)
 			return ctx;
 	}
@@ -125,7 +156,13 @@ static struct rmnet_nss_ctx *rmnet_nss_find_ctx(struct net_device *dev)
 static void rmnet_nss_free_ctx(struct rmnet_nss_ctx *ctx)
 {
 	if (ctx) {
-		hash_del(&ctx->hnode);
+		spin_lock_bh(&rmnet_nss_ctx_lock);
+		hash_del_rcu(&ctx->hnode);
+		spin_unlock_bh(&rmnet_nss_ctx_lock);
+
+		/* Let packets already using the context drain */
+		synchronize_rcu();
+
 		nss_rmnet_rx_xmit_callback_unregister(ctx->nss_ctx);
 		nss_rmnet_rx_destroy_sync(ctx->nss_ctx);
 		kfree(ctx);
@@ -319,6 +356,9 @@ drop:
  * Looks up NSS contex associated with the device. If the context is found,
  * we add a dummy ethernet header with the approriate protocol field set,
  * the pass the packet off to NSS for hardware acceleration.
+ *
+ * Packets are not held for aggregation: nss_rmnet_rx_tx_buf() takes one
+ * buffer at a time and this hook gets no end-of-burst signal to flush on.
  */
 int rmnet_nss_tx(struct sk_buff *skb)
 {
@@ -338,8 +378,10 @@ int rmnet_nss_tx(struct sk_buff *skb)
 
 	version = ((struct iphdr *)skb->data)->version;
 
+	rcu_read_lock();
 	ctx = rmnet_nss_find_ctx(dev);
 	if (!ctx) {
+		rcu_read_unlock();
 		rmnet_nss_inc_stat(RMNET_NSS_TX_NO_CTX);
 		return -EINVAL;
 	}
@@ -352,7 +394,7 @@ int rmnet_nss_tx(struct sk_buff *skb)
 		eth->h_proto = htons(ETH_P_IPV6);
 	} else {
 		rmnet_nss_inc_stat(RMNET_NSS_TX_BAD_IP);
-		goto fail;
+		goto fail_unlock;
 	}
 
 	skb->protocol = htons(ETH_P_802_3);
@@ -366,6 +408,7 @@ transmit:
 		 * Don't call rmnet_data_vnd_rx_fixup() to do this, as
 		 * there's no guarantee the skb pointer is still valid.
 		 */
+		rcu_read_unlock();
 		dev->stats.rx_packets++;
 		dev->stats.rx_bytes += len;
 		rmnet_nss_inc_stat(RMNET_NSS_TX_SUCCESS);
@@ -375,10 +418,13 @@ transmit:
 		goto transmit;
 	} else if (rc == NSS_TX_FAILURE_NOT_ENABLED) {
 		/* New stats */
+		rcu_read_unlock();
 		rmnet_nss_receive(dev, skb, NULL);
 		return 0;
 	}
 
+fail_unlock:
+	rcu_read_unlock();
 fail:
 	rmnet_nss_inc_stat(RMNET_NSS_TX_FAIL);
 	kfree_skb(skb);
@@ -437,7 +483,10 @@ int rmnet_nss_create_vnd(struct net_device *dev)
 
 	nss_rmnet_rx_register(ctx->nss_ctx, rmnet_nss_receive, dev);
 	nss_rmnet_rx_xmit_callback_register(ctx->nss_ctx, rmnet_nss_xmit);
-	hash_add_ptr(rmnet_nss_ctx_hashtable, &ctx->hnode, dev);
+
+	spin_lock_bh(&rmnet_nss_ctx_lock);
+	hash_add_ptr_rcu(rmnet_nss_ctx_hashtable, &ctx->hnode, dev);
+	spin_unlock_bh(&rmnet_nss_ctx_lock);
 	return 0;
 }
 
@@ -446,7 +495,11 @@ int rmnet_nss_free_vnd(struct net_device *dev)
 {
 	struct rmnet_nss_ctx *ctx;
 
+	rcu_read_lock();
 	ctx = rmnet_nss_find_ctx(dev);
+	rcu_read_unlock();
+
+	/* Contexts are only freed from here and on exit, which rmnet serializes */
 	rmnet_nss_free_ctx(ctx);
 
 	return 0;
@@ -218,6 +218,7 @@ int main(int argc, char **argv)
 	dtop_dev_init();
 	dtop_stat_init();
 	dtop_cpu_stats_init();
+	dtop_ipt_init();
 	dtop_gen_init("/sys/kernel/debug/clk/bimc_clk/");
 	dtop_gen_init("/sys/kernel/debug/clk/snoc_clk/");
 	dtop_gen_init("/sys/kernel/debug/clk/pnoc_clk/");
@@ -53,10 +53,19 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 * Array of strings where necessary dp names and values are held.
 * @var dtop_dev_vars::line_count
 * Number of lines the file is that the dpg represents.
+* @var dtop_dev_vars::file
+* File kept open for polling.
+* @var dtop_dev_vars::map
+* Line and field of each dp value, in dp order.
+* @var dtop_dev_vars::val
+* Values found by the last poll, in dp order.
 */
 struct dtop_dev_vars {
 	char **line;
 	int line_count;
+	struct dt_file file;
+	struct dt_field_map *map;
+	char **val;
 };
 
 /**
@@ -108,59 +117,25 @@ static void dt_dev_parse(char *line1, int len1,
  */
 int dtop_dev_poll(struct dtop_data_point_gatherer *dpg)
 {
-	char *data;
-	int *line_len = malloc(sizeof(int) *
-			((struct dtop_dev_vars *)
-			(dpg->priv))->line_count);
+	struct dtop_dev_vars *storage = dpg->priv;
 	int read;
-	struct dt_procdict *dict = malloc(sizeof(struct dt_procdict)
-					*((struct dtop_dev_vars *)
-					(dpg->priv))->line_count-2);
-	int j, n, sum;
-	int index = 0;
-	int dp = 0;
+	int dp;
 
-	read = dt_read_file(dpg->file, &data, DTOP_DEV_SIZE);
-	if (read == 0 || data == 0)
+	read = dt_file_read(&storage->file);
+	if (read == 0)
 		return DTOP_POLL_IO_ERR;
 
-	sum = 0;
-	/* Assigns each line read from the file, a length */
-	for (n = 0; n < ((struct dtop_dev_vars *)
-				(dpg->priv))->line_count; n++) {
-		line_len[n] = dt_read_line(((struct dtop_dev_vars *)
-					(dpg->priv))->line[n],
-					   DTOP_DEV_LINE, data,
-					   DTOP_DEV_SIZE, sum);
-		if (n <= (((struct dtop_dev_vars *)
-			(dpg->priv))->line_count - 1)) {
-			sum += (line_len[n] + 1);
-		}
-
-	}
-
-	for (n = 2; n < ((struct dtop_dev_vars *)
-			(dpg->priv))->line_count; n++) {
-		dt_dev_parse(((struct dtop_dev_vars *)
-				(dpg->priv))->line[n], line_len[n],
-					index, &dict[index]);
-		index++;
-	}
-
+	/* The interface name ends at ':', which may touch the first value */
+	dt_scan_fields(storage->file.buf, read, " \t:", storage->map,
+		       dpg->data_points_len, storage->val);
 
 	/* Assigns the dp value to the dp struct */
-	for (n = 2; n < ((struct dtop_dev_vars *)
-			(dpg->priv))->line_count; n++) {
-		for (j = 0; j < 16; j++) {
+	for (dp = 0; dp < dpg->data_points_len; dp++) {
+		if (storage->val[dp])
 			dtop_store_dp(&(dpg->data_points[dp]),
-						dict[n-2].val[j]);
-			dp++;
-		}
+				      storage->val[dp]);
 	}
 
-	dt_free(&data);
-	free(line_len);
-	free(dict);
 	return DTOP_POLL_OK;
 }
 
@@ -189,6 +164,9 @@ static void dtop_dev_dpg_deconstructor
 				(dpset->priv))->line_count; i++)
 		free(((struct dtop_dev_vars *)(dpset->priv))->line[i]);
 	free(((struct dtop_dev_vars *)(dpset->priv))->line);
+	free(((struct dtop_dev_vars *)(dpset->priv))->map);
+	free(((struct dtop_dev_vars *)(dpset->priv))->val);
+	dt_file_close(&((struct dtop_dev_vars *)(dpset->priv))->file);
 	free(((struct dtop_dev_vars *)(dpset->priv)));
 	free(dpset);
 }
@@ -265,8 +243,11 @@ int dtop_dev_search(char *name, struct dtop_dev_vars *storage)
 	dev_dict.val[15] = "compressed";
 
 	read = dt_read_file(name, &data, DTOP_DEV_SIZE);
-	if (read == 0 || data == 0)
+	if (read == 0 || data == 0) {
+		free(data_points);
+		free(line_len);
 		return DTOP_POLL_IO_ERR;
+	}
 
 	sum = 0;
 	/* Assigns each line read from the file, a length */
@@ -278,6 +259,19 @@ int dtop_dev_search(char *name, struct dtop_dev_vars *storage)
 			sum += (line_len[n] + 1);
 	}
 
+	storage->map = malloc(dp_count * sizeof(*storage->map));
+	storage->val = malloc(dp_count * sizeof(*storage->val));
+	if (!data_points || !storage->map || !storage->val ||
+	    dt_file_open(&storage->file, name, DTOP_DEV_SIZE)
+	    != FILE_SUCCESS) {
+		free(storage->map);
+		free(storage->val);
+		free(data_points);
+		free(line_len);
+		dt_free(&data);
+		return DTOP_POLL_IO_ERR;
+	}
+
 	construct_dev_file_dpg(storage, dp_count, data_points);
 
 	for (n = 2; n < storage->line_count; n++) {
@@ -298,6 +292,9 @@ int dtop_dev_search(char *name, struct dtop_dev_vars *storage)
 			data_points[dp].prefix = pref;
 			data_points[dp].name = dict.key[n-2];
 			data_points[dp].type = DTOP_ULONG;
+			/* Field 0 is the interface name */
+			storage->map[dp].line = n;
+			storage->map[dp].field = i+1;
 			dp++;
 		}
 		index++;
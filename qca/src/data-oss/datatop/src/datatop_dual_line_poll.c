@@ -46,6 +46,23 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define DTOP_DUAL_SIZE 8192
 #define DTOP_DUAL_LINE (DTOP_DUAL_SIZE>>2)
 
+/**
+* @struct dtop_dual_line_slot
+* @brief Position of one dp's fields in dtop_dual_line_vars::map.
+*
+* @var dtop_dual_line_slot::prefix
+* Entry of the prefix heading the name line, e.g. "Tcp:".
+* @var dtop_dual_line_slot::name
+* Entry of the dp name.
+* @var dtop_dual_line_slot::val
+* Entry of the dp value.
+*/
+struct dtop_dual_line_slot {
+	int prefix;
+	int name;
+	int val;
+};
+
 /**
 * @struct dtop_dual_line_vars
 * @brief Struct used to hold necessary variables for dual_line_file dpgs.
@@ -56,102 +73,165 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 * Array of strings where necessary dp names and values are held.
 * @var dtop_dual_line_vars::line_count
 * Number of lines the file is that the dpg represents.
+* @var dtop_dual_line_vars::file
+* File kept open for polling.
+* @var dtop_dual_line_vars::map
+* Line and field of each prefix, dp name and dp value, in file order.
+* @var dtop_dual_line_vars::val
+* Fields found by the last poll, in map order.
+* @var dtop_dual_line_vars::slot
+* Entries of map belonging to each dp, in dp order.
+* @var dtop_dual_line_vars::map_len
+* Number of entries in map and val.
 */
 struct dtop_dual_line_vars {
 	char **line;
 	char **line2;
 	int line_count;
+	struct dt_file file;
+	struct dt_field_map *map;
+	char **val;
+	struct dtop_dual_line_slot *slot;
+	int map_len;
 };
 
 /**
- * @brief Stores the data collected from a dual_line file.
+ * @brief Checks a prefix field, which still carries its ':', against a dp prefix.
+ *
+ * @param field Prefix field as found in the file.
+ * @param prefix Prefix of the dp, without ':'.
+ * @return 1 if they match, 0 otherwise.
+ */
+static int dt_dual_line_prefix_eq(const char *field, const char *prefix)
+{
+	int len = strlen(prefix);
+
+	return strncmp(field, prefix, len) == 0 &&
+	       (field[len] == ':' || field[len] == 0);
+}
+
+/**
+ * @brief Stores dp values from a dual_line file by matching names.
+ *
+ * Used when the file no longer has the layout recorded by the search,
+ * e.g. after a kernel added a counter.
  *
  * @param dpg Struct that polled data is added to.
+ * @param data Contents of the file.
  * @return DTOP_POLL_IO_ERR - Poll of dpg unsuccessful.
  * @return DTOP_POLL_OK - Poll of dpg successful.
  */
-int dtop_dual_line_poll(struct dtop_data_point_gatherer *dpg)
+static int dtop_dual_line_poll_by_name(struct dtop_data_point_gatherer *dpg,
+				       char *data)
 {
-	char *data;
-	int *line_len = malloc(sizeof(int) *
-			((struct dtop_dual_line_vars *)
-			(dpg->priv))->line_count);
-	int *line_len2 = malloc(sizeof(int) *
-			((struct dtop_dual_line_vars *)
-			(dpg->priv))->line_count);
-	int read;
-
+	struct dtop_dual_line_vars *storage = dpg->priv;
+	int *line_len = malloc(sizeof(int) * storage->line_count);
+	int *line_len2 = malloc(sizeof(int) * storage->line_count);
 	struct dt_procdict *dict = malloc(sizeof(struct dt_procdict)
-					* (((struct dtop_dual_line_vars *)
-					(dpg->priv))->line_count/2));
+					* (storage->line_count/2));
 	struct dt_procdict *prefix_dict = malloc(sizeof(struct dt_procdict)
-					* (((struct dtop_dual_line_vars *)
-					(dpg->priv))->line_count/2));
+					* (storage->line_count/2));
 	int i, j, k, n, sum, sum2;
+	int rc = DTOP_POLL_IO_ERR;
 
-	read = dt_read_file(dpg->file, &data, DTOP_DUAL_SIZE);
-	if (read == 0 || data == 0)
-		return DTOP_POLL_IO_ERR;
+	if (!line_len || !line_len2 || !dict || !prefix_dict)
+		goto out;
 
 	sum = 0;
 	sum2 = 0;
 	/* Assigns each line read from the file, a length */
-	for (n = 0; n < ((struct dtop_dual_line_vars *)
-				(dpg->priv))->line_count; n++) {
-		line_len[n] = dt_read_line(((struct dtop_dual_line_vars *)
-					(dpg->priv))->line[n],
+	for (n = 0; n < storage->line_count; n++) {
+		line_len[n] = dt_read_line(storage->line[n],
 					   DTOP_DUAL_LINE, data,
 					   DTOP_DUAL_SIZE, sum);
-		line_len2[n] = dt_read_line(((struct dtop_dual_line_vars *)
-					(dpg->priv))->line2[n],
+		line_len2[n] = dt_read_line(storage->line2[n],
 					    DTOP_DUAL_LINE, data,
 					    DTOP_DUAL_SIZE, sum2);
-		if (n <= (((struct dtop_dual_line_vars *)
-				(dpg->priv))->line_count-2)) {
+		if (n <= (storage->line_count-2)) {
 			sum += (line_len[n] + 1);
 			sum2 += (line_len2[n] + 1);
 		}
-
 	}
 
-	/* Stores dp names and values in dictionary */
-	for (i = 0; i < (((struct dtop_dual_line_vars *)
-				(dpg->priv))->line_count/2); i++)
-		dt_parse_proc_dictionary(((struct dtop_dual_line_vars *)
-					(dpg->priv))->line[2*i],
-					  line_len[2*i],
-					  ((struct dtop_dual_line_vars *)
-					  (dpg->priv))->line[(2*i)+1],
-					  line_len[(2*i)+1],
-					  &dict[i]);
-
-	/* Stores dp prefices in dictionary */
-	for (i = 0; i < (((struct dtop_dual_line_vars *)
-				(dpg->priv))->line_count/2); i++)
-		dt_parse_for_prefix(((struct dtop_dual_line_vars *)
-				(dpg->priv))->line2[2*i], line_len2[2*i],
+	/* Stores dp names, values and prefices in dictionaries */
+	for (i = 0; i < (storage->line_count/2); i++)
+		dt_parse_proc_dictionary(storage->line[2*i], line_len[2*i],
+			 storage->line[(2*i)+1], line_len[(2*i)+1], &dict[i]);
+
+	for (i = 0; i < (storage->line_count/2); i++)
+		dt_parse_for_prefix(storage->line2[2*i], line_len2[2*i],
 				    &prefix_dict[i]);
 
 	/* Assigns a dp value to each dp struct */
-	for (k = 0; k < (((struct dtop_dual_line_vars *)
-				(dpg->priv))->line_count/2); k++) {
+	for (k = 0; k < (storage->line_count/2); k++) {
 		for (j = 0; j < dpg->data_points_len; j++) {
-			i =  dt_find_dict_idx(dpg->data_points[j].name,
-					      &dict[k]);
+			i = dt_find_dict_idx(dpg->data_points[j].name,
+					     &dict[k]);
 			if (i >= 0 && i < dict[k].max &&
 				(strcmp(dpg->data_points[j].prefix,
 				prefix_dict[k].val[i]) == 0))
-
 				dtop_store_dp(&(dpg->data_points[j]),
 					      dict[k].val[i]);
 		}
 	}
+	rc = DTOP_POLL_OK;
 
-	dt_free(&data);
+out:
 	free(line_len);
 	free(line_len2);
 	free(dict);
 	free(prefix_dict);
+	return rc;
+}
+
+/**
+ * @brief Stores the data collected from a dual_line file.
+ *
+ * @param dpg Struct that polled data is added to.
+ * @return DTOP_POLL_IO_ERR - Poll of dpg unsuccessful.
+ * @return DTOP_POLL_OK - Poll of dpg successful.
+ */
+int dtop_dual_line_poll(struct dtop_data_point_gatherer *dpg)
+{
+	struct dtop_dual_line_vars *storage = dpg->priv;
+	struct dtop_dual_line_slot *slot;
+	int read;
+	int j;
+
+	read = dt_file_read(&storage->file);
+	if (read == 0)
+		return DTOP_POLL_IO_ERR;
+
+	/*
+	 * Look at the fields where the search found each dp, and only take
+	 * the values if the prefix and name there still match.
+	 */
+	dt_scan_fields(storage->file.buf, read, " ", storage->map,
+		       storage->map_len, storage->val);
+
+	for (j = 0; j < dpg->data_points_len; j++) {
+		slot = &storage->slot[j];
+		if (!storage->val[slot->prefix] || !storage->val[slot->name] ||
+		    !storage->val[slot->val] ||
+		    strcmp(storage->val[slot->name],
+			   dpg->data_points[j].name) != 0 ||
+		    !dt_dual_line_prefix_eq(storage->val[slot->prefix],
+					    dpg->data_points[j].prefix))
+			break;
+	}
+
+	if (j < dpg->data_points_len) {
+		/* dt_scan_fields() split the buffer, so read it again */
+		read = dt_file_read(&storage->file);
+		if (read == 0)
+			return DTOP_POLL_IO_ERR;
+		return dtop_dual_line_poll_by_name(dpg, storage->file.buf);
+	}
+
+	for (j = 0; j < dpg->data_points_len; j++)
+		dtop_store_dp(&(dpg->data_points[j]),
+			      storage->val[storage->slot[j].val]);
+
 	return DTOP_POLL_OK;
 }
 
@@ -175,6 +255,10 @@ static void dtop_dual_line_dpg_deconstructor
 	}
 	free(((struct dtop_dual_line_vars *)(dpset->priv))->line);
 	free(((struct dtop_dual_line_vars *)(dpset->priv))->line2);
+	free(((struct dtop_dual_line_vars *)(dpset->priv))->map);
+	free(((struct dtop_dual_line_vars *)(dpset->priv))->val);
+	free(((struct dtop_dual_line_vars *)(dpset->priv))->slot);
+	dt_file_close(&((struct dtop_dual_line_vars *)(dpset->priv))->file);
 	free(((struct dtop_dual_line_vars *)(dpset->priv)));
 	free(dpset);
 }
@@ -217,7 +301,7 @@ static void construct_dual_line_file_dpg(char *name, struct dtop_data_point
  */
 int dtop_dual_line_search(char *name, struct dtop_dual_line_vars *storage)
 {
-	int i, j, k, n, sum, sum2;
+	int i, j, k, m, n, sum, sum2;
 	char *data;
 	int *line_len = malloc(sizeof(int) * storage->line_count);
 	int *line_len2 = malloc(sizeof(int) * storage->line_count);
@@ -237,8 +321,13 @@ int dtop_dual_line_search(char *name, struct dtop_dual_line_vars *storage)
 				* (storage->line_count/2));
 
 	read = dt_read_file(name, &data, DTOP_DUAL_SIZE);
-	if (read == 0 || data == 0)
+	if (read == 0 || data == 0) {
+		free(line_len);
+		free(line_len2);
+		free(dict);
+		free(prefix_dict);
 		return DTOP_POLL_IO_ERR;
+	}
 
 	sum = 0;
 	sum2 = 0;
@@ -272,12 +361,51 @@ int dtop_dual_line_search(char *name, struct dtop_dual_line_vars *storage)
 			dp_count++;
 	}
 
+	/* Every pair of lines has a prefix, then a name and value per dp */
+	storage->map_len = (storage->line_count/2) + 2 * dp_count;
 	data_points = malloc(dp_count * sizeof(struct dtop_data_point));
+	storage->map = malloc(storage->map_len * sizeof(*storage->map));
+	storage->val = malloc(storage->map_len * sizeof(*storage->val));
+	storage->slot = malloc(dp_count * sizeof(*storage->slot));
+	if (!data_points || !storage->map || !storage->val || !storage->slot ||
+	    dt_file_open(&storage->file, name, DTOP_DUAL_SIZE)
+	    != FILE_SUCCESS) {
+		free(data_points);
+		free(storage->map);
+		free(storage->val);
+		free(storage->slot);
+		free(line_len);
+		free(line_len2);
+		free(dict);
+		free(prefix_dict);
+		dt_free(&data);
+		return DTOP_POLL_IO_ERR;
+	}
+
+	/* Records where the prefix, names and values sit, in file order */
+	m = 0;
+	for (j = 0; j < (storage->line_count/2); j++) {
+		storage->map[m].line = 2*j;
+		storage->map[m].field = 0;
+		m++;
+		for (i = 0; i < dict[j].max; i++, m++) {
+			storage->map[m].line = 2*j;
+			storage->map[m].field = i+1;
+		}
+		for (i = 0; i < dict[j].max; i++, m++) {
+			storage->map[m].line = (2*j)+1;
+			storage->map[m].field = i+1;
+		}
+	}
 
 	k = 0;
+	m = 0;
 	/* Creates a dtop_data_point struct for each dp found in the file */
-	for (j = 0; j < (storage->line_count/2); j++)
+	for (j = 0; j < (storage->line_count/2); j++) {
 		for (i = 0; i < dict[j].max; i++) {
+			storage->slot[k].prefix = m;
+			storage->slot[k].name = m + 1 + i;
+			storage->slot[k].val = m + 1 + dict[j].max + i;
 			if (dict[j].val[i][0] == '-')
 				data_points[k].type = DTOP_LONG;
 			else
@@ -288,6 +416,8 @@ int dtop_dual_line_search(char *name, struct dtop_dual_line_vars *storage)
 			data_points[k].initial_data_populated = NOT_POPULATED;
 			k++;
 		}
+		m += 1 + 2 * dict[j].max;
+	}
 
 	/* Calls dpg constructor, dpg will point to the dp struct */
 	construct_dual_line_file_dpg(name, data_points, storage, dp_count);
@@ -40,6 +40,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include "datatop_interface.h"
 #include "datatop_linked_list.h"
@@ -81,6 +82,88 @@ int dt_read_file(const char *file, char **buffer, int len)
 	return read;
 }
 
+/**
+ * @brief Opens a file to be polled and allocates its read buffer.
+ *
+ * Pollers keep the descriptor and buffer for their lifetime so that each
+ * poll is a single pread() without fopen() or malloc().
+ *
+ * @param f dt_file to set up.
+ * @param file File which is read from.
+ * @param size Maximum amount of data read on each poll.
+ * @return FILE_SUCCESS - File opened and buffer allocated.
+ * @return FILE_ERROR - File could not be opened or buffer not allocated.
+ */
+int dt_file_open(struct dt_file *f, const char *file, int size)
+{
+	f->buf = malloc(size + 1);
+	if (!f->buf) {
+		fprintf(stderr, "%s(): malloc(%d) failed\n", __func__, size + 1);
+		f->fd = -1;
+		return FILE_ERROR;
+	}
+
+	f->fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (f->fd < 0) {
+		fprintf(stderr, "%s(): Failed to open %s: ", __func__, file);
+		fprintf(stderr, "Error: %s\n", strerror(errno));
+		free(f->buf);
+		f->buf = 0;
+		return FILE_ERROR;
+	}
+
+	f->size = size;
+	f->buf[0] = 0;
+	return FILE_SUCCESS;
+}
+
+/**
+ * @brief Reads a polled file from the start into its buffer.
+ *
+ * procfs and sysfs files regenerate their contents when read from offset 0,
+ * so the descriptor can be reused for every poll.
+ *
+ * @param f dt_file set up by dt_file_open().
+ * @return Number of bytes of data placed in f->buf, 0 on error.
+ */
+int dt_file_read(struct dt_file *f)
+{
+	ssize_t rc;
+	int total = 0;
+
+	if (f->fd < 0)
+		return 0;
+
+	while (total < f->size) {
+		rc = pread(f->fd, f->buf + total, f->size - total, total);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+		if (rc == 0)
+			break;
+		total += rc;
+	}
+
+	f->buf[total] = 0;
+	return total;
+}
+
+/**
+ * @brief Closes a polled file and frees its buffer.
+ *
+ * @param f dt_file to release.
+ */
+void dt_file_close(struct dt_file *f)
+{
+	if (f->fd >= 0)
+		close(f->fd);
+	free(f->buf);
+	f->fd = -1;
+	f->buf = 0;
+}
+
 /**
  * @brief Deallocates memory no longer being used.
  *
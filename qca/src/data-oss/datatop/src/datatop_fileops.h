@@ -39,7 +39,27 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "datatop_linked_list.h"
 #include "datatop_opt.h"
 
+/**
+ * @struct dt_file
+ * @brief File kept open across polls and re-read from offset 0.
+ *
+ * @var dt_file::fd
+ * Descriptor of the open file, -1 when closed.
+ * @var dt_file::buf
+ * Buffer holding the contents of the last read, NUL terminated.
+ * @var dt_file::size
+ * Usable size of buf, not counting the terminator.
+ */
+struct dt_file {
+	int fd;
+	char *buf;
+	int size;
+};
+
 int dt_read_file(const char *file, char **buffer, int len);
+int dt_file_open(struct dt_file *f, const char *file, int size);
+int dt_file_read(struct dt_file *f);
+void dt_file_close(struct dt_file *f);
 void dt_free(char **buffer);
 int dtop_check_writefile_access(char *fw);
 int dtop_check_out_dir_presence(char *fw);
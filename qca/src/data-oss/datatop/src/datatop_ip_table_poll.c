@@ -302,14 +302,6 @@ void dtop_ip_table_init(char *out_dir)
   construct_ip_table_dpg("ip xfrm state show");
   construct_ip_table_dpg("ip xfrm policy show");
   construct_ip_table_dpg("ip addr");
-  construct_ip_table_dpg("iptables -t raw -L -n -v");
-  construct_ip_table_dpg("iptables -t mangle -L -n -v");
-  construct_ip_table_dpg("iptables -L -n -v");
-  construct_ip_table_dpg("iptables -t nat -L -n -v");
-  construct_ip_table_dpg("ip6tables -t raw -L -n -v");
-  construct_ip_table_dpg("ip6tables -t mangle -L -n -v");
-  construct_ip_table_dpg("ip6tables -L -n -v");
-  construct_ip_table_dpg("ip6tables -t nat -L -n -v");
   construct_ip_table_dpg("ip rule show");
   construct_ip_table_dpg("ip -6 rule show");
   construct_ip_table_dpg("ip route show table all");
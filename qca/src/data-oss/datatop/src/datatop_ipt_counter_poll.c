@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/**
+ * @file datatop_ipt_counter_poll.c
+ * @brief Adds ability for iptables and ip6tables counter collection
+ *
+ * File contains methods for searching and polling the packet and byte
+ * counters of every rule and built-in chain policy straight from the
+ * kernel with IPT_SO_GET_ENTRIES, so that they can be sampled at the
+ * same rate as the "/proc" files without running iptables.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/netfilter_ipv4/ip_tables.h>
+#include <linux/netfilter_ipv6/ip6_tables.h>
+#include "datatop_interface.h"
+#include "datatop_polling.h"
+
+#define DTOP_IPT_NAME_LEN 32
+
+/**
+ * @struct dtop_ipt_family
+ * @brief Describes how to read the tables of one address family.
+ *
+ * ipt_getinfo/ip6t_getinfo and the get_entries headers share one layout;
+ * only the entry itself differs, so the walk goes through offsets.
+ */
+struct dtop_ipt_family {
+	const char *name;
+	int domain;
+	int level;
+	int get_info;
+	int get_entries;
+	size_t hdr_size;
+	size_t target_offset;
+	size_t next_offset;
+	size_t counters;
+};
+
+static const struct dtop_ipt_family dtop_ipt_families[] = {
+	{ "iptables", AF_INET, IPPROTO_IP,
+	  IPT_SO_GET_INFO, IPT_SO_GET_ENTRIES,
+	  sizeof(struct ipt_get_entries),
+	  offsetof(struct ipt_entry, target_offset),
+	  offsetof(struct ipt_entry, next_offset),
+	  offsetof(struct ipt_entry, counters) },
+	{ "ip6tables", AF_INET6, IPPROTO_IPV6,
+	  IP6T_SO_GET_INFO, IP6T_SO_GET_ENTRIES,
+	  sizeof(struct ip6t_get_entries),
+	  offsetof(struct ip6t_entry, target_offset),
+	  offsetof(struct ip6t_entry, next_offset),
+	  offsetof(struct ip6t_entry, counters) },
+};
+
+static const char *dtop_ipt_tables[] = { "raw", "mangle", "filter", "nat" };
+
+static const char *dtop_ipt_hooks[NF_INET_NUMHOOKS] = {
+	"PREROUTING", "INPUT", "FORWARD", "OUTPUT", "POSTROUTING"
+};
+
+/**
+* @struct dtop_ipt_vars
+* @brief Struct used to hold necessary variables for an iptables dpg
+*
+* @var dtop_ipt_vars::fam
+* Address family the table belongs to.
+* @var dtop_ipt_vars::fd
+* Socket the table is read through, kept open for polling.
+* @var dtop_ipt_vars::info
+* Layout of the table the entries were read with.
+* @var dtop_ipt_vars::entries
+* Buffer the entries are read into, sized for info.size.
+* @var dtop_ipt_vars::rule
+* Rule number of each counter pair in dp order, 0 for a chain policy.
+* @var dtop_ipt_vars::cursor
+* Counter pair the next walked entry is expected to match.
+*/
+struct dtop_ipt_vars {
+	const struct dtop_ipt_family *fam;
+	int fd;
+	struct ipt_getinfo info;
+	struct ipt_get_entries *entries;
+	int *rule;
+	int cursor;
+};
+
+typedef void (*dtop_ipt_fn)(struct dtop_data_point_gatherer *dpg,
+			    const char *chain, int rule,
+			    const struct xt_counters *c);
+
+/**
+ * @brief Fetches the layout of a table.
+ *
+ * @param storage dtop_ipt_vars struct of the table.
+ * @param info Receives the layout; name must already be set.
+ * @return FILE_SUCCESS - Layout read.
+ * @return FILE_ERROR - Table could not be read.
+ */
+static int dt_ipt_get_info(struct dtop_ipt_vars *storage,
+			   struct ipt_getinfo *info)
+{
+	socklen_t len = sizeof(*info);
+
+	strlcpy(info->name, storage->info.name, sizeof(info->name));
+	if (getsockopt(storage->fd, storage->fam->level,
+		       storage->fam->get_info, info, &len) < 0)
+		return FILE_ERROR;
+	return FILE_SUCCESS;
+}
+
+/**
+ * @brief Checks whether two table layouts place the chains alike.
+ */
+static int dt_ipt_same_layout(const struct ipt_getinfo *a,
+			      const struct ipt_getinfo *b)
+{
+	return a->size == b->size && a->valid_hooks == b->valid_hooks &&
+	       !memcmp(a->hook_entry, b->hook_entry, sizeof(a->hook_entry)) &&
+	       !memcmp(a->underflow, b->underflow, sizeof(a->underflow));
+}
+
+/**
+ * @brief Reads the current entries of a table.
+ *
+ * The layout is fetched on every read, since a replaced ruleset of the
+ * same size moves the chain heads and policies without the kernel
+ * refusing the entries. It is fetched again afterwards; if the ruleset
+ * was replaced in between, or its size changed so that the kernel
+ * refused the read with EAGAIN, the read is retried.
+ *
+ * @param storage dtop_ipt_vars struct of the table.
+ * @return FILE_SUCCESS - Entries read.
+ * @return FILE_ERROR - Table could not be read.
+ */
+static int dt_ipt_read(struct dtop_ipt_vars *storage)
+{
+	const struct dtop_ipt_family *fam = storage->fam;
+	struct ipt_get_entries *entries;
+	struct ipt_getinfo info;
+	socklen_t len;
+	int retry;
+
+	for (retry = 0; retry < 3; retry++) {
+		if (dt_ipt_get_info(storage, &info) == FILE_ERROR)
+			return FILE_ERROR;
+
+		if (!storage->entries || info.size != storage->info.size) {
+			entries = realloc(storage->entries,
+					  fam->hdr_size + info.size);
+			if (!entries)
+				return FILE_ERROR;
+			storage->entries = entries;
+		}
+		storage->info = info;
+
+		entries = storage->entries;
+		strlcpy(entries->name, storage->info.name,
+			sizeof(entries->name));
+		entries->size = storage->info.size;
+		len = fam->hdr_size + storage->info.size;
+		if (getsockopt(storage->fd, fam->level, fam->get_entries,
+			       entries, &len) < 0) {
+			if (errno != EAGAIN)
+				return FILE_ERROR;
+			continue;
+		}
+
+		if (dt_ipt_get_info(storage, &info) == FILE_ERROR)
+			return FILE_ERROR;
+		if (dt_ipt_same_layout(&info, &storage->info))
+			return FILE_SUCCESS;
+	}
+
+	return FILE_ERROR;
+}
+
+/**
+ * @brief Reads a 16 bit field of an entry through its family offset.
+ */
+static unsigned int dt_ipt_u16(const char *entry, size_t off)
+{
+	return *(const uint16_t *)(entry + off);
+}
+
+/**
+ * @brief Walks the entries of a table chain by chain.
+ *
+ * Calls fn for every rule with its chain name and 1 based rule number,
+ * and for the policy of every built-in chain with rule number 0. The
+ * error entries that head user chains and the implicit return that ends
+ * them are not reported, matching what "iptables -L" shows.
+ *
+ * @param dpg Dpg of the table, passed on to fn.
+ * @param fn Function called for each counter pair, NULL to only count.
+ * @return Number of counter pairs reported.
+ */
+static int dt_ipt_walk(struct dtop_data_point_gatherer *dpg, dtop_ipt_fn fn)
+{
+	struct dtop_ipt_vars *storage = dpg->priv;
+	const struct dtop_ipt_family *fam = storage->fam;
+	const struct ipt_getinfo *info = &storage->info;
+	const char *base = (const char *)storage->entries + fam->hdr_size;
+	const char *chain = NULL;
+	const struct xt_entry_target *t;
+	const struct xt_counters *c;
+	const char *e;
+	unsigned int off, next;
+	int user = 0;
+	int rule = 0;
+	int count = 0;
+	int h;
+
+	for (off = 0; off < info->size; off = next) {
+		e = base + off;
+		next = off + dt_ipt_u16(e, fam->next_offset);
+		if (next <= off)
+			break;
+		t = (const struct xt_entry_target *)
+			(e + dt_ipt_u16(e, fam->target_offset));
+		c = (const struct xt_counters *)(e + fam->counters);
+
+		if (!strcmp(t->u.user.name, XT_ERROR_TARGET)) {
+			/* Heads a user chain, or ends the table */
+			chain = (const char *)t->data;
+			user = 1;
+			rule = 0;
+			continue;
+		}
+
+		for (h = 0; h < NF_INET_NUMHOOKS; h++) {
+			if (!(info->valid_hooks & (1 << h)))
+				continue;
+			if (off == info->hook_entry[h]) {
+				chain = dtop_ipt_hooks[h];
+				user = 0;
+				rule = 0;
+			}
+			if (off == info->underflow[h])
+				break;
+		}
+
+		if (!chain)
+			continue;
+
+		if (h < NF_INET_NUMHOOKS) {
+			if (fn)
+				fn(dpg, chain, 0, c);
+			count++;
+			continue;
+		}
+
+		/* The last entry of a user chain is its implicit return */
+		if (user && next < info->size &&
+		    !strcmp(((const struct xt_entry_target *)(base + next +
+			     dt_ipt_u16(base + next, fam->target_offset)))
+			    ->u.user.name, XT_ERROR_TARGET))
+			continue;
+
+		if (fn)
+			fn(dpg, chain, ++rule, c);
+		else
+			rule++;
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * @brief Stores one counter in a dp and populates its initial value.
+ */
+static void dt_ipt_store(struct dtop_data_point *dp, uint64_t val)
+{
+	dp->data.d_ulong = val;
+	if (dp->initial_data_populated == NOT_POPULATED) {
+		dp->initial_data.d_ulong = val;
+		dp->initial_data_populated = POPULATED;
+	}
+}
+
+/**
+ * @brief Walk callback storing a counter pair in its dps.
+ *
+ * Counter pairs are matched to dps by chain and rule number. Normally
+ * the next walked pair is the one at the cursor; after the ruleset has
+ * changed the match is looked for further on, and pairs without a dp
+ * are dropped since the set of dps is fixed at startup.
+ */
+static void dt_ipt_store_fn(struct dtop_data_point_gatherer *dpg,
+			    const char *chain, int rule,
+			    const struct xt_counters *c)
+{
+	struct dtop_ipt_vars *storage = dpg->priv;
+	int n;
+
+	for (n = storage->cursor; n < dpg->data_points_len / 2; n++) {
+		if (storage->rule[n] == rule &&
+		    !strcmp(dpg->data_points[2 * n].prefix, chain))
+			break;
+	}
+	if (n == dpg->data_points_len / 2)
+		return;
+
+	dt_ipt_store(&dpg->data_points[2 * n], c->pcnt);
+	dt_ipt_store(&dpg->data_points[2 * n + 1], c->bcnt);
+	storage->cursor = n + 1;
+}
+
+/**
+ * @brief Walk callback creating the dps of a counter pair.
+ */
+static void dt_ipt_create_fn(struct dtop_data_point_gatherer *dpg,
+			     const char *chain, int rule,
+			     const struct xt_counters *c)
+{
+	struct dtop_ipt_vars *storage = dpg->priv;
+	struct dtop_data_point *dp;
+	char name[DTOP_IPT_NAME_LEN];
+	int n = storage->cursor++;
+	int i;
+
+	(void)c;
+	storage->rule[n] = rule;
+	for (i = 0; i < 2; i++) {
+		dp = &dpg->data_points[2 * n + i];
+		if (rule)
+			snprintf(name, sizeof(name), "%d:%s", rule,
+				 i ? "bytes" : "pkts");
+		else
+			snprintf(name, sizeof(name), "policy:%s",
+				 i ? "bytes" : "pkts");
+		dp->name = strdup(name);
+		dp->prefix = strdup(chain);
+		dp->type = DTOP_ULONG;
+		dp->skip = DO_NOT_SKIP;
+		dp->initial_data_populated = NOT_POPULATED;
+	}
+}
+
+/**
+ * @brief Stores the counters read from an iptables table.
+ *
+ * @param dpg Struct that polled data is added to.
+ * @return DTOP_POLL_IO_ERR - Poll of dpg unsuccessful.
+ * @return DTOP_POLL_OK - Poll of dpg successful.
+ */
+int dtop_ipt_poll(struct dtop_data_point_gatherer *dpg)
+{
+	struct dtop_ipt_vars *storage = dpg->priv;
+
+	if (dt_ipt_read(storage) == FILE_ERROR)
+		return DTOP_POLL_IO_ERR;
+
+	storage->cursor = 0;
+	dt_ipt_walk(dpg, dt_ipt_store_fn);
+	return DTOP_POLL_OK;
+}
+
+/**
+ * @brief Frees dynamically allocated iptables dpg.
+ *
+ * Frees the memory of the dpg along with it's data_points
+ * and other malloc'd memory no longer needed.
+ *
+ * @param dpg Dpg to deconstruct and deallocate memory for.
+ */
+static void dtop_ipt_dpg_deconstructor
+			(struct dtop_data_point_gatherer *dpset)
+{
+	struct dtop_ipt_vars *storage = dpset->priv;
+	int i;
+
+	for (i = 0; i < dpset->data_points_len; i++) {
+		free(dpset->data_points[i].name);
+		free(dpset->data_points[i].prefix);
+	}
+	free(dpset->data_points);
+	close(storage->fd);
+	free(storage->entries);
+	free(storage->rule);
+	free(storage);
+	free(dpset->prefix);
+	free(dpset);
+}
+
+/**
+ * @brief Scans an iptables table in order to autodetect dps.
+ *
+ * Reads the table once and creates a packet and a byte dp for every
+ * rule and built-in chain policy in it. Tables that are not loaded, or
+ * cannot be read without CAP_NET_ADMIN, are skipped.
+ *
+ * @param fam Address family of the table.
+ * @param table Name of the table.
+ * @return DTOP_POLL_IO_ERR - Table could not be read.
+ * @return DTOP_POLL_OK - Dpg registered.
+ */
+static int dtop_ipt_search(const struct dtop_ipt_family *fam,
+			   const char *table)
+{
+	struct dtop_data_point_gatherer *dpg;
+	struct dtop_ipt_vars *storage;
+	int count;
+	int len;
+
+	storage = calloc(1, sizeof(*storage));
+	dpg = calloc(1, sizeof(*dpg));
+	if (!storage || !dpg)
+		goto err;
+
+	storage->fam = fam;
+	strlcpy(storage->info.name, table, sizeof(storage->info.name));
+	storage->fd = socket(fam->domain, SOCK_RAW, IPPROTO_RAW);
+	if (storage->fd < 0)
+		goto err;
+
+	dpg->priv = storage;
+	if (dt_ipt_read(storage) == FILE_ERROR)
+		goto err_close;
+
+	count = dt_ipt_walk(dpg, NULL);
+	if (!count)
+		goto err_close;
+
+	dpg->data_points = malloc(2 * count * sizeof(struct dtop_data_point));
+	storage->rule = malloc(count * sizeof(*storage->rule));
+	len = strlen(fam->name) + 1 + strlen(table) + 1;
+	dpg->prefix = malloc(len);
+	if (!dpg->data_points || !storage->rule || !dpg->prefix)
+		goto err_free;
+
+	snprintf(dpg->prefix, len, "%s/%s", fam->name, table);
+	dpg->data_points_len = 2 * count;
+	storage->cursor = 0;
+	dt_ipt_walk(dpg, dt_ipt_create_fn);
+
+	dpg->file = NULL;
+	dpg->poll = dtop_ipt_poll;
+	dpg->deconstruct = dtop_ipt_dpg_deconstructor;
+
+	dtop_register(dpg);
+	return DTOP_POLL_OK;
+
+err_free:
+	free(dpg->prefix);
+	free(dpg->data_points);
+	free(storage->rule);
+err_close:
+	free(storage->entries);
+	close(storage->fd);
+err:
+	free(dpg);
+	free(storage);
+	return DTOP_POLL_IO_ERR;
+}
+
+/**
+ * @brief Calls dtop_search for every iptables and ip6tables table.
+ */
+void dtop_ipt_init(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < sizeof(dtop_ipt_families) /
+			sizeof(dtop_ipt_families[0]); i++)
+		for (j = 0; j < sizeof(dtop_ipt_tables) /
+				sizeof(dtop_ipt_tables[0]); j++)
+			dtop_ipt_search(&dtop_ipt_families[i],
+					dtop_ipt_tables[j]);
+}
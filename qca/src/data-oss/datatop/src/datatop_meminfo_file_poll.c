@@ -55,10 +55,19 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 * Array of strings where necessary dp names and values are held.
 * @var dtop_meminfo_vars::line_count
 * Number of lines the file is that the dpg represents.
+* @var dtop_meminfo_vars::file
+* File kept open for polling.
+* @var dtop_meminfo_vars::map
+* Line and field of each dp value, in dp order.
+* @var dtop_meminfo_vars::val
+* Values found by the last poll, in dp order.
 */
 struct dtop_meminfo_vars {
 	char **line;
 	int line_count;
+	struct dt_file file;
+	struct dt_field_map *map;
+	char **val;
 };
 
 /**
@@ -108,57 +117,33 @@ int dt_meminfo_parse(char *line1, int len1,
  */
 int dtop_meminfo_poll(struct dtop_data_point_gatherer *dpg)
 {
-	char *data;
-	int *line_len = malloc(sizeof(int) *
-			((struct dtop_meminfo_vars *)
-			(dpg->priv))->line_count);
+	struct dtop_meminfo_vars *storage = dpg->priv;
 	int read;
-	struct dt_procdict dict;
-	int i, j, n, sum;
+	int i;
 
-	read = dt_read_file(dpg->file, &data, DTOP_MEM_SIZE);
-	if (read == 0 || data == 0)
+	read = dt_file_read(&storage->file);
+	if (read == 0)
 		return DTOP_POLL_IO_ERR;
 
-	sum = 0;
-	/* Assigns each line read from the file, a length */
-	for (n = 0; n < ((struct dtop_meminfo_vars *)
-				(dpg->priv))->line_count; n++) {
-		line_len[n] = dt_read_line(((struct dtop_meminfo_vars *)
-					(dpg->priv))->line[n],
-					   DTOP_MEM_LINE, data,
-					   DTOP_MEM_SIZE, sum);
-		if (n <= (((struct dtop_meminfo_vars *)
-			(dpg->priv))->line_count - 1)) {
-			sum += (line_len[n] + 1);
-		}
+	dt_scan_fields(storage->file.buf, read, " \t", storage->map,
+		       dpg->data_points_len, storage->val);
 
-	}
-
-	/* Stores dp names and values in dictionary */
-	for (i = 0; i < dpg->data_points_len; i++)
-		dt_meminfo_parse(((struct dtop_meminfo_vars *)
-			(dpg->priv))->line[i], line_len[i], i, &dict);
-
-	/* Assigns the dp value to the dp struct */
-	for (j = 0; j < dpg->data_points_len; j++) {
-		i = dt_find_dict_idx(dpg->data_points[j].name, &dict);
-		if (i >= 0 && i < dict.max) {
-			sscanf(dict.val[i], "%" PRIu64,
-			       &(dpg->data_points[i].data.d_ulong));
-			dpg->data_points[i].data.d_ulong *= 1024;
-			if (dpg->data_points[i].
-				initial_data_populated == NOT_POPULATED) {
-				dpg->data_points[i].initial_data.d_ulong
-					= dpg->data_points[i].data.d_ulong;
-				dpg->data_points[i].initial_data_populated
-					= POPULATED;
-			}
+	/* Assigns the dp value to the dp struct, converting kB to bytes */
+	for (i = 0; i < dpg->data_points_len; i++) {
+		if (!storage->val[i])
+			continue;
+		sscanf(storage->val[i], "%" PRIu64,
+		       &(dpg->data_points[i].data.d_ulong));
+		dpg->data_points[i].data.d_ulong *= 1024;
+		if (dpg->data_points[i].
+			initial_data_populated == NOT_POPULATED) {
+			dpg->data_points[i].initial_data.d_ulong
+				= dpg->data_points[i].data.d_ulong;
+			dpg->data_points[i].initial_data_populated
+				= POPULATED;
 		}
 	}
 
-	dt_free(&data);
-	free(line_len);
 	return DTOP_POLL_OK;
 }
 
@@ -179,6 +164,9 @@ static void dtop_meminfo_dpg_deconstructor
 				(dpset->priv))->line_count; i++)
 		free(((struct dtop_meminfo_vars *)(dpset->priv))->line[i]);
 	free(((struct dtop_meminfo_vars *)(dpset->priv))->line);
+	free(((struct dtop_meminfo_vars *)(dpset->priv))->map);
+	free(((struct dtop_meminfo_vars *)(dpset->priv))->val);
+	dt_file_close(&((struct dtop_meminfo_vars *)(dpset->priv))->file);
 	free(((struct dtop_meminfo_vars *)(dpset->priv)));
 	free(dpset);
 }
@@ -231,8 +219,10 @@ int dtop_meminfo_search(struct dtop_meminfo_vars *storage)
 		storage->line[i] = malloc(sizeof(char) * DTOP_MEM_LINE);
 
 	read = dt_read_file("/proc/meminfo", &data, DTOP_MEM_SIZE);
-	if (read == 0 || data == 0)
+	if (read == 0 || data == 0) {
+		free(line_len);
 		return DTOP_POLL_IO_ERR;
+	}
 
 	sum = 0;
 	/* Assigns each line read from the file, a length */
@@ -251,6 +241,18 @@ int dtop_meminfo_search(struct dtop_meminfo_vars *storage)
 
 	data_points = malloc
 		       (storage->line_count * sizeof(struct dtop_data_point));
+	storage->map = malloc(storage->line_count * sizeof(*storage->map));
+	storage->val = malloc(storage->line_count * sizeof(*storage->val));
+	if (!data_points || !storage->map || !storage->val ||
+	    dt_file_open(&storage->file, "/proc/meminfo", DTOP_MEM_SIZE)
+	    != FILE_SUCCESS) {
+		free(storage->map);
+		free(storage->val);
+		free(data_points);
+		free(line_len);
+		dt_free(&data);
+		return DTOP_POLL_IO_ERR;
+	}
 
 	k = 0;
 	/* Creates a dtop_data_point struct for each dp found in the file */
@@ -258,6 +260,9 @@ int dtop_meminfo_search(struct dtop_meminfo_vars *storage)
 		data_points[i].name = dict.key[i];
 		data_points[i].prefix = NULL;
 		data_points[i].type = DTOP_ULONG;
+		/* Field 0 is the name, field 1 the value in kB */
+		storage->map[i].line = i;
+		storage->map[i].field = 1;
 		k++;
 	}
 
@@ -43,6 +43,7 @@ void dtop_dev_init(void);
 void dtop_stat_init(void);
 void dtop_ip_table_init(char *out_dir);
 void *dtop_ip_table_start_poll(void * arg);
+void dtop_ipt_init(void);
 void dtop_cpu_stats_init(void);
 int dtop_value_only_poll(struct dtop_data_point_gatherer *dpg);
 void dtop_value_only_dpg_deconstructor
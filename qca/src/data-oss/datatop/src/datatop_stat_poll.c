@@ -53,10 +53,19 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 * Array of strings where necessary dp names and values are held.
 * @var dtop_stat_vars::line_count
 * Number of lines the file is that the dpg represents.
+* @var dtop_stat_vars::file
+* File kept open for polling.
+* @var dtop_stat_vars::map
+* Line and field of each dp value, in dp order.
+* @var dtop_stat_vars::val
+* Values found by the last poll, in dp order.
 */
 struct dtop_stat_vars {
 	char **line;
 	int line_count;
+	struct dt_file file;
+	struct dt_field_map *map;
+	char **val;
 };
 
 /**
@@ -115,47 +124,24 @@ static int dt_stat_parse(char *line1, int len1,
  */
 int dtop_stat_poll(struct dtop_data_point_gatherer *dpg)
 {
-	char *data;
-	int *line_len = malloc(sizeof(int) *
-			((struct dtop_stat_vars *)
-			(dpg->priv))->line_count);
+	struct dtop_stat_vars *storage = dpg->priv;
 	int read;
-	struct dt_procdict dict;
-	int i, n, sum;
-	int dp_count = 0;
+	int n;
 
-	read = dt_read_file(dpg->file, &data, DTOP_STAT_SIZE);
-	if (read == 0 || data == 0)
+	read = dt_file_read(&storage->file);
+	if (read == 0)
 		return DTOP_POLL_IO_ERR;
 
-	sum = 0;
-	/* Assigns each line read from the file, a length */
-	for (n = 0; n < ((struct dtop_stat_vars *)
-				(dpg->priv))->line_count; n++) {
-		line_len[n] = dt_read_line(((struct dtop_stat_vars *)
-					(dpg->priv))->line[n],
-					   DTOP_STAT_LINE, data,
-					   DTOP_STAT_SIZE, sum);
-		if (n <= (((struct dtop_stat_vars *)
-			(dpg->priv))->line_count - 1)) {
-			sum += (line_len[n] + 1);
-		}
-
-	}
-
-	/* Stores dp names and values in dictionary */
-	for (i = 0; i < ((struct dtop_stat_vars *)(dpg->priv))->line_count; i++)
-		dp_count = dt_stat_parse(((struct dtop_stat_vars *)
-			(dpg->priv))->line[i], line_len[i], i, dp_count, &dict);
+	dt_scan_fields(storage->file.buf, read, " ", storage->map,
+		       dpg->data_points_len, storage->val);
 
 	/* Assigns the dp value to the dp struct */
-	for (n = 0; n < dp_count; n++) {
-		dtop_store_dp(&(dpg->data_points[n]),
-				dict.val[n]);
+	for (n = 0; n < dpg->data_points_len; n++) {
+		if (storage->val[n])
+			dtop_store_dp(&(dpg->data_points[n]),
+				      storage->val[n]);
 	}
 
-	dt_free(&data);
-	free(line_len);
 	return DTOP_POLL_OK;
 }
 
@@ -178,6 +164,9 @@ static void dtop_stat_dpg_deconstructor
 				(dpset->priv))->line_count; i++)
 		free(((struct dtop_stat_vars *)(dpset->priv))->line[i]);
 	free(((struct dtop_stat_vars *)(dpset->priv))->line);
+	free(((struct dtop_stat_vars *)(dpset->priv))->map);
+	free(((struct dtop_stat_vars *)(dpset->priv))->val);
+	dt_file_close(&((struct dtop_stat_vars *)(dpset->priv))->file);
 	free(((struct dtop_stat_vars *)(dpset->priv)));
 
 	free(dpset);
@@ -236,8 +225,10 @@ int dtop_stat_search(struct dtop_stat_vars *storage)
 		storage->line[i] = malloc(sizeof(char) * DTOP_STAT_LINE);
 
 	read = dt_read_file("/proc/stat", &data, DTOP_STAT_SIZE);
-	if (read == 0 || data == 0)
+	if (read == 0 || data == 0) {
+		free(line_len);
 		return DTOP_POLL_IO_ERR;
+	}
 
 	sum = 0;
 	/* Assigns each line read from the file, a length */
@@ -260,9 +251,25 @@ int dtop_stat_search(struct dtop_stat_vars *storage)
 	}
 
 	data_points = malloc(dp_count * sizeof(struct dtop_data_point));
+	storage->map = malloc(dp_count * sizeof(*storage->map));
+	storage->val = malloc(dp_count * sizeof(*storage->val));
+	if (!data_points || !storage->map || !storage->val ||
+	    dt_file_open(&storage->file, "/proc/stat", DTOP_STAT_SIZE)
+	    != FILE_SUCCESS) {
+		free(storage->map);
+		free(storage->val);
+		free(data_points);
+		free(dp_per_line);
+		free(line_len);
+		dt_free(&data);
+		return DTOP_POLL_IO_ERR;
+	}
 
 	for (i = 0; i < (storage->line_count); i++) {
 		for (n = 0; n < dp_per_line[i]; n++) {
+			/* Field 0 is the name of the line */
+			storage->map[count].line = i;
+			storage->map[count].field = n+1;
 			if (dp_per_line[i] == 1) {
 				int dk_len = strlen(dict.key[i]) + 1;
 				int dp_len;
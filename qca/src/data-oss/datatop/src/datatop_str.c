@@ -258,3 +258,83 @@ int dt_single_line_parse(char *line1, int len1, struct dt_procdict *dict)
 	dict->max = k;
 	return k;
 }
+
+/**
+ * @brief Picks values out of a buffer by line and field position.
+ *
+ * Walks the buffer once, skipping whole lines that hold no wanted value.
+ * Fields are runs of characters not in delim. Every field listed in map is
+ * NUL terminated in place and returned through val; entries whose position
+ * is not present in the buffer are set to 0.
+ *
+ * @param buf Buffer to scan, NUL terminated at buf[len]; modified in place.
+ * @param len Number of valid bytes in buf.
+ * @param delim Characters separating fields on a line.
+ * @param map Value positions, sorted by line and then field.
+ * @param map_len Number of entries in map and val.
+ * @param val Receives a pointer to each value named in map.
+ * @return Number of map entries that were found.
+ */
+int dt_scan_fields(char *buf, int len, const char *delim,
+		   const struct dt_field_map *map, int map_len, char **val)
+{
+	int i = 0;
+	int m = 0;
+	int found = 0;
+	int line = 0;
+	int field = 0;
+	int start;
+	char *nl;
+
+	memset(val, 0, map_len * sizeof(*val));
+
+	while (i < len && m < map_len) {
+		if (buf[i] == '\n') {
+			line++;
+			field = 0;
+			i++;
+			continue;
+		}
+
+		/* Positions already passed are missing from this read */
+		while (m < map_len && (map[m].line < line ||
+		       (map[m].line == line && map[m].field < field)))
+			m++;
+		if (m == map_len)
+			break;
+
+		if (map[m].line > line) {
+			nl = memchr(&buf[i], '\n', len - i);
+			if (!nl)
+				break;
+			i = nl - buf;
+			continue;
+		}
+
+		if (strchr(delim, buf[i])) {
+			i++;
+			continue;
+		}
+
+		start = i;
+		while (i < len && buf[i] != '\n' && !strchr(delim, buf[i]))
+			i++;
+
+		if (field == map[m].field) {
+			val[m++] = &buf[start];
+			found++;
+			if (buf[i] == '\n') {
+				line++;
+				field = 0;
+				buf[i++] = 0;
+				continue;
+			}
+			buf[i] = 0;
+			if (i < len)
+				i++;
+		}
+		field++;
+	}
+
+	return found;
+}
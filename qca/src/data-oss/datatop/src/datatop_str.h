@@ -54,6 +54,20 @@ struct dt_procdict {
 	char *val[DTOP_DICT_SIZE];
 };
 
+/**
+ * @struct dt_field_map
+ * @brief Position of a datapoint value within a polled file.
+ *
+ * @var dt_field_map::line
+ * Line the value is on, counted from 0.
+ * @var dt_field_map::field
+ * Field within the line, counted from 0.
+ */
+struct dt_field_map {
+	int line;
+	int field;
+};
+
 int dt_read_line(char *buf1, int len1, const char *buf2, int len2, int start);
 
 int dt_parse_proc_dictionary(char *line1, int len1, char *line2, int len2,
@@ -67,4 +81,7 @@ int dt_parse_proc_same_line_key_and_val(char *line1, int len1, int l,
 void dt_parse_for_prefix(char *line1, int len1, struct dt_procdict *dict);
 
 int dt_single_line_parse(char *line1, int len1, struct dt_procdict *dict);
+
+int dt_scan_fields(char *buf, int len, const char *delim,
+		   const struct dt_field_map *map, int map_len, char **val);
 #endif /* DATATOP_STR_H */
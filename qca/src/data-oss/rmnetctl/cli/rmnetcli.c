@@ -55,8 +55,11 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include "rmnetcli.h"
 #include "librmnetctl.h"
+#include "librmnetctl_batch.h"
 
 #define RMNET_MAX_STR_LEN  16
+#define RMNET_BATCH_LINE_LEN  256
+#define RMNET_BATCH_MAX_ARGS  8
 
 #define _RMNETCLI_CHECKNULL(X)		do { if (!X) {                         \
 print_rmnet_api_status(RMNETCTL_INVALID_ARG, RMNETCTL_CFG_FAILURE_NO_COMMAND); \
@@ -78,7 +81,8 @@ char rmnetcfg_error_code_text
 [RMNETCFG_TOTAL_ERR_MSGS][RMNETCTL_ERR_MSG_SIZE] = {
 	"Help option Specified",
 	"ERROR: No\\Invalid command was specified\n",
-	"ERROR: Could not allocate buffer for Egress device\n"
+	"ERROR: Could not allocate buffer for Egress device\n",
+	"ERROR: Could not read batch file\n"
 };
 
 /*!
@@ -259,6 +263,11 @@ static void rmnet_api_usage(void)
 	printf("rmnetcli -n wdafreq       <real dev> set powersave poll freq\n\n");
 	printf(_2TABS" <vnd_name>              string - vnd device name\n\n");
 	printf(_2TABS" <freq>                  int - frequency\n\n");
+	printf("rmnetcli -n batch       <file>  run newlink, changelink,\n");
+	printf(_2TABS"                         dellink, flowactivate, flowdel\n");
+	printf(_2TABS"                         and flowcontrol commands from\n");
+	printf(_2TABS"                         file, one per line, in one\n");
+	printf(_2TABS"                         transaction. \"-\" reads stdin\n\n");
 
 }
 
@@ -300,6 +309,169 @@ static void print_rmnet_api_status(int return_code, uint16_t error_number)
 		printf("INVALID_ARG\n");
 }
 
+/*!
+* @brief Queue one line of a batch file
+* @details Takes the same arguments as the matching "rmnetcli -n" command
+* @param *batch Batch the request is queued on
+* @param argc Number of arguments of the line
+* @param argv Value of the arguments, NULL terminated
+* @param *error_number Error code if the request could not be queued
+* @return Status code of the queue call, RMNETCTL_INVALID_ARG if the line is
+* not a supported command
+*/
+static int rmnet_batch_queue_line(rmnetctl_batch_t *batch, int argc,
+				  char *argv[], uint16_t *error_number)
+{
+	if (!strcmp(*argv, "newlink") && argc >= 4) {
+		uint8_t offload = 0;
+		uint32_t flags = 0;
+
+		if (argv[4])
+			flags = _STRTOI32(argv[4]);
+
+		if (argv[4] && argv[5])
+			offload = _STRTOUI8(argv[5]);
+
+		return rtrmnet_batch_newvnd(batch, argv[1], argv[2],
+					    error_number, _STRTOI32(argv[3]),
+					    flags, offload);
+	} else if (!strcmp(*argv, "changelink") && argc >= 6) {
+		return rtrmnet_batch_changevnd(batch, argv[1], argv[2],
+					       error_number,
+					       _STRTOI32(argv[3]),
+					       _STRTOI32(argv[4]),
+					       _STRTOUI8(argv[5]));
+	} else if (!strcmp(*argv, "dellink") && argc >= 2) {
+		return rtrmnet_batch_delvnd(batch, argv[1], error_number);
+	} else if (!strcmp(*argv, "flowactivate") && argc >= 7) {
+		return rtrmnet_batch_activate_flow(batch, argv[1], argv[2],
+						   _STRTOUI8(argv[3]),
+						   _STRTOI32(argv[4]),
+						   _STRTOUI32(argv[5]),
+						   _STRTOUI32(argv[6]),
+						   error_number);
+	} else if (!strcmp(*argv, "flowdel") && argc >= 6) {
+		return rtrmnet_batch_delete_flow(batch, argv[1], argv[2],
+						 _STRTOUI8(argv[3]),
+						 _STRTOUI32(argv[4]),
+						 _STRTOI32(argv[5]),
+						 error_number);
+	} else if (!strcmp(*argv, "flowcontrol") && argc >= 7) {
+		return rtrmnet_batch_control_flow(batch, argv[1], argv[2],
+						  _STRTOUI8(argv[3]),
+						  _STRTOUI32(argv[4]),
+						  _STRTOUI16(argv[5]),
+						  _STRTOUI8(argv[6]),
+						  error_number);
+	}
+
+	return RMNETCTL_INVALID_ARG;
+}
+
+/*!
+* @brief Run the commands of a batch file in one transaction
+* @details Each non empty line not starting with '#' holds one command. All
+* lines are queued first, so a bad line stops the batch before anything is
+* sent. The status of every command is printed with its line number.
+* @param *handle Handle from rtrmnet_ctl_init()
+* @param *path Batch file, "-" for stdin
+* @param *error_number Error code of the first failure
+* @return Status code of rtrmnet_batch_commit(), or of the first line that
+* could not be queued
+*/
+static int rmnet_batch_call(rmnetctl_hndl_t *handle, char *path,
+			    uint16_t *error_number)
+{
+	char line[RMNET_BATCH_LINE_LEN];
+	char *argv[RMNET_BATCH_MAX_ARGS + 1];
+	rmnetctl_batch_t *batch = NULL;
+	uint32_t *line_nums = NULL, *tmp;
+	uint16_t *results = NULL;
+	uint32_t count = 0, max = 0, failed = 0, line_num = 0, i;
+	char *saveptr;
+	FILE *fp;
+	int return_code;
+	int argc;
+
+	fp = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	if (!fp) {
+		*error_number = RMNETCTL_CFG_FAILURE_BATCH_FILE;
+		return RMNETCTL_LIB_ERR;
+	}
+
+	return_code = rtrmnet_batch_init(handle, &batch, error_number);
+	if (return_code != RMNETCTL_SUCCESS)
+		goto out;
+
+	while (fgets(line, sizeof(line), fp)) {
+		line_num++;
+		argc = 0;
+		argv[argc] = strtok_r(line, " \t\r\n", &saveptr);
+		while (argv[argc] && argc < RMNET_BATCH_MAX_ARGS)
+			argv[++argc] = strtok_r(NULL, " \t\r\n", &saveptr);
+		argv[argc] = NULL;
+
+		if (!argc || argv[0][0] == '#')
+			continue;
+
+		if (count == max) {
+			max = max ? max * 2 : RMNETCTL_BATCH_MAX_INFLIGHT;
+			tmp = realloc(line_nums, max * sizeof(*line_nums));
+			if (!tmp) {
+				*error_number = RMNETCTL_API_ERR_REQUEST_NULL;
+				return_code = RMNETCTL_LIB_ERR;
+				goto out;
+			}
+			line_nums = tmp;
+		}
+
+		return_code = rmnet_batch_queue_line(batch, argc, argv,
+						     error_number);
+		if (return_code != RMNETCTL_SUCCESS) {
+			printf("line %u: ", line_num);
+			if (return_code == RMNETCTL_INVALID_ARG)
+				*error_number = RMNETCTL_CFG_FAILURE_BATCH_FILE;
+			goto out;
+		}
+
+		line_nums[count++] = line_num;
+	}
+
+	if (ferror(fp)) {
+		*error_number = RMNETCTL_CFG_FAILURE_BATCH_FILE;
+		return_code = RMNETCTL_LIB_ERR;
+		goto out;
+	}
+
+	if (count) {
+		results = calloc(count, sizeof(*results));
+		if (!results) {
+			*error_number = RMNETCTL_API_ERR_REQUEST_NULL;
+			return_code = RMNETCTL_LIB_ERR;
+			goto out;
+		}
+	}
+
+	return_code = rtrmnet_batch_commit(batch, results, count, &failed,
+					   error_number);
+	if (failed) {
+		for (i = 0; i < count; i++) {
+			if (results[i] == RMNETCTL_API_SUCCESS)
+				continue;
+			printf("line %u: error %u\n", line_nums[i], results[i]);
+		}
+	}
+	printf("%u of %u commands succeeded\n", count - failed, count);
+
+out:
+	free(results);
+	free(line_nums);
+	rtrmnet_batch_free(batch);
+	if (fp != stdin)
+		fclose(fp);
+	return return_code;
+}
+
 /*!
 * @brief Method to make the API calls
 * @details Checks for each type of parameter and calls the appropriate
@@ -512,6 +684,11 @@ static int rmnet_api_call(int argc, char *argv[])
 			return_code = rtrmnet_set_wda_freq(handle, argv[1], argv[2],
 							   _STRTOUI32(argv[3]),
 							   &error_number);
+		} else if (!strcmp(*argv, "batch")) {
+			_RMNETCLI_CHECKNULL(argv[1]);
+
+			return_code = rmnet_batch_call(handle, argv[1],
+						       &error_number);
 		}
 
 
@@ -51,11 +51,13 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define RMNETCTL_CFG_FAILURE_NO_COMMAND 101
 /* The buffer for egress device name was NULL */
 #define RMNETCTL_CFG_FAILURE_EGRESS_DEV_NAME_NULL 102
+/* The batch file could not be read or had an invalid line */
+#define RMNETCTL_CFG_FAILURE_BATCH_FILE 103
 
 /* This should always be the value of the starting element */
 #define RMNETCFG_ERR_NUM_START 100
 
 /* This should always be the total number of error message from CLI */
-#define RMNETCFG_TOTAL_ERR_MSGS 3
+#define RMNETCFG_TOTAL_ERR_MSGS 4
 
 #endif /* not defined RMNETCLI_H */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*!
+* @file    librmnetctl_batch.h
+* @brief   rmnet control API's for sending many requests in one transaction
+*/
+
+#ifndef LIBRMNETCTL_BATCH_H
+#define LIBRMNETCTL_BATCH_H
+
+#include <stdint.h>
+#include "librmnetctl.h"
+
+/* Requests sent in one send() before waiting for their acks */
+#define RMNETCTL_BATCH_MAX_INFLIGHT 32
+
+typedef struct rmnetctl_batch_s rmnetctl_batch_t;
+
+/* @brief Allocate an empty batch bound to a handle from rtrmnet_ctl_init()
+ * @param *hndl RmNet handle the batch is sent on
+ * @param **batch The new batch
+ * @param *error_code Status code of this operation
+ * @return RMNETCTL_SUCCESS if successful
+ * @return RMNETCTL_LIB_ERR if there was not enough memory
+ * @return RMNETCTL_INVALID_ARG if invalid arguments were passed
+ */
+int rtrmnet_batch_init(rmnetctl_hndl_t *hndl, rmnetctl_batch_t **batch,
+		       uint16_t *error_code);
+
+/* @brief Free a batch. Queued requests which were not committed are dropped
+ * @param *batch The batch
+ */
+void rtrmnet_batch_free(rmnetctl_batch_t *batch);
+
+/* @brief Number of requests queued in a batch */
+uint32_t rtrmnet_batch_count(rmnetctl_batch_t *batch);
+
+/* The queue functions take the same arguments as the matching rtrmnet_*
+ * function and only build the request. Nothing is sent until
+ * rtrmnet_batch_commit(). Device names are resolved when queueing.
+ */
+int rtrmnet_batch_newvnd(rmnetctl_batch_t *batch, char *devname,
+			 char *vndname, uint16_t *error_code, uint8_t index,
+			 uint32_t flagconfig, uint8_t offload);
+
+int rtrmnet_batch_delvnd(rmnetctl_batch_t *batch, char *vndname,
+			 uint16_t *error_code);
+
+int rtrmnet_batch_changevnd(rmnetctl_batch_t *batch, char *devname,
+			    char *vndname, uint16_t *error_code,
+			    uint8_t index, uint32_t flagconfig,
+			    uint8_t offload);
+
+int rtrmnet_batch_activate_flow(rmnetctl_batch_t *batch, char *devname,
+				char *vndname, uint8_t bearer_id,
+				uint32_t flow_id, int ip_type,
+				uint32_t tcm_handle, uint16_t *error_code);
+
+int rtrmnet_batch_delete_flow(rmnetctl_batch_t *batch, char *devname,
+			      char *vndname, uint8_t bearer_id,
+			      uint32_t flow_id, int ip_type,
+			      uint16_t *error_code);
+
+int rtrmnet_batch_control_flow(rmnetctl_batch_t *batch, char *devname,
+			       char *vndname, uint8_t bearer_id,
+			       uint16_t sequence, uint32_t grantsize,
+			       uint8_t ack, uint16_t *error_code);
+
+/* @brief Send all queued requests and collect their acks
+ * @details Requests are sent RMNETCTL_BATCH_MAX_INFLIGHT at a time in a
+ * single send(). Acks are matched to requests by sequence number. The kernel
+ * handles every request even when an earlier one fails. The batch is empty
+ * afterwards.
+ * @param *batch The batch
+ * @param *results Optional, one error code per request in queue order.
+ * 0 means success, otherwise the errno from the kernel
+ * @param num_results Number of entries in results
+ * @param *failed Optional, number of requests which failed
+ * @param *error_code Error code of the first failure
+ * @return RMNETCTL_SUCCESS if every request was acked without error
+ * @return RMNETCTL_KERNEL_ERR if the kernel rejected a request
+ * @return RMNETCTL_LIB_ERR if the requests could not be sent or acked
+ * @return RMNETCTL_INVALID_ARG if invalid arguments were passed
+ */
+int rtrmnet_batch_commit(rmnetctl_batch_t *batch, uint16_t *results,
+			 uint32_t num_results, uint32_t *failed,
+			 uint16_t *error_code);
+
+#endif /* not defined LIBRMNETCTL_BATCH_H */
@@ -56,6 +56,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <linux/rmnet_data.h>
 #include "librmnetctl_hndl.h"
 #include "librmnetctl.h"
+#include "librmnetctl_batch.h"
 
 #ifdef USE_GLIB
 #include <glib.h>
@@ -1403,27 +1404,26 @@ int rtrmnet_ctl_deinit(rmnetctl_hndl_t *hndl)
 	return RMNETCTL_SUCCESS;
 }
 
-int rtrmnet_ctl_newvnd(rmnetctl_hndl_t *hndl, char *devname, char *vndname,
-		       uint16_t *error_code, uint8_t  index,
-		       uint32_t flagconfig, uint8_t offload)
+/* @brief Fill a Netlink message for creating an rmnet device
+ * @details The sequence number is left for the caller to assign
+ * @return RMNETCTL_SUCCESS if the message is complete
+ * @return RMNETCTL_KERNEL_ERR if devname does not exist, errno in *error_code
+ * @return RMNETCTL_LIB_ERR if the RTAs do not fit the message
+ */
+static int rmnet_build_newvnd(struct nlmsg *req, char *devname, char *vndname,
+			      uint16_t *error_code, uint8_t index,
+			      uint32_t flagconfig, uint8_t offload)
 {
 	unsigned int devindex = 0;
-	struct nlmsg req;
 	size_t reqsize;
 	int rc;
 
-	if (!hndl || !devname || !vndname || !error_code ||
-	   _rmnetctl_check_dev_name(vndname) || _rmnetctl_check_dev_name(devname))
-		return RMNETCTL_INVALID_ARG;
-
-	memset(&req, 0, sizeof(req));
+	memset(req, 0, sizeof(*req));
 	reqsize = NLMSG_DATA_SIZE - sizeof(struct rtattr);
-	req.nl_addr.nlmsg_type = RTM_NEWLINK;
-	req.nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
-	req.nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL |
-				  NLM_F_ACK;
-	req.nl_addr.nlmsg_seq = hndl->transaction_id;
-	hndl->transaction_id++;
+	req->nl_addr.nlmsg_type = RTM_NEWLINK;
+	req->nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req->nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL |
+				   NLM_F_ACK;
 
 	/* Get index of devname*/
 	devindex = if_nametoindex(devname);
@@ -1433,39 +1433,28 @@ int rtrmnet_ctl_newvnd(rmnetctl_hndl_t *hndl, char *devname, char *vndname,
 	}
 
 	*error_code = RMNETCTL_API_ERR_RTA_FAILURE;
-	rc = rta_put_u32(&req, &reqsize, RMNET_IFLA_NUM_TX_QUEUES,
+	rc = rta_put_u32(req, &reqsize, RMNET_IFLA_NUM_TX_QUEUES,
 			 RMNETCTL_NUM_TX_QUEUES);
 	if (rc != RMNETCTL_SUCCESS)
 		return rc;
 
-	rc = rmnet_fill_newlink_msg(&req, &reqsize, devindex, vndname, index,
-				    flagconfig, offload);
-	if (rc != RMNETCTL_SUCCESS)
-		return rc;
-
-	if (send(hndl->netlink_fd, &req, req.nl_addr.nlmsg_len, 0) < 0) {
-		*error_code = RMNETCTL_API_ERR_MESSAGE_SEND;
-		return RMNETCTL_LIB_ERR;
-	}
-
-	return rmnet_get_ack(hndl, error_code);
+	return rmnet_fill_newlink_msg(req, &reqsize, devindex, vndname, index,
+				      flagconfig, offload);
 }
 
-int rtrmnet_ctl_delvnd(rmnetctl_hndl_t *hndl, char *vndname,
-		       uint16_t *error_code)
+/* @brief Fill a Netlink message for deleting an rmnet device
+ * @return RMNETCTL_SUCCESS if the message is complete
+ * @return RMNETCTL_KERNEL_ERR if vndname does not exist, errno in *error_code
+ */
+static int rmnet_build_delvnd(struct nlmsg *req, char *vndname,
+			      uint16_t *error_code)
 {
 	unsigned int devindex = 0;
-	struct nlmsg req;
 
-	if (!hndl || !vndname || !error_code)
-		return RMNETCTL_INVALID_ARG;
-
-	memset(&req, 0, sizeof(req));
-	req.nl_addr.nlmsg_type = RTM_DELLINK;
-	req.nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
-	req.nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
-	req.nl_addr.nlmsg_seq = hndl->transaction_id;
-	hndl->transaction_id++;
+	memset(req, 0, sizeof(*req));
+	req->nl_addr.nlmsg_type = RTM_DELLINK;
+	req->nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req->nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
 
 	/* Get index of vndname*/
 	devindex = if_nametoindex(vndname);
@@ -1475,37 +1464,29 @@ int rtrmnet_ctl_delvnd(rmnetctl_hndl_t *hndl, char *vndname,
 	}
 
 	/* Setup index attribute */
-	req.ifmsg.ifi_index = devindex;
-	if (send(hndl->netlink_fd, &req, req.nl_addr.nlmsg_len, 0) < 0) {
-		*error_code = RMNETCTL_API_ERR_MESSAGE_SEND;
-		return RMNETCTL_LIB_ERR;
-	}
-
-	return rmnet_get_ack(hndl, error_code);
+	req->ifmsg.ifi_index = devindex;
+	return RMNETCTL_SUCCESS;
 }
 
-
-int rtrmnet_ctl_changevnd(rmnetctl_hndl_t *hndl, char *devname, char *vndname,
-			  uint16_t *error_code, uint8_t  index,
-			  uint32_t flagconfig, uint8_t offload)
+/* @brief Fill a Netlink message for changing an rmnet device
+ * @return RMNETCTL_SUCCESS if the message is complete
+ * @return RMNETCTL_KERNEL_ERR if devname does not exist, errno in *error_code
+ * @return RMNETCTL_LIB_ERR if the RTAs do not fit the message
+ */
+static int rmnet_build_changevnd(struct nlmsg *req, char *devname,
+				 char *vndname, uint16_t *error_code,
+				 uint8_t index, uint32_t flagconfig,
+				 uint8_t offload)
 {
-	struct nlmsg req;
 	unsigned int devindex = 0;
 	size_t reqsize;
 	int rc;
 
-	memset(&req, 0, sizeof(req));
-
-	if (!hndl || !devname || !vndname || !error_code ||
-	    _rmnetctl_check_dev_name(vndname) || _rmnetctl_check_dev_name(devname))
-		return RMNETCTL_INVALID_ARG;
-
+	memset(req, 0, sizeof(*req));
 	reqsize = NLMSG_DATA_SIZE - sizeof(struct rtattr);
-	req.nl_addr.nlmsg_type = RTM_NEWLINK;
-	req.nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
-	req.nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
-	req.nl_addr.nlmsg_seq = hndl->transaction_id;
-	hndl->transaction_id++;
+	req->nl_addr.nlmsg_type = RTM_NEWLINK;
+	req->nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req->nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
 
 	/* Get index of devname*/
 	devindex = if_nametoindex(devname);
@@ -1514,14 +1495,28 @@ int rtrmnet_ctl_changevnd(rmnetctl_hndl_t *hndl, char *devname, char *vndname,
 		return RMNETCTL_KERNEL_ERR;
 	}
 
-	rc = rmnet_fill_newlink_msg(&req, &reqsize, devindex, vndname, index,
+	rc = rmnet_fill_newlink_msg(req, &reqsize, devindex, vndname, index,
 				    flagconfig, offload);
-	if (rc != RMNETCTL_SUCCESS) {
+	if (rc != RMNETCTL_SUCCESS)
 		*error_code = RMNETCTL_API_ERR_RTA_FAILURE;
-		return rc;
-	}
 
-	if (send(hndl->netlink_fd, &req, req.nl_addr.nlmsg_len, 0) < 0) {
+	return rc;
+}
+
+/* @brief Send a single request and wait for its ack
+ * @param *hndl RmNet handle for this transaction
+ * @param *req The Netlink message, the sequence number is assigned here
+ * @param *error_code Error code if transaction fails
+ * @return The result of rmnet_get_ack()
+ * @return RMNETCTL_LIB_ERR if the message could not be sent
+ */
+static int rmnet_send_req(rmnetctl_hndl_t *hndl, struct nlmsg *req,
+			  uint16_t *error_code)
+{
+	req->nl_addr.nlmsg_seq = hndl->transaction_id;
+	hndl->transaction_id++;
+
+	if (send(hndl->netlink_fd, req, req->nl_addr.nlmsg_len, 0) < 0) {
 		*error_code = RMNETCTL_API_ERR_MESSAGE_SEND;
 		return RMNETCTL_LIB_ERR;
 	}
@@ -1529,6 +1524,61 @@ int rtrmnet_ctl_changevnd(rmnetctl_hndl_t *hndl, char *devname, char *vndname,
 	return rmnet_get_ack(hndl, error_code);
 }
 
+int rtrmnet_ctl_newvnd(rmnetctl_hndl_t *hndl, char *devname, char *vndname,
+		       uint16_t *error_code, uint8_t  index,
+		       uint32_t flagconfig, uint8_t offload)
+{
+	struct nlmsg req;
+	int rc;
+
+	if (!hndl || !devname || !vndname || !error_code ||
+	   _rmnetctl_check_dev_name(vndname) || _rmnetctl_check_dev_name(devname))
+		return RMNETCTL_INVALID_ARG;
+
+	rc = rmnet_build_newvnd(&req, devname, vndname, error_code, index,
+				flagconfig, offload);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_send_req(hndl, &req, error_code);
+}
+
+int rtrmnet_ctl_delvnd(rmnetctl_hndl_t *hndl, char *vndname,
+		       uint16_t *error_code)
+{
+	struct nlmsg req;
+	int rc;
+
+	if (!hndl || !vndname || !error_code)
+		return RMNETCTL_INVALID_ARG;
+
+	rc = rmnet_build_delvnd(&req, vndname, error_code);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_send_req(hndl, &req, error_code);
+}
+
+
+int rtrmnet_ctl_changevnd(rmnetctl_hndl_t *hndl, char *devname, char *vndname,
+			  uint16_t *error_code, uint8_t  index,
+			  uint32_t flagconfig, uint8_t offload)
+{
+	struct nlmsg req;
+	int rc;
+
+	if (!hndl || !devname || !vndname || !error_code ||
+	    _rmnetctl_check_dev_name(vndname) || _rmnetctl_check_dev_name(devname))
+		return RMNETCTL_INVALID_ARG;
+
+	rc = rmnet_build_changevnd(&req, devname, vndname, error_code, index,
+				   flagconfig, offload);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_send_req(hndl, &req, error_code);
+}
+
 int rtrmnet_ctl_getvnd(rmnetctl_hndl_t *hndl, char *vndname,
 		       uint16_t *error_code, uint16_t *mux_id,
 		       uint32_t *flagconfig, uint8_t *agg_count,
@@ -1782,6 +1832,78 @@ int rtrmnet_set_uplink_aggregation_params(rmnetctl_hndl_t *hndl,
 
 }
 
+/* @brief Fill a Netlink message carrying a DFC flow message
+ * @param *req The Netlink message
+ * @param *devname The name of the real physical device
+ * @param *vndname The name of the VND we're modifying
+ * @param *flowinfo The parameters sent to the DFC driver
+ * @param *error_code Error code if the message could not be filled
+ * @return RMNETCTL_SUCCESS if the message is complete
+ * @return RMNETCTL_KERNEL_ERR if devname does not exist, errno in *error_code
+ * @return RMNETCTL_LIB_ERR if the RTAs do not fit the message
+ */
+static int rmnet_build_flow(struct nlmsg *req, char *devname, char *vndname,
+			    struct tcmsg *flowinfo, uint16_t *error_code)
+{
+	unsigned int devindex = 0;
+	size_t reqsize;
+	int rc;
+
+	memset(req, 0, sizeof(*req));
+	reqsize = NLMSG_DATA_SIZE - sizeof(struct rtattr);
+	req->nl_addr.nlmsg_type = RTM_NEWLINK;
+	req->nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req->nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+
+	/* Get index of devname*/
+	devindex = if_nametoindex(devname);
+	if (devindex == 0) {
+		*error_code = errno;
+		return RMNETCTL_KERNEL_ERR;
+	}
+
+	rc = rmnet_fill_flow_msg(req, &reqsize, devindex, vndname,
+				 (char *)flowinfo, sizeof(*flowinfo));
+	if (rc != RMNETCTL_SUCCESS)
+		*error_code = RMNETCTL_API_ERR_RTA_FAILURE;
+
+	return rc;
+}
+
+static void rmnet_activate_flowinfo(struct tcmsg *flowinfo, uint8_t bearer_id,
+				    uint32_t flow_id, int ip_type,
+				    uint32_t tcm_handle)
+{
+	memset(flowinfo, 0, sizeof(*flowinfo));
+	flowinfo->tcm_handle = tcm_handle;
+	flowinfo->tcm_family = RMNET_FLOW_MSG_ACTIVATE;
+	flowinfo->tcm__pad1 = bearer_id;
+	flowinfo->tcm_ifindex = ip_type;
+	flowinfo->tcm_parent = flow_id;
+}
+
+static void rmnet_delete_flowinfo(struct tcmsg *flowinfo, uint8_t bearer_id,
+				  uint32_t flow_id, int ip_type)
+{
+	memset(flowinfo, 0, sizeof(*flowinfo));
+	flowinfo->tcm_family = RMNET_FLOW_MSG_DEACTIVATE;
+	flowinfo->tcm_ifindex = ip_type;
+	flowinfo->tcm__pad1 = bearer_id;
+	flowinfo->tcm_parent = flow_id;
+}
+
+static void rmnet_control_flowinfo(struct tcmsg *flowinfo, uint8_t bearer_id,
+				   uint16_t sequence, uint32_t grantsize,
+				   uint8_t ack)
+{
+	memset(flowinfo, 0, sizeof(*flowinfo));
+	flowinfo->tcm_family = RMNET_FLOW_MSG_CONTROL;
+	flowinfo->tcm__pad1 = bearer_id;
+	flowinfo->tcm__pad2 = sequence;
+	flowinfo->tcm_parent = ack;
+	flowinfo->tcm_info = grantsize;
+}
+
 int rtrmnet_activate_flow(rmnetctl_hndl_t *hndl,
 			  char *devname,
 			  char *vndname,
@@ -1793,51 +1915,19 @@ int rtrmnet_activate_flow(rmnetctl_hndl_t *hndl,
 {
 	struct tcmsg  flowinfo;
 	struct nlmsg req;
-	unsigned int devindex = 0;
-	size_t reqsize =0;
 	int rc;
 
-	memset(&req, 0, sizeof(req));
-	memset(&flowinfo, 0, sizeof(flowinfo));
-
-
 	if (!hndl || !devname || !error_code ||_rmnetctl_check_dev_name(devname) ||
 		_rmnetctl_check_dev_name(vndname))
 		return RMNETCTL_INVALID_ARG;
 
-	reqsize = NLMSG_DATA_SIZE - sizeof(struct rtattr);
-	req.nl_addr.nlmsg_type = RTM_NEWLINK;
-	req.nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
-	req.nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
-	req.nl_addr.nlmsg_seq = hndl->transaction_id;
-	hndl->transaction_id++;
-
-	/* Get index of devname*/
-	devindex = if_nametoindex(devname);
-	if (devindex == 0) {
-		*error_code = errno;
-		return RMNETCTL_KERNEL_ERR;
-	}
-
-	flowinfo.tcm_handle = tcm_handle;
-	flowinfo.tcm_family = RMNET_FLOW_MSG_ACTIVATE;
-	flowinfo.tcm__pad1 = bearer_id;
-	flowinfo.tcm_ifindex = ip_type;
-	flowinfo.tcm_parent = flow_id;
-
-	rc = rmnet_fill_flow_msg(&req, &reqsize, devindex, vndname,
-				 (char *)&flowinfo, sizeof(flowinfo));
-	if (rc != RMNETCTL_SUCCESS) {
-		*error_code = RMNETCTL_API_ERR_RTA_FAILURE;
+	rmnet_activate_flowinfo(&flowinfo, bearer_id, flow_id, ip_type,
+				tcm_handle);
+	rc = rmnet_build_flow(&req, devname, vndname, &flowinfo, error_code);
+	if (rc != RMNETCTL_SUCCESS)
 		return rc;
-	}
 
-	if (send(hndl->netlink_fd, &req, req.nl_addr.nlmsg_len, 0) < 0) {
-		*error_code = RMNETCTL_API_ERR_MESSAGE_SEND;
-		return RMNETCTL_LIB_ERR;
-	}
-
-	return rmnet_get_ack(hndl, error_code);
+	return rmnet_send_req(hndl, &req, error_code);
 }
 
 
@@ -1851,49 +1941,18 @@ int rtrmnet_delete_flow(rmnetctl_hndl_t *hndl,
 {
 	struct tcmsg  flowinfo;
 	struct nlmsg req;
-	unsigned int devindex = 0;
-	size_t reqsize;
 	int rc;
 
-	memset(&req, 0, sizeof(req));
-	memset(&flowinfo, 0, sizeof(flowinfo));
-
 	if (!hndl || !devname || !error_code ||_rmnetctl_check_dev_name(devname) ||
 		_rmnetctl_check_dev_name(vndname))
 		return RMNETCTL_INVALID_ARG;
 
-	reqsize = NLMSG_DATA_SIZE - sizeof(struct rtattr);
-	req.nl_addr.nlmsg_type = RTM_NEWLINK;
-	req.nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
-	req.nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
-	req.nl_addr.nlmsg_seq = hndl->transaction_id;
-	hndl->transaction_id++;
-
-	/* Get index of devname*/
-	devindex = if_nametoindex(devname);
-	if (devindex == 0) {
-		*error_code = errno;
-		return RMNETCTL_KERNEL_ERR;
-	}
-
-	flowinfo.tcm_family = RMNET_FLOW_MSG_DEACTIVATE;
-	flowinfo.tcm_ifindex = ip_type;
-	flowinfo.tcm__pad1 = bearer_id;
-	flowinfo.tcm_parent = flow_id;
-
-	rc = rmnet_fill_flow_msg(&req, &reqsize, devindex, vndname,
-				 (char *)&flowinfo, sizeof(flowinfo));
-	if (rc != RMNETCTL_SUCCESS) {
-		*error_code = RMNETCTL_API_ERR_RTA_FAILURE;
+	rmnet_delete_flowinfo(&flowinfo, bearer_id, flow_id, ip_type);
+	rc = rmnet_build_flow(&req, devname, vndname, &flowinfo, error_code);
+	if (rc != RMNETCTL_SUCCESS)
 		return rc;
-	}
-
-	if (send(hndl->netlink_fd, &req, req.nl_addr.nlmsg_len, 0) < 0) {
-		*error_code = RMNETCTL_API_ERR_MESSAGE_SEND;
-		return RMNETCTL_LIB_ERR;
-	}
 
-	return rmnet_get_ack(hndl, error_code);
+	return rmnet_send_req(hndl, &req, error_code);
 }
 
 int rtrmnet_control_flow(rmnetctl_hndl_t *hndl,
@@ -1907,50 +1966,18 @@ int rtrmnet_control_flow(rmnetctl_hndl_t *hndl,
 {
 	struct tcmsg  flowinfo;
 	struct nlmsg req;
-	unsigned int devindex = 0;
-	size_t reqsize;
 	int rc;
 
-	memset(&req, 0, sizeof(req));
-	memset(&flowinfo, 0, sizeof(flowinfo));
-
 	if (!hndl || !devname || !error_code ||_rmnetctl_check_dev_name(devname) ||
 		_rmnetctl_check_dev_name(vndname))
 		return RMNETCTL_INVALID_ARG;
 
-	reqsize = NLMSG_DATA_SIZE - sizeof(struct rtattr);
-	req.nl_addr.nlmsg_type = RTM_NEWLINK;
-	req.nl_addr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
-	req.nl_addr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
-	req.nl_addr.nlmsg_seq = hndl->transaction_id;
-	hndl->transaction_id++;
-
-	/* Get index of devname*/
-	devindex = if_nametoindex(devname);
-	if (devindex == 0) {
-		*error_code = errno;
-		return RMNETCTL_KERNEL_ERR;
-	}
-
-	flowinfo.tcm_family = RMNET_FLOW_MSG_CONTROL;
-	flowinfo.tcm__pad1 = bearer_id;
-	flowinfo.tcm__pad2 = sequence;
-	flowinfo.tcm_parent = ack;
-	flowinfo.tcm_info = grantsize;
-
-	rc = rmnet_fill_flow_msg(&req, &reqsize, devindex, vndname,
-				 (char *)&flowinfo, sizeof(flowinfo));
-	if (rc != RMNETCTL_SUCCESS) {
-		*error_code = RMNETCTL_API_ERR_RTA_FAILURE;
+	rmnet_control_flowinfo(&flowinfo, bearer_id, sequence, grantsize, ack);
+	rc = rmnet_build_flow(&req, devname, vndname, &flowinfo, error_code);
+	if (rc != RMNETCTL_SUCCESS)
 		return rc;
-	}
 
-	if (send(hndl->netlink_fd, &req, req.nl_addr.nlmsg_len, 0) < 0) {
-		*error_code = RMNETCTL_API_ERR_MESSAGE_SEND;
-		return RMNETCTL_LIB_ERR;
-	}
-
-	return rmnet_get_ack(hndl, error_code);
+	return rmnet_send_req(hndl, &req, error_code);
 }
 
 
@@ -2275,3 +2302,341 @@ int rtrmnet_remove_filters(rmnetctl_hndl_t *hndl,
 
 	return rmnet_get_ack(hndl, error_code);
 }
+
+/*
+ *                       BATCHED NEW DRIVER API
+ */
+
+/* Error code of a request which has not been acked yet */
+#define RMNETCTL_BATCH_PENDING 0xFFFF
+#define RMNETCTL_BATCH_ACK_BUF_SIZE 8192
+
+struct rmnetctl_batch_s {
+	rmnetctl_hndl_t *hndl;
+	/* Queued requests, back to back */
+	char *buf;
+	size_t len;
+	size_t size;
+	/* Error code of each request, in queue order */
+	uint16_t *results;
+	uint32_t count;
+	uint32_t max;
+};
+
+int rtrmnet_batch_init(rmnetctl_hndl_t *hndl, rmnetctl_batch_t **batch,
+		       uint16_t *error_code)
+{
+	if (!hndl || !batch || !error_code)
+		return RMNETCTL_INVALID_ARG;
+
+	*batch = calloc(1, sizeof(rmnetctl_batch_t));
+	if (!*batch) {
+		*error_code = RMNETCTL_API_ERR_HNDL_INVALID;
+		return RMNETCTL_LIB_ERR;
+	}
+
+	(*batch)->hndl = hndl;
+	return RMNETCTL_SUCCESS;
+}
+
+void rtrmnet_batch_free(rmnetctl_batch_t *batch)
+{
+	if (!batch)
+		return;
+
+	free(batch->buf);
+	free(batch->results);
+	free(batch);
+}
+
+uint32_t rtrmnet_batch_count(rmnetctl_batch_t *batch)
+{
+	return batch ? batch->count : 0;
+}
+
+/* @brief Append a filled request to the batch
+ * @return RMNETCTL_SUCCESS if the request was queued
+ * @return RMNETCTL_LIB_ERR if there was not enough memory
+ */
+static int rmnet_batch_queue(rmnetctl_batch_t *batch, struct nlmsg *req,
+			     uint16_t *error_code)
+{
+	size_t len = NLMSG_ALIGN(req->nl_addr.nlmsg_len);
+
+	if (batch->len + len > batch->size) {
+		size_t size = batch->size ? batch->size * 2 :
+			      RMNETCTL_BATCH_MAX_INFLIGHT * sizeof(*req);
+		char *buf;
+
+		while (size < batch->len + len)
+			size *= 2;
+
+		buf = realloc(batch->buf, size);
+		if (!buf) {
+			*error_code = RMNETCTL_API_ERR_REQUEST_NULL;
+			return RMNETCTL_LIB_ERR;
+		}
+
+		batch->buf = buf;
+		batch->size = size;
+	}
+
+	if (batch->count == batch->max) {
+		uint32_t max = batch->max ? batch->max * 2 :
+			       RMNETCTL_BATCH_MAX_INFLIGHT;
+		uint16_t *results;
+
+		results = realloc(batch->results, max * sizeof(*results));
+		if (!results) {
+			*error_code = RMNETCTL_API_ERR_REQUEST_NULL;
+			return RMNETCTL_LIB_ERR;
+		}
+
+		batch->results = results;
+		batch->max = max;
+	}
+
+	memset(batch->buf + batch->len, 0, len);
+	memcpy(batch->buf + batch->len, req, req->nl_addr.nlmsg_len);
+	batch->len += len;
+	batch->results[batch->count++] = RMNETCTL_BATCH_PENDING;
+	*error_code = RMNETCTL_API_SUCCESS;
+	return RMNETCTL_SUCCESS;
+}
+
+int rtrmnet_batch_newvnd(rmnetctl_batch_t *batch, char *devname,
+			 char *vndname, uint16_t *error_code, uint8_t index,
+			 uint32_t flagconfig, uint8_t offload)
+{
+	struct nlmsg req;
+	int rc;
+
+	if (!batch || !devname || !vndname || !error_code ||
+	   _rmnetctl_check_dev_name(vndname) || _rmnetctl_check_dev_name(devname))
+		return RMNETCTL_INVALID_ARG;
+
+	rc = rmnet_build_newvnd(&req, devname, vndname, error_code, index,
+				flagconfig, offload);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_batch_queue(batch, &req, error_code);
+}
+
+int rtrmnet_batch_delvnd(rmnetctl_batch_t *batch, char *vndname,
+			 uint16_t *error_code)
+{
+	struct nlmsg req;
+	int rc;
+
+	if (!batch || !vndname || !error_code)
+		return RMNETCTL_INVALID_ARG;
+
+	rc = rmnet_build_delvnd(&req, vndname, error_code);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_batch_queue(batch, &req, error_code);
+}
+
+int rtrmnet_batch_changevnd(rmnetctl_batch_t *batch, char *devname,
+			    char *vndname, uint16_t *error_code,
+			    uint8_t index, uint32_t flagconfig,
+			    uint8_t offload)
+{
+	struct nlmsg req;
+	int rc;
+
+	if (!batch || !devname || !vndname || !error_code ||
+	    _rmnetctl_check_dev_name(vndname) || _rmnetctl_check_dev_name(devname))
+		return RMNETCTL_INVALID_ARG;
+
+	rc = rmnet_build_changevnd(&req, devname, vndname, error_code, index,
+				   flagconfig, offload);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_batch_queue(batch, &req, error_code);
+}
+
+int rtrmnet_batch_activate_flow(rmnetctl_batch_t *batch, char *devname,
+				char *vndname, uint8_t bearer_id,
+				uint32_t flow_id, int ip_type,
+				uint32_t tcm_handle, uint16_t *error_code)
+{
+	struct tcmsg  flowinfo;
+	struct nlmsg req;
+	int rc;
+
+	if (!batch || !devname || !error_code ||_rmnetctl_check_dev_name(devname) ||
+		_rmnetctl_check_dev_name(vndname))
+		return RMNETCTL_INVALID_ARG;
+
+	rmnet_activate_flowinfo(&flowinfo, bearer_id, flow_id, ip_type,
+				tcm_handle);
+	rc = rmnet_build_flow(&req, devname, vndname, &flowinfo, error_code);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_batch_queue(batch, &req, error_code);
+}
+
+int rtrmnet_batch_delete_flow(rmnetctl_batch_t *batch, char *devname,
+			      char *vndname, uint8_t bearer_id,
+			      uint32_t flow_id, int ip_type,
+			      uint16_t *error_code)
+{
+	struct tcmsg  flowinfo;
+	struct nlmsg req;
+	int rc;
+
+	if (!batch || !devname || !error_code ||_rmnetctl_check_dev_name(devname) ||
+		_rmnetctl_check_dev_name(vndname))
+		return RMNETCTL_INVALID_ARG;
+
+	rmnet_delete_flowinfo(&flowinfo, bearer_id, flow_id, ip_type);
+	rc = rmnet_build_flow(&req, devname, vndname, &flowinfo, error_code);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_batch_queue(batch, &req, error_code);
+}
+
+int rtrmnet_batch_control_flow(rmnetctl_batch_t *batch, char *devname,
+			       char *vndname, uint8_t bearer_id,
+			       uint16_t sequence, uint32_t grantsize,
+			       uint8_t ack, uint16_t *error_code)
+{
+	struct tcmsg  flowinfo;
+	struct nlmsg req;
+	int rc;
+
+	if (!batch || !devname || !error_code ||_rmnetctl_check_dev_name(devname) ||
+		_rmnetctl_check_dev_name(vndname))
+		return RMNETCTL_INVALID_ARG;
+
+	rmnet_control_flowinfo(&flowinfo, bearer_id, sequence, grantsize, ack);
+	rc = rmnet_build_flow(&req, devname, vndname, &flowinfo, error_code);
+	if (rc != RMNETCTL_SUCCESS)
+		return rc;
+
+	return rmnet_batch_queue(batch, &req, error_code);
+}
+
+/* @brief Receive acks until every request of a chunk has one
+ * @details Acks are matched on the sequence number of the request they
+ * answer, so acks arriving in any order or several per datagram are handled.
+ * @param *batch The batch
+ * @param first Index of the first request of the chunk
+ * @param num Number of requests in the chunk
+ * @param first_seq Sequence number of the first request of the chunk
+ * @param *error_code Error code if receiving fails
+ * @return RMNETCTL_SUCCESS if every request of the chunk was acked
+ * @return RMNETCTL_API_ERR_MESSAGE_RECEIVE if receiving failed
+ */
+static int rmnet_batch_get_acks(rmnetctl_batch_t *batch, uint32_t first,
+				uint32_t num, uint32_t first_seq,
+				uint16_t *error_code)
+{
+	char buf[RMNETCTL_BATCH_ACK_BUF_SIZE]
+		__attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh;
+	struct nlmsgerr *err;
+	uint32_t pending = num;
+	uint32_t index;
+	int len;
+
+	while (pending) {
+		len = recv(batch->hndl->netlink_fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			*error_code = errno;
+			return RMNETCTL_API_ERR_MESSAGE_RECEIVE;
+		}
+
+		for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type != NLMSG_ERROR)
+				continue;
+
+			index = nlh->nlmsg_seq - first_seq;
+			if (index >= num ||
+			    batch->results[first + index] != RMNETCTL_BATCH_PENDING)
+				continue;
+
+			err = (struct nlmsgerr *)NLMSG_DATA(nlh);
+			batch->results[first + index] = err->error ?
+				-err->error : RMNETCTL_API_SUCCESS;
+			pending--;
+		}
+	}
+
+	return RMNETCTL_SUCCESS;
+}
+
+int rtrmnet_batch_commit(rmnetctl_batch_t *batch, uint16_t *results,
+			 uint32_t num_results, uint32_t *failed,
+			 uint16_t *error_code)
+{
+	struct nlmsghdr *nlh;
+	uint32_t first_seq;
+	uint32_t nfailed = 0;
+	uint32_t first, i;
+	size_t off, chunk;
+	int rc = RMNETCTL_SUCCESS;
+
+	if (!batch || !error_code || (num_results && !results))
+		return RMNETCTL_INVALID_ARG;
+
+	*error_code = RMNETCTL_API_SUCCESS;
+	off = 0;
+	for (first = 0; first < batch->count; first += i) {
+		/* Number the chunk and send it in one go */
+		first_seq = batch->hndl->transaction_id;
+		chunk = 0;
+		for (i = 0; i < RMNETCTL_BATCH_MAX_INFLIGHT &&
+			    first + i < batch->count; i++) {
+			nlh = (struct nlmsghdr *)(batch->buf + off + chunk);
+			nlh->nlmsg_seq = batch->hndl->transaction_id;
+			batch->hndl->transaction_id++;
+			chunk += NLMSG_ALIGN(nlh->nlmsg_len);
+		}
+
+		if (send(batch->hndl->netlink_fd, batch->buf + off, chunk, 0) < 0) {
+			*error_code = RMNETCTL_API_ERR_MESSAGE_SEND;
+			rc = RMNETCTL_LIB_ERR;
+			break;
+		}
+
+		if (rmnet_batch_get_acks(batch, first, i, first_seq,
+					 error_code) != RMNETCTL_SUCCESS) {
+			rc = RMNETCTL_LIB_ERR;
+			break;
+		}
+
+		off += chunk;
+	}
+
+	/* Requests which were not sent or acked fail with the library error */
+	for (i = 0; i < batch->count; i++) {
+		if (batch->results[i] == RMNETCTL_BATCH_PENDING)
+			batch->results[i] = *error_code;
+
+		if (batch->results[i] != RMNETCTL_API_SUCCESS) {
+			if (!nfailed && rc == RMNETCTL_SUCCESS) {
+				*error_code = batch->results[i];
+				rc = RMNETCTL_KERNEL_ERR;
+			}
+			nfailed++;
+		}
+
+		if (i < num_results)
+			results[i] = batch->results[i];
+	}
+
+	if (failed)
+		*failed = nfailed;
+
+	batch->len = 0;
+	batch->count = 0;
+	return rc;
+}
@@ -217,6 +217,39 @@ struct br_fdb_event {
 
 extern void br_fdb_register_notify(struct notifier_block *nb);
 extern void br_fdb_unregister_notify(struct notifier_block *nb);
+
+#define BR_FDB_EVENT_REFRESH 0x03
+
+/* Maximum number of events carried by one batched notification */
+#define BR_FDB_BATCH_MAX     256
+
+/* One FDB event of a batched notification. The device reference is
+ * held by the bridge until the notifier chain returns.
+ */
+struct br_fdb_batch_entry {
+	unsigned char addr[6];
+	__u16 vid;
+	unsigned char event;
+	unsigned char is_local;
+	struct net_device *dev;
+};
+
+/* Batched FDB notification, delivered from process context.
+ *
+ * Events are delivered in the order they were generated, across all
+ * bridges, so the ADD/DEL/REFRESH sequence of a given MAC/VLAN is
+ * preserved. Refresh events are rate-limited per FDB entry. If the
+ * queue overflowed since the previous batch, 'dropped' is non-zero and
+ * listeners must resynchronize their state from the FDB.
+ */
+struct br_fdb_event_batch {
+	unsigned int count;
+	unsigned int dropped;
+	struct br_fdb_batch_entry *entries;
+};
+
+extern void br_fdb_batch_register_notify(struct notifier_block *nb);
+extern void br_fdb_batch_unregister_notify(struct notifier_block *nb);
 extern struct net_device *br_fdb_bridge_dev_get_and_hold(struct net_bridge *br);
 extern int br_fdb_delete_by_netdev(struct net_device *dev,
 			const unsigned char *addr, u16 vid);
@@ -152,6 +152,7 @@ struct xfrm_state {
 	};
 	struct hlist_node	bysrc;
 	struct hlist_node	byspi;
+	struct hlist_node	byspi_family;
 
 	refcount_t		refcnt;
 	spinlock_t		lock;
@@ -214,6 +215,9 @@ struct xfrm_state {
 	/* The functions for replay detection. */
 	const struct xfrm_replay *repl;
 
+	/* Sharded replay windows and per-CPU lifetime counters, if enabled */
+	struct xfrm_replay_pcpu	*replay_pcpu;
+
 	/* internal flag that only holds state for delayed aevent at the
 	 * moment
 	*/
@@ -1563,6 +1567,10 @@ void xfrm_sad_getinfo(struct net *net, struct xfrmk_sadinfo *si);
 void xfrm_spd_getinfo(struct net *net, struct xfrmk_spdinfo *si);
 u32 xfrm_replay_seqhi(struct xfrm_state *x, __be32 net_seq);
 int xfrm_init_replay(struct xfrm_state *x);
+void xfrm_replay_pcpu_free(struct xfrm_state *x);
+void xfrm_replay_pcpu_merge(struct xfrm_state *x);
+void xfrm_replay_pcpu_resync(struct xfrm_state *x);
+void xfrm_replay_pcpu_account(struct xfrm_state *x, unsigned int len);
 u32 xfrm_state_mtu(struct xfrm_state *x, int mtu);
 int __xfrm_init_state(struct xfrm_state *x, bool init_replay, bool offload);
 int xfrm_init_state(struct xfrm_state *x);
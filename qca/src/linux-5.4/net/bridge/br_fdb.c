@@ -51,6 +51,128 @@ void br_fdb_unregister_notify(struct notifier_block *nb)
 }
 EXPORT_SYMBOL_GPL(br_fdb_unregister_notify);
 
+/* Batched FDB notifications
+ *
+ * Listeners that mirror the FDB (offload engines) can register here
+ * instead of being called once per address from atomic context. Events
+ * are queued by the datapath into a single FIFO and delivered from a
+ * work item as vectors of up to BR_FDB_BATCH_MAX entries, which keeps
+ * the per-MAC ADD/DEL/REFRESH ordering intact.
+ */
+#define BR_FDB_BATCH_QUEUE_LEN		1024
+#define BR_FDB_BATCH_REFRESH_INTERVAL	HZ
+
+struct br_fdb_batch_queue {
+	spinlock_t lock;
+	unsigned int head;
+	unsigned int count;
+	unsigned int dropped;
+	struct br_fdb_batch_entry entries[BR_FDB_BATCH_QUEUE_LEN];
+};
+
+static BLOCKING_NOTIFIER_HEAD(br_fdb_batch_notifier_list);
+static struct br_fdb_batch_queue br_fdb_batch_queue = {
+	.lock = __SPIN_LOCK_UNLOCKED(br_fdb_batch_queue.lock),
+};
+
+/* Only touched by the work item, which never runs concurrently with itself */
+static struct br_fdb_batch_entry br_fdb_batch_vec[BR_FDB_BATCH_MAX];
+
+static void br_fdb_batch_work_fn(struct work_struct *work)
+{
+	struct br_fdb_batch_queue *q = &br_fdb_batch_queue;
+	struct br_fdb_event_batch batch;
+	unsigned long flags;
+	unsigned int i, n;
+
+	for (;;) {
+		spin_lock_irqsave(&q->lock, flags);
+		n = min_t(unsigned int, q->count, BR_FDB_BATCH_MAX);
+		for (i = 0; i < n; i++) {
+			br_fdb_batch_vec[i] = q->entries[q->head];
+			q->head = (q->head + 1) % BR_FDB_BATCH_QUEUE_LEN;
+		}
+		q->count -= n;
+		batch.dropped = q->dropped;
+		q->dropped = 0;
+		spin_unlock_irqrestore(&q->lock, flags);
+
+		if (!n && !batch.dropped)
+			break;
+
+		batch.count = n;
+		batch.entries = br_fdb_batch_vec;
+		blocking_notifier_call_chain(&br_fdb_batch_notifier_list, 0,
+					     (void *)&batch);
+
+		for (i = 0; i < n; i++)
+			dev_put(br_fdb_batch_vec[i].dev);
+
+		cond_resched();
+	}
+}
+
+static DECLARE_WORK(br_fdb_batch_work, br_fdb_batch_work_fn);
+
+static void br_fdb_batch_queue_event(const struct net_bridge_fdb_entry *fdb,
+				     struct net_device *dev,
+				     unsigned char event)
+{
+	struct br_fdb_batch_queue *q = &br_fdb_batch_queue;
+	struct br_fdb_batch_entry *e;
+	unsigned long flags;
+
+	if (!rcu_access_pointer(br_fdb_batch_notifier_list.head))
+		return;
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (unlikely(q->count == BR_FDB_BATCH_QUEUE_LEN)) {
+		q->dropped++;
+	} else {
+		e = &q->entries[(q->head + q->count) % BR_FDB_BATCH_QUEUE_LEN];
+		ether_addr_copy(e->addr, fdb->key.addr.addr);
+		e->vid = fdb->key.vlan_id;
+		e->event = event;
+		e->is_local = fdb->is_local;
+		e->dev = dev;
+		dev_hold(dev);
+		q->count++;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	schedule_work(&br_fdb_batch_work);
+}
+
+/* Refreshes are only reported once per BR_FDB_BATCH_REFRESH_INTERVAL
+ * for a given entry; a racing update may at worst report it twice.
+ */
+static void br_fdb_batch_refresh(struct net_bridge_fdb_entry *fdb,
+				 const struct net_bridge_port *dst,
+				 unsigned long now)
+{
+	if (!dst || !rcu_access_pointer(br_fdb_batch_notifier_list.head))
+		return;
+
+	if (time_before(now, fdb->batch_refreshed +
+			BR_FDB_BATCH_REFRESH_INTERVAL))
+		return;
+
+	fdb->batch_refreshed = now;
+	br_fdb_batch_queue_event(fdb, dst->dev, BR_FDB_EVENT_REFRESH);
+}
+
+void br_fdb_batch_register_notify(struct notifier_block *nb)
+{
+	blocking_notifier_chain_register(&br_fdb_batch_notifier_list, nb);
+}
+EXPORT_SYMBOL_GPL(br_fdb_batch_register_notify);
+
+void br_fdb_batch_unregister_notify(struct notifier_block *nb)
+{
+	blocking_notifier_chain_unregister(&br_fdb_batch_notifier_list, nb);
+}
+EXPORT_SYMBOL_GPL(br_fdb_batch_unregister_notify);
+
 int __init br_fdb_init(void)
 {
 	br_fdb_cache = kmem_cache_create("bridge_fdb_cache",
@@ -65,6 +187,7 @@ int __init br_fdb_init(void)
 
 void br_fdb_fini(void)
 {
+	flush_work(&br_fdb_batch_work);
 	kmem_cache_destroy(br_fdb_cache);
 }
 
@@ -536,6 +659,7 @@ static struct net_bridge_fdb_entry *fdb_create(struct net_bridge *br,
 		fdb->offloaded = 0;
 		fdb->is_sticky = 0;
 		fdb->updated = fdb->used = jiffies;
+		fdb->batch_refreshed = fdb->updated;
 		if (rhashtable_lookup_insert_fast(&br->fdb_hash_tbl,
 						  &fdb->rhnode,
 						  br_fdb_rht_params)) {
@@ -647,6 +771,8 @@ void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 			if (unlikely(fdb_modified)) {
 				trace_br_fdb_update(br, source, addr, vid, added_by_user);
 				fdb_notify(br, fdb, RTM_NEWNEIGH, true);
+			} else {
+				br_fdb_batch_refresh(fdb, READ_ONCE(fdb->dst), now);
 			}
 		}
 	} else {
@@ -698,7 +824,11 @@ void br_fdb_entry_refresh(struct net_device *dev, const char *addr, __u16 vid)
 	rcu_read_lock();
 	fdb = fdb_find_rcu(&p->br->fdb_hash_tbl, addr, vid);
 	if (likely(fdb)) {
-		fdb->updated = jiffies;
+		unsigned long now = jiffies;
+
+		/* dst may change under us while the entry migrates ports */
+		fdb->updated = now;
+		br_fdb_batch_refresh(fdb, READ_ONCE(fdb->dst), now);
 	}
 	rcu_read_unlock();
 }
@@ -822,6 +952,7 @@ static void fdb_notify(struct net_bridge *br,
 		atomic_notifier_call_chain(&br_fdb_notifier_list,
 					   event,
 					   (void *)&fdb_event);
+		br_fdb_batch_queue_event(fdb, fdb->dst->dev, event);
 	}
 
 	skb = nlmsg_new(fdb_nlmsg_size(), GFP_ATOMIC);
@@ -274,22 +274,42 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 	struct net_device *dev = BR_INPUT_SKB_CB(skb)->brdev;
 	struct net_bridge *br = netdev_priv(dev);
 	struct net_bridge_port *prev = NULL;
-	struct net_bridge_port_group *p;
+	struct net_bridge_port_group *p = NULL;
+	struct net_bridge_mdb_fwd *fwd = NULL;
 	struct hlist_node *rp;
+	unsigned int i = 0;
 
 	rp = rcu_dereference(hlist_first_rcu(&br->router_list));
-	p = mdst ? rcu_dereference(mdst->ports) : NULL;
-	while (p || rp) {
+	if (mdst) {
+		/* Walk the flattened vector; the port group list is only
+		 * used if it could not be allocated.
+		 */
+		fwd = rcu_dereference(mdst->fwd);
+		if (!fwd)
+			p = rcu_dereference(mdst->ports);
+	}
+	while (p || rp || (fwd && i < fwd->num_ports)) {
 		struct net_bridge_port *port, *lport, *rport;
+		const unsigned char *addr = NULL;
 
-		lport = p ? p->port : NULL;
+		if (fwd) {
+			lport = NULL;
+			if (i < fwd->num_ports) {
+				lport = fwd->ports[i].port;
+				addr = fwd->ports[i].eth_addr;
+			}
+		} else {
+			lport = p ? p->port : NULL;
+			if (p)
+				addr = p->eth_addr;
+		}
 		rport = hlist_entry_safe(rp, struct net_bridge_port, rlist);
 
 		if ((unsigned long)lport > (unsigned long)rport) {
 			port = lport;
 
 			if (port->flags & BR_MULTICAST_TO_UNICAST) {
-				maybe_deliver_addr(lport, skb, p->eth_addr,
+				maybe_deliver_addr(lport, skb, addr,
 						   local_orig);
 				goto delivered;
 			}
@@ -301,8 +321,12 @@ void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 		if (IS_ERR(prev))
 			goto out;
 delivered:
-		if ((unsigned long)lport >= (unsigned long)port)
-			p = rcu_dereference(p->next);
+		if ((unsigned long)lport >= (unsigned long)port) {
+			if (fwd)
+				i++;
+			else
+				p = rcu_dereference(p->next);
+		}
 		if ((unsigned long)rport >= (unsigned long)port)
 			rp = rcu_dereference(hlist_next_rcu(rp));
 	}
@@ -642,6 +642,7 @@ static int br_mdb_add_group(struct net_bridge *br, struct net_bridge_port *port,
 	if (unlikely(!p))
 		return -ENOMEM;
 	rcu_assign_pointer(*pp, p);
+	br_multicast_fwd_rebuild(mp);
 	if (state == MDB_TEMPORARY)
 		mod_timer(&p->timer, now + br->multicast_membership_interval);
 
@@ -769,6 +770,7 @@ static int __br_mdb_del(struct net_bridge *br, struct br_mdb_entry *entry)
 		hlist_del_init(&p->mglist);
 		del_timer(&p->timer);
 		kfree_rcu(p, rcu);
+		br_multicast_fwd_rebuild(mp);
 		err = 0;
 
 		if (!mp->ports && !mp->host_joined &&
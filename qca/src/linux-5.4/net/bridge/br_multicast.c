@@ -157,12 +157,49 @@ static void br_multicast_group_expired(struct timer_list *t)
 			       br_mdb_rht_params);
 	hlist_del_rcu(&mp->mdb_node);
 
+	br_multicast_fwd_rebuild(mp);
 	kfree_rcu(mp, rcu);
 
 out:
 	spin_unlock(&br->multicast_lock);
 }
 
+/* Must be called with multicast_lock held whenever mp->ports changes.
+ * If the vector can't be allocated the data path falls back to walking
+ * the port group list, so a stale vector is never left published.
+ */
+void br_multicast_fwd_rebuild(struct net_bridge_mdb_entry *mp)
+{
+	struct net_bridge *br = mp->br;
+	struct net_bridge_mdb_fwd *fwd = NULL, *old;
+	struct net_bridge_port_group *p;
+	unsigned int n = 0;
+
+	for (p = mlock_dereference(mp->ports, br); p;
+	     p = mlock_dereference(p->next, br))
+		n++;
+
+	if (n)
+		fwd = kmalloc(struct_size(fwd, ports, n), GFP_ATOMIC);
+
+	if (fwd) {
+		fwd->num_ports = 0;
+		for (p = mlock_dereference(mp->ports, br); p;
+		     p = mlock_dereference(p->next, br)) {
+			struct net_bridge_mdb_fwd_port *fp;
+
+			fp = &fwd->ports[fwd->num_ports++];
+			fp->port = p->port;
+			ether_addr_copy(fp->eth_addr, p->eth_addr);
+		}
+	}
+
+	old = mlock_dereference(mp->fwd, br);
+	rcu_assign_pointer(mp->fwd, fwd);
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
 static void br_multicast_del_pg(struct net_bridge *br,
 				struct net_bridge_port_group *pg)
 {
@@ -186,6 +223,7 @@ static void br_multicast_del_pg(struct net_bridge *br,
 		br_mdb_notify(br->dev, p->port, &pg->addr, RTM_DELMDB,
 			      p->flags);
 		kfree_rcu(p, rcu);
+		br_multicast_fwd_rebuild(mp);
 
 		if (!mp->ports && !mp->host_joined &&
 		    netif_running(br->dev))
@@ -571,6 +609,7 @@ static int br_multicast_add_group(struct net_bridge *br,
 	if (unlikely(!p))
 		goto err;
 	rcu_assign_pointer(*pp, p);
+	br_multicast_fwd_rebuild(mp);
 	br_mdb_notify(br->dev, port, group, RTM_NEWMDB, 0);
 
 found:
@@ -1411,6 +1450,7 @@ br_multicast_leave_group(struct net_bridge *br,
 			hlist_del_init(&p->mglist);
 			del_timer(&p->timer);
 			kfree_rcu(p, rcu);
+			br_multicast_fwd_rebuild(mp);
 			br_mdb_notify(br->dev, port, group, RTM_DELMDB,
 				      p->flags | MDB_PG_FLAGS_FAST_LEAVE);
 
@@ -1909,6 +1949,7 @@ void br_multicast_dev_del(struct net_bridge *br)
 		rhashtable_remove_fast(&br->mdb_hash_tbl, &mp->rhnode,
 				       br_mdb_rht_params);
 		hlist_del_rcu(&mp->mdb_node);
+		br_multicast_fwd_rebuild(mp);
 		kfree_rcu(mp, rcu);
 	}
 	spin_unlock_bh(&br->multicast_lock);
@@ -195,6 +195,7 @@ struct net_bridge_fdb_entry {
 	/* write-heavy members should not affect lookups */
 	unsigned long			updated ____cacheline_aligned_in_smp;
 	unsigned long			used;
+	unsigned long			batch_refreshed;
 
 	struct rcu_head			rcu;
 };
@@ -214,10 +215,25 @@ struct net_bridge_port_group {
 	unsigned char			flags;
 };
 
+/* Flattened copy of an mdb entry's port group list for the data path,
+ * kept in the same (descending port pointer) order as the list.
+ */
+struct net_bridge_mdb_fwd_port {
+	struct net_bridge_port		*port;
+	unsigned char			eth_addr[ETH_ALEN] __aligned(2);
+};
+
+struct net_bridge_mdb_fwd {
+	struct rcu_head			rcu;
+	unsigned int			num_ports;
+	struct net_bridge_mdb_fwd_port	ports[];
+};
+
 struct net_bridge_mdb_entry {
 	struct rhash_head		rhnode;
 	struct net_bridge		*br;
 	struct net_bridge_port_group __rcu *ports;
+	struct net_bridge_mdb_fwd __rcu	*fwd;
 	struct rcu_head			rcu;
 	struct timer_list		timer;
 	struct br_ip			addr;
@@ -694,6 +710,7 @@ struct net_bridge_port_group *
 br_multicast_new_port_group(struct net_bridge_port *port, struct br_ip *group,
 			    struct net_bridge_port_group __rcu *next,
 			    unsigned char flags, const unsigned char *src);
+void br_multicast_fwd_rebuild(struct net_bridge_mdb_entry *mp);
 int br_mdb_hash_init(struct net_bridge *br);
 void br_mdb_hash_fini(struct net_bridge *br);
 void br_mdb_notify(struct net_device *dev, struct net_bridge_port *port,
@@ -452,6 +452,73 @@ static int xfrm_inner_mode_input(struct xfrm_state *x,
 	return -EOPNOTSUPP;
 }
 
+/* Lockless counterparts of the state checks in xfrm_input() for states
+ * using sharded replay windows, see xfrm_replay.c. Soft and hard expiry
+ * is evaluated when the per-CPU counters are merged.
+ */
+static int xfrm_input_check_pcpu(struct net *net, struct xfrm_state *x,
+				 struct sk_buff *skb, __be32 seq,
+				 int encap_type)
+{
+	int err;
+
+	if (unlikely(READ_ONCE(x->km.state) != XFRM_STATE_VALID)) {
+		if (x->km.state == XFRM_STATE_ACQ)
+			XFRM_INC_STATS(net, LINUX_MIB_XFRMACQUIREERROR);
+		else
+			XFRM_INC_STATS(net, LINUX_MIB_XFRMINSTATEINVALID);
+		return -EINVAL;
+	}
+
+	if ((x->encap ? x->encap->encap_type : 0) != encap_type) {
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMINSTATEMISMATCH);
+		return -EINVAL;
+	}
+
+	if (x->repl->check(x, skb, seq)) {
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMINSTATESEQERROR);
+		return -EINVAL;
+	}
+
+	if (unlikely(!x->curlft.use_time)) {
+		spin_lock(&x->lock);
+		err = xfrm_state_check_expire(x);
+		spin_unlock(&x->lock);
+		if (err) {
+			XFRM_INC_STATS(net, LINUX_MIB_XFRMINSTATEEXPIRED);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static int xfrm_input_finish_pcpu(struct net *net, struct xfrm_state *x,
+				  struct sk_buff *skb, __be32 seq,
+				  int nexthdr)
+{
+	if (nexthdr < 0) {
+		if (nexthdr == -EBADMSG) {
+			xfrm_audit_state_icvfail(x, skb, x->type->proto);
+			spin_lock(&x->lock);
+			x->stats.integrity_failed++;
+			spin_unlock(&x->lock);
+		}
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMINSTATEPROTOERROR);
+		return nexthdr;
+	}
+
+	/* Checks and advances the replay window in one step */
+	if (x->repl->recheck(x, skb, seq)) {
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMINSTATESEQERROR);
+		return -EINVAL;
+	}
+
+	xfrm_replay_pcpu_account(x, skb->len);
+
+	return 0;
+}
+
 int xfrm_input(struct sk_buff *skb, int nexthdr, __be32 spi, int encap_type)
 {
 	const struct xfrm_state_afinfo *afinfo;
@@ -592,6 +659,12 @@ int xfrm_input(struct sk_buff *skb, int nexthdr, __be32 spi, int encap_type)
 		}
 
 lock:
+		if (x->replay_pcpu) {
+			if (xfrm_input_check_pcpu(net, x, skb, seq, encap_type))
+				goto drop;
+			goto checked;
+		}
+
 		spin_lock(&x->lock);
 
 		if (unlikely(x->km.state != XFRM_STATE_VALID)) {
@@ -619,7 +692,7 @@ lock:
 		}
 
 		spin_unlock(&x->lock);
-
+checked:
 		if (xfrm_tunnel_check(skb, x, family)) {
 			XFRM_INC_STATS(net, LINUX_MIB_XFRMINSTATEMODEERROR);
 			goto drop;
@@ -642,6 +715,13 @@ lock:
 resume:
 		dev_put(skb->dev);
 
+		if (x->replay_pcpu) {
+			if (xfrm_input_finish_pcpu(net, x, skb, seq, nexthdr))
+				goto drop;
+			encap_type = 0;
+			goto finished;
+		}
+
 		spin_lock(&x->lock);
 		if (nexthdr < 0) {
 			if (nexthdr == -EBADMSG) {
@@ -667,7 +747,7 @@ resume:
 		x->curlft.packets++;
 
 		spin_unlock(&x->lock);
-
+finished:
 		XFRM_MODE_SKB_CB(skb)->protocol = nexthdr;
 
 		inner_mode = &x->inner_mode;
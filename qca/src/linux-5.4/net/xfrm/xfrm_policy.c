@@ -2073,10 +2073,109 @@ xfrm_policy_eval_candidates(struct xfrm_pol_inexact_candidates *cand,
 	return prefer;
 }
 
-static struct xfrm_policy *xfrm_policy_lookup_bytype(struct net *net, u8 type,
-						     const struct flowi *fl,
-						     u16 family, u8 dir,
-						     u32 if_id)
+/*
+ * Per-CPU policy lookup cache.
+ *
+ * Results of xfrm_policy_lookup_bytype(), including "no policy", are
+ * memoized per CPU in a small direct-mapped table keyed by the fields of
+ * the flow that xfrm_policy_match() looks at. Entries are tagged with
+ * xfrm_policy_cache_genid, which is bumped whenever a policy is linked
+ * or unlinked, so any policy database change invalidates every cached
+ * result. The cache holds no references: an entry is only trusted if its
+ * generation still matches one sampled inside the RCU section that
+ * dereferences it, and the policy must be re-held with
+ * xfrm_pol_hold_rcu() before use.
+ */
+#define XFRM_POLICY_CACHE_SIZE	64
+
+struct xfrm_pol_cache_key {
+	const struct net	*net;
+	xfrm_address_t		daddr;
+	xfrm_address_t		saddr;
+	u32			mark;
+	u32			if_id;
+	int			oif;
+	__be16			sport;
+	__be16			dport;
+	u16			family;
+	u8			proto;
+	u8			dir;
+	u8			type;
+};
+
+struct xfrm_pol_cache_entry {
+	struct xfrm_pol_cache_key	key;
+	struct xfrm_policy		*pol;
+	unsigned int			genid;
+	bool				valid;
+};
+
+struct xfrm_pol_cache {
+	struct xfrm_pol_cache_entry	ent[XFRM_POLICY_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct xfrm_pol_cache, xfrm_pol_cache);
+static atomic_t xfrm_policy_cache_genid __cacheline_aligned_in_smp;
+
+static void xfrm_policy_cache_flush(void)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&xfrm_policy_cache_genid);
+}
+
+static bool xfrm_policy_cache_key_init(struct xfrm_pol_cache_key *key,
+				       struct net *net, u8 type,
+				       const struct flowi *fl, u16 family,
+				       u8 dir, u32 if_id)
+{
+	const union flowi_uli *uli;
+
+	/* LSM decisions are not covered by the generation count */
+	if (fl->flowi_secid)
+		return false;
+
+	memset(key, 0, sizeof(*key));
+	switch (family) {
+	case AF_INET:
+		key->daddr.a4 = fl->u.ip4.daddr;
+		key->saddr.a4 = fl->u.ip4.saddr;
+		uli = &fl->u.ip4.uli;
+		break;
+	case AF_INET6:
+		key->daddr.in6 = fl->u.ip6.daddr;
+		key->saddr.in6 = fl->u.ip6.saddr;
+		uli = &fl->u.ip6.uli;
+		break;
+	default:
+		return false;
+	}
+
+	key->net = net;
+	key->mark = fl->flowi_mark;
+	key->if_id = if_id;
+	key->oif = fl->flowi_oif;
+	key->sport = xfrm_flowi_sport(fl, uli);
+	key->dport = xfrm_flowi_dport(fl, uli);
+	key->family = family;
+	key->proto = fl->flowi_proto;
+	key->dir = dir;
+	key->type = type;
+
+	return true;
+}
+
+static struct xfrm_pol_cache_entry *
+xfrm_policy_cache_slot(const struct xfrm_pol_cache_key *key)
+{
+	u32 hash = jhash2((const u32 *)key, sizeof(*key) / sizeof(u32), 0);
+
+	return &this_cpu_ptr(&xfrm_pol_cache)->ent[hash % XFRM_POLICY_CACHE_SIZE];
+}
+
+static struct xfrm_policy *__xfrm_policy_lookup_bytype(struct net *net, u8 type,
+						       const struct flowi *fl,
+						       u16 family, u8 dir,
+						       u32 if_id)
 {
 	struct xfrm_pol_inexact_candidates cand;
 	const xfrm_address_t *daddr, *saddr;
@@ -2138,6 +2237,57 @@ fail:
 	return ret;
 }
 
+static struct xfrm_policy *xfrm_policy_lookup_bytype(struct net *net, u8 type,
+						     const struct flowi *fl,
+						     u16 family, u8 dir,
+						     u32 if_id)
+{
+	struct xfrm_pol_cache_entry *e;
+	struct xfrm_pol_cache_key key;
+	struct xfrm_policy *pol;
+	unsigned int genid;
+
+	/* The cache is per CPU and also used from softirq context */
+	if (irqs_disabled() ||
+	    !xfrm_policy_cache_key_init(&key, net, type, fl, family, dir, if_id))
+		return __xfrm_policy_lookup_bytype(net, type, fl, family, dir,
+						   if_id);
+
+	/* The generation must be sampled inside the RCU section: a policy
+	 * unlinked after this read is only freed once we leave it, and one
+	 * unlinked before it has already invalidated the entry.
+	 */
+	rcu_read_lock();
+	genid = atomic_read_acquire(&xfrm_policy_cache_genid);
+	local_bh_disable();
+	e = xfrm_policy_cache_slot(&key);
+	if (e->valid && e->genid == genid &&
+	    !memcmp(&e->key, &key, sizeof(key))) {
+		pol = e->pol;
+		if (!pol || xfrm_pol_hold_rcu(pol)) {
+			local_bh_enable();
+			rcu_read_unlock();
+			return pol;
+		}
+	}
+	local_bh_enable();
+	rcu_read_unlock();
+
+	pol = __xfrm_policy_lookup_bytype(net, type, fl, family, dir, if_id);
+	if (IS_ERR(pol))
+		return pol;
+
+	local_bh_disable();
+	e = xfrm_policy_cache_slot(&key);
+	e->key = key;
+	e->pol = pol;
+	e->genid = genid;
+	e->valid = true;
+	local_bh_enable();
+
+	return pol;
+}
+
 static struct xfrm_policy *xfrm_policy_lookup(struct net *net,
 					      const struct flowi *fl,
 					      u16 family, u8 dir, u32 if_id)
@@ -2205,6 +2355,7 @@ static void __xfrm_policy_link(struct xfrm_policy *pol, int dir)
 	list_add(&pol->walk.all, &net->xfrm.policy_all);
 	net->xfrm.policy_count[dir]++;
 	xfrm_pol_hold(pol);
+	xfrm_policy_cache_flush();
 }
 
 static struct xfrm_policy *__xfrm_policy_unlink(struct xfrm_policy *pol,
@@ -2224,6 +2375,7 @@ static struct xfrm_policy *__xfrm_policy_unlink(struct xfrm_policy *pol,
 
 	list_del_init(&pol->walk.all);
 	net->xfrm.policy_count[dir]--;
+	xfrm_policy_cache_flush();
 
 	return pol;
 }
@@ -7,21 +7,80 @@
  */
 
 #include <linux/export.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
 #include <net/xfrm.h>
 
-u32 xfrm_replay_seqhi(struct xfrm_state *x, __be32 net_seq)
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "xfrm."
+
+/*
+ * Sharded replay windows for high-rate inbound ESN SAs.
+ *
+ * Instead of serializing every packet of an SA on x->lock, the replay
+ * window is split into shards selected by the low bits of the sequence
+ * number, each with its own lock. A replayed packet always maps to the
+ * shard of the original, whichever CPU or crypto completion context
+ * handles it. The highest sequence number accepted by any shard is kept
+ * in rp->top; every packet is also checked against the window floor
+ * below it, so a shard that has seen little traffic cannot accept
+ * numbers the SA as a whole has already left behind.
+ *
+ * Lifetime byte/packet counters are kept per CPU. They are merged back
+ * into x->curlft every XFRM_REPLAY_PCPU_MERGE_PKTS packets per CPU, on
+ * every packet once the SA gets close to a lifetime limit it has not
+ * crossed yet, and from the state timers. The merge slides x->replay_esn
+ * up to the SA wide top and ORs in the bits each shard accepted since
+ * the previous merge, so aevents and dumps see the full window.
+ */
+#define XFRM_REPLAY_PCPU_SHARDS_PER_CPU	4
+#define XFRM_REPLAY_PCPU_MERGE_PKTS	64
+
+static bool pcpu_replay __read_mostly;
+module_param(pcpu_replay, bool, 0644);
+MODULE_PARM_DESC(pcpu_replay, "Use sharded replay windows and per-CPU lifetime counters for new ESN states");
+
+struct xfrm_replay_pcpu_lft {
+	u64			bytes;
+	u64			packets;
+	u32			unmerged;
+	struct u64_stats_sync	syncp;
+};
+
+/* dirty_lo..dirty_hi bounds the sequence numbers accepted since the last
+ * merge; the range is empty when dirty_lo > dirty_hi.
+ */
+struct xfrm_replay_shard {
+	spinlock_t			lock;
+	struct xfrm_replay_state_esn	*replay_esn;
+	u64				dirty_lo;
+	u64				dirty_hi;
+} ____cacheline_aligned_in_smp;
+
+struct xfrm_replay_pcpu {
+	u32				mask;
+	atomic64_t			top;
+	struct xfrm_replay_pcpu_lft __percpu *lft;
+	u64				merged_bytes;
+	u64				merged_packets;
+	struct xfrm_replay_shard	shards[];
+};
+
+static inline struct xfrm_replay_shard *
+xfrm_replay_pcpu_shard(const struct xfrm_state *x, __be32 net_seq)
 {
-	u32 seq, seq_hi, bottom;
-	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
+	return &x->replay_pcpu->shards[ntohl(net_seq) & x->replay_pcpu->mask];
+}
 
-	if (!(x->props.flags & XFRM_STATE_ESN))
-		return 0;
+static u32 ___xfrm_replay_seqhi(u32 top, u32 seq_hi, u32 wsize, __be32 net_seq)
+{
+	u32 seq, bottom;
 
 	seq = ntohl(net_seq);
-	seq_hi = replay_esn->seq_hi;
-	bottom = replay_esn->seq - replay_esn->replay_window + 1;
+	bottom = top - wsize + 1;
 
-	if (likely(replay_esn->seq >= replay_esn->replay_window - 1)) {
+	if (likely(top >= wsize - 1)) {
 		/* A. same subspace */
 		if (unlikely(seq < bottom))
 			seq_hi++;
@@ -33,6 +92,35 @@ u32 xfrm_replay_seqhi(struct xfrm_state *x, __be32 net_seq)
 
 	return seq_hi;
 }
+
+static u32 __xfrm_replay_seqhi(const struct xfrm_replay_state_esn *replay_esn,
+			       __be32 net_seq)
+{
+	return ___xfrm_replay_seqhi(replay_esn->seq, replay_esn->seq_hi,
+				    replay_esn->replay_window, net_seq);
+}
+
+/* The high sequence bits are inferred from the SA wide top, not from the
+ * shard, which may lag behind it.
+ */
+static u32 xfrm_replay_pcpu_seqhi(const struct xfrm_state *x, __be32 net_seq)
+{
+	u64 top = atomic64_read(&x->replay_pcpu->top);
+
+	return ___xfrm_replay_seqhi(lower_32_bits(top), upper_32_bits(top),
+				    x->replay_esn->replay_window, net_seq);
+}
+
+u32 xfrm_replay_seqhi(struct xfrm_state *x, __be32 net_seq)
+{
+	if (!(x->props.flags & XFRM_STATE_ESN))
+		return 0;
+
+	if (x->replay_pcpu)
+		return xfrm_replay_pcpu_seqhi(x, net_seq);
+
+	return __xfrm_replay_seqhi(x->replay_esn, net_seq);
+}
 EXPORT_SYMBOL(xfrm_replay_seqhi);
 ;
 static void xfrm_replay_notify(struct xfrm_state *x, int event)
@@ -420,12 +508,12 @@ static int xfrm_replay_overflow_esn(struct xfrm_state *x, struct sk_buff *skb)
 	return err;
 }
 
-static int xfrm_replay_check_esn(struct xfrm_state *x,
-				 struct sk_buff *skb, __be32 net_seq)
+static int __xfrm_replay_check_esn(struct xfrm_state *x,
+				   const struct xfrm_replay_state_esn *replay_esn,
+				   struct sk_buff *skb, __be32 net_seq)
 {
 	unsigned int bitnr, nr;
 	u32 diff;
-	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
 	u32 pos;
 	u32 seq = ntohl(net_seq);
 	u32 wsize = replay_esn->replay_window;
@@ -479,6 +567,12 @@ err:
 	return -EINVAL;
 }
 
+static int xfrm_replay_check_esn(struct xfrm_state *x,
+				 struct sk_buff *skb, __be32 net_seq)
+{
+	return __xfrm_replay_check_esn(x, x->replay_esn, skb, net_seq);
+}
+
 static int xfrm_replay_recheck_esn(struct xfrm_state *x,
 				   struct sk_buff *skb, __be32 net_seq)
 {
@@ -491,19 +585,16 @@ static int xfrm_replay_recheck_esn(struct xfrm_state *x,
 	return xfrm_replay_check_esn(x, skb, net_seq);
 }
 
-static void xfrm_replay_advance_esn(struct xfrm_state *x, __be32 net_seq)
+static void __xfrm_replay_advance_esn(struct xfrm_replay_state_esn *replay_esn,
+				      __be32 net_seq)
 {
 	unsigned int bitnr, nr, i;
 	int wrap;
 	u32 diff, pos, seq, seq_hi;
-	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
-
-	if (!replay_esn->replay_window)
-		return;
 
 	seq = ntohl(net_seq);
 	pos = (replay_esn->seq - 1) % replay_esn->replay_window;
-	seq_hi = xfrm_replay_seqhi(x, net_seq);
+	seq_hi = __xfrm_replay_seqhi(replay_esn, net_seq);
 	wrap = seq_hi - replay_esn->seq_hi;
 
 	if ((!wrap && seq > replay_esn->seq) || wrap > 0) {
@@ -539,16 +630,377 @@ static void xfrm_replay_advance_esn(struct xfrm_state *x, __be32 net_seq)
 			bitnr = replay_esn->replay_window - (diff - pos);
 	}
 
-	xfrm_dev_state_advance_esn(x);
-
 	nr = bitnr >> 5;
 	bitnr = bitnr & 0x1F;
 	replay_esn->bmp[nr] |= (1U << bitnr);
+}
+
+static void xfrm_replay_advance_esn(struct xfrm_state *x, __be32 net_seq)
+{
+	if (!x->replay_esn->replay_window)
+		return;
+
+	__xfrm_replay_advance_esn(x->replay_esn, net_seq);
+
+	xfrm_dev_state_advance_esn(x);
 
 	if (xfrm_aevent_is_on(xs_net(x)))
 		x->repl->notify(x, XFRM_REPLAY_UPDATE);
 }
 
+/* Bit of @replay_esn holding the sequence number @diff below its top */
+static unsigned int xfrm_replay_esn_bitnr(const struct xfrm_replay_state_esn *replay_esn,
+					  u32 diff)
+{
+	u32 pos = (replay_esn->seq - 1) % replay_esn->replay_window;
+
+	if (pos >= diff)
+		return (pos - diff) % replay_esn->replay_window;
+
+	return replay_esn->replay_window - (diff - pos);
+}
+
+static u64 xfrm_replay_esn_top(const struct xfrm_replay_state_esn *replay_esn)
+{
+	return ((u64)replay_esn->seq_hi << 32) | replay_esn->seq;
+}
+
+/* Reject anything below the SA wide window, whatever its shard has seen */
+static int xfrm_replay_pcpu_check_floor(struct xfrm_state *x,
+					struct sk_buff *skb, __be32 net_seq)
+{
+	u32 wsize = x->replay_esn->replay_window;
+	u64 top = atomic64_read(&x->replay_pcpu->top);
+	u64 seq = ((u64)xfrm_replay_pcpu_seqhi(x, net_seq) << 32) |
+		  ntohl(net_seq);
+
+	if (likely(seq + wsize > top))
+		return 0;
+
+	x->stats.replay_window++;
+	xfrm_audit_state_replay(x, skb, net_seq);
+	return -EINVAL;
+}
+
+static void xfrm_replay_pcpu_raise_top(struct xfrm_replay_pcpu *rp, u64 seq)
+{
+	s64 old = atomic64_read(&rp->top);
+
+	while ((u64)old < seq) {
+		s64 prev = atomic64_cmpxchg(&rp->top, old, seq);
+
+		if (prev == old)
+			break;
+		old = prev;
+	}
+}
+
+static int xfrm_replay_check_pcpu(struct xfrm_state *x,
+				  struct sk_buff *skb, __be32 net_seq)
+{
+	struct xfrm_replay_shard *shard = xfrm_replay_pcpu_shard(x, net_seq);
+	int err;
+
+	err = xfrm_replay_pcpu_check_floor(x, skb, net_seq);
+	if (err)
+		return err;
+
+	spin_lock(&shard->lock);
+	err = __xfrm_replay_check_esn(x, shard->replay_esn, skb, net_seq);
+	spin_unlock(&shard->lock);
+
+	return err;
+}
+
+/* The recheck and the window update must be atomic with respect to
+ * other packets carrying the same sequence number, so the shard is
+ * advanced here rather than in a separate ->advance() call.
+ */
+static int xfrm_replay_recheck_pcpu(struct xfrm_state *x,
+				    struct sk_buff *skb, __be32 net_seq)
+{
+	struct xfrm_replay_shard *shard = xfrm_replay_pcpu_shard(x, net_seq);
+	u32 seq_hi = xfrm_replay_pcpu_seqhi(x, net_seq);
+	int err = -EINVAL;
+
+	if (unlikely(XFRM_SKB_CB(skb)->seq.input.hi != htonl(seq_hi))) {
+		x->stats.replay_window++;
+		return err;
+	}
+
+	err = xfrm_replay_pcpu_check_floor(x, skb, net_seq);
+	if (err)
+		return err;
+
+	spin_lock(&shard->lock);
+	err = __xfrm_replay_check_esn(x, shard->replay_esn, skb, net_seq);
+	if (!err) {
+		u64 seq = ((u64)seq_hi << 32) | ntohl(net_seq);
+
+		__xfrm_replay_advance_esn(shard->replay_esn, net_seq);
+		xfrm_replay_pcpu_raise_top(x->replay_pcpu, seq);
+		shard->dirty_lo = min(shard->dirty_lo, seq);
+		shard->dirty_hi = max(shard->dirty_hi, seq);
+	}
+	spin_unlock(&shard->lock);
+
+	return err;
+}
+
+static void xfrm_replay_advance_pcpu(struct xfrm_state *x, __be32 net_seq)
+{
+	/* Already done by xfrm_replay_recheck_pcpu() */
+}
+
+static void xfrm_replay_pcpu_clean(struct xfrm_replay_shard *shard)
+{
+	shard->dirty_lo = U64_MAX;
+	shard->dirty_hi = 0;
+}
+
+/* Bring x->replay_esn up to date with the shards: slide it up to the SA
+ * wide top, then set the bits each shard accepted since the last merge
+ * that are still inside the window. Only the dirty range of a shard is
+ * walked, in steps of the shard count, as a shard only ever holds its
+ * own residue class. Shards whose whole window has fallen below the
+ * floor are moved up to the top, so their own high bits never go stale.
+ * The state lock must be held.
+ */
+static void xfrm_replay_pcpu_merge_esn(struct xfrm_state *x)
+{
+	struct xfrm_replay_state_esn *replay_esn = x->replay_esn;
+	struct xfrm_replay_pcpu *rp = x->replay_pcpu;
+	u32 wsize = replay_esn->replay_window;
+	u64 top = atomic64_read(&rp->top);
+	u64 old = xfrm_replay_esn_top(replay_esn);
+	u64 floor = top >= wsize ? top - wsize + 1 : 0;
+	unsigned int i;
+
+	if (top > old) {
+		replay_esn->seq = lower_32_bits(top);
+		replay_esn->seq_hi = upper_32_bits(top);
+
+		if (top - old >= wsize) {
+			memset(replay_esn->bmp, 0,
+			       replay_esn->bmp_len * sizeof(__u32));
+		} else {
+			u32 d;
+
+			/* Clear the slots of old + 1 .. top */
+			for (d = 0; d < top - old; d++) {
+				unsigned int bit = xfrm_replay_esn_bitnr(replay_esn, d);
+
+				replay_esn->bmp[bit >> 5] &= ~(1U << (bit & 0x1F));
+			}
+		}
+	}
+
+	for (i = 0; i <= rp->mask; i++) {
+		struct xfrm_replay_shard *shard = &rp->shards[i];
+		struct xfrm_replay_state_esn *sre;
+		u64 stop, seq;
+
+		spin_lock(&shard->lock);
+		sre = shard->replay_esn;
+		stop = xfrm_replay_esn_top(sre);
+
+		seq = shard->dirty_lo;
+		if (seq < floor)
+			seq += round_up(floor - seq, rp->mask + 1);
+
+		for (; seq <= shard->dirty_hi; seq += rp->mask + 1) {
+			unsigned int sbit, bit;
+
+			if (stop - seq >= wsize)
+				continue;
+
+			sbit = xfrm_replay_esn_bitnr(sre, stop - seq);
+			if (!(sre->bmp[sbit >> 5] & (1U << (sbit & 0x1F))))
+				continue;
+
+			bit = xfrm_replay_esn_bitnr(replay_esn, top - seq);
+			replay_esn->bmp[bit >> 5] |= 1U << (bit & 0x1F);
+		}
+		xfrm_replay_pcpu_clean(shard);
+
+		if (top - stop >= wsize) {
+			sre->seq = replay_esn->seq;
+			sre->seq_hi = replay_esn->seq_hi;
+			memset(sre->bmp, 0, sre->bmp_len * sizeof(__u32));
+		}
+		spin_unlock(&shard->lock);
+	}
+}
+
+/* Load x->replay_esn into every shard, after it was set from userspace.
+ * The state lock must be held.
+ */
+void xfrm_replay_pcpu_resync(struct xfrm_state *x)
+{
+	struct xfrm_replay_pcpu *rp = x->replay_pcpu;
+	unsigned int len, i;
+
+	if (!rp)
+		return;
+
+	len = xfrm_replay_state_esn_len(x->replay_esn);
+	for (i = 0; i <= rp->mask; i++) {
+		spin_lock(&rp->shards[i].lock);
+		memcpy(rp->shards[i].replay_esn, x->replay_esn, len);
+		xfrm_replay_pcpu_clean(&rp->shards[i]);
+		spin_unlock(&rp->shards[i].lock);
+	}
+	atomic64_set(&rp->top, xfrm_replay_esn_top(x->replay_esn));
+}
+EXPORT_SYMBOL(xfrm_replay_pcpu_resync);
+
+/* Fold the per-CPU lifetime counters and the replay shards back into
+ * the state. The state lock must be held.
+ */
+void xfrm_replay_pcpu_merge(struct xfrm_state *x)
+{
+	struct xfrm_replay_pcpu *rp = x->replay_pcpu;
+	u64 bytes = 0, packets = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct xfrm_replay_pcpu_lft *lft = per_cpu_ptr(rp->lft, cpu);
+		unsigned int start;
+		u64 b, p;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&lft->syncp);
+			b = lft->bytes;
+			p = lft->packets;
+		} while (u64_stats_fetch_retry_irq(&lft->syncp, start));
+
+		bytes += b;
+		packets += p;
+	}
+
+	x->curlft.bytes += bytes - rp->merged_bytes;
+	x->curlft.packets += packets - rp->merged_packets;
+	rp->merged_bytes = bytes;
+	rp->merged_packets = packets;
+
+	xfrm_replay_pcpu_merge_esn(x);
+}
+EXPORT_SYMBOL(xfrm_replay_pcpu_merge);
+
+/* True when the unmerged per-CPU counters could take the SA past one of
+ * its byte or packet limits. The soft limits only matter until the SA
+ * has soft expired, which latches km.dying; after that only the hard
+ * limits keep packets merging early.
+ */
+static bool xfrm_replay_pcpu_near_limit(const struct xfrm_state *x,
+					unsigned int len)
+{
+	u64 slack = (u64)num_online_cpus() * XFRM_REPLAY_PCPU_MERGE_PKTS;
+	u64 packets = READ_ONCE(x->curlft.packets) + slack;
+	u64 bytes = READ_ONCE(x->curlft.bytes) + slack * len;
+
+	if (packets >= x->lft.hard_packet_limit ||
+	    bytes >= x->lft.hard_byte_limit)
+		return true;
+
+	if (READ_ONCE(x->km.dying))
+		return false;
+
+	return packets >= x->lft.soft_packet_limit ||
+	       bytes >= x->lft.soft_byte_limit;
+}
+
+/* Account a received packet, only taking the state lock to merge. */
+void xfrm_replay_pcpu_account(struct xfrm_state *x, unsigned int len)
+{
+	struct xfrm_replay_pcpu_lft *lft = this_cpu_ptr(x->replay_pcpu->lft);
+
+	u64_stats_update_begin(&lft->syncp);
+	lft->bytes += len;
+	lft->packets++;
+	u64_stats_update_end(&lft->syncp);
+
+	if (++lft->unmerged < XFRM_REPLAY_PCPU_MERGE_PKTS &&
+	    likely(!xfrm_replay_pcpu_near_limit(x, len)))
+		return;
+
+	lft->unmerged = 0;
+
+	/* Never skipped, or lifetime limits could be overshot unbounded */
+	spin_lock(&x->lock);
+	xfrm_replay_pcpu_merge(x);
+	if (x->km.state == XFRM_STATE_VALID)
+		xfrm_state_check_expire(x);
+	if (xfrm_aevent_is_on(xs_net(x)))
+		x->repl->notify(x, XFRM_REPLAY_UPDATE);
+	spin_unlock(&x->lock);
+}
+EXPORT_SYMBOL(xfrm_replay_pcpu_account);
+
+/* Callers merge the shards first, x->replay_esn is already current */
+static void xfrm_replay_notify_pcpu(struct xfrm_state *x, int event)
+{
+	xfrm_replay_notify_esn(x, event);
+}
+
+static int xfrm_replay_pcpu_alloc(struct xfrm_state *x)
+{
+	unsigned int nshards, len, i;
+	struct xfrm_replay_pcpu *rp;
+	int cpu;
+
+	nshards = roundup_pow_of_two(num_possible_cpus() *
+				     XFRM_REPLAY_PCPU_SHARDS_PER_CPU);
+	len = xfrm_replay_state_esn_len(x->replay_esn);
+
+	rp = kzalloc(struct_size(rp, shards, nshards), GFP_ATOMIC);
+	if (!rp)
+		return -ENOMEM;
+
+	rp->mask = nshards - 1;
+	atomic64_set(&rp->top, xfrm_replay_esn_top(x->replay_esn));
+	rp->lft = alloc_percpu_gfp(struct xfrm_replay_pcpu_lft, GFP_ATOMIC);
+	if (!rp->lft)
+		goto err;
+
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(rp->lft, cpu)->syncp);
+
+	for (i = 0; i < nshards; i++) {
+		spin_lock_init(&rp->shards[i].lock);
+		xfrm_replay_pcpu_clean(&rp->shards[i]);
+		rp->shards[i].replay_esn = kmemdup(x->replay_esn, len,
+						   GFP_ATOMIC);
+		if (!rp->shards[i].replay_esn)
+			goto err;
+	}
+
+	x->replay_pcpu = rp;
+	return 0;
+
+err:
+	for (i = 0; i < nshards; i++)
+		kfree(rp->shards[i].replay_esn);
+	free_percpu(rp->lft);
+	kfree(rp);
+	return -ENOMEM;
+}
+
+void xfrm_replay_pcpu_free(struct xfrm_state *x)
+{
+	struct xfrm_replay_pcpu *rp = x->replay_pcpu;
+	unsigned int i;
+
+	if (!rp)
+		return;
+
+	for (i = 0; i <= rp->mask; i++)
+		kfree(rp->shards[i].replay_esn);
+	free_percpu(rp->lft);
+	kfree(rp);
+	x->replay_pcpu = NULL;
+}
+
 #ifdef CONFIG_XFRM_OFFLOAD
 static int xfrm_replay_overflow_offload(struct xfrm_state *x, struct sk_buff *skb)
 {
@@ -699,6 +1151,14 @@ static const struct xfrm_replay xfrm_replay_esn = {
 	.notify		= xfrm_replay_notify_esn,
 	.overflow	= xfrm_replay_overflow_offload_esn,
 };
+
+static const struct xfrm_replay xfrm_replay_pcpu = {
+	.advance	= xfrm_replay_advance_pcpu,
+	.check		= xfrm_replay_check_pcpu,
+	.recheck	= xfrm_replay_recheck_pcpu,
+	.notify		= xfrm_replay_notify_pcpu,
+	.overflow	= xfrm_replay_overflow_offload_esn,
+};
 #else
 static const struct xfrm_replay xfrm_replay_legacy = {
 	.advance	= xfrm_replay_advance,
@@ -723,6 +1183,14 @@ static const struct xfrm_replay xfrm_replay_esn = {
 	.notify		= xfrm_replay_notify_esn,
 	.overflow	= xfrm_replay_overflow_esn,
 };
+
+static const struct xfrm_replay xfrm_replay_pcpu = {
+	.advance	= xfrm_replay_advance_pcpu,
+	.check		= xfrm_replay_check_pcpu,
+	.recheck	= xfrm_replay_recheck_pcpu,
+	.notify		= xfrm_replay_notify_pcpu,
+	.overflow	= xfrm_replay_overflow_esn,
+};
 #endif
 
 int xfrm_init_replay(struct xfrm_state *x)
@@ -738,6 +1206,9 @@ int xfrm_init_replay(struct xfrm_state *x)
 			if (replay_esn->replay_window == 0)
 				return -EINVAL;
 			x->repl = &xfrm_replay_esn;
+			if (READ_ONCE(pcpu_replay) &&
+			    (x->replay_pcpu || !xfrm_replay_pcpu_alloc(x)))
+				x->repl = &xfrm_replay_pcpu;
 		} else {
 			x->repl = &xfrm_replay_bmp;
 		}
@@ -26,6 +26,7 @@
 #include <linux/slab.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
+#include <linux/jhash.h>
 
 #include "xfrm_hash.h"
 
@@ -39,6 +40,10 @@ static void xfrm_state_gc_task(struct work_struct *work);
    1. Hash table by (spi,daddr,ah/esp) to find SA by SPI. (input,ctl)
    2. Hash table by (daddr,family,reqid) to find what SAs exist for given
       destination/tunnel endpoint. (output)
+
+   SAs with an SPI are also linked to a table by (net,spi,family), shared
+   by all namespaces, so that xfrm_state_lookup_byspi() does not need to
+   know the destination address.
  */
 
 static unsigned int xfrm_state_hashmax __read_mostly = 1 * 1024 * 1024;
@@ -170,6 +175,40 @@ static struct xfrm_state_afinfo __rcu *xfrm_state_afinfo[NPROTO];
 
 static DEFINE_SPINLOCK(xfrm_state_gc_lock);
 
+#define XFRM_STATE_BYSPI_FAMILY_BITS	10
+#define XFRM_STATE_BYSPI_FAMILY_SIZE	(1U << XFRM_STATE_BYSPI_FAMILY_BITS)
+
+static struct hlist_head xfrm_state_byspi_family[XFRM_STATE_BYSPI_FAMILY_SIZE];
+static DEFINE_SPINLOCK(xfrm_state_byspi_family_lock);
+
+static inline unsigned int xfrm_spi_family_hash(const struct net *net,
+						__be32 spi,
+						unsigned short family)
+{
+	return jhash_2words((__force u32)spi, family, net_hash_mix(net)) &
+	       (XFRM_STATE_BYSPI_FAMILY_SIZE - 1);
+}
+
+/* Called with net->xfrm.xfrm_state_lock held, x->id.spi must be set. */
+static void xfrm_state_byspi_family_add(struct xfrm_state *x)
+{
+	unsigned int h;
+
+	h = xfrm_spi_family_hash(xs_net(x), x->id.spi, x->props.family);
+
+	spin_lock(&xfrm_state_byspi_family_lock);
+	hlist_add_head_rcu(&x->byspi_family, xfrm_state_byspi_family + h);
+	spin_unlock(&xfrm_state_byspi_family_lock);
+}
+
+/* Called with net->xfrm.xfrm_state_lock held. */
+static void xfrm_state_byspi_family_del(struct xfrm_state *x)
+{
+	spin_lock(&xfrm_state_byspi_family_lock);
+	hlist_del_rcu(&x->byspi_family);
+	spin_unlock(&xfrm_state_byspi_family_lock);
+}
+
 int __xfrm_state_delete(struct xfrm_state *x);
 
 int km_query(struct xfrm_state *x, struct xfrm_tmpl *t, struct xfrm_policy *pol);
@@ -484,6 +523,7 @@ static void ___xfrm_state_destroy(struct xfrm_state *x)
 	kfree(x->calg);
 	kfree(x->encap);
 	kfree(x->coaddr);
+	xfrm_replay_pcpu_free(x);
 	kfree(x->replay_esn);
 	kfree(x->preplay_esn);
 	if (x->type_offload)
@@ -527,6 +567,8 @@ static enum hrtimer_restart xfrm_timer_handler(struct hrtimer *me)
 	spin_lock(&x->lock);
 	if (x->km.state == XFRM_STATE_DEAD)
 		goto out;
+	if (x->replay_pcpu)
+		xfrm_replay_pcpu_merge(x);
 	if (x->km.state == XFRM_STATE_EXPIRED)
 		goto expired;
 	if (x->lft.hard_add_expires_seconds) {
@@ -619,6 +661,7 @@ struct xfrm_state *xfrm_state_alloc(struct net *net)
 		INIT_HLIST_NODE(&x->bydst);
 		INIT_HLIST_NODE(&x->bysrc);
 		INIT_HLIST_NODE(&x->byspi);
+		INIT_HLIST_NODE(&x->byspi_family);
 		hrtimer_init(&x->mtimer, CLOCK_BOOTTIME, HRTIMER_MODE_ABS_SOFT);
 		x->mtimer.function = xfrm_timer_handler;
 		timer_setup(&x->rtimer, xfrm_replay_timer_handler, 0);
@@ -662,8 +705,10 @@ int __xfrm_state_delete(struct xfrm_state *x)
 		list_del(&x->km.all);
 		hlist_del_rcu(&x->bydst);
 		hlist_del_rcu(&x->bysrc);
-		if (x->id.spi)
+		if (x->id.spi) {
 			hlist_del_rcu(&x->byspi);
+			xfrm_state_byspi_family_del(x);
+		}
 		net->xfrm.state_num--;
 		spin_unlock(&net->xfrm.xfrm_state_lock);
 
@@ -1141,6 +1186,7 @@ found:
 			if (x->id.spi) {
 				h = xfrm_spi_hash(net, &x->id.daddr, x->id.spi, x->id.proto, encap_family);
 				hlist_add_head_rcu(&x->byspi, net->xfrm.state_byspi + h);
+				xfrm_state_byspi_family_add(x);
 			}
 			x->lft.hard_add_expires_seconds = net->xfrm.sysctl_acq_expires;
 			hrtimer_start(&x->mtimer,
@@ -1217,21 +1263,23 @@ EXPORT_SYMBOL(xfrm_stateonly_find);
 struct xfrm_state *xfrm_state_lookup_byspi(struct net *net, __be32 spi,
 					      unsigned short family)
 {
+	unsigned int h = xfrm_spi_family_hash(net, spi, family);
 	struct xfrm_state *x;
-	struct xfrm_state_walk *w;
 
-	spin_lock_bh(&net->xfrm.xfrm_state_lock);
-	list_for_each_entry(w, &net->xfrm.state_all, all) {
-		x = container_of(w, struct xfrm_state, km);
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(x, xfrm_state_byspi_family + h, byspi_family) {
 		if (x->props.family != family ||
-			x->id.spi != spi)
+			x->id.spi != spi ||
+			!net_eq(xs_net(x), net))
 			continue;
 
-		xfrm_state_hold(x);
-		spin_unlock_bh(&net->xfrm.xfrm_state_lock);
+		if (!xfrm_state_hold_rcu(x))
+			continue;
+
+		rcu_read_unlock();
 		return x;
 	}
-	spin_unlock_bh(&net->xfrm.xfrm_state_lock);
+	rcu_read_unlock();
 	return NULL;
 }
 EXPORT_SYMBOL(xfrm_state_lookup_byspi);
@@ -1255,6 +1303,7 @@ static void __xfrm_state_insert(struct xfrm_state *x)
 				  x->props.family);
 
 		hlist_add_head_rcu(&x->byspi, net->xfrm.state_byspi + h);
+		xfrm_state_byspi_family_add(x);
 	}
 
 	hrtimer_start(&x->mtimer, ktime_set(1, 0), HRTIMER_MODE_REL_SOFT);
@@ -1766,9 +1815,15 @@ xfrm_state_lookup(struct net *net, u32 mark, const xfrm_address_t *daddr, __be32
 		  u8 proto, unsigned short family)
 {
 	struct xfrm_state *x;
+	unsigned int sequence;
 
+	/* Lockless: only retry if a resize raced with a failed lookup */
 	rcu_read_lock();
-	x = __xfrm_state_lookup(net, mark, daddr, spi, proto, family);
+	do {
+		sequence = read_seqcount_begin(&net->xfrm.xfrm_state_hash_generation);
+		x = __xfrm_state_lookup(net, mark, daddr, spi, proto, family);
+	} while (!x && read_seqcount_retry(&net->xfrm.xfrm_state_hash_generation,
+					   sequence));
 	rcu_read_unlock();
 	return x;
 }
@@ -2043,6 +2098,7 @@ int xfrm_alloc_spi(struct xfrm_state *x, u32 low, u32 high)
 		x->id.spi = newspi;
 		h = xfrm_spi_hash(net, &x->id.daddr, x->id.spi, x->id.proto, x->props.family);
 		hlist_add_head_rcu(&x->byspi, net->xfrm.state_byspi + h);
+		xfrm_state_byspi_family_add(x);
 		spin_unlock_bh(&net->xfrm.xfrm_state_lock);
 
 		err = 0;
@@ -2145,6 +2201,8 @@ static void xfrm_replay_timer_handler(struct timer_list *t)
 	spin_lock(&x->lock);
 
 	if (x->km.state == XFRM_STATE_VALID) {
+		if (x->replay_pcpu)
+			xfrm_replay_pcpu_merge(x);
 		if (xfrm_aevent_is_on(xs_net(x)))
 			x->repl->notify(x, XFRM_REPLAY_TIMEOUT);
 		else
@@ -529,6 +529,7 @@ static void xfrm_update_ae_params(struct xfrm_state *x, struct nlattr **attrs,
 		       xfrm_replay_state_esn_len(replay_esn));
 		memcpy(x->preplay_esn, replay_esn,
 		       xfrm_replay_state_esn_len(replay_esn));
+		xfrm_replay_pcpu_resync(x);
 	}
 
 	if (rp) {
@@ -0,0 +1,105 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Compare inbound ESN SA throughput with the per-SA lock and with the
+# sharded replay windows (xfrm.pcpu_replay). Topology:
+#
+# 10.0.0.1        10.0.0.2
+#  veth0 --------- veth1
+#  ns-tx           ns-rx
+#
+# A single ESP transport mode SA with ESN carries UDP traffic generated
+# by udpgso_bench_tx. Receive side throughput is reported by
+# udpgso_bench_rx.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+readonly SUFFIX="$(mktemp -u XXXXXX)"
+readonly TX_NS="ns-tx-${SUFFIX}"
+readonly RX_NS="ns-rx-${SUFFIX}"
+readonly PARAM=/sys/module/xfrm/parameters/pcpu_replay
+
+KEY_AEAD=0x0123456789abcdef0123456789abcdef01234567
+SPI=0x1000
+DURATION=${DURATION:-5}
+
+cleanup() {
+	local -r jobs="$(jobs -p)"
+
+	[ -n "${jobs}" ] && kill -INT ${jobs} 2>/dev/null
+	ip netns del "${TX_NS}" 2>/dev/null
+	ip netns del "${RX_NS}" 2>/dev/null
+}
+trap cleanup EXIT
+
+setup() {
+	ip netns add "${TX_NS}"
+	ip netns add "${RX_NS}"
+	ip -netns "${TX_NS}" link set lo up
+	ip -netns "${RX_NS}" link set lo up
+
+	ip -netns "${TX_NS}" link add veth0 type veth peer name veth1 \
+		netns "${RX_NS}"
+	ip -netns "${TX_NS}" addr add 10.0.0.1/24 dev veth0
+	ip -netns "${RX_NS}" addr add 10.0.0.2/24 dev veth1
+	ip -netns "${TX_NS}" link set veth0 up
+	ip -netns "${RX_NS}" link set veth1 up
+
+	# spread the single SA over all receive CPUs
+	ip netns exec "${RX_NS}" sh -c \
+		'for q in /sys/class/net/veth1/queues/rx-*/rps_cpus; do echo ff > $q; done' \
+		2>/dev/null
+
+	for ns in "${TX_NS}" "${RX_NS}"; do
+		ip -netns "${ns}" xfrm state add src 10.0.0.1 dst 10.0.0.2 \
+			proto esp spi ${SPI} reqid 1 mode transport \
+			replay-window 128 flag esn \
+			aead 'rfc4106(gcm(aes))' ${KEY_AEAD} 128
+	done
+
+	ip -netns "${TX_NS}" xfrm policy add src 10.0.0.1 dst 10.0.0.2 \
+		proto udp dir out tmpl src 10.0.0.1 dst 10.0.0.2 \
+		proto esp reqid 1 mode transport
+	ip -netns "${RX_NS}" xfrm policy add src 10.0.0.1 dst 10.0.0.2 \
+		proto udp dir in tmpl src 10.0.0.1 dst 10.0.0.2 \
+		proto esp reqid 1 mode transport
+}
+
+run_one() {
+	local -r mode=$1
+
+	echo ${mode} > ${PARAM}
+	setup
+
+	ip netns exec "${RX_NS}" ./udpgso_bench_rx -4 &
+	# Hack: let bg programs complete the startup
+	sleep 0.1
+	ip netns exec "${TX_NS}" ./udpgso_bench_tx -4 -D 10.0.0.2 \
+		-l ${DURATION} -s 1400 -m
+	sleep 0.2
+
+	ip -netns "${RX_NS}" -s xfrm state list spi ${SPI} | grep -A1 lifetime
+	cleanup
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit $ksft_skip
+fi
+
+if [ ! -w ${PARAM} ]; then
+	echo "SKIP: ${PARAM} not available"
+	exit $ksft_skip
+fi
+
+readonly saved=$(cat ${PARAM})
+
+echo "esn sa - per-SA lock"
+run_one N
+
+echo "esn sa - sharded replay windows"
+run_one Y
+
+echo ${saved} > ${PARAM}
+exit 0
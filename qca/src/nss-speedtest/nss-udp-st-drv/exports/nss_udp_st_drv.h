@@ -25,6 +25,11 @@
 #define NSS_UDP_ST_IFNAMSZ	24
 #define NSS_UDP_ST_IPNAMSZ	40
 #define NSS_UDP_ST_MODESZ	24
+#define NSS_UDP_ST_FLOWS_MAX	262144	/* Maximum flows across all rules */
+#define NSS_UDP_ST_LAT_HIST	16	/* log2 us latency buckets; the last one is open ended */
+#define NSS_UDP_ST_RING_MAGIC	0x4e555352	/* "NUSR" */
+#define NSS_UDP_ST_RING_ENTRIES	256	/* Snapshots kept in the stats ring */
+#define NSS_UDP_ST_STREAM_INTERVAL_MIN	10	/* Shortest snapshot interval in ms */
 
 #ifdef __KERNEL__ /* only kernel will use. */
 #define NSS_UDP_ST_FLAG_IPV4	0x1
@@ -39,6 +44,8 @@
 #define NSS_UDP_ST_IOCTL_START_TX	_IOW(NSS_UDP_ST_IOCTL_MAGIC, 1, int)
 #define NSS_UDP_ST_IOCTL_START_RX	_IOW(NSS_UDP_ST_IOCTL_MAGIC, 2, int)
 #define NSS_UDP_ST_IOCTL_STOP	_IO(NSS_UDP_ST_IOCTL_MAGIC, 3)
+#define NSS_UDP_ST_IOCTL_FLOW_STATS	_IOWR(NSS_UDP_ST_IOCTL_MAGIC, 4, struct nss_udp_st_flow_query)
+#define NSS_UDP_ST_IOCTL_STREAM	_IOW(NSS_UDP_ST_IOCTL_MAGIC, 5, uint32_t)
 #define NSS_UDP_ST_DEV	"/dev/nss_udp_st"
 
 #ifdef __KERNEL__ /* only kernel will use. */
@@ -46,12 +53,13 @@
 #define NSS_UDP_ST_MAX_TAILROOM	32	/* Maximum tailroom needed */
 #define NSS_UDP_ST_BUFFER_SIZE_MAX	1500	/* 1500 bytes */
 #define NSS_UDP_ST_RATE_MAX	20000000000	/* 20 Gbps */
+#define NSS_UDP_ST_PROBE_MAGIC	0x4e555354	/* "NUST" */
 
 extern struct nss_udp_st nust;
 extern struct delayed_work nss_udp_st_tx_delayed_work;
 extern struct workqueue_struct *work_queue;
 extern void nss_udp_st_update_stats(size_t pkt_size);
-extern uint64_t nss_udp_st_tx_num_pkt;
+extern void nss_udp_st_update_stats_bulk(size_t pkts, size_t bytes);
 extern struct net_device *nust_dev;
 #endif
 
@@ -65,6 +73,7 @@ enum nss_udp_st_rule {
 	NSS_UDP_ST_SPORT,	/* source port */
 	NSS_UDP_ST_DPORT,	/* destination port */
 	NSS_UDP_ST_FLAGS,	/* IP version flag */
+	NSS_UDP_ST_FLOWS,	/* number of flows */
 };
 
 /*
@@ -89,6 +98,8 @@ enum nss_udp_st_error {
 	NSS_UDP_ST_ERROR_MEMORY_FAILURE,		/* Memory allocation failed */
 	NSS_UDP_ST_ERROR_INCORRECT_IP_VERSION,	/* Incorrect IP version */
 	NSS_UDP_ST_ERROR_PACKET_DROP,	/* Packet Drop */
+	NSS_UDP_ST_ERROR_TOO_MANY_FLOWS,	/* Flow count exceeds NSS_UDP_ST_FLOWS_MAX */
+	NSS_UDP_ST_ERROR_TX_COPY,	/* Template still queued, packet sent as a copy */
 	NSS_UDP_ST_ERROR_MAX			/* Maximum error statistics type */
 };
 
@@ -122,6 +133,82 @@ struct nss_udp_st_opt {
 	uint16_t ip_version;	/* ip version flag */
 	char sip[NSS_UDP_ST_IPNAMSZ];	/* source ip string */
 	char dip[NSS_UDP_ST_IPNAMSZ];	/* dest ip string */
+	uint32_t flows;			/* flows expanded from this rule; 0 is one flow */
+};
+
+/*
+ * nss_udp_st_flow_stats
+ *  per flow statistics; addresses are in host order
+ */
+struct nss_udp_st_flow_stats {
+	uint32_t sip[4];		/* source ip */
+	uint32_t dip[4];		/* dest ip */
+	uint16_t sport;			/* source port */
+	uint16_t dport;			/* dest port */
+	uint16_t ip_version;		/* ip version */
+	uint16_t reserved;		/* reserved */
+	uint64_t tx_packets;		/* packets transmitted on this flow */
+	uint64_t rx_packets;		/* packets received on this flow */
+	uint64_t lost;			/* sequence numbers never received */
+	uint64_t reordered;		/* packets received behind a later one */
+	uint32_t lat_p50;		/* 50th percentile latency in us */
+	uint32_t lat_p90;		/* 90th percentile latency in us */
+	uint32_t lat_p99;		/* 99th percentile latency in us */
+	uint32_t lat_max;		/* maximum latency in us */
+};
+
+/*
+ * nss_udp_st_flow_query
+ *  request for a window of per flow statistics
+ */
+struct nss_udp_st_flow_query {
+	uint32_t start;			/* first flow to copy */
+	uint32_t count;			/* entries available at stats; updated to entries copied */
+	uint32_t total;			/* total flows in the test; filled by the driver */
+	uint32_t reserved;		/* reserved */
+	uint64_t stats;			/* user pointer to struct nss_udp_st_flow_stats array */
+};
+
+/*
+ * nss_udp_st_snap
+ *  one interval snapshot in the stats ring
+ *
+ * Packet and byte counts are totals of the current test; everything else
+ * covers only the interval ending at tstamp.
+ */
+struct nss_udp_st_snap {
+	uint64_t seq;			/* snapshot number, 0 while being written */
+	uint64_t tstamp;		/* CLOCK_REALTIME at the snapshot in ms */
+	uint64_t interval;		/* length of the interval in ns */
+	uint64_t tx_packets;		/* packets transmitted */
+	uint64_t tx_bytes;		/* bytes transmitted */
+	uint64_t rx_packets;		/* packets received */
+	uint64_t rx_bytes;		/* bytes received */
+	uint64_t tx_pps;		/* transmit packets per second */
+	uint64_t tx_bps;		/* transmit bits per second */
+	uint64_t rx_pps;		/* receive packets per second */
+	uint64_t rx_bps;		/* receive bits per second */
+	uint64_t drops;			/* transmit drops */
+	int64_t lost;			/* sequence gaps; late arrivals subtract */
+	uint64_t reordered;		/* late arrivals */
+	uint32_t lat_hist[NSS_UDP_ST_LAT_HIST];	/* latency histogram, bucket i below 2^i us */
+};
+
+/*
+ * nss_udp_st_ring
+ *  read-only ring of interval snapshots mapped from NSS_UDP_ST_DEV
+ *
+ * Snapshot n lives in snap[n % entries]; the driver fills it and then
+ * advances head to n. A reader copies an entry and keeps it only if its
+ * seq reads n both before and after the copy.
+ */
+struct nss_udp_st_ring {
+	uint32_t magic;			/* NSS_UDP_ST_RING_MAGIC */
+	uint32_t entries;		/* number of snapshots in the ring */
+	uint32_t interval;		/* snapshot interval in ms, 0 when stopped */
+	uint32_t reserved;		/* reserved */
+	uint64_t head;			/* snapshots published */
+	struct nss_udp_st_snap snap[];	/* snapshots */
 };
 
 #ifdef __KERNEL__ /* only kernel will use. */
@@ -178,6 +265,18 @@ struct nss_udp_st_rules {
 	uint16_t dport;			/* dest port */
 	uint16_t flags;			/* version of IP address */
 	uint8_t dst_mac[ETH_ALEN];		/* dest mac */
+	uint32_t flows;			/* flows expanded from this rule */
+};
+
+/*
+ * nss_udp_st_probe
+ *	header carried at the start of the UDP payload of every test packet
+ */
+struct nss_udp_st_probe {
+	__be32 magic;			/* NSS_UDP_ST_PROBE_MAGIC */
+	__be32 flow;			/* flow index at the sender */
+	__be64 seq;			/* per flow sequence number */
+	__be64 tstamp;			/* CLOCK_REALTIME at transmit in ns */
 };
 
 /*
@@ -189,6 +288,7 @@ struct nss_udp_st {
 	struct nss_udp_st_rules rules;	/* database for config rules */
 	struct nss_udp_st_stats stats;	/* result statistics */
 	uint32_t rule_count;		/* no of rules configured */
+	uint32_t flow_count;		/* no of flows expanded from the rules */
 	uint64_t time;			/* duration of test */
 	bool mode;			/* start =0; stop=1 */
 	bool dir;			/* tx=0; rx=1 */
@@ -31,7 +31,6 @@ struct nss_udp_st nust;
 struct delayed_work nss_udp_st_tx_delayed_work;
 struct workqueue_struct *work_queue;
 void nss_udp_st_update_stats(size_t pkt_size);
-uint64_t nss_udp_st_tx_num_pkt;
 struct net_device *nust_dev;
 
 /*
@@ -60,6 +59,16 @@ static struct nf_hook_ops nss_udp_st_nf_ipv6_ops[] __read_mostly = {
 	},
 };
 
+/*
+ * nss_udp_st_rx_unregister()
+ *	de-register pre-routing hook for rx path
+ */
+static void nss_udp_st_rx_unregister(void)
+{
+	nf_unregister_net_hooks(&init_net, nss_udp_st_nf_ipv4_ops, ARRAY_SIZE(nss_udp_st_nf_ipv4_ops));
+	nf_unregister_net_hooks(&init_net, nss_udp_st_nf_ipv6_ops, ARRAY_SIZE(nss_udp_st_nf_ipv6_ops));
+}
+
 /*
  * nss_udp_st_check_rules()
  *	check for ARP resolution and valid return mac
@@ -129,6 +138,15 @@ static ssize_t nss_udp_st_read(struct file *file, char __user *buf,
 	return copied;
 }
 
+/*
+ * nss_udp_st_mmap()
+ *	map the stats ring
+ */
+static int nss_udp_st_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	return nss_udp_st_stream_mmap(vma);
+}
+
 /*
  * nss_udp_st_write()
  *	receive rules from userspace
@@ -159,8 +177,15 @@ static ssize_t nss_udp_st_write(struct file *file, const char __user *buf,
 		kfree(rules);
 		return -EINVAL;
 	}
+	if (opt.flows > NSS_UDP_ST_FLOWS_MAX) {
+		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_TOO_MANY_FLOWS]);
+		kfree(rules);
+		return -EINVAL;
+	}
+
 	rules->sport = opt.sport;
 	rules->dport = opt.dport;
+	rules->flows = opt.flows;
 	if(opt.ip_version == 4) {
 		rules->flags |= NSS_UDP_ST_FLAG_IPV4;
 		nss_udp_st_get_ipaddr_ntoh(opt.sip, sizeof(struct in_addr), &rules->sip.ip.ipv4);
@@ -192,7 +217,6 @@ static ssize_t nss_udp_st_write(struct file *file, const char __user *buf,
 static void nss_udp_st_reset_stats(void) {
 	memset(&nust.stats, 0, sizeof(struct nss_udp_st_stats));
 	nust.stats.first_pkt = true;
-	nss_udp_st_tx_num_pkt = 0;
 }
 
 /*
@@ -219,6 +243,10 @@ static long nss_udp_st_ioctl(struct file *file, unsigned int ioctl_num,
 			return -EINVAL;
 		}
 
+		/*
+		 * threads of a test that ran out of time wait here to be reaped
+		 */
+		nss_udp_st_tx_cleanup();
 		nss_udp_st_reset_stats();
 		nust.dir = NSS_UDP_ST_TX;
 
@@ -229,11 +257,17 @@ static long nss_udp_st_ioctl(struct file *file, unsigned int ioctl_num,
 		if (!nust.time) {
 			nust.time = NSS_UDP_ST_TX_DEFAULT_TIMEOUT;
 		}
+
+		/*
+		 * tx threads start sending as soon as they are created
+		 */
+		nust.mode = NSS_UDP_ST_START;
 		if (!nss_udp_st_tx()) {
 			pr_err("Unable to start Tx test\n");
+			nust.mode = NSS_UDP_ST_STOP;
+			nss_udp_st_tx_cleanup();
 			return -EINVAL;
 		}
-		nust.mode = NSS_UDP_ST_START;
 		break;
 
 	case NSS_UDP_ST_IOCTL_START_RX:
@@ -242,9 +276,15 @@ static long nss_udp_st_ioctl(struct file *file, unsigned int ioctl_num,
 			return -EINVAL;
 		}
 
+		nss_udp_st_tx_cleanup();
 		nss_udp_st_reset_stats();
 		nust.dir = NSS_UDP_ST_RX;
 
+		if (nss_udp_st_flow_build()) {
+			pr_err("Unable to build Rx flows\n");
+			return -EINVAL;
+		}
+
 		/*
 		 * register pre-routing hook for rx path
 		 */
@@ -264,22 +304,55 @@ static long nss_udp_st_ioctl(struct file *file, unsigned int ioctl_num,
 		break;
 
 	case NSS_UDP_ST_IOCTL_STOP:
+		/*
+		 * A tx test that ran out of time is already in stop mode but
+		 * still holds its threads and templates.
+		 */
+		if (nust.dir == NSS_UDP_ST_TX) {
+			nust.mode = NSS_UDP_ST_STOP;
+			nss_udp_st_tx_cleanup();
+			nss_udp_st_clear_rules();
+			break;
+		}
+
 		if (nust.mode == NSS_UDP_ST_STOP)
 			break;
 
 		nust.mode = NSS_UDP_ST_STOP;
+		nss_udp_st_rx_unregister();
+		nss_udp_st_clear_rules();
+		break;
 
-		if (nust.dir == NSS_UDP_ST_RX) {
-			/*
-			 * de-register pre-routing hook for rx path
-			 */
-			nf_unregister_net_hooks(&init_net, nss_udp_st_nf_ipv4_ops, ARRAY_SIZE(nss_udp_st_nf_ipv4_ops));
-			nf_unregister_net_hooks(&init_net, nss_udp_st_nf_ipv6_ops, ARRAY_SIZE(nss_udp_st_nf_ipv6_ops));
-		} else {
-			nss_udp_st_hrtimer_cleanup();
+	case NSS_UDP_ST_IOCTL_FLOW_STATS:
+	{
+		struct nss_udp_st_flow_query query;
+
+		if (copy_from_user(&query, (void __user *)arg, sizeof(query))) {
+			return -EFAULT;
+		}
+
+		ret = nss_udp_st_flow_stats_copy(&query);
+		if (ret) {
+			return ret;
+		}
+
+		if (copy_to_user((void __user *)arg, &query, sizeof(query))) {
+			return -EFAULT;
 		}
-		nss_udp_st_clear_rules();
 		break;
+	}
+
+	case NSS_UDP_ST_IOCTL_STREAM:
+	{
+		uint32_t interval;
+
+		if (copy_from_user(&interval, (void __user *)arg, sizeof(interval))) {
+			return -EFAULT;
+		}
+
+		ret = nss_udp_st_stream_set_interval(interval);
+		break;
+	}
 
 	default:
 		ret = -EINVAL;
@@ -292,9 +365,11 @@ static long nss_udp_st_ioctl(struct file *file, unsigned int ioctl_num,
  * file ops for /dev/nss_udp_st
  */
 static const struct file_operations nss_udp_st_ops = {
+	.owner      =   THIS_MODULE,
 	.open       =   nss_udp_st_open,
 	.read       =   nss_udp_st_read,
 	.write      =  nss_udp_st_write,
+	.mmap       =   nss_udp_st_mmap,
 	.unlocked_ioctl = nss_udp_st_ioctl,
 	.release    =   nss_udp_st_release,
 };
@@ -311,6 +386,12 @@ static int __init nss_udp_st_init(void)
 	memset(&nust, 0, sizeof(struct nss_udp_st));
 	INIT_LIST_HEAD(&(nust.rules.list));
 
+	ret = nss_udp_st_stream_init();
+	if (ret) {
+		pr_err("Unable to allocate the stats ring err = %d\n", ret);
+		return ret;
+	}
+
 	dump_major = register_chrdev(UNNAMED_MAJOR, DEVICE_NAME, &nss_udp_st_ops);
 	if (dump_major < 0) {
 		ret = dump_major;
@@ -338,6 +419,7 @@ device_failed:
 class_failed:
 	unregister_chrdev(dump_major, DEVICE_NAME);
 reg_failed:
+	nss_udp_st_stream_deinit();
 	return ret;
 }
 
@@ -347,10 +429,18 @@ reg_failed:
  */
 static void __exit nss_udp_st_exit(void)
 {
+	if ((nust.dir == NSS_UDP_ST_RX) && (nust.mode == NSS_UDP_ST_START)) {
+		nss_udp_st_rx_unregister();
+	}
+
 	nust.mode = NSS_UDP_ST_STOP;
+	nss_udp_st_tx_cleanup();
+	nss_udp_st_flow_free();
+	nss_udp_st_clear_rules();
 	device_destroy(dump_class, MKDEV(dump_major, 0));
 	class_destroy(dump_class);
 	unregister_chrdev(dump_major, DEVICE_NAME);
+	nss_udp_st_stream_deinit();
 }
 
 /*
@@ -358,6 +448,15 @@ static void __exit nss_udp_st_exit(void)
  *  update packet and time stats for tx/rx
  */
 void nss_udp_st_update_stats(size_t pkt_size)
+{
+	nss_udp_st_update_stats_bulk(1, pkt_size);
+}
+
+/*
+ * nss_udp_st_update_stats_bulk()
+ *  update packet and time stats for a batch of tx/rx packets
+ */
+void nss_udp_st_update_stats_bulk(size_t pkts, size_t bytes)
 {
 	long time_curr;
 	long time_start;
@@ -368,13 +467,13 @@ void nss_udp_st_update_stats(size_t pkt_size)
 	}
 
 	if (nust.dir == NSS_UDP_ST_TX) {
-		atomic_long_inc(&nust.stats.p_stats.tx_packets);
-		atomic_long_add(pkt_size, &nust.stats.p_stats.tx_bytes);
+		atomic_long_add(pkts, &nust.stats.p_stats.tx_packets);
+		atomic_long_add(bytes, &nust.stats.p_stats.tx_bytes);
 	}
 
 	if (nust.dir == NSS_UDP_ST_RX) {
-		atomic_long_inc(&nust.stats.p_stats.rx_packets);
-		atomic_long_add(pkt_size, &nust.stats.p_stats.rx_bytes);
+		atomic_long_add(pkts, &nust.stats.p_stats.rx_packets);
+		atomic_long_add(bytes, &nust.stats.p_stats.rx_bytes);
 	}
 
 	atomic_long_set(&nust.stats.timer_stats[NSS_UDP_ST_STATS_TIME_CURRENT], (jiffies * 1000/HZ));
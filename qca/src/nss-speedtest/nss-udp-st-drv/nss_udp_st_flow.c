@@ -0,0 +1,378 @@
+/*
+ **************************************************************************
+ * Copyright (c) 2022 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT
+ * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ **************************************************************************
+ */
+#include <linux/list.h>
+#include <linux/skbuff.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/uaccess.h>
+#include "nss_udp_st_public.h"
+
+#define NSS_UDP_ST_FLOW_COPY_MAX	64	/* flow statistics copied to user per chunk */
+
+struct nss_udp_st_flow_tbl nss_udp_st_flows;
+static DEFINE_PER_CPU(struct nss_udp_st_flow_totals, nss_udp_st_flow_pcpu);
+
+/*
+ * nss_udp_st_flow_hash()
+ *	hash a 5-tuple into the rx lookup table
+ */
+static inline uint32_t nss_udp_st_flow_hash(uint16_t flags, uint32_t *sip, uint32_t *dip,
+						uint16_t sport, uint16_t dport)
+{
+	uint32_t s = sip[0];
+	uint32_t d = dip[0];
+
+	if (flags & NSS_UDP_ST_FLAG_IPV6) {
+		s ^= sip[1] ^ sip[2] ^ sip[3];
+		d ^= dip[1] ^ dip[2] ^ dip[3];
+	}
+
+	return jhash_3words(s, d, ((uint32_t)sport << 16) | dport, flags) & nss_udp_st_flows.hash_mask;
+}
+
+/*
+ * nss_udp_st_flow_match()
+ *	check if a flow carries the given 5-tuple
+ */
+static inline bool nss_udp_st_flow_match(struct nss_udp_st_flow *flow, uint16_t flags, uint32_t *sip,
+						uint32_t *dip, uint16_t sport, uint16_t dport)
+{
+	if ((flow->flags != flags) || (flow->sport != sport) || (flow->dport != dport)) {
+		return false;
+	}
+
+	if (flags & NSS_UDP_ST_FLAG_IPV4) {
+		return (flow->sip.ip.ipv4 == sip[0]) && (flow->dip.ip.ipv4 == dip[0]);
+	}
+
+	return nss_udp_st_compare_ipv6(flow->sip.ip.ipv6, sip) && nss_udp_st_compare_ipv6(flow->dip.ip.ipv6, dip);
+}
+
+/*
+ * nss_udp_st_flow_lookup()
+ *	find the flow of a received packet; addresses are in host order
+ */
+struct nss_udp_st_flow *nss_udp_st_flow_lookup(uint16_t flags, uint32_t *sip, uint32_t *dip,
+						uint16_t sport, uint16_t dport)
+{
+	struct nss_udp_st_flow *flow;
+	uint32_t idx;
+
+	if (!nss_udp_st_flows.count) {
+		return NULL;
+	}
+
+	idx = nss_udp_st_flow_hash(flags, sip, dip, sport, dport);
+	hlist_for_each_entry(flow, &nss_udp_st_flows.hash[idx], node) {
+		if (nss_udp_st_flow_match(flow, flags, sip, dip, sport, dport)) {
+			return flow;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * nss_udp_st_flow_rx()
+ *	account sequence and latency of a received probe
+ *
+ * A sequence number beyond the expected one counts the gap as lost; a later
+ * arrival of a missing number is counted as reordered and taken off the loss.
+ */
+void nss_udp_st_flow_rx(struct nss_udp_st_flow *flow, struct nss_udp_st_probe *probe)
+{
+	uint64_t seq = be64_to_cpu(probe->seq);
+	uint64_t sent = be64_to_cpu(probe->tstamp);
+	uint64_t now = ktime_get_real_ns();
+	struct nss_udp_st_flow_totals *totals;
+	int64_t lost;
+	bool late = false;
+	uint32_t lat = 0;
+	uint32_t bucket = 0;
+
+	if (now > sent) {
+		lat = (uint32_t)min_t(uint64_t, div_u64(now - sent, NSEC_PER_USEC), U32_MAX);
+		bucket = min_t(uint32_t, fls(lat), NSS_UDP_ST_LAT_HIST - 1);
+	}
+
+	spin_lock(&flow->lock);
+	flow->rx.packets++;
+	lost = flow->rx.lost;
+	if (seq >= flow->rx.next_seq) {
+		flow->rx.lost += seq - flow->rx.next_seq;
+		flow->rx.next_seq = seq + 1;
+	} else {
+		flow->rx.reordered++;
+		late = true;
+		if (flow->rx.lost) {
+			flow->rx.lost--;
+		}
+	}
+
+	lost = (int64_t)flow->rx.lost - lost;
+	flow->rx.lat_hist[bucket]++;
+	if (lat > flow->rx.lat_max) {
+		flow->rx.lat_max = lat;
+	}
+	spin_unlock(&flow->lock);
+
+	/*
+	 * Totals across flows for the interval snapshots; hooks run with
+	 * bottom halves disabled so the per CPU copy is ours.
+	 */
+	totals = this_cpu_ptr(&nss_udp_st_flow_pcpu);
+	totals->lost += lost;
+	totals->reordered += late;
+	totals->lat_hist[bucket]++;
+}
+
+/*
+ * nss_udp_st_flow_totals_get()
+ *	sum the per CPU rx totals
+ */
+void nss_udp_st_flow_totals_get(struct nss_udp_st_flow_totals *totals)
+{
+	struct nss_udp_st_flow_totals *pcpu;
+	int cpu;
+	int i;
+
+	memset(totals, 0, sizeof(*totals));
+	for_each_possible_cpu(cpu) {
+		pcpu = per_cpu_ptr(&nss_udp_st_flow_pcpu, cpu);
+		totals->lost += READ_ONCE(pcpu->lost);
+		totals->reordered += READ_ONCE(pcpu->reordered);
+		for (i = 0; i < NSS_UDP_ST_LAT_HIST; i++) {
+			totals->lat_hist[i] += READ_ONCE(pcpu->lat_hist[i]);
+		}
+	}
+}
+
+/*
+ * nss_udp_st_flow_percentile()
+ *	upper bound of the histogram bucket holding the given percentile
+ */
+static uint32_t nss_udp_st_flow_percentile(uint32_t *hist, uint64_t total, uint32_t pct, uint32_t max)
+{
+	uint64_t target = div_u64(total * pct + 99, 100);
+	uint64_t sum = 0;
+	int i;
+
+	if (!total) {
+		return 0;
+	}
+
+	for (i = 0; i < NSS_UDP_ST_LAT_HIST - 1; i++) {
+		sum += hist[i];
+		if (sum >= target) {
+			return min_t(uint32_t, 1U << i, max);
+		}
+	}
+
+	return max;
+}
+
+/*
+ * nss_udp_st_flow_fill()
+ *	snapshot one flow into the user visible statistics
+ */
+static void nss_udp_st_flow_fill(struct nss_udp_st_flow *flow, struct nss_udp_st_flow_stats *st)
+{
+	uint64_t samples = 0;
+	int i;
+
+	memset(st, 0, sizeof(*st));
+	if (flow->flags & NSS_UDP_ST_FLAG_IPV4) {
+		st->sip[0] = flow->sip.ip.ipv4;
+		st->dip[0] = flow->dip.ip.ipv4;
+		st->ip_version = 4;
+	} else {
+		memcpy(st->sip, flow->sip.ip.ipv6, sizeof(st->sip));
+		memcpy(st->dip, flow->dip.ip.ipv6, sizeof(st->dip));
+		st->ip_version = 6;
+	}
+
+	st->sport = flow->sport;
+	st->dport = flow->dport;
+
+	if (nss_udp_st_flows.tx) {
+		st->tx_packets = READ_ONCE(flow->tx.seq);
+		return;
+	}
+
+	spin_lock_bh(&flow->lock);
+
+	/*
+	 * The highest sequence seen tells how many the sender had put on the wire
+	 */
+	st->tx_packets = flow->rx.next_seq;
+	st->rx_packets = flow->rx.packets;
+	st->lost = flow->rx.lost;
+	st->reordered = flow->rx.reordered;
+	st->lat_max = flow->rx.lat_max;
+	for (i = 0; i < NSS_UDP_ST_LAT_HIST; i++) {
+		samples += flow->rx.lat_hist[i];
+	}
+
+	st->lat_p50 = nss_udp_st_flow_percentile(flow->rx.lat_hist, samples, 50, st->lat_max);
+	st->lat_p90 = nss_udp_st_flow_percentile(flow->rx.lat_hist, samples, 90, st->lat_max);
+	st->lat_p99 = nss_udp_st_flow_percentile(flow->rx.lat_hist, samples, 99, st->lat_max);
+	spin_unlock_bh(&flow->lock);
+}
+
+/*
+ * nss_udp_st_flow_stats_copy()
+ *	copy a window of per flow statistics to userspace
+ */
+int nss_udp_st_flow_stats_copy(struct nss_udp_st_flow_query *query)
+{
+	struct nss_udp_st_flow_stats __user *ustats = u64_to_user_ptr(query->stats);
+	struct nss_udp_st_flow_stats *buf;
+	uint32_t copied = 0;
+	uint32_t count;
+	uint32_t i;
+
+	query->total = nss_udp_st_flows.count;
+	if (query->start >= nss_udp_st_flows.count) {
+		query->count = 0;
+		return 0;
+	}
+
+	count = min(query->count, nss_udp_st_flows.count - query->start);
+	buf = kmalloc_array(NSS_UDP_ST_FLOW_COPY_MAX, sizeof(*buf), GFP_KERNEL);
+	if (!buf) {
+		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_MEMORY_FAILURE]);
+		return -ENOMEM;
+	}
+
+	while (copied < count) {
+		uint32_t n = min_t(uint32_t, count - copied, NSS_UDP_ST_FLOW_COPY_MAX);
+
+		for (i = 0; i < n; i++) {
+			nss_udp_st_flow_fill(&nss_udp_st_flows.flows[query->start + copied + i], &buf[i]);
+		}
+
+		if (copy_to_user(ustats + copied, buf, n * sizeof(*buf))) {
+			kfree(buf);
+			return -EFAULT;
+		}
+
+		copied += n;
+	}
+
+	kfree(buf);
+	query->count = copied;
+	return 0;
+}
+
+/*
+ * nss_udp_st_flow_free()
+ *	release the flows of the previous test
+ */
+void nss_udp_st_flow_free(void)
+{
+	uint32_t i;
+
+	if (!nss_udp_st_flows.flows) {
+		return;
+	}
+
+	if (nss_udp_st_flows.tx) {
+		for (i = 0; i < nss_udp_st_flows.count; i++) {
+			if (nss_udp_st_flows.flows[i].tx.skb) {
+				kfree_skb(nss_udp_st_flows.flows[i].tx.skb);
+			}
+		}
+	}
+
+	vfree(nss_udp_st_flows.hash);
+	vfree(nss_udp_st_flows.flows);
+	memset(&nss_udp_st_flows, 0, sizeof(nss_udp_st_flows));
+}
+
+/*
+ * nss_udp_st_flow_build()
+ *	expand the configured rules into flows
+ *
+ * Flow i of a rule uses source port (sport + i) modulo 64K and carries
+ * every wrap into the destination port.
+ */
+int nss_udp_st_flow_build(void)
+{
+	struct nss_udp_st_rules *pos = NULL;
+	struct nss_udp_st_flow *flow;
+	uint32_t buckets;
+	uint32_t count = 0;
+	uint32_t idx;
+	uint32_t i;
+
+	nss_udp_st_flow_free();
+
+	list_for_each_entry(pos, &nust.rules.list, list) {
+		count += max_t(uint32_t, pos->flows, 1);
+		if (count > NSS_UDP_ST_FLOWS_MAX) {
+			atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_TOO_MANY_FLOWS]);
+			pr_err("Too many flows, maximum is %u\n", NSS_UDP_ST_FLOWS_MAX);
+			return -E2BIG;
+		}
+	}
+
+	if (!count) {
+		return 0;
+	}
+
+	buckets = roundup_pow_of_two(count);
+	nss_udp_st_flows.flows = vzalloc(array_size(count, sizeof(struct nss_udp_st_flow)));
+	nss_udp_st_flows.hash = vzalloc(array_size(buckets, sizeof(struct hlist_head)));
+	if (!nss_udp_st_flows.flows || !nss_udp_st_flows.hash) {
+		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_MEMORY_FAILURE]);
+		vfree(nss_udp_st_flows.hash);
+		vfree(nss_udp_st_flows.flows);
+		memset(&nss_udp_st_flows, 0, sizeof(nss_udp_st_flows));
+		return -ENOMEM;
+	}
+
+	nss_udp_st_flows.hash_mask = buckets - 1;
+	nss_udp_st_flows.tx = (nust.dir == NSS_UDP_ST_TX);
+	flow = nss_udp_st_flows.flows;
+
+	list_for_each_entry(pos, &nust.rules.list, list) {
+		uint32_t n = max_t(uint32_t, pos->flows, 1);
+
+		for (i = 0; i < n; i++, flow++) {
+			uint32_t port = pos->sport + i;
+
+			flow->sip = pos->sip;
+			flow->dip = pos->dip;
+			flow->flags = pos->flags;
+			flow->sport = (uint16_t)port;
+			flow->dport = pos->dport + (uint16_t)(port >> 16);
+			spin_lock_init(&flow->lock);
+
+			idx = nss_udp_st_flow_hash(flow->flags,
+					(flow->flags & NSS_UDP_ST_FLAG_IPV4) ? &flow->sip.ip.ipv4 : flow->sip.ip.ipv6,
+					(flow->flags & NSS_UDP_ST_FLAG_IPV4) ? &flow->dip.ip.ipv4 : flow->dip.ip.ipv6,
+					flow->sport, flow->dport);
+			hlist_add_head(&flow->node, &nss_udp_st_flows.hash[idx]);
+		}
+	}
+
+	nss_udp_st_flows.count = count;
+	pr_debug("expanded %u rules into %u flows\n", nust.rule_count, count);
+	return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ **************************************************************************
+ * Copyright (c) 2022 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT
+ * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ **************************************************************************
+ */
+#ifndef __NSS_UDP_ST_FLOW_H
+#define __NSS_UDP_ST_FLOW_H
+
+/*
+ * nss_udp_st_flow
+ *	one 5-tuple expanded from a rule
+ *
+ * Every rule is expanded into rule->flows 5-tuples by stepping the source port
+ * and carrying into the destination port. Tx owns each flow from exactly one
+ * thread, so the tx part needs no locking; the rx part is updated from the
+ * pre-routing hook, which may run on any CPU, under the flow lock.
+ */
+struct nss_udp_st_flow {
+	struct hlist_node node;		/* rx lookup hash chain */
+	struct nss_udp_st_ip sip;	/* source ip */
+	struct nss_udp_st_ip dip;	/* dest ip */
+	uint16_t sport;			/* source port */
+	uint16_t dport;			/* dest port */
+	uint16_t flags;			/* version of IP address */
+	spinlock_t lock;		/* protects rx statistics */
+	union {
+		struct {
+			struct sk_buff *skb;	/* prebuilt template */
+			uint64_t seq;		/* next sequence number */
+			__wsum csum;		/* UDP checksum of the template without pseudo header */
+			uint16_t probe_off;	/* probe offset from skb->head */
+			uint16_t data_off;	/* template skb->data offset from skb->head */
+			uint16_t len;		/* template skb->len */
+		} tx;
+		struct {
+			uint64_t packets;	/* packets received */
+			uint64_t next_seq;	/* next expected sequence number */
+			uint64_t lost;		/* sequence gaps not filled */
+			uint64_t reordered;	/* late arrivals */
+			uint32_t lat_max;	/* maximum latency in us */
+			uint32_t lat_hist[NSS_UDP_ST_LAT_HIST];	/* latency histogram */
+		} rx;
+	};
+};
+
+/*
+ * nss_udp_st_flow_totals
+ *	rx accounting summed over all flows since the module was loaded
+ */
+struct nss_udp_st_flow_totals {
+	int64_t lost;			/* net sequence gaps; late arrivals subtract */
+	uint64_t reordered;		/* late arrivals */
+	uint64_t lat_hist[NSS_UDP_ST_LAT_HIST];	/* latency histogram */
+};
+
+/*
+ * nss_udp_st_flow_tbl
+ *	flows of the current test
+ */
+struct nss_udp_st_flow_tbl {
+	struct nss_udp_st_flow *flows;	/* flow array */
+	struct hlist_head *hash;	/* rx lookup buckets */
+	uint32_t count;			/* number of flows */
+	uint32_t hash_mask;		/* bucket mask */
+	bool tx;			/* flows hold tx templates */
+};
+
+extern struct nss_udp_st_flow_tbl nss_udp_st_flows;
+
+int nss_udp_st_flow_build(void);
+
+void nss_udp_st_flow_free(void);
+
+struct nss_udp_st_flow *nss_udp_st_flow_lookup(uint16_t flags, uint32_t *sip, uint32_t *dip,
+						uint16_t sport, uint16_t dport);
+
+void nss_udp_st_flow_rx(struct nss_udp_st_flow *flow, struct nss_udp_st_probe *probe);
+
+int nss_udp_st_flow_stats_copy(struct nss_udp_st_flow_query *query);
+
+void nss_udp_st_flow_totals_get(struct nss_udp_st_flow_totals *totals);
+
+#endif /*NSS_UDP_ST_FLOW_H*/
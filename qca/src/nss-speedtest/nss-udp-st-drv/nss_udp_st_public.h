@@ -28,6 +28,8 @@
  */
 
 #include "nss_udp_st_drv.h"
+#include "nss_udp_st_flow.h"
+#include "nss_udp_st_stream.h"
 #include "nss_udp_st_tx.h"
 #include "nss_udp_st_rx.h"
 #include "nss_udp_st_ip.h"
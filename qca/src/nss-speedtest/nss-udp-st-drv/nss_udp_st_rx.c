@@ -20,6 +20,31 @@
 #include <net/netfilter/nf_conntrack_core.h>
 #include "nss_udp_st_public.h"
 
+/*
+ * nss_udp_st_rx_probe()
+ *	account a matched packet against its flow and consume it
+ */
+static unsigned int nss_udp_st_rx_probe(struct sk_buff *skb, struct nss_udp_st_flow *flow, struct udphdr *uh,
+					size_t pkt_size)
+{
+	struct nss_udp_st_probe *probe = (struct nss_udp_st_probe *)(uh + 1);
+
+	/*
+	 * Packets from senders without the probe still count towards throughput
+	 */
+	if ((ntohs(uh->len) >= sizeof(*uh) + sizeof(*probe)) &&
+		pskb_may_pull(skb, (unsigned char *)(probe + 1) - skb->data)) {
+		probe = (struct nss_udp_st_probe *)(udp_hdr(skb) + 1);
+		if (probe->magic == htonl(NSS_UDP_ST_PROBE_MAGIC)) {
+			nss_udp_st_flow_rx(flow, probe);
+		}
+	}
+
+	nss_udp_st_update_stats(pkt_size);
+	kfree_skb(skb);
+	return NF_STOLEN;
+}
+
 /*
  * nss_udp_st_rx_ipv4_pre_routing_hook()
  *	pre-routing hook into netfilter packet monitoring point for IPv4
@@ -28,8 +53,9 @@ unsigned int nss_udp_st_rx_ipv4_pre_routing_hook(void *priv, struct sk_buff *skb
 {
 	struct udphdr *uh;
 	struct iphdr *iph;
-	struct nss_udp_st_rules *rules = NULL;
-	struct nss_udp_st_rules *n = NULL;
+	struct nss_udp_st_flow *flow;
+	uint32_t saddr;
+	uint32_t daddr;
 
 	iph = (struct iphdr *)skb_network_header(skb);
 
@@ -42,22 +68,19 @@ unsigned int nss_udp_st_rx_ipv4_pre_routing_hook(void *priv, struct sk_buff *skb
 
 	uh = (struct udphdr *)skb_transport_header(skb);
 
-	list_for_each_entry_safe(rules, n, &nust.rules.list, list) {
-		/*
-		 * If incoming packet matches 5tuple, it is a speedtest packet.
-		 * Increase Rx packet stats and drop packet.
-		 */
-		if ((rules->flags & NSS_UDP_ST_FLAG_IPV4) &&
-			(rules->sip.ip.ipv4 == ntohl(iph->daddr)) &&
-			(rules->dip.ip.ipv4 == ntohl(iph->saddr)) &&
-			(rules->sport == ntohs(uh->source)) &&
-			(rules->dport == ntohs(uh->dest)) ) {
-				nss_udp_st_update_stats(ntohs(iph->tot_len) + sizeof(struct ethhdr));
-				kfree_skb(skb);
-				return NF_STOLEN;
-		}
+	saddr = ntohl(iph->saddr);
+	daddr = ntohl(iph->daddr);
+
+	/*
+	 * If incoming packet matches the 5tuple of a flow, it is a speedtest packet.
+	 * Increase Rx packet stats and drop packet.
+	 */
+	flow = nss_udp_st_flow_lookup(NSS_UDP_ST_FLAG_IPV4, &daddr, &saddr, ntohs(uh->source), ntohs(uh->dest));
+	if (!flow) {
+		return NF_ACCEPT;
 	}
-	return NF_ACCEPT;
+
+	return nss_udp_st_rx_probe(skb, flow, uh, ntohs(iph->tot_len) + sizeof(struct ethhdr));
 }
 
 /*
@@ -70,8 +93,7 @@ unsigned int nss_udp_st_rx_ipv6_pre_routing_hook(void *priv, struct sk_buff *skb
 	struct ipv6hdr *iph;
 	struct in6_addr saddr;
 	struct in6_addr daddr;
-	struct nss_udp_st_rules *rules = NULL;
-	struct nss_udp_st_rules *n = NULL;
+	struct nss_udp_st_flow *flow;
 
 	iph = (struct ipv6hdr *)skb_network_header(skb);
 
@@ -87,21 +109,15 @@ unsigned int nss_udp_st_rx_ipv6_pre_routing_hook(void *priv, struct sk_buff *skb
 	nss_udp_st_get_ipv6_addr_ntoh(iph->saddr.s6_addr32, saddr.s6_addr32);
 	nss_udp_st_get_ipv6_addr_ntoh(iph->daddr.s6_addr32, daddr.s6_addr32);
 
-	list_for_each_entry_safe(rules, n, &nust.rules.list, list) {
-
-		/*
-		 * If incoming packet matches 5tuple, it is a speedtest packet.
-		 * Increase Rx packet stats and drop packet.
-		 */
-		if ((rules->flags & NSS_UDP_ST_FLAG_IPV6) &&
-			(nss_udp_st_compare_ipv6(rules->sip.ip.ipv6, daddr.s6_addr32)) &&
-			(nss_udp_st_compare_ipv6(rules->dip.ip.ipv6, saddr.s6_addr32)) &&
-			(rules->sport == ntohs(uh->source)) &&
-			(rules->dport == ntohs(uh->dest))) {
-				nss_udp_st_update_stats(ntohs(iph->payload_len) + sizeof(struct ethhdr));
-				kfree_skb(skb);
-				return NF_STOLEN;
-		}
+	/*
+	 * If incoming packet matches the 5tuple of a flow, it is a speedtest packet.
+	 * Increase Rx packet stats and drop packet.
+	 */
+	flow = nss_udp_st_flow_lookup(NSS_UDP_ST_FLAG_IPV6, daddr.s6_addr32, saddr.s6_addr32,
+					ntohs(uh->source), ntohs(uh->dest));
+	if (!flow) {
+		return NF_ACCEPT;
 	}
-	return NF_ACCEPT;
+
+	return nss_udp_st_rx_probe(skb, flow, uh, ntohs(iph->payload_len) + sizeof(struct ethhdr));
 }
@@ -0,0 +1,228 @@
+/*
+ **************************************************************************
+ * Copyright (c) 2022 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT
+ * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ **************************************************************************
+ */
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include "nss_udp_st_public.h"
+
+/*
+ * nss_udp_st_stream
+ *	interval snapshot state
+ */
+struct nss_udp_st_stream {
+	struct nss_udp_st_ring *ring;		/* shared snapshot ring */
+	size_t size;				/* mapped size of the ring */
+	struct delayed_work work;		/* snapshot work */
+	struct mutex lock;			/* serializes interval changes */
+	uint64_t last_ns;			/* time of the previous snapshot */
+	uint64_t tx_packets;			/* counters at the previous snapshot */
+	uint64_t tx_bytes;
+	uint64_t rx_packets;
+	uint64_t rx_bytes;
+	uint64_t drops;
+	struct nss_udp_st_flow_totals totals;	/* flow totals at the previous snapshot */
+};
+
+static struct nss_udp_st_stream nss_udp_st_stream;
+
+/*
+ * nss_udp_st_stream_delta()
+ *	interval delta of a counter that restarts with every test
+ */
+static inline uint64_t nss_udp_st_stream_delta(uint64_t cur, uint64_t *prev)
+{
+	uint64_t delta = (cur >= *prev) ? cur - *prev : cur;
+
+	*prev = cur;
+	return delta;
+}
+
+/*
+ * nss_udp_st_stream_rate()
+ *	scale an interval count to a per second rate
+ */
+static inline uint64_t nss_udp_st_stream_rate(uint64_t count, uint64_t interval_ns)
+{
+	uint64_t interval_us = div_u64(interval_ns, NSEC_PER_USEC);
+
+	/*
+	 * Microsecond resolution keeps count * USEC_PER_SEC clear of overflow
+	 * at line rate bit counts.
+	 */
+	if (!interval_us) {
+		return 0;
+	}
+
+	return div64_u64(count * USEC_PER_SEC, interval_us);
+}
+
+/*
+ * nss_udp_st_stream_baseline()
+ *	take the counters a new run of snapshots is measured against
+ */
+static void nss_udp_st_stream_baseline(void)
+{
+	struct nss_udp_st_stream *st = &nss_udp_st_stream;
+
+	st->last_ns = ktime_get_ns();
+	st->tx_packets = atomic_long_read(&nust.stats.p_stats.tx_packets);
+	st->tx_bytes = atomic_long_read(&nust.stats.p_stats.tx_bytes);
+	st->rx_packets = atomic_long_read(&nust.stats.p_stats.rx_packets);
+	st->rx_bytes = atomic_long_read(&nust.stats.p_stats.rx_bytes);
+	st->drops = atomic_long_read(&nust.stats.errors[NSS_UDP_ST_ERROR_PACKET_DROP]);
+	nss_udp_st_flow_totals_get(&st->totals);
+}
+
+/*
+ * nss_udp_st_stream_work()
+ *	publish one interval snapshot and rearm
+ */
+static void nss_udp_st_stream_work(struct work_struct *work)
+{
+	struct nss_udp_st_stream *st = container_of(to_delayed_work(work), struct nss_udp_st_stream, work);
+	struct nss_udp_st_ring *ring = st->ring;
+	struct nss_udp_st_flow_totals totals;
+	struct nss_udp_st_snap *snap;
+	uint64_t now = ktime_get_ns();
+	uint64_t interval = now - st->last_ns;
+	uint64_t head = ring->head + 1;
+	uint64_t tx_packets, tx_bytes, rx_packets, rx_bytes;
+	int i;
+
+	snap = &ring->snap[head % ring->entries];
+
+	/*
+	 * Invalidate the slot before rewriting it so that a reader overlapping
+	 * the update discards its copy.
+	 */
+	WRITE_ONCE(snap->seq, 0);
+	smp_wmb();
+
+	snap->tstamp = ktime_get_real_ns();
+	snap->tstamp = div_u64(snap->tstamp, NSEC_PER_MSEC);
+	snap->interval = interval;
+	snap->tx_packets = atomic_long_read(&nust.stats.p_stats.tx_packets);
+	snap->tx_bytes = atomic_long_read(&nust.stats.p_stats.tx_bytes);
+	snap->rx_packets = atomic_long_read(&nust.stats.p_stats.rx_packets);
+	snap->rx_bytes = atomic_long_read(&nust.stats.p_stats.rx_bytes);
+
+	tx_packets = nss_udp_st_stream_delta(snap->tx_packets, &st->tx_packets);
+	tx_bytes = nss_udp_st_stream_delta(snap->tx_bytes, &st->tx_bytes);
+	rx_packets = nss_udp_st_stream_delta(snap->rx_packets, &st->rx_packets);
+	rx_bytes = nss_udp_st_stream_delta(snap->rx_bytes, &st->rx_bytes);
+
+	snap->tx_pps = nss_udp_st_stream_rate(tx_packets, interval);
+	snap->tx_bps = nss_udp_st_stream_rate(tx_bytes * 8, interval);
+	snap->rx_pps = nss_udp_st_stream_rate(rx_packets, interval);
+	snap->rx_bps = nss_udp_st_stream_rate(rx_bytes * 8, interval);
+	snap->drops = nss_udp_st_stream_delta(atomic_long_read(&nust.stats.errors[NSS_UDP_ST_ERROR_PACKET_DROP]),
+						&st->drops);
+
+	nss_udp_st_flow_totals_get(&totals);
+	snap->lost = totals.lost - st->totals.lost;
+	snap->reordered = totals.reordered - st->totals.reordered;
+	for (i = 0; i < NSS_UDP_ST_LAT_HIST; i++) {
+		snap->lat_hist[i] = (uint32_t)(totals.lat_hist[i] - st->totals.lat_hist[i]);
+	}
+
+	st->totals = totals;
+	st->last_ns = now;
+
+	smp_wmb();
+	WRITE_ONCE(snap->seq, head);
+	smp_wmb();
+	WRITE_ONCE(ring->head, head);
+
+	schedule_delayed_work(&st->work, msecs_to_jiffies(ring->interval));
+}
+
+/*
+ * nss_udp_st_stream_set_interval()
+ *	start, retime or stop (interval 0) the snapshots
+ */
+int nss_udp_st_stream_set_interval(uint32_t interval)
+{
+	struct nss_udp_st_stream *st = &nss_udp_st_stream;
+
+	if (interval && (interval < NSS_UDP_ST_STREAM_INTERVAL_MIN)) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&st->lock);
+	cancel_delayed_work_sync(&st->work);
+	WRITE_ONCE(st->ring->interval, interval);
+	if (interval) {
+		nss_udp_st_stream_baseline();
+		schedule_delayed_work(&st->work, msecs_to_jiffies(interval));
+	}
+	mutex_unlock(&st->lock);
+
+	return 0;
+}
+
+/*
+ * nss_udp_st_stream_mmap()
+ *	map the snapshot ring read-only into userspace
+ */
+int nss_udp_st_stream_mmap(struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE) {
+		return -EPERM;
+	}
+
+	if (vma->vm_pgoff || (vma->vm_end - vma->vm_start) > nss_udp_st_stream.size) {
+		return -EINVAL;
+	}
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, nss_udp_st_stream.ring, 0);
+}
+
+/*
+ * nss_udp_st_stream_init()
+ *	allocate the snapshot ring
+ */
+int nss_udp_st_stream_init(void)
+{
+	struct nss_udp_st_stream *st = &nss_udp_st_stream;
+
+	st->size = PAGE_ALIGN(struct_size(st->ring, snap, NSS_UDP_ST_RING_ENTRIES));
+	st->ring = vmalloc_user(st->size);
+	if (!st->ring) {
+		return -ENOMEM;
+	}
+
+	st->ring->magic = NSS_UDP_ST_RING_MAGIC;
+	st->ring->entries = NSS_UDP_ST_RING_ENTRIES;
+	mutex_init(&st->lock);
+	INIT_DELAYED_WORK(&st->work, nss_udp_st_stream_work);
+	return 0;
+}
+
+/*
+ * nss_udp_st_stream_deinit()
+ *	stop the snapshots and free the ring
+ */
+void nss_udp_st_stream_deinit(void)
+{
+	struct nss_udp_st_stream *st = &nss_udp_st_stream;
+
+	cancel_delayed_work_sync(&st->work);
+	vfree(st->ring);
+	st->ring = NULL;
+}
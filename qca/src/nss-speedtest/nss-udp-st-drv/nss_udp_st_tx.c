@@ -18,7 +18,8 @@
 
 #include <linux/list.h>
 #include <linux/string.h>
-#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
 #include <net/act_api.h>
 #include <net/netfilter/nf_conntrack_core.h>
 #include <linux/if_vlan.h>
@@ -26,10 +27,20 @@
 #include <net/ip6_checksum.h>
 #include "nss_udp_st_public.h"
 
-int tx_timer_flag;
-static ktime_t kt;
-static struct hrtimer tx_hr_timer;
-static enum hrtimer_restart tx_hr_restart = HRTIMER_NORESTART;
+/*
+ * nss_udp_st_tx_thread
+ *	per CPU transmit thread; sends flows first, first + stride, ...
+ */
+struct nss_udp_st_tx_thread {
+	struct task_struct *task;	/* bound kthread */
+	uint32_t first;			/* first flow of this thread */
+	uint32_t stride;		/* distance between its flows */
+	uint32_t burst;			/* packets sent per pacing step */
+	uint64_t gap_ns;		/* time between its packets at the target rate */
+};
+
+static struct nss_udp_st_tx_thread *nss_udp_st_tx_threads;
+static uint32_t nss_udp_st_tx_nthreads;
 static struct vlan_hdr vh;
 static struct net_device *xmit_dev;
 static struct pppoe_opt info;
@@ -38,7 +49,7 @@ static struct pppoe_opt info;
  * nss_udp_st_generate_ipv4_hdr()
  *	generate ipv4 header
  */
-static inline void nss_udp_st_generate_ipv4_hdr(struct iphdr *iph, uint16_t ip_len, struct nss_udp_st_rules *rules)
+static inline void nss_udp_st_generate_ipv4_hdr(struct iphdr *iph, uint16_t ip_len, struct nss_udp_st_flow *flow)
 {
 	iph->version = 4;
 	iph->ihl = 5;
@@ -49,8 +60,8 @@ static inline void nss_udp_st_generate_ipv4_hdr(struct iphdr *iph, uint16_t ip_l
 	iph->ttl = 64;
 	iph->protocol = IPPROTO_UDP;
 	iph->check = 0;
-	iph->saddr = htonl(rules->sip.ip.ipv4);
-	iph->daddr = htonl(rules->dip.ip.ipv4);
+	iph->saddr = htonl(flow->sip.ip.ipv4);
+	iph->daddr = htonl(flow->dip.ip.ipv4);
 	iph->check = ip_fast_csum((unsigned char *)iph, iph->ihl);
 }
 
@@ -58,7 +69,7 @@ static inline void nss_udp_st_generate_ipv4_hdr(struct iphdr *iph, uint16_t ip_l
  * nss_udp_st_generate_ipv6_hdr()
  *	generate ipv6 header
  */
-static inline void nss_udp_st_generate_ipv6_hdr(struct ipv6hdr *ipv6h, uint16_t ip_len, struct nss_udp_st_rules *rules)
+static inline void nss_udp_st_generate_ipv6_hdr(struct ipv6hdr *ipv6h, uint16_t ip_len, struct nss_udp_st_flow *flow)
 {
 	struct in6_addr addr;
 
@@ -67,43 +78,22 @@ static inline void nss_udp_st_generate_ipv6_hdr(struct ipv6hdr *ipv6h, uint16_t
 	ipv6h->nexthdr = IPPROTO_UDP;
 	ipv6h->payload_len = htons(ip_len - sizeof(*ipv6h));
 	ipv6h->hop_limit = 64;
-	nss_udp_st_get_ipv6_addr_hton(rules->sip.ip.ipv6, addr.s6_addr32);
+	nss_udp_st_get_ipv6_addr_hton(flow->sip.ip.ipv6, addr.s6_addr32);
 	memcpy(ipv6h->saddr.s6_addr32, addr.s6_addr32, sizeof(ipv6h->saddr.s6_addr32));
-	nss_udp_st_get_ipv6_addr_hton(rules->dip.ip.ipv6, addr.s6_addr32);
+	nss_udp_st_get_ipv6_addr_hton(flow->dip.ip.ipv6, addr.s6_addr32);
 	memcpy(ipv6h->daddr.s6_addr32, addr.s6_addr32, sizeof(ipv6h->daddr.s6_addr32));
 }
 
 /*
  * nss_udp_st_generate_udp_hdr()
- *	generate udp header
+ *	generate udp header; the checksum is filled per packet from the template sum
  */
-static void nss_udp_st_generate_udp_hdr(struct udphdr *uh, uint16_t udp_len, struct nss_udp_st_rules *rules)
+static void nss_udp_st_generate_udp_hdr(struct udphdr *uh, uint16_t udp_len, struct nss_udp_st_flow *flow)
 {
-
-	uh->source = htons(rules->sport);
-	uh->dest = htons(rules->dport);
+	uh->source = htons(flow->sport);
+	uh->dest = htons(flow->dport);
 	uh->len = htons(udp_len);
-
-	if (rules->flags & NSS_UDP_ST_FLAG_IPV4) {
-		uh->check = csum_tcpudp_magic(rules->sip.ip.ipv4, rules->dip.ip.ipv4, udp_len, IPPROTO_UDP,
-		csum_partial(uh, udp_len, 0));
-	} else if (rules->flags & NSS_UDP_ST_FLAG_IPV6) {
-		struct in6_addr saddr;
-		struct in6_addr daddr;
-
-		nss_udp_st_get_ipv6_addr_hton(rules->sip.ip.ipv6, saddr.s6_addr32);
-		nss_udp_st_get_ipv6_addr_hton(rules->dip.ip.ipv6, daddr.s6_addr32);
-
-		uh->check = csum_ipv6_magic(&saddr, &daddr, udp_len, IPPROTO_UDP,
-		csum_partial(uh, udp_len, 0));
-	} else {
-		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_INCORRECT_IP_VERSION]);
-		return;
-	}
-
-	if (uh->check == 0) {
-		uh->check = CSUM_MANGLED_0;
-	}
+	uh->check = 0;
 }
 
 /*
@@ -173,15 +163,17 @@ static void nss_udp_st_generate_pppoe_hdr(struct sk_buff *skb, uint16_t ppp_prot
 }
 
 /*
- * nss_udp_st_tx_packets()
- *	allocate, populate and send tx packet
+ * nss_udp_st_tx_flow_template()
+ *	allocate and populate the template packet of a flow
  */
-static void nss_udp_st_tx_packets(struct net_device *ndev, struct nss_udp_st_rules *rules)
+static int nss_udp_st_tx_flow_template(struct net_device *ndev, struct nss_udp_st_rules *rules,
+					struct nss_udp_st_flow *flow, uint32_t index)
 {
 	struct sk_buff *skb;
 	struct udphdr *uh;
 	struct iphdr *iph;
 	struct ipv6hdr *ipv6h;
+	struct nss_udp_st_probe *probe;
 	size_t align_offset;
 	size_t skb_sz;
 	size_t pkt_sz;
@@ -193,13 +185,18 @@ static void nss_udp_st_tx_packets(struct net_device *ndev, struct nss_udp_st_rul
 	pkt_sz = nust.config.buffer_sz;
 	ip_len = pkt_sz;
 
-	if (rules->flags & NSS_UDP_ST_FLAG_IPV4) {
+	if (flow->flags & NSS_UDP_ST_FLAG_IPV4) {
 		udp_len = pkt_sz - sizeof(*iph);
-	} else if (rules->flags & NSS_UDP_ST_FLAG_IPV6) {
+	} else if (flow->flags & NSS_UDP_ST_FLAG_IPV6) {
 		udp_len = pkt_sz - sizeof(*ipv6h);
 	} else {
 		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_INCORRECT_IP_VERSION]);
-		return;
+		return -EINVAL;
+	}
+
+	if (udp_len < sizeof(*uh) + sizeof(*probe)) {
+		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_INCORRECT_BUFFER_SIZE]);
+		return -EINVAL;
 	}
 
 	skb_sz = NSS_UDP_ST_MIN_HEADROOM + pkt_sz + sizeof(struct ethhdr) + NSS_UDP_ST_MIN_TAILROOM + SMP_CACHE_BYTES;
@@ -207,7 +204,7 @@ static void nss_udp_st_tx_packets(struct net_device *ndev, struct nss_udp_st_rul
 	skb = dev_alloc_skb(skb_sz);
 	if (!skb) {
 		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_MEMORY_FAILURE]);
-		return;
+		return -ENOMEM;
 	}
 
 	align_offset = PTR_ALIGN(skb->data, SMP_CACHE_BYTES) - skb->data;
@@ -219,34 +216,39 @@ static void nss_udp_st_tx_packets(struct net_device *ndev, struct nss_udp_st_rul
 	skb_push(skb, sizeof(*uh));
 	skb_reset_transport_header(skb);
 	uh = udp_hdr(skb);
-	nss_udp_st_generate_udp_hdr(uh, udp_len, rules);
+	nss_udp_st_generate_udp_hdr(uh, udp_len, flow);
 
 	/*
 	 * populate ipv4 or ipv6  header
 	 */
-	if (rules->flags & NSS_UDP_ST_FLAG_IPV4) {
+	if (flow->flags & NSS_UDP_ST_FLAG_IPV4) {
 		skb_push(skb, sizeof(*iph));
 		skb_reset_network_header(skb);
 		iph = ip_hdr(skb);
-		nss_udp_st_generate_ipv4_hdr(iph, ip_len, rules);
+		nss_udp_st_generate_ipv4_hdr(iph, ip_len, flow);
 		data = skb_put(skb, pkt_sz - sizeof(*iph) - sizeof(*uh));
 		memset(data, 0, pkt_sz - sizeof(*iph) - sizeof(*uh));
-	} else if (rules->flags & NSS_UDP_ST_FLAG_IPV6) {
+	} else {
 		skb_push(skb, sizeof(*ipv6h));
 		skb_reset_network_header(skb);
 		ipv6h = ipv6_hdr(skb);
-		nss_udp_st_generate_ipv6_hdr(ipv6h, ip_len, rules);
+		nss_udp_st_generate_ipv6_hdr(ipv6h, ip_len, flow);
 		data = skb_put(skb, pkt_sz - sizeof(*ipv6h) - sizeof(*uh));
 		memset(data, 0, pkt_sz - sizeof(*ipv6h) - sizeof(*uh));
-	} else {
-		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_INCORRECT_IP_VERSION]);
-		kfree_skb(skb);
-		return;
 	}
 
+	/*
+	 * The probe leads the payload. Sequence and timestamp stay zero in the
+	 * template so that its sum covers everything but them.
+	 */
+	probe = (struct nss_udp_st_probe *)data;
+	probe->magic = htonl(NSS_UDP_ST_PROBE_MAGIC);
+	probe->flow = htonl(index);
+	flow->tx.csum = csum_partial(uh, udp_len, 0);
+
 	switch (ndev->type) {
 	case ARPHRD_PPP:
-		if (rules->flags & NSS_UDP_ST_FLAG_IPV4) {
+		if (flow->flags & NSS_UDP_ST_FLAG_IPV4) {
 			ppp_protocol = PPP_IP;
 		} else {
 			ppp_protocol = PPP_IPV6;
@@ -265,7 +267,7 @@ static void nss_udp_st_tx_packets(struct net_device *ndev, struct nss_udp_st_rul
 		break;
 
 	case ARPHRD_ETHER:
-		if (rules->flags & NSS_UDP_ST_FLAG_IPV4) {
+		if (flow->flags & NSS_UDP_ST_FLAG_IPV4) {
 			skb->protocol = htons(ETH_P_IP);
 		} else {
 			skb->protocol = htons(ETH_P_IPV6);
@@ -285,17 +287,114 @@ static void nss_udp_st_tx_packets(struct net_device *ndev, struct nss_udp_st_rul
 		break;
 	}
 
+	skb->dev = xmit_dev;
+	flow->tx.skb = skb;
+	flow->tx.probe_off = (unsigned char *)probe - skb->head;
+	flow->tx.data_off = skb->data - skb->head;
+	flow->tx.len = skb->len;
+	flow->tx.seq = 0;
+	return 0;
+}
+
+/*
+ * nss_udp_st_tx_flow_skb()
+ *	get the packet to send next for a flow
+ *
+ * Once the driver has released the previous send the template is sent
+ * again with an extra reference, like pktgen does; its layout is restored
+ * in case the driver moved skb->data. While the template is still queued
+ * it can't be stamped, so a copy with the same layout is sent instead.
+ */
+static struct sk_buff *nss_udp_st_tx_flow_skb(struct nss_udp_st_flow *flow)
+{
+	struct sk_buff *skb = flow->tx.skb;
+
+	if (likely(!skb_shared(skb))) {
+		skb->data = skb->head + flow->tx.data_off;
+		skb->len = flow->tx.len;
+		skb_set_tail_pointer(skb, flow->tx.len);
+		skb->dev = xmit_dev;
+		return skb_get(skb);
+	}
+
+	atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_TX_COPY]);
+	return skb_copy(skb, GFP_ATOMIC);
+}
+
+/*
+ * nss_udp_st_tx_flow_xmit()
+ *	stamp and send the next packet of a flow
+ *
+ * Called with bottom halves disabled.
+ */
+static int nss_udp_st_tx_flow_xmit(struct nss_udp_st_flow *flow)
+{
+	struct nss_udp_st_probe *probe;
+	struct netdev_queue *txq;
+	struct sk_buff *skb;
+	struct udphdr *uh;
+	netdev_tx_t ret;
+	__wsum csum;
+	int cpu = smp_processor_id();
+
+	skb = nss_udp_st_tx_flow_skb(flow);
+	if (!skb) {
+		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_MEMORY_FAILURE]);
+		return -ENOMEM;
+	}
+
+	probe = (struct nss_udp_st_probe *)(skb->head + flow->tx.probe_off);
+	probe->seq = cpu_to_be64(flow->tx.seq);
+	probe->tstamp = cpu_to_be64(ktime_get_real_ns());
+	csum = csum_partial(&probe->seq, sizeof(probe->seq) + sizeof(probe->tstamp), flow->tx.csum);
+
+	uh = (struct udphdr *)probe - 1;
+	if (flow->flags & NSS_UDP_ST_FLAG_IPV4) {
+		struct iphdr *iph = (struct iphdr *)uh - 1;
+
+		uh->check = csum_tcpudp_magic(iph->saddr, iph->daddr, ntohs(uh->len), IPPROTO_UDP, csum);
+	} else {
+		struct ipv6hdr *ipv6h = (struct ipv6hdr *)uh - 1;
+
+		uh->check = csum_ipv6_magic(&ipv6h->saddr, &ipv6h->daddr, ntohs(uh->len), IPPROTO_UDP, csum);
+	}
+
+	if (uh->check == 0) {
+		uh->check = CSUM_MANGLED_0;
+	}
+
 	/*
-	 * tx packet
+	 * Threads on other CPUs share the device; serialize on the queue lock
+	 * like the stack does and leave a stopped queue alone.
 	 */
-	skb->dev = xmit_dev;
-	if (xmit_dev->netdev_ops->ndo_start_xmit(skb, xmit_dev) != NETDEV_TX_OK) {
+	skb_set_queue_mapping(skb, cpu % xmit_dev->real_num_tx_queues);
+	txq = skb_get_tx_queue(xmit_dev, skb);
+
+	HARD_TX_LOCK(xmit_dev, txq, cpu);
+	if (unlikely(netif_xmit_frozen_or_stopped(txq))) {
+		HARD_TX_UNLOCK(xmit_dev, txq);
+		kfree_skb(skb);
+		return -EBUSY;
+	}
+
+	ret = netdev_start_xmit(skb, xmit_dev, txq, false);
+	HARD_TX_UNLOCK(xmit_dev, txq);
+
+	if (likely(ret == NETDEV_TX_OK)) {
+		flow->tx.seq++;
+		return 0;
+	}
+
+	/*
+	 * A busy driver hands the packet back; anything else consumed it
+	 */
+	if (!dev_xmit_complete(ret)) {
 		kfree_skb(skb);
-		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_PACKET_DROP]);
-		return;
+		return -EBUSY;
 	}
 
-	nss_udp_st_update_stats(ip_len + sizeof(struct ethhdr));
+	atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_PACKET_DROP]);
+	return -EIO;
 }
 
 /*
@@ -423,36 +522,66 @@ fail:
 }
 
 /*
- * nss_udp_st_tx_work_send_packets()
- *	generate and send packets per rule
+ * nss_udp_st_tx_thread_fn()
+ *	send bursts over the flows of this thread at its share of the rate
  */
-static void nss_udp_st_tx_work_send_packets(void)
+static int nss_udp_st_tx_thread_fn(void *arg)
 {
-	int i = 0;
-	struct nss_udp_st_rules *pos = NULL;
-	struct nss_udp_st_rules *n = NULL;
+	struct nss_udp_st_tx_thread *t = (struct nss_udp_st_tx_thread *)arg;
+	struct nss_udp_st_flow *flows = nss_udp_st_flows.flows;
+	size_t pkt_bytes = nust.config.buffer_sz + sizeof(struct ethhdr);
+	uint32_t idx = t->first;
+	uint64_t next = ktime_get_ns();
+	uint64_t now;
+	size_t pkts;
+	int i;
+
+	while (!kthread_should_stop() && (nust.mode == NSS_UDP_ST_START) && nss_udp_st_tx_valid()) {
+		pkts = 0;
+
+		local_bh_disable();
+		for (i = 0; i < t->burst; i++) {
+			if (!nss_udp_st_tx_flow_xmit(&flows[idx])) {
+				pkts++;
+			}
 
-	if (!nss_udp_st_tx_valid()  || nust.mode == NSS_UDP_ST_STOP ) {
-		dev_put(nust_dev);
-		tx_hr_restart = HRTIMER_NORESTART;
-		return;
-	}
-
-	list_for_each_entry_safe(pos, n, &nust.rules.list, list) {
-		for (i = 0; i < nss_udp_st_tx_num_pkt; i++) {
-			/*
-			 * check if test time has elapsed or test has been stopped
-			 */
-			if (!nss_udp_st_tx_valid()  || nust.mode == NSS_UDP_ST_STOP ) {
-				dev_put(nust_dev);
-				tx_hr_restart = HRTIMER_NORESTART;
-				return;
+			idx += t->stride;
+			if (idx >= nss_udp_st_flows.count) {
+				idx = t->first;
 			}
+		}
+		local_bh_enable();
 
-			nss_udp_st_tx_packets(nust_dev, pos);
+		nss_udp_st_update_stats_bulk(pkts, pkts * pkt_bytes);
+
+		/*
+		 * Sleep off any lead over the schedule; after a long stall restart the
+		 * schedule instead of bursting to catch up.
+		 */
+		next += t->gap_ns * t->burst;
+		now = ktime_get_ns();
+		if (next > now + NSS_UDP_ST_TX_SLEEP_MIN_NS) {
+			usleep_range(div_u64(next - now, NSEC_PER_USEC), div_u64(next - now, NSEC_PER_USEC) + 10);
+			continue;
+		}
+
+		if (now > next + NSS_UDP_ST_TX_SLACK_NS) {
+			next = now;
 		}
+
+		cond_resched();
 	}
-	tx_hr_restart = HRTIMER_RESTART;
+
+	/*
+	 * Stay around until the test is stopped so that cleanup owns the exit
+	 */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
 }
 
 /*
@@ -461,8 +590,6 @@ static void nss_udp_st_tx_work_send_packets(void)
  */
 static bool nss_udp_st_tx_init(void)
 {
-	uint64_t total_bps;
-
 	if (nust.config.rate > NSS_UDP_ST_RATE_MAX) {
 		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_INCORRECT_RATE]);
 		return false;
@@ -472,14 +599,7 @@ static bool nss_udp_st_tx_init(void)
 		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_INCORRECT_BUFFER_SIZE]);
 		return false;
 	}
-	total_bps = (uint64_t)nust.config.rate * 1024 * 1024;
 
-	/*
-	 * calculate number of pkts to send per rule per 10 ms
-	 */
-	nss_udp_st_tx_num_pkt = total_bps / (nust.rule_count * (nust.config.buffer_sz + sizeof(struct ethhdr)) * 8 * NSS_UDP_ST_TX_TIMER);
-	nss_udp_st_tx_num_pkt ++;
-	pr_debug("total number of packets to tx every 100ms %llu\n",nss_udp_st_tx_num_pkt);
 	if(!nss_udp_st_set_dev()) {
 		return false;
 	}
@@ -488,38 +608,138 @@ static bool nss_udp_st_tx_init(void)
 }
 
 /*
- * nss_udp_st_hrtimer_cleanup()
- *	cancel hrtimer
+ * nss_udp_st_tx_templates()
+ *	build the template packet of every flow
  */
-void nss_udp_st_hrtimer_cleanup(void)
+static bool nss_udp_st_tx_templates(void)
 {
-	hrtimer_cancel(&tx_hr_timer);
-	tx_hr_restart = HRTIMER_NORESTART;
+	struct nss_udp_st_rules *pos = NULL;
+	uint32_t idx = 0;
+	uint32_t i;
+
+	if (nss_udp_st_flow_build()) {
+		return false;
+	}
+
+	list_for_each_entry(pos, &nust.rules.list, list) {
+		for (i = 0; i < max_t(uint32_t, pos->flows, 1); i++, idx++) {
+			if (nss_udp_st_tx_flow_template(nust_dev, pos, &nss_udp_st_flows.flows[idx], idx)) {
+				return false;
+			}
+		}
+	}
+
+	return idx != 0;
 }
 
 /*
- * nss_udp_st_hrtimer_callback()
- *	hrtimer callback function
+ * nss_udp_st_tx_threads_start()
+ *	spread the flows over one bound thread per online CPU
  */
-static enum hrtimer_restart nss_udp_st_hrtimer_callback(struct hrtimer *timer)
+static bool nss_udp_st_tx_threads_start(void)
 {
-	nss_udp_st_tx_work_send_packets();
-	if(tx_hr_restart == HRTIMER_RESTART) {
-		hrtimer_forward_now(timer, kt);
+	struct nss_udp_st_tx_thread *t;
+	struct task_struct *task;
+	uint64_t total_bps;
+	uint64_t gap_ns;
+	uint32_t nthreads;
+	uint32_t n = 0;
+	int cpu;
+
+	nthreads = min_t(uint32_t, num_online_cpus(), nss_udp_st_flows.count);
+	nss_udp_st_tx_threads = kcalloc(nthreads, sizeof(*nss_udp_st_tx_threads), GFP_KERNEL);
+	if (!nss_udp_st_tx_threads) {
+		atomic_long_inc(&nust.stats.errors[NSS_UDP_ST_ERROR_MEMORY_FAILURE]);
+		return false;
 	}
-	return tx_hr_restart;
+
+	/*
+	 * Each thread paces its own share of the rate. Without a rate every
+	 * flow sends one packet per idle period.
+	 */
+	total_bps = (uint64_t)nust.config.rate * 1024 * 1024;
+	if (total_bps) {
+		gap_ns = div64_u64((uint64_t)(nust.config.buffer_sz + sizeof(struct ethhdr)) * 8 * NSEC_PER_SEC * nthreads,
+					total_bps);
+	} else {
+		gap_ns = div_u64((uint64_t)NSS_UDP_ST_TX_IDLE_NS * nthreads, nss_udp_st_flows.count);
+	}
+
+	for_each_online_cpu(cpu) {
+		if (n == nthreads) {
+			break;
+		}
+
+		t = &nss_udp_st_tx_threads[n];
+		t->first = n;
+		t->stride = nthreads;
+		t->gap_ns = gap_ns;
+		t->burst = NSS_UDP_ST_TX_BURST;
+		if (!total_bps) {
+			t->burst = min_t(uint32_t, t->burst, DIV_ROUND_UP(nss_udp_st_flows.count - n, nthreads));
+		}
+
+		task = kthread_create_on_node(nss_udp_st_tx_thread_fn, t, cpu_to_node(cpu), "nss_udp_st_tx/%d", cpu);
+		if (IS_ERR(task)) {
+			pr_err("Unable to create tx thread on cpu %d\n", cpu);
+			break;
+		}
+
+		kthread_bind(task, cpu);
+		get_task_struct(task);
+		t->task = task;
+		n++;
+	}
+
+	nss_udp_st_tx_nthreads = n;
+	if (n != nthreads) {
+		return false;
+	}
+
+	for (n = 0; n < nthreads; n++) {
+		wake_up_process(nss_udp_st_tx_threads[n].task);
+	}
+
+	pr_debug("%u flows on %u tx threads, %llu ns between packets per thread\n",
+			nss_udp_st_flows.count, nthreads, gap_ns);
+	return true;
 }
 
 /*
- * nss_udp_st_hrtimer_init()
- *	initialize hrtimer
+ * nss_udp_st_tx_cleanup()
+ *	stop the tx threads and release the templates and device
  */
-void nss_udp_st_hrtimer_init(void)
+void nss_udp_st_tx_cleanup(void)
 {
-	tx_hr_restart = HRTIMER_RESTART;
-	kt = ktime_set(0,10000000);
-	hrtimer_init(&tx_hr_timer, CLOCK_REALTIME, HRTIMER_MODE_ABS_HARD);
-	tx_hr_timer.function = &nss_udp_st_hrtimer_callback;
+	struct nss_udp_st_flow *flow;
+	uint32_t i;
+
+	for (i = 0; i < nss_udp_st_tx_nthreads; i++) {
+		kthread_stop(nss_udp_st_tx_threads[i].task);
+		put_task_struct(nss_udp_st_tx_threads[i].task);
+	}
+
+	kfree(nss_udp_st_tx_threads);
+	nss_udp_st_tx_threads = NULL;
+	nss_udp_st_tx_nthreads = 0;
+
+	/*
+	 * Per flow counters stay readable until the next test
+	 */
+	if (nss_udp_st_flows.tx) {
+		for (i = 0; i < nss_udp_st_flows.count; i++) {
+			flow = &nss_udp_st_flows.flows[i];
+			if (flow->tx.skb) {
+				kfree_skb(flow->tx.skb);
+				flow->tx.skb = NULL;
+			}
+		}
+	}
+
+	if (nust_dev) {
+		dev_put(nust_dev);
+		nust_dev = NULL;
+	}
 }
 
 /*
@@ -565,12 +785,9 @@ bool nss_udp_st_tx(void)
 
 	pr_debug("Speedtest interface: %s\n", nust_dev->name);
 
-	if (!tx_timer_flag) {
-		nss_udp_st_hrtimer_init();
-		hrtimer_start(&tx_hr_timer, kt, HRTIMER_MODE_ABS_HARD);
-		tx_timer_flag = 1;
-	} else {
-		hrtimer_restart(&tx_hr_timer);
+	if (!nss_udp_st_tx_templates() || !nss_udp_st_tx_threads_start()) {
+		pr_err("Unable to set up tx flows on %s\n", nust_dev->name);
+		return false;
 	}
 
 	return true;
@@ -19,7 +19,10 @@
 #define __NSS_UDP_ST_TX_H
 
 #define NSS_UDP_ST_TX_DEFAULT_TIMEOUT	50	/* Default Tx test duration*/
-#define NSS_UDP_ST_TX_TIMER 100	/* To caluculate pkt per 10 ms*/
+#define NSS_UDP_ST_TX_BURST	32	/* Packets sent per pacing step */
+#define NSS_UDP_ST_TX_SLEEP_MIN_NS	20000	/* Lead over schedule worth sleeping for */
+#define NSS_UDP_ST_TX_SLACK_NS	10000000	/* Lag after which the schedule restarts */
+#define NSS_UDP_ST_TX_IDLE_NS	10000000	/* Period of one packet per flow when no rate is set */
 #define NSS_UDP_ST_MIN_HEADROOM	32	/* Min headroom needed */
 #define NSS_UDP_ST_MIN_TAILROOM	32	/* Min tailroom needed */
 
@@ -27,6 +30,6 @@ bool nss_udp_st_tx_valid(void);
 
 bool nss_udp_st_tx(void);
 
-void nss_udp_st_hrtimer_cleanup(void);
+void nss_udp_st_tx_cleanup(void);
 
 #endif /*NSS_UDP_ST_TX_H*/
@@ -23,12 +23,18 @@
 #include <string.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
 #include "nss-udp-st.h"
 
 struct nss_udp_st_param st_param;
 struct nss_udp_st_opt st_opt;
 struct nss_udp_st_cfg st_cfg;
 struct nss_udp_st_stat st_stat;
+static volatile sig_atomic_t st_stream_stop;
 
 struct option long_options[] =
 {
@@ -44,6 +50,9 @@ struct option long_options[] =
 	{"rate", required_argument, NULL, 'r'},
 	{"buffer_sz", required_argument, NULL, 'b'},
 	{"dscp", required_argument, NULL, 'c'},
+	{"flows", required_argument, NULL, 'l'},
+	{"interval", required_argument, NULL, 'i'},
+	{"count", required_argument, NULL, 'o'},
 	{"help", no_argument, NULL, 'h'},
 	{0, 0, 0, 0}
 };
@@ -89,8 +98,8 @@ static int nss_udp_st_create(void)
 		return -EINVAL;
 	}
 
-	fprintf(fp, "sip=<%s> dip=<%s> sport=<%d> dport=<%d> version=<%d>\n",
-	st_opt.sip, st_opt.dip, st_opt.sport, st_opt.dport, st_opt.ip_version);
+	fprintf(fp, "sip=<%s> dip=<%s> sport=<%d> dport=<%d> version=<%d> flows=<%u>\n",
+	st_opt.sip, st_opt.dip, st_opt.sport, st_opt.dport, st_opt.ip_version, st_opt.flows);
 
 	fclose(fp);
 	return 0;
@@ -178,6 +187,8 @@ static int nss_udp_st_push_rules(void)
 					st_opt.dport=atoi(token);
 				if (count == NSS_UDP_ST_FLAGS)
 					st_opt.ip_version=atoi(token);
+				if (count == NSS_UDP_ST_FLOWS)
+					st_opt.flows=strtoul(token, NULL, 10);
 
 				count ++;
 			}
@@ -304,6 +315,8 @@ static int nss_udp_st_stats(void)
 		st_stat.errors[NSS_UDP_ST_ERROR_PACKET_DROP]);
 	fprintf(fp, "\tincorrect ip version = %lld\n",
 		st_stat.errors[NSS_UDP_ST_ERROR_INCORRECT_IP_VERSION]);
+	fprintf(fp, "\ttx template copies = %lld\n",
+		st_stat.errors[NSS_UDP_ST_ERROR_TX_COPY]);
 
 	fprintf(fp, "\nThroughput Stats\n");
 	fprintf(fp, "\tthroughput  = %lld Mbps\n",
@@ -312,6 +325,220 @@ static int nss_udp_st_stats(void)
 	return 0;
 }
 
+/*
+ * nss_udp_st_flow_addr()
+ *	Format a host order flow address
+ */
+static void nss_udp_st_flow_addr(uint32_t *addr, uint16_t ip_version, char *buf, size_t len)
+{
+	uint32_t net[4];
+	int i;
+
+	if (ip_version == 4) {
+		net[0] = htonl(addr[0]);
+		inet_ntop(AF_INET, net, buf, len);
+		return;
+	}
+
+	for (i = 0; i < 4; i++) {
+		net[i] = htonl(addr[i]);
+	}
+	inet_ntop(AF_INET6, net, buf, len);
+}
+
+/*
+ * nss_udp_st_flow_stats()
+ *	Read NSS UDP speedtest per flow results
+ */
+static int nss_udp_st_flow_stats(void)
+{
+	struct nss_udp_st_flow_query query;
+	struct nss_udp_st_flow_stats *stats;
+	char sip[NSS_UDP_ST_IPNAMSZ];
+	char dip[NSS_UDP_ST_IPNAMSZ];
+	FILE *fp = NULL;
+	uint32_t start = 0;
+	uint32_t i;
+	int ret = 0;
+
+	stats = calloc(NSS_UDP_ST_FLOW_CHUNK, sizeof(*stats));
+	if (!stats) {
+		printf("memory allocation error\n");
+		return -ENOMEM;
+	}
+
+	fp = fopen(NSS_UDP_ST_FLOW_STATS, "w");
+	if (!fp) {
+		printf("create/open file error\n");
+		free(stats);
+		return -EINVAL;
+	}
+
+	fprintf(fp, "%-40s %-40s %5s %5s %12s %12s %10s %10s %8s %8s %8s %8s\n",
+		"sip", "dip", "sport", "dport", "tx_packets", "rx_packets", "lost",
+		"reordered", "p50_us", "p90_us", "p99_us", "max_us");
+
+	do {
+		memset(&query, 0, sizeof(query));
+		query.start = start;
+		query.count = NSS_UDP_ST_FLOW_CHUNK;
+		query.stats = (uint64_t)(uintptr_t)stats;
+
+		ret = ioctl(st_cfg.handle, NSS_UDP_ST_IOCTL_FLOW_STATS, &query);
+		if (ret < 0) {
+			printf("ioctl error %d\n", ret);
+			ret = -EINVAL;
+			break;
+		}
+
+		for (i = 0; i < query.count; i++) {
+			nss_udp_st_flow_addr(stats[i].sip, stats[i].ip_version, sip, sizeof(sip));
+			nss_udp_st_flow_addr(stats[i].dip, stats[i].ip_version, dip, sizeof(dip));
+			fprintf(fp, "%-40s %-40s %5u %5u %12llu %12llu %10llu %10llu %8u %8u %8u %8u\n",
+				sip, dip, stats[i].sport, stats[i].dport,
+				(unsigned long long)stats[i].tx_packets,
+				(unsigned long long)stats[i].rx_packets,
+				(unsigned long long)stats[i].lost,
+				(unsigned long long)stats[i].reordered,
+				stats[i].lat_p50, stats[i].lat_p90,
+				stats[i].lat_p99, stats[i].lat_max);
+		}
+
+		start += query.count;
+	} while (query.count && (start < query.total));
+
+	fclose(fp);
+	free(stats);
+	return ret;
+}
+
+/*
+ * nss_udp_st_stream_signal()
+ *	Leave stream mode on SIGINT/SIGTERM
+ */
+static void nss_udp_st_stream_signal(int sig)
+{
+	st_stream_stop = 1;
+}
+
+/*
+ * nss_udp_st_stream_print()
+ *	Emit one snapshot as a JSON line
+ */
+static void nss_udp_st_stream_print(struct nss_udp_st_snap *snap)
+{
+	int i;
+
+	printf("{\"seq\":%" PRIu64 ",\"tstamp_ms\":%" PRIu64 ",\"interval_ns\":%" PRIu64
+		",\"tx_packets\":%" PRIu64 ",\"tx_bytes\":%" PRIu64
+		",\"rx_packets\":%" PRIu64 ",\"rx_bytes\":%" PRIu64
+		",\"tx_pps\":%" PRIu64 ",\"tx_bps\":%" PRIu64
+		",\"rx_pps\":%" PRIu64 ",\"rx_bps\":%" PRIu64
+		",\"drops\":%" PRIu64 ",\"lost\":%" PRId64 ",\"reordered\":%" PRIu64
+		",\"lat_hist_us\":[",
+		snap->seq, snap->tstamp, snap->interval,
+		snap->tx_packets, snap->tx_bytes, snap->rx_packets, snap->rx_bytes,
+		snap->tx_pps, snap->tx_bps, snap->rx_pps, snap->rx_bps,
+		snap->drops, snap->lost, snap->reordered);
+
+	for (i = 0; i < NSS_UDP_ST_LAT_HIST; i++) {
+		printf("%s%u", i ? "," : "", snap->lat_hist[i]);
+	}
+
+	printf("]}\n");
+	fflush(stdout);
+}
+
+/*
+ * nss_udp_st_stream()
+ *	Print interval snapshots from the driver's stats ring as JSON lines
+ *
+ * Bucket i of lat_hist_us counts latencies below 2^i us (at least 2^(i-1) us
+ * for i > 0); the last bucket is open ended.
+ */
+static int nss_udp_st_stream(void)
+{
+	struct nss_udp_st_ring *ring;
+	struct nss_udp_st_snap snap;
+	uint32_t interval = st_cfg.interval ? st_cfg.interval : NSS_UDP_ST_STREAM_INTERVAL;
+	uint32_t stop = 0;
+	uint64_t printed = 0;
+	uint64_t head;
+	uint64_t next;
+	size_t size;
+	bool started;
+	int ret = 0;
+
+	size = sizeof(*ring) + NSS_UDP_ST_RING_ENTRIES * sizeof(struct nss_udp_st_snap);
+	ring = mmap(NULL, size, PROT_READ, MAP_SHARED, st_cfg.handle, 0);
+	if (ring == MAP_FAILED) {
+		printf("mmap error %d\n", errno);
+		return -EINVAL;
+	}
+
+	if ((ring->magic != NSS_UDP_ST_RING_MAGIC) || (ring->entries != NSS_UDP_ST_RING_ENTRIES)) {
+		printf("stats ring mismatch\n");
+		munmap(ring, size);
+		return -EINVAL;
+	}
+
+	/*
+	 * Leave snapshots running if another reader started them
+	 */
+	started = !__atomic_load_n(&ring->interval, __ATOMIC_RELAXED);
+	if (started || (ring->interval != interval)) {
+		ret = ioctl(st_cfg.handle, NSS_UDP_ST_IOCTL_STREAM, &interval);
+		if (ret < 0) {
+			printf("ioctl error %d\n", ret);
+			munmap(ring, size);
+			return -EINVAL;
+		}
+	}
+
+	signal(SIGINT, nss_udp_st_stream_signal);
+	signal(SIGTERM, nss_udp_st_stream_signal);
+
+	next = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) + 1;
+	while (!st_stream_stop && (!st_cfg.count || (printed < st_cfg.count))) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if (head < next) {
+			usleep(interval * 1000 / 4);
+			continue;
+		}
+
+		/*
+		 * Skip what the ring has already overwritten
+		 */
+		if (head - next >= NSS_UDP_ST_RING_ENTRIES) {
+			next = head - NSS_UDP_ST_RING_ENTRIES + 1;
+		}
+
+		for (; (next <= head) && (!st_cfg.count || (printed < st_cfg.count)); next++) {
+			struct nss_udp_st_snap *slot = &ring->snap[next % NSS_UDP_ST_RING_ENTRIES];
+
+			if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != next) {
+				continue;
+			}
+
+			memcpy(&snap, slot, sizeof(snap));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != next) {
+				continue;
+			}
+
+			nss_udp_st_stream_print(&snap);
+			printed++;
+		}
+	}
+
+	if (started) {
+		ioctl(st_cfg.handle, NSS_UDP_ST_IOCTL_STREAM, &stop);
+	}
+
+	munmap(ring, size);
+	return 0;
+}
+
 /*
  * nss_udp_st_usage()
  *	Usage for command line arguments
@@ -322,9 +549,11 @@ static void nss_udp_st_usage(void)
 	printf("\n./nss_udp_st --mode <init> --rate <rate in Mbps> \
 		--buffer_sz <buffer_size in bytes> --dscp <dscp> --net_dev <net_dev>");
 	printf("\n./nss_udp_st --mode <create> --sip <sip> --dip <dip> \
-		--sport <sport> --dport <dport> --version <4/6>");
+		--sport <sport> --dport <dport> --version <4/6> [--flows <flows>]");
 	printf("\n./nss_udp_st --mode <start> --type <tx/rx> --time <time in seconds>");
 	printf("\n./nss_udp_st --mode <stats> --type <tx/rx>");
+	printf("\n./nss_udp_st --mode <flows>");
+	printf("\n./nss_udp_st --mode <stream> [--interval <interval in ms>] [--count <snapshots>]");
 	printf("\n./nss_udp_st --mode <list/clear/final>");
 }
 
@@ -338,7 +567,7 @@ static int nss_udp_st_get_opt(int args, char **argv)
 	int option_index = 0;
 
 	while (1) {
-		c = getopt_long_only(args, argv, "m:x:s:d:y:z:n:f:t:r:b:c",
+		c = getopt_long_only(args, argv, "m:x:s:d:y:z:n:f:t:r:b:c:l:i:o:",
 			long_options, &option_index);
 		if (c == -1)
 			break;
@@ -399,6 +628,18 @@ static int nss_udp_st_get_opt(int args, char **argv)
 			st_param.dscp = atoi(optarg);
 			break;
 
+		case 'l':
+			st_opt.flows = strtoul(optarg, NULL, 10);
+			break;
+
+		case 'i':
+			st_cfg.interval = strtoul(optarg, NULL, 10);
+			break;
+
+		case 'o':
+			st_cfg.count = strtoull(optarg, NULL, 10);
+			break;
+
 		case 'h':
 			nss_udp_st_usage();
 			break;
@@ -453,6 +694,14 @@ int main(int args, char **argv)
 		st_cfg.handle = open(NSS_UDP_ST_DEV, O_RDWR);
 		nss_udp_st_stats();
 		close(st_cfg.handle);
+	} else if (!strcmp(st_cfg.mode,"stream")) {
+		st_cfg.handle = open(NSS_UDP_ST_DEV, O_RDWR);
+		nss_udp_st_stream();
+		close(st_cfg.handle);
+	} else if (!strcmp(st_cfg.mode,"flows")) {
+		st_cfg.handle = open(NSS_UDP_ST_DEV, O_RDWR);
+		nss_udp_st_flow_stats();
+		close(st_cfg.handle);
 	} else {
 		printf("invalid command line options for mode\n");
 		return -EINVAL;
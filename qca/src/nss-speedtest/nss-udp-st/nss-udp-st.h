@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <stdatomic.h>
+#include <stdint.h>
 #include "nss_udp_st_drv.h"
 
 /*
@@ -37,6 +38,9 @@
 #define NSS_UDP_ST_TX_STATS "/tmp/nss-udp-st/tx_stats"
 #define NSS_UDP_ST_RX_STATS "/tmp/nss-udp-st/rx_stats"
 #define NSS_UDP_ST_RULES "/tmp/nss-udp-st/rules"
+#define NSS_UDP_ST_FLOW_STATS "/tmp/nss-udp-st/flow_stats"
+#define NSS_UDP_ST_FLOW_CHUNK 1024	/* flow statistics read per ioctl */
+#define NSS_UDP_ST_STREAM_INTERVAL 1000	/* default snapshot interval in ms */
 
 /*
  * nss_udp_st_cfg
@@ -46,6 +50,8 @@ struct nss_udp_st_cfg {
 	long time;                      /* time for speedtest */
 	int handle;                     /* handle for NSS_UDP_ST_DEV */
 	int type;                       /* type ( tx/rx ) */
+	uint32_t interval;              /* snapshot interval in ms for stream mode */
+	uint64_t count;                 /* snapshots to print in stream mode, 0 for no limit */
 	char mode[NSS_UDP_ST_MODESZ];   /* mode for speedtest */
 };
 
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __NSS_NLASYNC_API_H__
+#define __NSS_NLASYNC_API_H__
+
+/** @addtogroup chapter_nlasync
+ This chapter describes the asynchronous (pipelined) socket APIs.
+
+ Messages are sent without waiting for the kernel; up to a window of messages
+ can be outstanding and each one is completed through a callback when its
+ ack/error arrives. The context is not thread safe, use one context per thread.
+
+ @note1hang
+ Completion reports the status returned by the NSS NL family for the message,
+ that is, whether the family could queue it to NSS. It does not mean NSS has
+ accepted it; a rule NSS rejects still completes with success. The NSS verdict
+ is only carried by the response message, which the family unicasts when the
+ caller asked for it in the common message header. Such responses arrive on
+ this socket and are passed to the callback set with nss_nlasync_set_resp_cb();
+ without one they are consumed and only counted. Use the synchronous APIs when
+ the result has to be known before going on.
+*/
+
+/** @addtogroup nss_nlasync_datatypes @{ */
+
+#define NSS_NLASYNC_WINDOW_DEF 64		/**< Default number of outstanding messages. */
+#define NSS_NLASYNC_WINDOW_MAX 1024		/**< Maximum number of outstanding messages. */
+#define NSS_NLASYNC_BATCH_MAX 16384		/**< Maximum bytes given to the kernel in one send call. */
+
+/**
+ * Completion callback for asynchronous messages.
+ *
+ * @param[in] user_ctx User context (provided at open).
+ * @param[in] msg_ctx Message context (provided at send).
+ * @param[in] error 0 if the NL family queued the message to NSS; negative error returned by the kernel otherwise.
+ *
+ * @return
+ * None.
+ */
+typedef void (*nss_nlasync_done_t)(void *user_ctx, void *msg_ctx, int error);
+
+/**
+ * Outstanding message.
+ */
+struct nss_nlasync_req {
+	uint32_t seq;			/**< Netlink sequence number. */
+	bool busy;			/**< Waiting for ack/error. */
+	nss_nlasync_done_t cb;		/**< Completion callback. */
+	void *msg_ctx;			/**< Message context. */
+};
+
+/**
+ * Asynchronous message statistics.
+ */
+struct nss_nlasync_stats {
+	uint64_t tx_msgs;		/**< Messages sent. */
+	uint64_t tx_batches;		/**< Send calls to the kernel. */
+	uint64_t tx_fail;		/**< Messages which could not be sent. */
+	uint64_t ack;			/**< Messages completed with success. */
+	uint64_t nack;			/**< Messages completed with error. */
+	uint64_t resp;			/**< NSS responses received. */
+	uint32_t window_full;		/**< Times a send waited for the window. */
+};
+
+/**
+ * NSS NL asynchronous socket context.
+ */
+struct nss_nlasync_ctx {
+	/* Public, caller must populate using helpers */
+	const char *family_name;		/**< Family name. */
+	void *user_ctx;				/**< Socket user context. */
+
+	/* Private, maintained by the library */
+	struct nl_sock *nl_sk;			/**< Linux NL socket. */
+	struct nss_nlasync_req *req;		/**< Outstanding messages, indexed by sequence number. */
+	uint32_t window;			/**< Size of the request table. */
+	uint32_t pending;			/**< Messages waiting for ack/error. */
+	uint32_t seq;				/**< Sequence number of the next message. */
+	uint8_t *tx_buf;			/**< Messages packed for the next send call. */
+	size_t tx_len;				/**< Bytes used in tx_buf. */
+	uint32_t tx_cnt;			/**< Messages packed in tx_buf. */
+	uint32_t tx_seq;			/**< Sequence number of the first message in tx_buf. */
+	int family_id;				/**< Family identifier. */
+	nl_recvmsg_msg_cb_t resp_cb;		/**< NSS response callback. */
+	struct nss_nlasync_stats stats;		/**< Statistics. */
+};
+
+/** @} *//* end_addtogroup nss_nlasync_datatypes */
+
+/** @addtogroup nss_nlasync_functions @{ */
+
+/**
+ * Opens NSS NL family socket for asynchronous messages.
+ *
+ * @param[in] ctx Asynchronous context allocated by the caller.
+ * @param[in] family_name Family name.
+ * @param[in] user_ctx User context passed to the completion callbacks.
+ * @param[in] window Maximum outstanding messages; 0 selects NSS_NLASYNC_WINDOW_DEF.
+ *
+ * @detdesc The receive buffer is sized for the ack and the NSS response of
+ *       every outstanding message. If the kernel grants less, the window is
+ *       reduced to what fits so that acks are not lost to a receive overrun.
+ *
+ * @return
+ * Status of the operation.
+ */
+int nss_nlasync_open(struct nss_nlasync_ctx *ctx, const char *family_name, void *user_ctx, uint32_t window);
+
+/**
+ * Closes NSS NL asynchronous socket.
+ *
+ * @param[in] ctx Asynchronous context.
+ *
+ * @return
+ * None.
+ *
+ * @note Outstanding messages are waited for; their callbacks run before the function returns.
+ */
+void nss_nlasync_close(struct nss_nlasync_ctx *ctx);
+
+/**
+ * Sends NSS NL message without waiting for the kernel.
+ *
+ * @param[in] ctx Asynchronous context.
+ * @param[in] cm Common message header.
+ * @param[in] data Message data.
+ * @param[in] cb Completion callback, may be NULL.
+ * @param[in] msg_ctx Message context passed to the completion callback.
+ *
+ * @detdesc The function only blocks when the window is full, until the oldest
+ *       outstanding message is completed.
+ *
+ * @return
+ * Status of the send operation.
+ */
+int nss_nlasync_send(struct nss_nlasync_ctx *ctx, struct nss_nlcmn *cm, void *data, nss_nlasync_done_t cb, void *msg_ctx);
+
+/**
+ * Sends an array of NSS NL messages without waiting for the kernel.
+ *
+ * @param[in] ctx Asynchronous context.
+ * @param[in] msgs First message; every message starts with its common message header.
+ * @param[in] size Size of one array element.
+ * @param[in] count Number of messages.
+ * @param[in] cb Completion callback, may be NULL.
+ *
+ * @detdesc Messages are packed up to the free window into a single send call
+ *       to the kernel. The completion callback gets the message as message context.
+ *
+ * @return
+ * Number of messages sent; a negative error if none could be sent.
+ */
+int nss_nlasync_send_bulk(struct nss_nlasync_ctx *ctx, void *msgs, size_t size, uint32_t count, nss_nlasync_done_t cb);
+
+/**
+ * Processes the acks/errors available on the socket.
+ *
+ * @param[in] ctx Asynchronous context.
+ * @param[in] timeout_ms Time to wait for the kernel; 0 does not wait, negative waits forever.
+ *
+ * @return
+ * Number of messages completed; a negative error on failure.
+ */
+int nss_nlasync_poll(struct nss_nlasync_ctx *ctx, int timeout_ms);
+
+/**
+ * Waits until all outstanding messages are completed.
+ *
+ * @param[in] ctx Asynchronous context.
+ *
+ * @detdesc NSS responses already queued on the socket are consumed as well,
+ *       including those that arrived after the last ack. Responses still on
+ *       their way are not waited for; call the function again to consume them.
+ *
+ * @return
+ * Status of the operation.
+ */
+int nss_nlasync_flush(struct nss_nlasync_ctx *ctx);
+
+/**
+ * Sets the callback for NSS responses.
+ *
+ * @param[in] ctx Asynchronous context.
+ * @param[in] cb Callback called with the response message and the user context (provided at open).
+ *
+ * @return
+ * None.
+ *
+ * @note Responses are matched to rules by their content, not by sequence number;
+ *       a response can arrive after the completion callback of its message.
+ */
+static inline void nss_nlasync_set_resp_cb(struct nss_nlasync_ctx *ctx, nl_recvmsg_msg_cb_t cb)
+{
+	ctx->resp_cb = cb;
+}
+
+/**
+ * Returns the socket descriptor, to wait for acks from an event loop.
+ *
+ * @param[in] ctx Asynchronous context.
+ *
+ * @return
+ * Socket descriptor.
+ */
+static inline int nss_nlasync_get_fd(struct nss_nlasync_ctx *ctx)
+{
+	return nl_socket_get_fd(ctx->nl_sk);
+}
+
+/**
+ * Returns the number of outstanding messages.
+ *
+ * @param[in] ctx Asynchronous context.
+ *
+ * @return
+ * Number of messages waiting for ack/error.
+ */
+static inline uint32_t nss_nlasync_get_pending(struct nss_nlasync_ctx *ctx)
+{
+	return ctx->pending;
+}
+
+/** @} *//* end_addtogroup nss_nlasync_functions */
+
+#endif /* __NSS_NLASYNC_API_H__ */
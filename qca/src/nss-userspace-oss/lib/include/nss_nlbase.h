@@ -63,6 +63,7 @@
 #include <nss_udp_st.h>
 #include <nss_nl_if.h>
 #include <nss_nlsock_api.h>
+#include <nss_nlasync_api.h>
 #include <nss_nlcapwap_if.h>
 #include <nss_nlcapwap_api.h>
 #include <nss_nldtls_if.h>
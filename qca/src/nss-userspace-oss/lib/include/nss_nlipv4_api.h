@@ -103,6 +103,40 @@ void nss_nlipv4_sock_close(struct nss_nlipv4_ctx *ctx);
  */
 int nss_nlipv4_sock_send(struct nss_nlipv4_ctx *ctx, struct nss_nlipv4_rule *rule, nss_nlipv4_resp_t cb, void *data);
 
+/**
+ * Opens NSS NL IPv4 socket for asynchronous rule messages.
+ *
+ * @param[in] actx Asynchronous context allocated by the caller.
+ * @param[in] user_ctx User context passed to the completion callbacks.
+ * @param[in] window Maximum outstanding rules; 0 selects the default.
+ *
+ * @return
+ * Status of the open call.
+ */
+static inline int nss_nlipv4_async_open(struct nss_nlasync_ctx *actx, void *user_ctx, uint32_t window)
+{
+	return nss_nlasync_open(actx, NSS_NLIPV4_FAMILY, user_ctx, window);
+}
+
+/**
+ * Sends an array of IPv4 rules asynchronously to NSS NETLINK.
+ *
+ * @param[in] actx NSS NL asynchronous context.
+ * @param[in] rules IPv4 rules, each initialized with nss_nlipv4_init_rule(); create and destroy can be mixed.
+ * @param[in] count Number of rules.
+ * @param[in] cb Completion callback, called with the rule as message context.
+ *
+ * @detdesc The rules must stay valid until the callback for them has been called.
+ *
+ * @return
+ * Number of rules sent; a negative error if none could be sent.
+ */
+static inline int nss_nlipv4_sock_send_bulk(struct nss_nlasync_ctx *actx, struct nss_nlipv4_rule *rules, uint32_t count,
+						nss_nlasync_done_t cb)
+{
+	return nss_nlasync_send_bulk(actx, rules, sizeof(*rules), count, cb);
+}
+
 /**
  * Initializes IPv4 rule message.
  *
@@ -0,0 +1,616 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <poll.h>
+#include <sys/socket.h>
+#include "nss_nlbase.h"
+
+/*
+ * Receive buffer per outstanding message; the kernel charges the full skb
+ * for the ack and for the NSS response unicast after it, which is allocated
+ * with NLMSG_GOODSIZE. Size the buffer so a complete window of both fits.
+ */
+#define NSS_NLASYNC_RXBUF_PER_MSG 8192
+#define NSS_NLASYNC_RXBUF_MIN 32768
+
+/*
+ * nss_nlasync_next_seq()
+ *	Advances the sequence number, skipping NL_AUTO_SEQ.
+ */
+static inline uint32_t nss_nlasync_next_seq(uint32_t seq)
+{
+	seq++;
+	return seq ? seq : 1;
+}
+
+/*
+ * nss_nlasync_get_req()
+ *	Returns the request slot of a sequence number.
+ */
+static inline struct nss_nlasync_req *nss_nlasync_get_req(struct nss_nlasync_ctx *ctx, uint32_t seq)
+{
+	return &ctx->req[seq % ctx->window];
+}
+
+/*
+ * nss_nlasync_complete()
+ *	Completes an outstanding message.
+ */
+static void nss_nlasync_complete(struct nss_nlasync_ctx *ctx, uint32_t seq, int error)
+{
+	struct nss_nlasync_req *req = nss_nlasync_get_req(ctx, seq);
+	nss_nlasync_done_t cb;
+
+	if (!req->busy || (req->seq != seq)) {
+		nss_nlsock_log_error("%s: ack for unknown sequence(%u)\n", ctx->family_name, seq);
+		return;
+	}
+
+	cb = req->cb;
+	req->busy = false;
+	req->cb = NULL;
+	ctx->pending--;
+
+	if (error) {
+		ctx->stats.nack++;
+	} else {
+		ctx->stats.ack++;
+	}
+
+	if (cb) {
+		cb(ctx->user_ctx, req->msg_ctx, error);
+	}
+}
+
+/*
+ * nss_nlasync_abort()
+ *	Completes all outstanding messages with an error.
+ *
+ * Used when acks have been lost, so the state of these messages is unknown.
+ */
+static void nss_nlasync_abort(struct nss_nlasync_ctx *ctx, int error)
+{
+	uint32_t i;
+
+	for (i = 0; (i < ctx->window) && ctx->pending; i++) {
+		if (ctx->req[i].busy) {
+			nss_nlasync_complete(ctx, ctx->req[i].seq, error);
+		}
+	}
+}
+
+/*
+ * nss_nlasync_ack_cb()
+ *	Handles ack of a message.
+ */
+static int nss_nlasync_ack_cb(struct nl_msg *msg, void *arg)
+{
+	struct nss_nlasync_ctx *ctx = (struct nss_nlasync_ctx *)arg;
+
+	nss_nlasync_complete(ctx, nlmsg_hdr(msg)->nlmsg_seq, 0);
+
+	/*
+	 * Acks of several messages can be queued in one read, keep going
+	 */
+	return NL_OK;
+}
+
+/*
+ * nss_nlasync_err_cb()
+ *	Handles error of a message.
+ */
+static int nss_nlasync_err_cb(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg)
+{
+	struct nss_nlasync_ctx *ctx = (struct nss_nlasync_ctx *)arg;
+
+	nss_nlasync_complete(ctx, err->msg.nlmsg_seq, err->error);
+	return NL_SKIP;
+}
+
+/*
+ * nss_nlasync_resp_cb()
+ *	Handles a response unicast by the family.
+ *
+ * Responses carry no sequence number of ours; they are consumed here so they
+ * do not fill the receive buffer and handed to the response callback, if any.
+ */
+static int nss_nlasync_resp_cb(struct nl_msg *msg, void *arg)
+{
+	struct nss_nlasync_ctx *ctx = (struct nss_nlasync_ctx *)arg;
+
+	if (nlmsg_hdr(msg)->nlmsg_type != ctx->family_id) {
+		return NL_SKIP;
+	}
+
+	ctx->stats.resp++;
+
+	if (ctx->resp_cb) {
+		ctx->resp_cb(msg, ctx->user_ctx);
+	}
+
+	return NL_OK;
+}
+
+/*
+ * nss_nlasync_set_rxbuf()
+ *	Sizes the receive buffer for the window.
+ *
+ * Returns the window which fits in the buffer the kernel granted.
+ */
+static uint32_t nss_nlasync_set_rxbuf(struct nss_nlasync_ctx *ctx, uint32_t window)
+{
+	int fd = nl_socket_get_fd(ctx->nl_sk);
+	socklen_t optlen = sizeof(int);
+	int rxbuf, granted;
+
+	rxbuf = window * NSS_NLASYNC_RXBUF_PER_MSG;
+	rxbuf = (rxbuf < NSS_NLASYNC_RXBUF_MIN) ? NSS_NLASYNC_RXBUF_MIN : rxbuf;
+
+	/*
+	 * Try to go past net.core.rmem_max first, that needs CAP_NET_ADMIN
+	 */
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rxbuf, sizeof(rxbuf)) < 0) {
+		nl_socket_set_buffer_size(ctx->nl_sk, rxbuf, 0);
+	}
+
+	/*
+	 * The kernel doubles the requested size to leave room for its overhead
+	 */
+	if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &granted, &optlen) < 0) {
+		return window;
+	}
+
+	if (granted / 2 >= rxbuf) {
+		return window;
+	}
+
+	window = (granted / 2) / NSS_NLASYNC_RXBUF_PER_MSG;
+	window = window ? window : 1;
+	nss_nlsock_log_info("%s: receive buffer(%d) is smaller than requested(%d), window reduced to %u\n",
+				ctx->family_name, granted / 2, rxbuf, window);
+	return window;
+}
+
+/*
+ * nss_nlasync_put()
+ *	Packs a message in the transmit buffer and reserves its request slot.
+ */
+static int nss_nlasync_put(struct nss_nlasync_ctx *ctx, struct nss_nlcmn *cm, void *data,
+				nss_nlasync_done_t cb, void *msg_ctx)
+{
+	struct nss_nlasync_req *req = nss_nlasync_get_req(ctx, ctx->seq);
+	struct nlmsghdr *nlh;
+	struct nl_msg *msg;
+	void *user_hdr;
+	size_t msg_len;
+	int len;
+
+	/*
+	 * The slot is still used by an older message; the caller has to
+	 * send what is packed and wait for acks
+	 */
+	if (req->busy) {
+		return -EBUSY;
+	}
+
+	msg = nlmsg_alloc();
+	if (!msg) {
+		nss_nlsock_log_error("%s: failed to allocate message buffer\n", ctx->family_name);
+		return -ENOMEM;
+	}
+
+	len = nss_nlcmn_get_len(cm);
+	user_hdr = genlmsg_put(msg, NL_AUTO_PORT, ctx->seq, ctx->family_id, len, 0,
+				nss_nlcmn_get_cmd(cm), nss_nlcmn_get_ver(cm));
+	if (!user_hdr) {
+		nss_nlsock_log_error("%s: failed to put message header of length(%d)\n", ctx->family_name, len);
+		nlmsg_free(msg);
+		return -EMSGSIZE;
+	}
+
+	memcpy(user_hdr, data, len);
+
+	/*
+	 * Fills in the port and the request/ack flags, sequence number is already set
+	 */
+	nl_complete_msg(ctx->nl_sk, msg);
+
+	nlh = nlmsg_hdr(msg);
+	msg_len = NLMSG_ALIGN(nlh->nlmsg_len);
+	if (msg_len > NSS_NLASYNC_BATCH_MAX) {
+		nlmsg_free(msg);
+		return -EMSGSIZE;
+	}
+
+	if ((ctx->tx_len + msg_len) > NSS_NLASYNC_BATCH_MAX) {
+		nlmsg_free(msg);
+		return -ENOSPC;
+	}
+
+	memcpy(ctx->tx_buf + ctx->tx_len, nlh, nlh->nlmsg_len);
+	nlmsg_free(msg);
+
+	if (!ctx->tx_cnt) {
+		ctx->tx_seq = ctx->seq;
+	}
+
+	ctx->tx_len += msg_len;
+	ctx->tx_cnt++;
+
+	req->seq = ctx->seq;
+	req->cb = cb;
+	req->msg_ctx = msg_ctx;
+	req->busy = true;
+	ctx->pending++;
+
+	ctx->seq = nss_nlasync_next_seq(ctx->seq);
+	return 0;
+}
+
+/*
+ * nss_nlasync_tx()
+ *	Gives the packed messages to the kernel in one send call.
+ */
+static int nss_nlasync_tx(struct nss_nlasync_ctx *ctx)
+{
+	uint32_t seq = ctx->tx_seq;
+	uint32_t cnt = ctx->tx_cnt;
+	int error;
+
+	if (!cnt) {
+		return 0;
+	}
+
+	error = nl_sendto(ctx->nl_sk, ctx->tx_buf, ctx->tx_len);
+	ctx->tx_len = 0;
+	ctx->tx_cnt = 0;
+
+	if (error >= 0) {
+		ctx->stats.tx_msgs += cnt;
+		ctx->stats.tx_batches++;
+		return 0;
+	}
+
+	nss_nlsock_log_error("%s: failed to send %u messages, error(%d)\n", ctx->family_name, cnt, error);
+
+	/*
+	 * Nothing will ack these messages, release their slots without callback
+	 */
+	ctx->stats.tx_fail += cnt;
+	while (cnt--) {
+		struct nss_nlasync_req *req = nss_nlasync_get_req(ctx, seq);
+
+		req->busy = false;
+		req->cb = NULL;
+		ctx->pending--;
+		seq = nss_nlasync_next_seq(seq);
+	}
+
+	return error;
+}
+
+/*
+ * nss_nlasync_wait()
+ *	Waits for a free request slot for the next message.
+ */
+static int nss_nlasync_wait(struct nss_nlasync_ctx *ctx)
+{
+	while ((ctx->pending >= ctx->window) || nss_nlasync_get_req(ctx, ctx->seq)->busy) {
+		int error;
+
+		ctx->stats.window_full++;
+
+		error = nss_nlasync_poll(ctx, -1);
+		if (error < 0) {
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * nss_nlasync_poll()
+ *	Processes the acks/errors available on the socket.
+ */
+int nss_nlasync_poll(struct nss_nlasync_ctx *ctx, int timeout_ms)
+{
+	uint64_t done = ctx->stats.ack + ctx->stats.nack;
+	struct pollfd pfd = {0};
+	int error;
+
+	pfd.fd = nl_socket_get_fd(ctx->nl_sk);
+	pfd.events = POLLIN;
+
+	while (ctx->pending) {
+		error = poll(&pfd, 1, timeout_ms);
+		if (error < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -errno;
+		}
+
+		if (!error) {
+			break;
+		}
+
+		error = nl_recvmsgs_default(ctx->nl_sk);
+		if (error < 0) {
+			/*
+			 * Receive overrun drops acks, which only happens if the
+			 * kernel granted less than the window was sized for or
+			 * other traffic shares the socket; fail what is
+			 * outstanding instead of waiting for acks which will
+			 * never come
+			 */
+			nss_nlsock_log_error("%s: failed to receive acks, error(%d)\n", ctx->family_name, error);
+			nss_nlasync_abort(ctx, -EIO);
+			return error;
+		}
+
+		/*
+		 * Drain whatever else is queued, without waiting
+		 */
+		timeout_ms = 0;
+	}
+
+	return (int)(ctx->stats.ack + ctx->stats.nack - done);
+}
+
+/*
+ * nss_nlasync_drain()
+ *	Processes everything already queued on the socket, without waiting.
+ *
+ * nss_nlasync_poll() stops reading once nothing is outstanding, while NSS
+ * responses can still arrive after the ack of the last message.
+ */
+static int nss_nlasync_drain(struct nss_nlasync_ctx *ctx)
+{
+	struct pollfd pfd = {0};
+	int error;
+
+	pfd.fd = nl_socket_get_fd(ctx->nl_sk);
+	pfd.events = POLLIN;
+
+	while ((error = poll(&pfd, 1, 0)) != 0) {
+		if (error < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -errno;
+		}
+
+		error = nl_recvmsgs_default(ctx->nl_sk);
+		if (error < 0) {
+			nss_nlsock_log_error("%s: failed to receive responses, error(%d)\n", ctx->family_name, error);
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * nss_nlasync_send()
+ *	Sends NSS NL message without waiting for the kernel.
+ */
+int nss_nlasync_send(struct nss_nlasync_ctx *ctx, struct nss_nlcmn *cm, void *data, nss_nlasync_done_t cb, void *msg_ctx)
+{
+	int error;
+
+	error = nss_nlasync_wait(ctx);
+	if (error < 0) {
+		return error;
+	}
+
+	error = nss_nlasync_put(ctx, cm, data, cb, msg_ctx);
+	if (error < 0) {
+		return error;
+	}
+
+	error = nss_nlasync_tx(ctx);
+	if (error < 0) {
+		return error;
+	}
+
+	/*
+	 * Reap acks already received, it keeps the window open
+	 */
+	nss_nlasync_poll(ctx, 0);
+	return 0;
+}
+
+/*
+ * nss_nlasync_send_bulk()
+ *	Sends an array of NSS NL messages without waiting for the kernel.
+ */
+int nss_nlasync_send_bulk(struct nss_nlasync_ctx *ctx, void *msgs, size_t size, uint32_t count, nss_nlasync_done_t cb)
+{
+	uint8_t *msg = (uint8_t *)msgs;
+	uint32_t sent = 0;
+	int error = 0;
+
+	while (sent < count) {
+		uint32_t packed = 0;
+
+		error = nss_nlasync_wait(ctx);
+		if (error < 0) {
+			break;
+		}
+
+		/*
+		 * Pack as many messages as the window and the send buffer allow
+		 */
+		while ((sent + packed) < count) {
+			uint8_t *cur = msg + ((sent + packed) * size);
+
+			if (ctx->pending >= ctx->window) {
+				break;
+			}
+
+			error = nss_nlasync_put(ctx, (struct nss_nlcmn *)cur, cur, cb, cur);
+			if (error < 0) {
+				break;
+			}
+
+			packed++;
+		}
+
+		/*
+		 * A busy slot or a full buffer only ends the batch
+		 */
+		if ((error < 0) && (error != -EBUSY) && (error != -ENOSPC)) {
+			nss_nlasync_tx(ctx);
+			sent += packed;
+			break;
+		}
+
+		error = nss_nlasync_tx(ctx);
+		if (error < 0) {
+			break;
+		}
+
+		sent += packed;
+	}
+
+	if (sent) {
+		nss_nlasync_poll(ctx, 0);
+		return sent;
+	}
+
+	return error;
+}
+
+/*
+ * nss_nlasync_flush()
+ *	Waits until all outstanding messages are completed.
+ */
+int nss_nlasync_flush(struct nss_nlasync_ctx *ctx)
+{
+	while (ctx->pending) {
+		int error = nss_nlasync_poll(ctx, -1);
+
+		if (error < 0) {
+			return error;
+		}
+	}
+
+	/*
+	 * Consume responses queued behind the last ack
+	 */
+	return nss_nlasync_drain(ctx);
+}
+
+/*
+ * nss_nlasync_open()
+ *	Opens NSS NL family socket for asynchronous messages.
+ */
+int nss_nlasync_open(struct nss_nlasync_ctx *ctx, const char *family_name, void *user_ctx, uint32_t window)
+{
+	int one = 1;
+	int error;
+
+	if (!ctx || !family_name) {
+		return -EINVAL;
+	}
+
+	window = window ? window : NSS_NLASYNC_WINDOW_DEF;
+	if (window > NSS_NLASYNC_WINDOW_MAX) {
+		nss_nlsock_log_error("%s: window(%u) is larger than %u\n", family_name, window, NSS_NLASYNC_WINDOW_MAX);
+		return -EINVAL;
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->family_name = family_name;
+	ctx->user_ctx = user_ctx;
+	ctx->seq = 1;
+
+	ctx->nl_sk = nl_socket_alloc();
+	if (!ctx->nl_sk) {
+		nss_nlsock_log_error("%s: failed to allocate socket\n", family_name);
+		return -ENOMEM;
+	}
+
+	error = genl_connect(ctx->nl_sk);
+	if (error < 0) {
+		nss_nlsock_log_error("%s: failed to connect socket, error(%d)\n", family_name, error);
+		goto free_sock;
+	}
+
+	ctx->family_id = genl_ctrl_resolve(ctx->nl_sk, family_name);
+	if (ctx->family_id < 0) {
+		nss_nlsock_log_error("%s: failed to resolve family, error(%d)\n", family_name, ctx->family_id);
+		error = ctx->family_id;
+		goto free_sock;
+	}
+
+	/*
+	 * Several messages are in flight, acks are matched to them by sequence number
+	 */
+	nl_socket_disable_seq_check(ctx->nl_sk);
+	nl_socket_modify_cb(ctx->nl_sk, NL_CB_ACK, NL_CB_CUSTOM, nss_nlasync_ack_cb, ctx);
+	nl_socket_modify_err_cb(ctx->nl_sk, NL_CB_CUSTOM, nss_nlasync_err_cb, ctx);
+	nl_socket_modify_cb(ctx->nl_sk, NL_CB_VALID, NL_CB_CUSTOM, nss_nlasync_resp_cb, ctx);
+
+	/*
+	 * Errors only need the header of the failed message, not the full rule
+	 */
+	setsockopt(nl_socket_get_fd(ctx->nl_sk), SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+
+	ctx->window = nss_nlasync_set_rxbuf(ctx, window);
+	ctx->req = calloc(ctx->window, sizeof(*ctx->req));
+	ctx->tx_buf = malloc(NSS_NLASYNC_BATCH_MAX);
+	if (!ctx->req || !ctx->tx_buf) {
+		nss_nlsock_log_error("%s: failed to allocate request table\n", family_name);
+		error = -ENOMEM;
+		goto free_mem;
+	}
+
+	return 0;
+
+free_mem:
+	free(ctx->tx_buf);
+	free(ctx->req);
+	ctx->tx_buf = NULL;
+	ctx->req = NULL;
+free_sock:
+	nl_socket_free(ctx->nl_sk);
+	ctx->nl_sk = NULL;
+	return error;
+}
+
+/*
+ * nss_nlasync_close()
+ *	Closes NSS NL asynchronous socket.
+ */
+void nss_nlasync_close(struct nss_nlasync_ctx *ctx)
+{
+	if (!ctx->nl_sk) {
+		return;
+	}
+
+	if (nss_nlasync_flush(ctx) < 0) {
+		nss_nlasync_abort(ctx, -EIO);
+	}
+
+	nl_socket_free(ctx->nl_sk);
+	free(ctx->tx_buf);
+	free(ctx->req);
+	memset(ctx, 0, sizeof(*ctx));
+}
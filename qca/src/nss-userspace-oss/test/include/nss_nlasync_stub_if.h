@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * nss_nlasync_stub_if.h
+ *	Stub generic netlink family shared by the stub module and the nlasync test.
+ */
+#ifndef __NSS_NLASYNC_STUB_IF_H__
+#define __NSS_NLASYNC_STUB_IF_H__
+
+#define NSS_NLASYNC_STUB_FAMILY "nss_nlasync_stub"	/* Family name */
+#define NSS_NLASYNC_STUB_VER 1				/* Family version */
+
+/*
+ * Commands; the stub answers each one by its command only, the payload is not looked at.
+ */
+enum nss_nlasync_stub_cmd {
+	NSS_NLASYNC_STUB_CMD_UNSPEC,	/* Not used */
+	NSS_NLASYNC_STUB_CMD_ACK,	/* Acked with success */
+	NSS_NLASYNC_STUB_CMD_NACK,	/* Acked with -EINVAL */
+	NSS_NLASYNC_STUB_CMD_RESP,	/* Acked with success, payload echoed back later as a response */
+	NSS_NLASYNC_STUB_CMD_MAX
+};
+
+#define NSS_NLASYNC_STUB_NACK_ERROR 22	/* EINVAL, error returned for NSS_NLASYNC_STUB_CMD_NACK */
+
+#endif /* __NSS_NLASYNC_STUB_IF_H__ */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * nss_nlasync_test.c
+ *	Drives the asynchronous NL socket against the stub family and reports its rate.
+ *
+ * Load test/stub/qca-nss-nlasync-stub.ko first; the stub acks, nacks or
+ * responds to every message by its command.
+ */
+#include <time.h>
+#include <poll.h>
+#include <nss_nlbase.h>
+#include "nss_nlasync_stub_if.h"
+
+#define NSS_NLASYNC_TEST_COUNT_DEF 100000	/* Default number of messages */
+#define NSS_NLASYNC_TEST_RESP_WAIT_MS 1000	/* Time responses may lag behind their acks */
+
+/*
+ * Test message
+ */
+struct nss_nlasync_test_msg {
+	struct nss_nlcmn cm;			/* Common message header */
+	uint32_t index;				/* Index of the message */
+};
+
+/*
+ * Test state
+ */
+struct nss_nlasync_test {
+	int expect;				/* Completion status expected for every message */
+	uint64_t done;				/* Messages completed as expected */
+	uint64_t bad;				/* Messages completed otherwise */
+	uint64_t resp;				/* Responses received */
+};
+
+/*
+ * nss_nlasync_test_done()
+ *	Completion callback of a message.
+ */
+static void nss_nlasync_test_done(void *user_ctx, void *msg_ctx, int error)
+{
+	struct nss_nlasync_test *test = (struct nss_nlasync_test *)user_ctx;
+
+	if (error == test->expect) {
+		test->done++;
+		return;
+	}
+
+	test->bad++;
+	nss_nlsock_log_error("message(%u) completed with %d, expected %d\n",
+				((struct nss_nlasync_test_msg *)msg_ctx)->index, error, test->expect);
+}
+
+/*
+ * nss_nlasync_test_resp()
+ *	Response callback.
+ */
+static int nss_nlasync_test_resp(struct nl_msg *msg, void *arg)
+{
+	struct nss_nlasync_test *test = (struct nss_nlasync_test *)arg;
+
+	test->resp++;
+	return NL_OK;
+}
+
+/*
+ * nss_nlasync_test_now()
+ *	Returns monotonic time in seconds.
+ */
+static double nss_nlasync_test_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/*
+ * nss_nlasync_test_wait_resp()
+ *	Consumes responses still on their way after the last ack.
+ */
+static int nss_nlasync_test_wait_resp(struct nss_nlasync_ctx *ctx, struct nss_nlasync_test *test, uint32_t count)
+{
+	double end = nss_nlasync_test_now() + (NSS_NLASYNC_TEST_RESP_WAIT_MS / 1000.0);
+	struct pollfd pfd = {0};
+	int error;
+
+	pfd.fd = nss_nlasync_get_fd(ctx);
+	pfd.events = POLLIN;
+
+	while ((test->resp < count) && (nss_nlasync_test_now() < end)) {
+		if (poll(&pfd, 1, 10) <= 0) {
+			continue;
+		}
+
+		/*
+		 * Nothing is outstanding, flush only consumes what is queued
+		 */
+		error = nss_nlasync_flush(ctx);
+		if (error < 0) {
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * nss_nlasync_test_usage()
+ *	Prints usage.
+ */
+static void nss_nlasync_test_usage(const char *name)
+{
+	printf("Usage: %s [-c ack|nack|resp] [-n count] [-w window]\n", name);
+	printf("\t-c: command the stub answers, default ack\n");
+	printf("\t-n: number of messages, default %u\n", NSS_NLASYNC_TEST_COUNT_DEF);
+	printf("\t-w: outstanding messages, default %u\n", NSS_NLASYNC_WINDOW_DEF);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t count = NSS_NLASYNC_TEST_COUNT_DEF;
+	uint8_t cmd = NSS_NLASYNC_STUB_CMD_ACK;
+	struct nss_nlasync_test test = {0};
+	struct nss_nlasync_test_msg *msgs;
+	struct nss_nlasync_ctx ctx;
+	uint32_t window = 0;
+	uint32_t sent = 0;
+	double start, elapsed;
+	uint32_t i;
+	int error, opt;
+
+	while ((opt = getopt(argc, argv, "c:n:w:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			if (!strcmp(optarg, "ack")) {
+				cmd = NSS_NLASYNC_STUB_CMD_ACK;
+			} else if (!strcmp(optarg, "nack")) {
+				cmd = NSS_NLASYNC_STUB_CMD_NACK;
+			} else if (!strcmp(optarg, "resp")) {
+				cmd = NSS_NLASYNC_STUB_CMD_RESP;
+			} else {
+				nss_nlasync_test_usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			window = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			nss_nlasync_test_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!count) {
+		nss_nlasync_test_usage(argv[0]);
+		return 1;
+	}
+
+	test.expect = (cmd == NSS_NLASYNC_STUB_CMD_NACK) ? -NSS_NLASYNC_STUB_NACK_ERROR : 0;
+
+	msgs = calloc(count, sizeof(*msgs));
+	if (!msgs) {
+		nss_nlsock_log_error("failed to allocate %u messages\n", count);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		nss_nlcmn_set_ver(&msgs[i].cm, NSS_NLASYNC_STUB_VER);
+		nss_nlcmn_init_cmd(&msgs[i].cm, sizeof(msgs[i]), cmd);
+		msgs[i].index = i;
+	}
+
+	error = nss_nlasync_open(&ctx, NSS_NLASYNC_STUB_FAMILY, &test, window);
+	if (error < 0) {
+		nss_nlsock_log_error("failed to open %s, is the stub module loaded? error(%d)\n",
+					NSS_NLASYNC_STUB_FAMILY, error);
+		free(msgs);
+		return 1;
+	}
+
+	nss_nlasync_set_resp_cb(&ctx, nss_nlasync_test_resp);
+
+	start = nss_nlasync_test_now();
+	while (sent < count) {
+		error = nss_nlasync_send_bulk(&ctx, &msgs[sent], sizeof(*msgs), count - sent, nss_nlasync_test_done);
+		if (error < 0) {
+			nss_nlsock_log_error("failed to send message(%u), error(%d)\n", sent, error);
+			break;
+		}
+
+		sent += error;
+	}
+
+	error = nss_nlasync_flush(&ctx);
+	elapsed = nss_nlasync_test_now() - start;
+	if (error < 0) {
+		nss_nlsock_log_error("failed to flush, error(%d)\n", error);
+	}
+
+	if ((error >= 0) && (cmd == NSS_NLASYNC_STUB_CMD_RESP)) {
+		error = nss_nlasync_test_wait_resp(&ctx, &test, sent);
+	}
+
+	printf("messages: %u sent, %llu completed as expected, %llu otherwise, %llu responses\n",
+		sent, (unsigned long long)test.done, (unsigned long long)test.bad, (unsigned long long)test.resp);
+	printf("window: %u, send calls: %llu, window full: %u\n", ctx.window,
+		(unsigned long long)ctx.stats.tx_batches, ctx.stats.window_full);
+	printf("rate: %.0f messages/s\n", elapsed > 0 ? sent / elapsed : 0);
+
+	if ((error < 0) || (sent != count) || (test.done != count) || test.bad) {
+		error = -EIO;
+	}
+
+	if ((cmd == NSS_NLASYNC_STUB_CMD_RESP) && (test.resp != count)) {
+		error = -EIO;
+	}
+
+	nss_nlasync_close(&ctx);
+	free(msgs);
+	return (error < 0) ? 1 : 0;
+}
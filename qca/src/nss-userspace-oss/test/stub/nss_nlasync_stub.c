@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * nss_nlasync_stub.c
+ *	Stub generic netlink family for the nlasync test.
+ *
+ * Acks or nacks every message by its command, without NSS. Responses are
+ * unicast from a work item once the ack is out, the way NSS responses come
+ * back after the family has queued the message.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/skbuff.h>
+#include <linux/workqueue.h>
+#include <net/genetlink.h>
+#include <net/net_namespace.h>
+#include "nss_nlasync_stub_if.h"
+
+/*
+ * Destination of a deferred response, kept in the control buffer of its skb
+ */
+struct nss_nlasync_stub_cb {
+	struct net *net;
+	u32 portid;
+};
+
+#define NSS_NLASYNC_STUB_CB(skb) ((struct nss_nlasync_stub_cb *)(skb)->cb)
+
+static struct sk_buff_head nss_nlasync_stub_resp_q;
+static struct work_struct nss_nlasync_stub_resp_work;
+static struct genl_family nss_nlasync_stub_family;
+
+/*
+ * nss_nlasync_stub_resp_send()
+ *	Unicasts the queued responses.
+ */
+static void nss_nlasync_stub_resp_send(struct work_struct *work)
+{
+	struct sk_buff *skb;
+	struct net *net;
+	u32 portid;
+
+	while ((skb = skb_dequeue(&nss_nlasync_stub_resp_q))) {
+		net = NSS_NLASYNC_STUB_CB(skb)->net;
+		portid = NSS_NLASYNC_STUB_CB(skb)->portid;
+
+		/*
+		 * Frees the skb also when the receiver is gone or its buffer is full
+		 */
+		genlmsg_unicast(net, skb, portid);
+		put_net(net);
+	}
+}
+
+/*
+ * nss_nlasync_stub_ack()
+ *	Acks the message with success.
+ */
+static int nss_nlasync_stub_ack(struct sk_buff *skb, struct genl_info *info)
+{
+	return 0;
+}
+
+/*
+ * nss_nlasync_stub_nack()
+ *	Acks the message with an error.
+ */
+static int nss_nlasync_stub_nack(struct sk_buff *skb, struct genl_info *info)
+{
+	return -NSS_NLASYNC_STUB_NACK_ERROR;
+}
+
+/*
+ * nss_nlasync_stub_resp()
+ *	Acks the message with success and echoes its payload back as a response.
+ */
+static int nss_nlasync_stub_resp(struct sk_buff *skb, struct genl_info *info)
+{
+	int len = genlmsg_len(info->genlhdr);
+	struct sk_buff *resp;
+	void *hdr;
+
+	resp = genlmsg_new(len, GFP_KERNEL);
+	if (!resp) {
+		return -ENOMEM;
+	}
+
+	/*
+	 * Responses carry no sequence number, as the ones of NSS
+	 */
+	hdr = genlmsg_put(resp, info->snd_portid, 0, &nss_nlasync_stub_family, 0, NSS_NLASYNC_STUB_CMD_RESP);
+	if (!hdr) {
+		nlmsg_free(resp);
+		return -EMSGSIZE;
+	}
+
+	skb_put_data(resp, genlmsg_data(info->genlhdr), len);
+	genlmsg_end(resp, hdr);
+
+	NSS_NLASYNC_STUB_CB(resp)->net = get_net(genl_info_net(info));
+	NSS_NLASYNC_STUB_CB(resp)->portid = info->snd_portid;
+	skb_queue_tail(&nss_nlasync_stub_resp_q, resp);
+	schedule_work(&nss_nlasync_stub_resp_work);
+	return 0;
+}
+
+static const struct genl_ops nss_nlasync_stub_ops[] = {
+	{.cmd = NSS_NLASYNC_STUB_CMD_ACK, .doit = nss_nlasync_stub_ack,},
+	{.cmd = NSS_NLASYNC_STUB_CMD_NACK, .doit = nss_nlasync_stub_nack,},
+	{.cmd = NSS_NLASYNC_STUB_CMD_RESP, .doit = nss_nlasync_stub_resp,},
+};
+
+static struct genl_family nss_nlasync_stub_family = {
+	.name = NSS_NLASYNC_STUB_FAMILY,
+	.version = NSS_NLASYNC_STUB_VER,
+	.hdrsize = 0,
+	.maxattr = 0,
+	.netnsok = true,
+	.module = THIS_MODULE,
+	.ops = nss_nlasync_stub_ops,
+	.n_ops = ARRAY_SIZE(nss_nlasync_stub_ops),
+};
+
+/*
+ * nss_nlasync_stub_init()
+ *	Registers the stub family.
+ */
+static int __init nss_nlasync_stub_init(void)
+{
+	int error;
+
+	skb_queue_head_init(&nss_nlasync_stub_resp_q);
+	INIT_WORK(&nss_nlasync_stub_resp_work, nss_nlasync_stub_resp_send);
+
+	error = genl_register_family(&nss_nlasync_stub_family);
+	if (error) {
+		pr_err("failed to register %s family, error(%d)\n", NSS_NLASYNC_STUB_FAMILY, error);
+		return error;
+	}
+
+	pr_info("%s family registered\n", NSS_NLASYNC_STUB_FAMILY);
+	return 0;
+}
+
+/*
+ * nss_nlasync_stub_exit()
+ *	Unregisters the stub family and drops responses not sent yet.
+ */
+static void __exit nss_nlasync_stub_exit(void)
+{
+	struct sk_buff *skb;
+
+	genl_unregister_family(&nss_nlasync_stub_family);
+	cancel_work_sync(&nss_nlasync_stub_resp_work);
+
+	while ((skb = skb_dequeue(&nss_nlasync_stub_resp_q))) {
+		put_net(NSS_NLASYNC_STUB_CB(skb)->net);
+		kfree_skb(skb);
+	}
+
+	pr_info("%s family unregistered\n", NSS_NLASYNC_STUB_FAMILY);
+}
+
+module_init(nss_nlasync_stub_init);
+module_exit(nss_nlasync_stub_exit);
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("NSS NL asynchronous socket test stub");
@@ -360,6 +360,7 @@ struct general_device_out_api {
  * APIs for upper layer above general device, start
  */
 void qca_switch_probe(void);
+void sim_switch_probe(void);
 void genl_dev_linux_probe(void);
 /*
  * genl_dev_init: initialize general device sub module
@@ -124,6 +124,7 @@ static uint32_t qca_switch_api_param_nums(uint32_t api_id)
 	case SW_API_FDB_RESV_DEL:
 	case SW_API_TRUNK_HASH_SET:
 	case SW_API_TRUNK_HASH_GET:
+	case SW_API_PTS_LINK_STATUS_GET:
 		return 2;
 	case SW_API_FDB_DELPORT:
 	case SW_API_PT_SPEED_GET:
@@ -790,6 +791,24 @@ static bool qca_switch_port_get_link_status(struct switch_port *port)
 	return status;
 }
 
+/*
+ * qca_switch_get_link_status_bulk : get link status of all switch ports by one ioctl
+ * sw_sys: switch system
+ * link_bitmap: returned bitmap of link up ports
+ * return value: successful or fail
+ */
+static bool qca_switch_get_link_status_bulk(struct general_device_switch_system *sw_sys, uint32_t *link_bitmap)
+{
+	uint32_t status = 0;
+
+	if (!qca_switch_ioctl(SW_API_PTS_LINK_STATUS_GET, sw_sys->switch_obj, (uint32_t)(&status))) {
+		return false;
+	}
+
+	*link_bitmap = status;
+	return true;
+}
+
 /*
  * qca_switch_port_get_duplex : get duplex of switch port
  * port: switch port
@@ -1334,7 +1353,21 @@ static bool qca_switch_init(struct general_device_switch_system *sw_sys)
 	qca_sw->mirror_port = qca_switch_shell_cmd_get_int(sw_sys->name, "get_mirror_port");
 	qca_sw->private_hdr_type = qca_switch_shell_cmd_get_int(sw_sys->name, "get_private_header_type");
 
-	return qca_switch_load_runtime_ports(qca_sw) || qca_switch_load_ports(qca_sw);
+	if (!qca_switch_load_runtime_ports(qca_sw) && !qca_switch_load_ports(qca_sw)) {
+		return false;
+	}
+
+	/*
+	 * SSDK only reflects link of a switch port on carrier of its data channel if that
+	 * channel is not shared with other ports, otherwise keep polling
+	 */
+	if (qca_sw->link_event_auto) {
+		sw_sys->link_event_netlink = genl_dev_sw_ports_exported(sw_sys);
+		DP(GENL_DEVICE, DEBUG, "link event of switch %s is %s", sw_sys->name,
+			sw_sys->link_event_netlink ? "listened" : "polled, data channel is shared");
+	}
+
+	return true;
 }
 
 /*
@@ -1394,7 +1427,8 @@ void qca_switch_probe(void)
 	int num_of_switch = qca_switch_shell_cmd_get_word_list(NULL, "get_switch_list", sw_names, QCA_SW_NUM_MAX);
 	struct qca_switch_system *qca_sw;
 	struct general_device_switch_system *sw_sys;
-	int idx;
+	char link_event[1][QCA_SW_SHELL_CMD_WORD_SIZE];
+	int idx, link_event_cnt;
 
 	for (idx = 0; idx < num_of_switch; idx++) {
 		qca_sw = (struct qca_switch_system *)calloc(1, sizeof(struct qca_switch_system));
@@ -1408,9 +1442,13 @@ void qca_switch_probe(void)
 		sw_sys->switch_obj = idx;
 		sw_sys->real_agg_dev = false;
 		sw_sys->support_link_event = false;
+		link_event_cnt = qca_switch_shell_cmd_get_word_list(sw_sys->name, "get_linkstatus_event", link_event, 1);
+		sw_sys->link_event_netlink = ((link_event_cnt == 1) && !strcmp(link_event[0], "1"));
+		qca_sw->link_event_auto = ((link_event_cnt == 1) && !strcmp(link_event[0], "auto"));
 		sw_sys->link_status_poll_interval = qca_switch_shell_cmd_get_int(sw_sys->name, "get_linkstatus_poll_interval");
 
 		sw_sys->ops.common.get_link_status = qca_switch_port_get_link_status;
+		sw_sys->ops.common.get_link_status_bulk = qca_switch_get_link_status_bulk;
 		sw_sys->ops.common.get_duplex = qca_switch_port_get_duplex;
 		sw_sys->ops.common.get_speed = qca_switch_port_get_speed;
 		sw_sys->ops.bridge.is_bridge_member = qca_switch_port_is_bridge_member;
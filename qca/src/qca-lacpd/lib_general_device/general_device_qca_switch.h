@@ -175,6 +175,10 @@ struct qca_switch_system {
 	 */
 	uint16_t private_hdr_type;
 	uint16_t padd;
+	/*
+	 * Listen RTM_NEWLINK only if every switch port has a data channel of its own
+	 */
+	bool link_event_auto;
 	/*
 	 * Specify private header in switch
 	 * This is a counter.
@@ -0,0 +1,491 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#include "general_device_sim_switch.h"
+
+/*
+ * Utilities start
+ */
+/*
+ * sim_switch_port_flags : get interface flags of Linux network device of a switch port
+ * return value: interface flags, 0 if failed
+ */
+static short sim_switch_port_flags(struct sim_switch_system *sim_sw, uint32_t port_num)
+{
+	struct ifreq ifr = {};
+
+	if (port_num >= sim_sw->num_of_ports) {
+		return 0;
+	}
+
+	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", sim_sw->ports[port_num]);
+	if (ioctl(sim_sw->ioctl_fd, SIOCGIFFLAGS, &ifr) < 0) {
+		return 0;
+	}
+
+	return ifr.ifr_flags;
+}
+
+/*
+ * sim_switch_port_num_of_ifindex : find switch port mapped on a Linux network device
+ * return value: port number, or SIM_SW_PORT_NUM if not found
+ */
+static uint32_t sim_switch_port_num_of_ifindex(struct sim_switch_system *sim_sw, int ifindex)
+{
+	char ifname[IF_NAMESIZE];
+	uint32_t port_num;
+
+	if (NULL == if_indextoname(ifindex, ifname)) {
+		return SIM_SW_PORT_NUM;
+	}
+
+	for (port_num = 0; port_num < sim_sw->num_of_ports; port_num++) {
+		if (!strncmp(sim_sw->ports[port_num], ifname, sizeof(sim_sw->ports[port_num]))) {
+			return port_num;
+		}
+	}
+
+	return SIM_SW_PORT_NUM;
+}
+
+/*
+ * sim_switch_recv_packet : receive BPDU/LACPDU on Linux network device of switch port
+ */
+static void sim_switch_recv_packet(struct genl_os_service_fd *fd, unsigned int events)
+{
+	static uint8_t bpdu_dst_mac[GENERAL_DEVICE_HW_ADDR_SIZE] = {0x01, 0x80, 0xc2, 0x0, 0x0, 0x0};
+	static uint8_t lacpdu_dst_mac[GENERAL_DEVICE_HW_ADDR_SIZE] = {0x01, 0x80, 0xc2, 0x0, 0x0, 0x2};
+	struct sim_switch_system *sim_sw = (struct sim_switch_system *)fd->arg;
+	uint8_t buf[SIM_SW_CONTROL_PKT_MAX_SIZE];
+	struct sockaddr_ll sl;
+	socklen_t salen = sizeof(sl);
+	int ret_buf_len;
+	uint32_t port_num;
+
+	if (!(events & GENL_OS_SERVICE_FD_EVENTS_READ)) {
+		DP(GENL_DEVICE, WARNING, "event %d is not read event, return", events);
+		return;
+	}
+
+	ret_buf_len = recvfrom(fd->fd, buf, sizeof(buf), 0, (struct sockaddr *) &sl, &salen);
+	if (ret_buf_len <= 0) {
+		DP(GENL_DEVICE, WARNING, "recvfrom failed: %m");
+		return;
+	}
+
+	if ((sl.sll_pkttype == PACKET_OUTGOING) || (ret_buf_len < ETH_HLEN)) {
+		return;
+	}
+
+	port_num = sim_switch_port_num_of_ifindex(sim_sw, sl.sll_ifindex);
+	if (port_num >= SIM_SW_PORT_NUM) {
+		return;
+	}
+
+	if (!memcmp(buf, bpdu_dst_mac, sizeof(bpdu_dst_mac))) {
+		genl_dev_sw_port_recv_bpdu(&sim_sw->base, sim_sw->ports[port_num], port_num, buf, ret_buf_len);
+	} else if (!memcmp(buf, lacpdu_dst_mac, sizeof(lacpdu_dst_mac))) {
+		genl_dev_sw_port_recv_lacpdu(&sim_sw->base, sim_sw->ports[port_num], port_num, buf, ret_buf_len);
+	}
+}
+
+/*
+ * sim_switch_send_packet : send control/protocol packet on Linux network device of switch port
+ */
+static bool sim_switch_send_packet(struct sim_switch_system *sim_sw, struct switch_port *port, const uint8_t *buf, uint32_t buf_len)
+{
+	struct sockaddr_ll sl;
+	int sent_len;
+
+	if (!sim_sw->raw_socket_enabled) {
+		return false;
+	}
+
+	memset(&sl, 0, sizeof(sl));
+	sl.sll_family = AF_PACKET;
+	sl.sll_protocol = htons(ETH_P_ALL);
+	sl.sll_ifindex = if_nametoindex(port->data_channel);
+	sl.sll_halen = GENERAL_DEVICE_HW_ADDR_SIZE;
+	memcpy(&sl.sll_addr, buf, GENERAL_DEVICE_HW_ADDR_SIZE);
+
+	if (!sl.sll_ifindex) {
+		DP(GENL_DEVICE, WARNING, "Can't resolve data channel of switch port %s", port->name);
+		return false;
+	}
+
+	sent_len = sendto(sim_sw->raw_socket.fd, buf, buf_len, 0, (struct sockaddr *) &sl, sizeof(sl));
+	if (sent_len < 0) {
+		DP(GENL_DEVICE, NOTICE, "Send packet failed");
+	}
+
+	return (sent_len == buf_len);
+}
+
+/*
+ * sim_switch_enable_raw_socket : Open raw socket to receive control/protocol packet
+ */
+static bool sim_switch_enable_raw_socket(struct sim_switch_system *sim_sw, bool enable)
+{
+	struct genl_os_service *os_service = genl_dev_os_service_get();
+	bool ret = false;
+
+	enable ? (++sim_sw->raw_socket_enabled) : (--sim_sw->raw_socket_enabled);
+	if (sim_sw->raw_socket_enabled != enable) {
+		return true;
+	}
+
+	if (enable) {
+		sim_sw->raw_socket.fd = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+		if (sim_sw->raw_socket.fd >= 0) {
+			if (fcntl(sim_sw->raw_socket.fd, F_SETFL, (fcntl(sim_sw->raw_socket.fd, F_GETFL, 0) | O_NONBLOCK)) >= 0) {
+				sim_sw->raw_socket.cb = sim_switch_recv_packet;
+				sim_sw->raw_socket.arg = (void *)sim_sw;
+				if (os_service->fd_add(&sim_sw->raw_socket, GENL_OS_SERVICE_FD_FLAGS_READ)) {
+					ret = true;
+				}
+			}
+		}
+	} else {
+		if (os_service->fd_del(&sim_sw->raw_socket)) {
+			if (close(sim_sw->raw_socket.fd) >= 0) {
+				sim_sw->raw_socket.fd = 0;
+				ret = true;
+			}
+		}
+	}
+
+	if (!ret) {
+		enable ? (--sim_sw->raw_socket_enabled) : (++sim_sw->raw_socket_enabled);
+	}
+
+	return ret;
+}
+
+/*
+ * sim_sw_agg_id_is_active : check if an aggregator id is allocated
+ */
+static bool sim_sw_agg_id_is_active(struct sim_switch_system *sim_sw, uint32_t agg_id)
+{
+	if (!sim_sw_agg_id_is_valid(agg_id)) {
+		return false;
+	}
+
+	return (sim_sw->agg_id_bitmap & (1 << agg_id)) != 0;
+}
+
+/*
+ * sim_switch_load_ports : create switch ports from environment variable "LACPD_SIM_SWITCH_PORTS"
+ */
+static bool sim_switch_load_ports(struct sim_switch_system *sim_sw)
+{
+	struct general_device_switch_system *sw_sys = &sim_sw->base;
+	char port_name[GENERAL_DEVICE_SYSTEM_NAME_SIZE];
+	uint32_t port_num;
+
+	for (port_num = 0; port_num < sim_sw->num_of_ports; port_num++) {
+		snprintf(port_name, sizeof(port_name), "%s.%s", SIM_SW_NAME, sim_sw->ports[port_num]);
+
+		if (!genl_dev_sw_port_create(sw_sys, port_name, port_num, sim_sw->port_domain + port_num,
+					     sim_sw->ports[port_num], sim_sw->ports[port_num])) {
+			DP(GENL_DEVICE, CRIT, "Create switch port %s failed", port_name);
+			return false;
+		}
+	}
+
+	return true;
+}
+/*
+ * Utilities end
+ */
+
+/*
+ * sim_switch_port_get_link_status : get link status of switch port
+ */
+static bool sim_switch_port_get_link_status(struct switch_port *port)
+{
+	struct sim_switch_system *sim_sw = container_of(port->sw_sys, struct sim_switch_system, base);
+
+	return ((sim_switch_port_flags(sim_sw, port->port_num) & (IFF_UP|IFF_RUNNING)) == (IFF_UP|IFF_RUNNING));
+}
+
+/*
+ * sim_switch_get_link_status_bulk : get link status of all switch ports
+ */
+static bool sim_switch_get_link_status_bulk(struct general_device_switch_system *sw_sys, uint32_t *link_bitmap)
+{
+	struct sim_switch_system *sim_sw = container_of(sw_sys, struct sim_switch_system, base);
+	uint32_t port_num;
+
+	*link_bitmap = 0;
+	for (port_num = 0; port_num < sim_sw->num_of_ports; port_num++) {
+		if ((sim_switch_port_flags(sim_sw, port_num) & (IFF_UP|IFF_RUNNING)) == (IFF_UP|IFF_RUNNING)) {
+			*link_bitmap |= (1 << port_num);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * sim_switch_port_get_duplex : simulated switch port is always full duplex
+ */
+static uint32_t sim_switch_port_get_duplex(struct switch_port *port)
+{
+	return 1;
+}
+
+/*
+ * sim_switch_port_get_speed : simulated switch port is always 1Gbps
+ */
+static uint32_t sim_switch_port_get_speed(struct switch_port *port)
+{
+	return 1000;
+}
+
+/*
+ * sim_switch_port_get_hw_addr : use hardware address of Linux network device
+ */
+static bool sim_switch_port_get_hw_addr(struct switch_port *port, uint8_t *hw_addr)
+{
+	struct sim_switch_system *sim_sw = container_of(port->sw_sys, struct sim_switch_system, base);
+	struct ifreq ifr = {};
+
+	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", port->data_channel);
+	if (ioctl(sim_sw->ioctl_fd, SIOCGIFHWADDR, &ifr) < 0) {
+		return false;
+	}
+
+	memcpy(hw_addr, ifr.ifr_hwaddr.sa_data, GENERAL_DEVICE_HW_ADDR_SIZE);
+	return true;
+}
+
+static bool sim_switch_port_is_bridge_member(struct switch_port *port, struct switch_port *br)
+{
+	return false;
+}
+
+static bool sim_switch_port_flush_fdb(struct switch_port *port)
+{
+	return true;
+}
+
+/*
+ * sim_switch_port_enable_raw_socket : enable STP/LACP on port, open raw socket for BPDU/LACPDU
+ */
+static bool sim_switch_port_enable_raw_socket(struct switch_port *port)
+{
+	return sim_switch_enable_raw_socket(container_of(port->sw_sys, struct sim_switch_system, base), true);
+}
+
+/*
+ * sim_switch_port_disable_raw_socket : disable STP/LACP on port, close raw socket if nobody uses it
+ */
+static bool sim_switch_port_disable_raw_socket(struct switch_port *port)
+{
+	return sim_switch_enable_raw_socket(container_of(port->sw_sys, struct sim_switch_system, base), false);
+}
+
+static bool sim_switch_port_set_stp_state(struct switch_port *port, enum general_device_stp_state state)
+{
+	return true;
+}
+
+/*
+ * sim_switch_port_send_pdu : send BPDU/LACPDU on switch port
+ */
+static bool sim_switch_port_send_pdu(struct switch_port *port, const uint8_t *buf, uint32_t buf_len)
+{
+	return sim_switch_send_packet(container_of(port->sw_sys, struct sim_switch_system, base), port, buf, buf_len);
+}
+
+/*
+ * sim_switch_new_aggregator : allocate a free aggregator id
+ */
+static bool sim_switch_new_aggregator(struct switch_port *port)
+{
+	struct sim_switch_system *sim_sw = container_of(port->sw_sys, struct sim_switch_system, base);
+	uint32_t agg_id;
+
+	for (agg_id = SIM_SW_AGG_ID_MIN; agg_id <= SIM_SW_AGG_ID_MAX; agg_id++) {
+		if (!sim_sw_agg_id_is_active(sim_sw, agg_id)) {
+			sim_sw->agg_id_bitmap |= (1 << agg_id);
+			port->switch_port_obj = sim_sw->agg_domain + agg_id;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * sim_switch_destroy_aggregator : free aggregator id
+ */
+static bool sim_switch_destroy_aggregator(struct switch_port *port)
+{
+	struct sim_switch_system *sim_sw = container_of(port->sw_sys, struct sim_switch_system, base);
+	uint32_t agg_id = port->switch_port_obj - sim_sw->agg_domain;
+
+	if (!sim_sw_agg_id_is_active(sim_sw, agg_id)) {
+		return false;
+	}
+
+	sim_sw->agg_id_bitmap &= ~(1 << agg_id);
+	return true;
+}
+
+static bool sim_switch_port_is_aggregator(struct switch_port *master, struct switch_port *slave)
+{
+	struct sim_switch_system *sim_sw = container_of(master->sw_sys, struct sim_switch_system, base);
+
+	return sim_sw_agg_id_is_active(sim_sw, master->switch_port_obj - sim_sw->agg_domain);
+}
+
+/*
+ * sim_switch_port_attach_slave : members of aggregator are maintained by "switch port" layer, nothing to program
+ */
+static bool sim_switch_port_attach_slave(struct switch_port *master, struct switch_port *slave)
+{
+	return sim_switch_port_is_aggregator(master, slave);
+}
+
+static bool sim_switch_port_detach_slave(struct switch_port *master, struct switch_port *slave)
+{
+	return sim_switch_port_is_aggregator(master, slave);
+}
+
+static bool sim_switch_port_set_tx_hash_policy(struct switch_port *aggregator, enum general_device_agg_tx_hash_policy policy)
+{
+	return true;
+}
+
+/*
+ * hardware specific initiation when switch port system start
+ */
+static bool sim_switch_init(struct general_device_switch_system *sw_sys)
+{
+	struct sim_switch_system *sim_sw = container_of(sw_sys, struct sim_switch_system, base);
+
+	sim_sw->ioctl_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sim_sw->ioctl_fd < 0) {
+		return false;
+	}
+
+	sim_sw->port_domain = genl_dev_sw_alloc_netdev_obj_domain(sw_sys, SIM_SW_PORT_NUM);
+	sim_sw->agg_domain = genl_dev_sw_alloc_netdev_obj_domain(sw_sys, SIM_SW_AGG_NUM);
+
+	return sim_switch_load_ports(sim_sw);
+}
+
+/*
+ * hardware specific finalization when switch port system stop
+ */
+static bool sim_switch_exit(struct general_device_switch_system *sw_sys)
+{
+	struct sim_switch_system *sim_sw = container_of(sw_sys, struct sim_switch_system, base);
+
+	if (sim_sw->ioctl_fd >= 0) {
+		close(sim_sw->ioctl_fd);
+		sim_sw->ioctl_fd = -1;
+	}
+
+	return true;
+}
+
+static bool sim_switch_private(struct general_device_switch_system *sw_sys, uint32_t func_id, void *input_arg, void *output_arg)
+{
+	return false;
+}
+
+/*
+ * sim_switch_probe : register simulated switch if "LACPD_SIM_SWITCH_PORTS" is set
+ */
+void sim_switch_probe(void)
+{
+	const char *ports_env = getenv(SIM_SW_PORTS_ENV);
+	const char *interval_env = getenv(SIM_SW_POLL_INTERVAL_ENV);
+	struct sim_switch_system *sim_sw;
+	struct general_device_switch_system *sw_sys;
+	char ports[SIM_SW_PORT_NUM * GENERAL_DEVICE_SYSTEM_NAME_SIZE];
+	char *word, *save;
+
+	if (!ports_env) {
+		return;
+	}
+
+	sim_sw = (struct sim_switch_system *)calloc(1, sizeof(struct sim_switch_system));
+	if (!sim_sw) {
+		DP(GENL_DEVICE, CRIT, "Allocate memory for simulated switch failed");
+		return;
+	}
+
+	snprintf(ports, sizeof(ports), "%s", ports_env);
+	for (word = strtok_r(ports, " ,", &save); word && (sim_sw->num_of_ports < SIM_SW_PORT_NUM); word = strtok_r(NULL, " ,", &save)) {
+		snprintf(sim_sw->ports[sim_sw->num_of_ports], sizeof(sim_sw->ports[0]), "%s", word);
+		sim_sw->num_of_ports++;
+	}
+
+	sim_sw->ioctl_fd = -1;
+	sw_sys = &sim_sw->base;
+	snprintf(sw_sys->name, sizeof(sw_sys->name), "%s", SIM_SW_NAME);
+	sw_sys->switch_obj = 0;
+	sw_sys->real_agg_dev = false;
+	sw_sys->support_link_event = false;
+	sw_sys->link_event_netlink = true;
+	sw_sys->link_status_poll_interval = interval_env ? strtoul(interval_env, NULL, 0) : SIM_SW_POLL_INTERVAL_DEFAULT;
+
+	sw_sys->ops.common.get_link_status = sim_switch_port_get_link_status;
+	sw_sys->ops.common.get_link_status_bulk = sim_switch_get_link_status_bulk;
+	sw_sys->ops.common.get_duplex = sim_switch_port_get_duplex;
+	sw_sys->ops.common.get_speed = sim_switch_port_get_speed;
+	sw_sys->ops.common.get_hw_addr = sim_switch_port_get_hw_addr;
+	sw_sys->ops.bridge.is_bridge_member = sim_switch_port_is_bridge_member;
+	sw_sys->ops.bridge.flush_fdb = sim_switch_port_flush_fdb;
+	sw_sys->ops.stp.enable = sim_switch_port_enable_raw_socket;
+	sw_sys->ops.stp.disable = sim_switch_port_disable_raw_socket;
+	sw_sys->ops.stp.set_port_state = sim_switch_port_set_stp_state;
+	sw_sys->ops.stp.send_bpdu = sim_switch_port_send_pdu;
+	sw_sys->ops.agg.enable = sim_switch_port_enable_raw_socket;
+	sw_sys->ops.agg.disable = sim_switch_port_disable_raw_socket;
+	sw_sys->ops.agg.new_aggregator = sim_switch_new_aggregator;
+	sw_sys->ops.agg.destroy_aggregator = sim_switch_destroy_aggregator;
+	sw_sys->ops.agg.is_aggregator = sim_switch_port_is_aggregator;
+	sw_sys->ops.agg.attach_slave = sim_switch_port_attach_slave;
+	sw_sys->ops.agg.detach_slave = sim_switch_port_detach_slave;
+	sw_sys->ops.agg.send_lacpdu = sim_switch_port_send_pdu;
+	sw_sys->ops.agg.set_tx_hash_policy = sim_switch_port_set_tx_hash_policy;
+	sw_sys->ops.init = sim_switch_init;
+	sw_sys->ops.exit = sim_switch_exit;
+	sw_sys->ops.private = sim_switch_private;
+
+	sw_sys->base.domain = SIM_SW_DOMAIN_INIT;
+	sw_sys->base.next_internal_domain = SIM_SW_INTERNAL_DOMAIN_INIT;
+
+	if (!genl_dev_register_switch_system(sw_sys)) {
+		DP(GENL_DEVICE, CRIT, "Register simulated switch failed");
+		free(sim_sw);
+	}
+}
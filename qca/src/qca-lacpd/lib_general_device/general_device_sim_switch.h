@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef __GENERAL_DEVICE_SIM_SWITCH_H
+#define __GENERAL_DEVICE_SIM_SWITCH_H
+
+#include "general_device_switch.h"
+
+/*
+ * Simulated switch maps every switch port on a Linux network device, normally one end of a veth pair.
+ * Taking down the other end of the pair is a link failure of the switch port.
+ *
+ * LACPD_SIM_SWITCH_PORTS="veth0 veth1 ..." : Linux network devices used as switch ports 0, 1, ...
+ * LACPD_SIM_SWITCH_POLL_INTERVAL=msec : interval of fallback link status poll
+ */
+#define SIM_SW_PORTS_ENV "LACPD_SIM_SWITCH_PORTS"
+#define SIM_SW_POLL_INTERVAL_ENV "LACPD_SIM_SWITCH_POLL_INTERVAL"
+#define SIM_SW_POLL_INTERVAL_DEFAULT 1000
+#define SIM_SW_NAME "sim"
+#define SIM_SW_PORT_NUM 16
+#define SIM_SW_AGG_ID_MIN 0
+#define SIM_SW_AGG_ID_MAX 7
+#define SIM_SW_AGG_NUM ((SIM_SW_AGG_ID_MAX - SIM_SW_AGG_ID_MIN) + 1)
+#define sim_sw_agg_id_is_valid(AGG_ID) ((AGG_ID) <= SIM_SW_AGG_ID_MAX && (AGG_ID) >= SIM_SW_AGG_ID_MIN)
+#define SIM_SW_DOMAIN_INIT 0xe0
+#define SIM_SW_INTERNAL_DOMAIN_INIT 0xf0
+#define SIM_SW_CONTROL_PKT_MAX_SIZE 512
+
+struct sim_switch_system {
+	struct general_device_switch_system base;
+
+	/*
+	 * Linux network device of each switch port, indexed by port number
+	 */
+	char ports[SIM_SW_PORT_NUM][GENERAL_DEVICE_SYSTEM_NAME_SIZE];
+	uint32_t num_of_ports;
+	/*
+	 * Raw socket is used to send and receive BPDU/LACPDU on all switch ports
+	 */
+	struct genl_os_service_fd raw_socket;
+	/*
+	 * Open raw socket to receive control/protocol packet
+	 * This is a counter.
+	 */
+	int raw_socket_enabled;
+	/*
+	 * Socket for interface ioctl
+	 */
+	int ioctl_fd;
+	/*
+	 * magic prefix for index of normal switch port
+	 */
+	uint32_t port_domain;
+	/*
+	 * magic prefix for index of switch aggregator
+	 */
+	uint32_t agg_domain;
+	/*
+	 * Once an aggregator is created, set its corresponding bit here
+	 */
+	uint32_t agg_id_bitmap;
+};
+
+#endif /*__GENERAL_DEVICE_SIM_SWITCH_H*/
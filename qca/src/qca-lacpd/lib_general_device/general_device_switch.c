@@ -13,6 +13,13 @@
  * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
 #include "general_device_switch.h"
 /*
  * Utilities start
@@ -167,20 +174,76 @@ struct switch_port *genl_dev_sw_port_create(struct general_device_switch_system
 }
 
 /*
- * genl_dev_sw_link_status_update: handler of timer "struct general_device_switch_system -> link_status_monitor"
+ * genl_dev_sw_ports_exported: check if every switch port has a data channel of its own
+ * sw_sys: switch system
+ * return value: true: link of each switch port can be seen on a Linux network device, false: some ports share one
  */
-static void genl_dev_sw_link_status_update(struct genl_os_service_timer *timer)
+bool genl_dev_sw_ports_exported(struct general_device_switch_system *sw_sys)
+{
+	struct switch_port *port, *other;
+
+	if (list_empty(&sw_sys->switch_ports)) {
+		return false;
+	}
+
+	list_for_each_entry(port, &sw_sys->switch_ports, node) {
+		if (port->type != SWITCH_PORT_TYPE_EXPORTED) {
+			return false;
+		}
+
+		list_for_each_entry(other, &sw_sys->switch_ports, node) {
+			if ((other != port) && !strncmp(other->data_channel, port->data_channel, sizeof(port->data_channel))) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+ * genl_dev_sw_link_status_interval: interval of timer "struct general_device_switch_system -> link_status_monitor"
+ */
+static uint32_t genl_dev_sw_link_status_interval(struct general_device_switch_system *sw_sys)
+{
+	if (sw_sys->link_event_netlink && (sw_sys->link_status_poll_interval < SWITCH_PORT_LINK_FALLBACK_INTERVAL)) {
+		return SWITCH_PORT_LINK_FALLBACK_INTERVAL;
+	}
+
+	return sw_sys->link_status_poll_interval;
+}
+
+/*
+ * genl_dev_sw_link_status_read: read link status of switch port, use result of bulk query if it is valid
+ */
+static bool genl_dev_sw_link_status_read(struct general_device_switch_system *sw_sys, struct switch_port *port, bool bulk_valid, uint32_t link_bitmap)
+{
+	if (bulk_valid) {
+		return ((link_bitmap & (1 << port->port_num)) != 0);
+	}
+
+	return sw_sys->ops.common.get_link_status(port);
+}
+
+/*
+ * genl_dev_sw_link_status_refresh: read link status of all switch ports and notify the changed ones
+ */
+static void genl_dev_sw_link_status_refresh(struct general_device_switch_system *sw_sys)
 {
-	struct general_device_switch_system *sw_sys = (struct general_device_switch_system *)timer->arg;
-	struct genl_os_service *os_service = genl_dev_os_service_get();
 	struct switch_port *port, *slave;
 	bool new_link_status, slave_new_link_status;
+	bool bulk_valid = false;
+	uint32_t link_bitmap = 0;
+
+	if (sw_sys->ops.common.get_link_status_bulk) {
+		bulk_valid = sw_sys->ops.common.get_link_status_bulk(sw_sys, &link_bitmap);
+	}
 
 	list_for_each_entry(port, &sw_sys->switch_ports, node) {
 		if (switch_port_is_aggregator(port) && (!sw_sys->real_agg_dev)) {
 			new_link_status = false;
 			list_for_each_entry(slave, &port->agg_slaves, node) {
-				slave_new_link_status = sw_sys->ops.common.get_link_status(slave);
+				slave_new_link_status = genl_dev_sw_link_status_read(sw_sys, slave, bulk_valid, link_bitmap);
 				if (slave_new_link_status != slave->link_status){
 					slave->link_status = slave_new_link_status;
 					genl_dev_sw_port_link_status_changed(sw_sys, slave, slave->link_status);
@@ -188,8 +251,13 @@ static void genl_dev_sw_link_status_update(struct genl_os_service_timer *timer)
 
 				new_link_status = new_link_status || slave->link_status;
 			}
-		} else {
+		} else if (switch_port_is_aggregator(port)) {
+			/*
+			 * Real aggregator device has no bit in bitmap of bulk query
+			 */
 			new_link_status = sw_sys->ops.common.get_link_status(port);
+		} else {
+			new_link_status = genl_dev_sw_link_status_read(sw_sys, port, bulk_valid, link_bitmap);
 		}
 
 		if (new_link_status != port->link_status){
@@ -197,8 +265,147 @@ static void genl_dev_sw_link_status_update(struct genl_os_service_timer *timer)
 			genl_dev_sw_port_link_status_changed(sw_sys, port, port->link_status);
 		}
 	}
+}
+
+/*
+ * genl_dev_sw_link_status_update: handler of timer "struct general_device_switch_system -> link_status_monitor"
+ */
+static void genl_dev_sw_link_status_update(struct genl_os_service_timer *timer)
+{
+	struct general_device_switch_system *sw_sys = (struct general_device_switch_system *)timer->arg;
+	struct genl_os_service *os_service = genl_dev_os_service_get();
+
+	genl_dev_sw_link_status_refresh(sw_sys);
 
-	os_service->timer_set(&sw_sys->link_status_monitor, sw_sys->link_status_poll_interval);
+	os_service->timer_set(&sw_sys->link_status_monitor, genl_dev_sw_link_status_interval(sw_sys));
+}
+
+/*
+ * genl_dev_sw_is_channel: check if a Linux network device is control or data channel of any switch port
+ */
+static bool genl_dev_sw_is_channel(struct general_device_switch_system *sw_sys, const char *ifname)
+{
+	struct switch_port *port, *slave;
+
+	list_for_each_entry(port, &sw_sys->switch_ports, node) {
+		if (!strncmp(port->control_channel, ifname, sizeof(port->control_channel))
+			|| !strncmp(port->data_channel, ifname, sizeof(port->data_channel))) {
+			return true;
+		}
+
+		list_for_each_entry(slave, &port->agg_slaves, node) {
+			if (!strncmp(slave->control_channel, ifname, sizeof(slave->control_channel))
+				|| !strncmp(slave->data_channel, ifname, sizeof(slave->data_channel))) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * genl_dev_sw_link_event_recv: handler of "struct general_device_switch_system -> link_event_socket"
+ */
+static void genl_dev_sw_link_event_recv(struct genl_os_service_fd *fd, unsigned int events)
+{
+	struct general_device_switch_system *sw_sys = (struct general_device_switch_system *)fd->arg;
+	uint8_t buf[SWITCH_PORT_NETLINK_BUF_SIZE];
+	struct nlmsghdr *nlh;
+	struct ifinfomsg *ifi;
+	struct rtattr *rta;
+	struct timespec start, end;
+	int len, rta_len;
+	bool changed = false;
+
+	if (!(events & GENL_OS_SERVICE_FD_EVENTS_READ)) {
+		DP(GENL_DEVICE, WARNING, "event %d is not read event, return", events);
+		return;
+	}
+
+	/*
+	 * Drain the socket first, so a burst of link events costs only one refresh
+	 */
+	while ((len = recv(fd->fd, buf, sizeof(buf), 0)) > 0) {
+		for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			if ((nlh->nlmsg_type != RTM_NEWLINK) && (nlh->nlmsg_type != RTM_DELLINK)) {
+				continue;
+			}
+
+			ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+			rta_len = IFLA_PAYLOAD(nlh);
+			for (rta = IFLA_RTA(ifi); RTA_OK(rta, rta_len); rta = RTA_NEXT(rta, rta_len)) {
+				if ((rta->rta_type == IFLA_IFNAME) && genl_dev_sw_is_channel(sw_sys, (const char *)RTA_DATA(rta))) {
+					changed = true;
+				}
+			}
+		}
+	}
+
+	if ((len < 0) && (errno == ENOBUFS)) {
+		/*
+		 * Kernel dropped some events, we don't know which device changed
+		 */
+		DP(GENL_DEVICE, NOTICE, "link event socket of switch %s overrun", sw_sys->name);
+		changed = true;
+	}
+
+	if (!changed) {
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	genl_dev_sw_link_status_refresh(sw_sys);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	DP(GENL_DEVICE, DEBUG, "link event of switch %s handled in %ld usec", sw_sys->name,
+		(long)((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000));
+}
+
+/*
+ * genl_dev_sw_link_event_enable: open or close netlink socket to listen RTM_NEWLINK
+ * return value: true: successful, false: failed
+ */
+static bool genl_dev_sw_link_event_enable(struct general_device_switch_system *sw_sys, bool enable)
+{
+	struct genl_os_service *os_service = genl_dev_os_service_get();
+	struct sockaddr_nl sa;
+	int fd;
+
+	if (!enable) {
+		os_service->fd_del(&sw_sys->link_event_socket);
+		close(sw_sys->link_event_socket.fd);
+		sw_sys->link_event_socket.fd = -1;
+		return true;
+	}
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0) {
+		return false;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+	sa.nl_groups = RTMGRP_LINK;
+
+	if ((bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+		|| (fcntl(fd, F_SETFL, (fcntl(fd, F_GETFL, 0) | O_NONBLOCK)) < 0)) {
+		close(fd);
+		return false;
+	}
+
+	sw_sys->link_event_socket.fd = fd;
+	sw_sys->link_event_socket.cb = genl_dev_sw_link_event_recv;
+	sw_sys->link_event_socket.arg = (void *)sw_sys;
+
+	if (!os_service->fd_add(&sw_sys->link_event_socket, GENL_OS_SERVICE_FD_FLAGS_READ)) {
+		close(fd);
+		sw_sys->link_event_socket.fd = -1;
+		return false;
+	}
+
+	DP(GENL_DEVICE, DEBUG, "listen link event of switch %s", sw_sys->name);
+	return true;
 }
 
 /*
@@ -216,18 +423,32 @@ static bool genl_dev_sw_init(struct general_device_system *system_obj)
 {
 	struct general_device_switch_system *sw_sys = container_of(system_obj, struct general_device_switch_system, base);
 	struct genl_os_service *os_service;
+	bool ret;
+
+	/*
+	 * Lower driver loads its ports here, it may decide 'link_event_netlink' from them
+	 */
+	ret = sw_sys->ops.init(sw_sys);
 
 	if (!sw_sys->support_link_event) {
 		os_service = genl_dev_os_service_get();
 
+		if (sw_sys->link_event_netlink && !genl_dev_sw_link_event_enable(sw_sys, true)) {
+			DP(GENL_DEVICE, WARNING, "Listen link event of switch %s failed, poll link status instead", sw_sys->name);
+			sw_sys->link_event_netlink = false;
+		}
+
 		sw_sys->link_status_monitor.cb = genl_dev_sw_link_status_update;
 		sw_sys->link_status_monitor.arg = (void *)sw_sys;
-		sw_sys->link_status_monitor.msecs = sw_sys->link_status_poll_interval;
+		sw_sys->link_status_monitor.msecs = genl_dev_sw_link_status_interval(sw_sys);
 
+		/*
+		 * First poll learns initial link status, then only events or fallback poll update it
+		 */
 		os_service->timer_set(&sw_sys->link_status_monitor, sw_sys->link_status_poll_interval);
 	}
 
-	return sw_sys->ops.init(sw_sys);
+	return ret;
 }
 
 /*
@@ -244,6 +465,10 @@ static bool genl_dev_sw_exit(struct general_device_system *system_obj)
 		os_service = genl_dev_os_service_get();
 
 		os_service->timer_cancel(&sw_sys->link_status_monitor);
+
+		if (sw_sys->link_event_netlink) {
+			genl_dev_sw_link_event_enable(sw_sys, false);
+		}
 	}
 
 	return sw_sys->ops.exit(sw_sys);
@@ -19,6 +19,11 @@
 #include "general_device_api.h"
 
 #define SWITCH_PORT_LAYER_DEPTH (GENERAL_DEVICE_LAYER_DEPTH + 1)
+/*
+ * When link events come from netlink, poll only this often to recover lost events, in unit of msec
+ */
+#define SWITCH_PORT_LINK_FALLBACK_INTERVAL 10000
+#define SWITCH_PORT_NETLINK_BUF_SIZE 8192
 #define switch_port_is_agg_slave(port) (NULL != (port)->agg_parent)
 #define switch_port_is_aggregator(port) ((port)->sw_sys->ops.agg.is_aggregator((port), NULL))
 
@@ -112,6 +117,13 @@ struct switch_ops_common {
 	 * return value: true: link up; false: link down
 	 */
 	bool (*get_link_status)(struct switch_port *port);
+	/*
+	 * get_link_status_bulk : (optional), get link status of all hardware ports by one query
+	 * sw_sys: switch system
+	 * link_bitmap: returned bitmap of link up ports, bit index is 'port_num' of switch port
+	 * return value: successful or fail
+	 */
+	bool (*get_link_status_bulk)(struct general_device_switch_system *sw_sys, uint32_t *link_bitmap);
 	/*
 	 * get_duplex : get duplex of switch port
 	 * port: switch port
@@ -284,6 +296,7 @@ struct general_device_switch_system {
 	struct general_device_system base;			/*Super class*/
 	struct list_head switch_ports;				/*List of switch ports*/
 	struct genl_os_service_timer link_status_monitor;	/*timer to monitor link status of switch port*/
+	struct genl_os_service_fd link_event_socket;		/*netlink socket listening RTM_NEWLINK if 'link_event_netlink' is true*/
 	/*
 	 * Fields maintained by 'switch port' module, end
 	 */
@@ -294,6 +307,7 @@ struct general_device_switch_system {
 	uint32_t switch_obj;					/*index of switch*/
 	bool real_agg_dev;					/*aggregator has a real device index, switch driver can operate on this index*/
 	bool support_link_event;				/*lower device system can notify link status event. If false, "switch port" layer will poll*/
+	bool link_event_netlink;				/*switch driver reflects port link on control/data channel, "switch port" layer listens RTM_NEWLINK and polls only as fallback*/
 	uint32_t link_status_poll_interval;			/*interval to poll link status of switch port if link event is not supported, in unit of msec*/
 	struct switch_ops ops;					/*APIs provided by specific switch system*/
 	/*
@@ -355,6 +369,12 @@ uint32_t genl_dev_sw_alloc_netdev_obj_domain(struct general_device_switch_system
  */
 struct switch_port *genl_dev_sw_port_create(struct general_device_switch_system *sw_sys, const char *port_name, uint32_t port_num,
 											uint32_t switch_port_obj, const char *ctrl_channel, const char *data_channel);
+/*
+ * genl_dev_sw_ports_exported: check if every switch port has a data channel of its own
+ * sw_sys: switch system
+ * return value: true: link of each switch port can be seen on a Linux network device, false: some ports share one
+ */
+bool genl_dev_sw_ports_exported(struct general_device_switch_system *sw_sys);
 /*
  * genl_dev_register_switch_system : register a switch system
  */
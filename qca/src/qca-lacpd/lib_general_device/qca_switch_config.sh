@@ -36,6 +36,24 @@ get_linkstatus_poll_interval(){
 	esac
 }
 
+#"1" if switch driver reflects port link on control/data channel, then
+#link status is updated by RTM_NEWLINK and polled only as a slow fallback
+#"auto" does so only if every switch port has a data channel of its own,
+#ports sharing a data channel (e.g. eth1 below) have no carrier of their own
+#"0" always polls
+get_linkstatus_event(){
+	local sw_name=$1
+
+	case "$sw_name" in
+	sw1)
+		echo "auto"
+		;;
+	*)
+		echo "auto"
+		;;
+	esac
+}
+
 get_private_header_type(){
 	local sw_name=$1
 
@@ -1173,6 +1173,9 @@ static void lacpd_debug_init(void)
 int main(int argc, char **argv)
 {
 	qca_switch_probe();
+#ifdef LACPD_SIM_SWITCH
+	sim_switch_probe();
+#endif
 	genl_dev_linux_probe();
 	lacpd_uci_cfg_probe();
 	lacpd_ubus_status_system_probe();
@@ -36,6 +36,9 @@
 #include <linux/rtnetlink.h>
 #include <linux/debugfs.h>
 #include <linux/completion.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/log2.h>
 
 #include <crypto/aes.h>
 #include <crypto/des.h>
@@ -74,6 +77,41 @@ static int free_timeout = NSS_CRYPTOAPI_TIMEOUT;
 module_param(free_timeout, int, 0644);
 MODULE_PARM_DESC(free_timeout, "Timeout (msecs) for delayed session free; due to outstanding requests");
 
+static uint batch_size = 1;
+module_param(batch_size, uint, 0644);
+MODULE_PARM_DESC(batch_size, "Requests staged per context before submission; 1 disables batching (max 16)");
+
+static uint batch_timeout = 50;
+module_param(batch_timeout, uint, 0644);
+MODULE_PARM_DESC(batch_timeout, "Maximum time (usecs) a request stays staged before the batch is submitted");
+
+static uint done_budget;
+module_param(done_budget, uint, 0644);
+MODULE_PARM_DESC(done_budget, "Completions processed per deferred pass; 0 completes each request inline");
+
+/*
+ * Deferred completion
+ */
+struct nss_cryptoapi_done_entry {
+	struct crypto_async_request *areq;	/* Completed request */
+	struct nss_crypto_hdr *ch;		/* Crypto hdr returned by NSS */
+	nss_cryptoapi_finish_method_t finish;	/* Per algorithm type completion work; NULL if failed to submit */
+	int error;				/* Result of finish, or submit error */
+	uint8_t status;				/* NSS response status */
+};
+
+/*
+ * Per CPU ring of deferred completions
+ */
+struct nss_cryptoapi_done_queue {
+	struct tasklet_struct tasklet;		/* Completion pass */
+	uint32_t head;				/* Producer index */
+	uint32_t tail;				/* Consumer index */
+	struct nss_cryptoapi_done_entry ring[NSS_CRYPTOAPI_DONE_RING];
+};
+
+static DEFINE_PER_CPU(struct nss_cryptoapi_done_queue, nss_cryptoapi_done_queue);
+
 struct nss_cryptoapi_algo_info g_algo_info[] = {
 	/*
 	 * Aynsc Block ciphers
@@ -1933,6 +1971,336 @@ int nss_cryptoapi_status2error(struct nss_cryptoapi_ctx *ctx, uint8_t status)
 	}
 }
 
+/*
+ * nss_cryptoapi_ref_sub()
+ *	Drop multiple cryptoapi context references at once
+ */
+static inline void nss_cryptoapi_ref_sub(struct nss_cryptoapi_ctx *ctx, uint32_t count)
+{
+	BUG_ON(atomic_read(&ctx->refcnt) < count);
+	if (atomic_sub_and_test(count, &ctx->refcnt)) {
+		complete(&ctx->complete);
+	}
+}
+
+/*
+ * nss_cryptoapi_done_run()
+ *	Complete a run of deferred requests belonging to the same context
+ *
+ * Context references for the whole run are released together before
+ * the requests are handed back, same order as the inline path.
+ */
+static void nss_cryptoapi_done_run(struct nss_cryptoapi_done_queue *dq, struct nss_cryptoapi_ctx *ctx,
+					uint32_t start, uint32_t end)
+{
+	struct nss_cryptoapi_done_entry *entry;
+
+	ctx->stats.coalesced += end - start;
+	nss_cryptoapi_ref_sub(ctx, end - start);
+
+	for (; start != end; start++) {
+		entry = &dq->ring[start & (NSS_CRYPTOAPI_DONE_RING - 1)];
+		entry->areq->complete(entry->areq, entry->error);
+	}
+}
+
+/*
+ * nss_cryptoapi_done_poll()
+ *	Process up to budget deferred completions of this CPU
+ */
+static void nss_cryptoapi_done_poll(unsigned long data)
+{
+	struct nss_cryptoapi_done_queue *dq = (struct nss_cryptoapi_done_queue *)data;
+	uint32_t budget = done_budget ? done_budget : NSS_CRYPTOAPI_DONE_RING;
+	struct nss_cryptoapi_ctx *run_ctx = NULL;
+	struct nss_cryptoapi_done_entry *entry;
+	struct nss_cryptoapi_ctx *ctx;
+	uint32_t start, end, cur;
+
+	start = dq->tail;
+	end = dq->head;
+	if ((end - start) > budget)
+		end = start + budget;
+
+	for (cur = start; cur != end; cur++) {
+		entry = &dq->ring[cur & (NSS_CRYPTOAPI_DONE_RING - 1)];
+		ctx = crypto_tfm_ctx(entry->areq->tfm);
+
+		if (ctx != run_ctx) {
+			if (run_ctx)
+				nss_cryptoapi_done_run(dq, run_ctx, start, cur);
+
+			run_ctx = ctx;
+			start = cur;
+		}
+
+		if (entry->finish)
+			entry->error = entry->finish(ctx, entry->areq, entry->ch, entry->status);
+	}
+
+	if (run_ctx)
+		nss_cryptoapi_done_run(dq, run_ctx, start, end);
+
+	dq->tail = end;
+
+	/*
+	 * Budget exhausted; come back for the rest
+	 */
+	if (dq->head != dq->tail)
+		tasklet_schedule(&dq->tasklet);
+}
+
+/*
+ * nss_cryptoapi_done()
+ *	Complete a request returned by NSS
+ *
+ * With a non zero done_budget completions arriving in softirq are queued
+ * on a per CPU ring and processed together by nss_cryptoapi_done_poll();
+ * otherwise the request is completed right away.
+ */
+void nss_cryptoapi_done(struct nss_cryptoapi_ctx *ctx, struct crypto_async_request *areq,
+			struct nss_crypto_hdr *ch, uint8_t status, nss_cryptoapi_finish_method_t finish)
+{
+	struct nss_cryptoapi_done_queue *dq;
+	struct nss_cryptoapi_done_entry *entry;
+	int error;
+
+	if (done_budget && in_serving_softirq()) {
+		dq = this_cpu_ptr(&nss_cryptoapi_done_queue);
+
+		/*
+		 * Ring full; drain it here to keep the completion order
+		 */
+		if ((dq->head - dq->tail) >= NSS_CRYPTOAPI_DONE_RING)
+			nss_cryptoapi_done_poll((unsigned long)dq);
+
+		entry = &dq->ring[dq->head & (NSS_CRYPTOAPI_DONE_RING - 1)];
+		entry->areq = areq;
+		entry->ch = ch;
+		entry->finish = finish;
+		entry->status = status;
+		dq->head++;
+
+		tasklet_schedule(&dq->tasklet);
+		return;
+	}
+
+	error = finish(ctx, areq, ch, status);
+
+	/*
+	 * Decrement cryptoapi reference
+	 */
+	nss_cryptoapi_ref_dec(ctx);
+	areq->complete(areq, error);
+}
+
+/*
+ * nss_cryptoapi_done_error()
+ *	Fail a request that was accepted with -EINPROGRESS but could not be submitted
+ *
+ * The request is completed from the deferred completion pass, never from
+ * the context that submitted the batch it was staged in.
+ */
+static void nss_cryptoapi_done_error(struct crypto_async_request *areq, int error)
+{
+	struct nss_cryptoapi_done_queue *dq;
+	struct nss_cryptoapi_done_entry *entry;
+
+	local_bh_disable();
+	dq = this_cpu_ptr(&nss_cryptoapi_done_queue);
+
+	/*
+	 * Ring full; make room by completing older NSS responses
+	 */
+	if ((dq->head - dq->tail) >= NSS_CRYPTOAPI_DONE_RING)
+		nss_cryptoapi_done_poll((unsigned long)dq);
+
+	entry = &dq->ring[dq->head & (NSS_CRYPTOAPI_DONE_RING - 1)];
+	entry->areq = areq;
+	entry->ch = NULL;
+	entry->finish = NULL;
+	entry->error = error;
+	entry->status = 0;
+	dq->head++;
+
+	tasklet_schedule(&dq->tasklet);
+	local_bh_enable();
+}
+
+/*
+ * nss_cryptoapi_batch_detach()
+ *	Move the staged entries out of the batch; called with batch lock held
+ */
+static uint16_t nss_cryptoapi_batch_detach(struct nss_cryptoapi_batch *batch, struct nss_cryptoapi_batch_entry *entry)
+{
+	uint16_t count = batch->count;
+
+	memcpy(entry, batch->entry, count * sizeof(*entry));
+	batch->count = 0;
+	hrtimer_try_to_cancel(&batch->timer);
+	return count;
+}
+
+/*
+ * nss_cryptoapi_batch_submit()
+ *	Hand a batch of prepared requests to NSS back to back
+ */
+static void nss_cryptoapi_batch_submit(struct nss_cryptoapi_ctx *ctx, struct nss_cryptoapi_batch_entry *entry,
+					uint16_t count)
+{
+	struct crypto_async_request *areq;
+	int error;
+	int i;
+
+	if (!count)
+		return;
+
+	ctx->stats.batch_hist[min_t(uint16_t, ilog2(count), NSS_CRYPTOAPI_BATCH_HIST - 1)]++;
+
+	for (i = 0; i < count; i++, entry++) {
+		error = nss_crypto_transform_payload(ctx->user, entry->ch, entry->cb, entry->app_data);
+		if (likely(error >= 0)) {
+			ctx->stats.queued++;
+			continue;
+		}
+
+		/*
+		 * The caller already got -EINPROGRESS; report the failure
+		 * through the deferred completion callback. The context
+		 * reference is released there.
+		 */
+		areq = entry->app_data;
+		nss_crypto_hdr_free(ctx->user, entry->ch);
+		ctx->stats.failed_queue++;
+		nss_cryptoapi_done_error(areq, error);
+	}
+}
+
+/*
+ * nss_cryptoapi_batch_timeout()
+ *	Submit a partially filled batch once its time bound expires
+ */
+static enum hrtimer_restart nss_cryptoapi_batch_timeout(struct hrtimer *timer)
+{
+	struct nss_cryptoapi_batch *batch = container_of(timer, struct nss_cryptoapi_batch, timer);
+	struct nss_cryptoapi_ctx *ctx = container_of(batch, struct nss_cryptoapi_ctx, batch);
+	struct nss_cryptoapi_batch_entry entry[NSS_CRYPTOAPI_BATCH_MAX];
+	uint16_t count;
+
+	spin_lock_bh(&batch->lock);
+	count = nss_cryptoapi_batch_detach(batch, entry);
+	spin_unlock_bh(&batch->lock);
+
+	if (count) {
+		ctx->stats.batch_timeout++;
+		nss_cryptoapi_batch_submit(ctx, entry, count);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * nss_cryptoapi_batch_add()
+ *	Stage a prepared request; submit the batch once it is full
+ *
+ * Returns false if the request could not be staged and must be
+ * submitted by the caller.
+ */
+static bool nss_cryptoapi_batch_add(struct nss_cryptoapi_ctx *ctx, struct nss_crypto_hdr *ch,
+					nss_crypto_req_callback_t cb, void *app_data)
+{
+	struct nss_cryptoapi_batch_entry entry[NSS_CRYPTOAPI_BATCH_MAX];
+	struct nss_cryptoapi_batch *batch = &ctx->batch;
+	uint16_t size = min_t(uint32_t, batch_size, NSS_CRYPTOAPI_BATCH_MAX);
+	struct nss_cryptoapi_batch_entry *staged;
+	uint16_t count;
+
+	spin_lock_bh(&batch->lock);
+	if (unlikely(batch->closed)) {
+		spin_unlock_bh(&batch->lock);
+		return false;
+	}
+
+	staged = &batch->entry[batch->count++];
+	staged->ch = ch;
+	staged->cb = cb;
+	staged->app_data = app_data;
+
+	if (batch->count < size) {
+		/*
+		 * First request of a new batch starts the time bound
+		 */
+		if (batch->count == 1)
+			hrtimer_start(&batch->timer, ns_to_ktime((u64)batch_timeout * NSEC_PER_USEC), HRTIMER_MODE_REL_SOFT);
+
+		spin_unlock_bh(&batch->lock);
+		return true;
+	}
+
+	count = nss_cryptoapi_batch_detach(batch, entry);
+	spin_unlock_bh(&batch->lock);
+
+	ctx->stats.batch_full++;
+	nss_cryptoapi_batch_submit(ctx, entry, count);
+	return true;
+}
+
+/*
+ * nss_cryptoapi_batch_init()
+ *	Initialize the submission batch of a context
+ */
+void nss_cryptoapi_batch_init(struct nss_cryptoapi_ctx *ctx)
+{
+	struct nss_cryptoapi_batch *batch = &ctx->batch;
+
+	spin_lock_init(&batch->lock);
+	hrtimer_init(&batch->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	batch->timer.function = nss_cryptoapi_batch_timeout;
+}
+
+/*
+ * nss_cryptoapi_batch_flush()
+ *	Submit any staged request; used before the session is changed
+ */
+void nss_cryptoapi_batch_flush(struct nss_cryptoapi_ctx *ctx)
+{
+	struct nss_cryptoapi_batch_entry entry[NSS_CRYPTOAPI_BATCH_MAX];
+	struct nss_cryptoapi_batch *batch = &ctx->batch;
+	uint16_t count;
+
+	spin_lock_bh(&batch->lock);
+	count = nss_cryptoapi_batch_detach(batch, entry);
+	spin_unlock_bh(&batch->lock);
+
+	if (count) {
+		ctx->stats.batch_flush++;
+		nss_cryptoapi_batch_submit(ctx, entry, count);
+	}
+}
+
+/*
+ * nss_cryptoapi_batch_deinit()
+ *	Submit staged requests and stop batching for a context going away
+ */
+void nss_cryptoapi_batch_deinit(struct nss_cryptoapi_ctx *ctx)
+{
+	struct nss_cryptoapi_batch_entry entry[NSS_CRYPTOAPI_BATCH_MAX];
+	struct nss_cryptoapi_batch *batch = &ctx->batch;
+	uint16_t count;
+
+	spin_lock_bh(&batch->lock);
+	batch->closed = true;
+	count = nss_cryptoapi_batch_detach(batch, entry);
+	spin_unlock_bh(&batch->lock);
+
+	hrtimer_cancel(&batch->timer);
+
+	if (count) {
+		ctx->stats.batch_flush++;
+		nss_cryptoapi_batch_submit(ctx, entry, count);
+	}
+}
+
 /*
  * nss_cryptoapi_transform()
  * 	Transform routine for encryption and decryption operations.
@@ -1944,6 +2312,20 @@ int nss_cryptoapi_transform(struct nss_cryptoapi_ctx *ctx, struct nss_cryptoapi_
 	uint8_t *iv_addr;
 	int error;
 
+	/*
+	 * Session still being created in the background; the request is
+	 * held and replayed once it is ready
+	 */
+	if (unlikely(ctx->sid == NSS_CRYPTO_SESSION_MAX) && ctx->sess) {
+		error = nss_cryptoapi_session_hold(ctx, info, app_data);
+		if (error) {
+			if (error != -EINPROGRESS)
+				nss_cryptoapi_ref_dec(ctx);
+
+			return error;
+		}
+	}
+
 	/*
 	 * Allocate crypto hdr
 	 */
@@ -2033,6 +2415,13 @@ int nss_cryptoapi_transform(struct nss_cryptoapi_ctx *ctx, struct nss_cryptoapi_
 	}
 
 skip_iv:
+	/*
+	 * With batching enabled the request is staged and submitted together
+	 * with the rest of the batch once it fills up or the timer expires
+	 */
+	if (!ahash && (batch_size > 1) && nss_cryptoapi_batch_add(ctx, ch, info->cb, app_data))
+		return -EINPROGRESS;
+
 	/*
 	 * Send the buffer to CORE layer for processing
 	 */
@@ -2062,6 +2451,7 @@ ssize_t nss_cryptoapi_ctx_stats_read(struct file *fp, char __user *ubuf, size_t
 	ssize_t max_buf_len;
 	ssize_t len;
 	ssize_t ret;
+	int lo, hi;
 	int i;
 	char *buf;
 
@@ -2070,6 +2460,7 @@ ssize_t nss_cryptoapi_ctx_stats_read(struct file *fp, char __user *ubuf, size_t
 	 */
 	max_buf_len = NSS_CRYPTOAPI_DEBUGFS_MAX_STATS_ENTRY * NSS_CRYPTOAPI_DEBUGFS_MAX_NAME * 2;
 	max_buf_len += (ARRAY_SIZE(stats->error) * NSS_CRYPTOAPI_DEBUGFS_MAX_NAME * 2);
+	max_buf_len += (ARRAY_SIZE(stats->batch_hist) * NSS_CRYPTOAPI_DEBUGFS_MAX_NAME * 2);
 
 	buf = vzalloc(max_buf_len);
 	if (!buf)
@@ -2090,6 +2481,24 @@ ssize_t nss_cryptoapi_ctx_stats_read(struct file *fp, char __user *ubuf, size_t
 	len += snprintf(buf + len, max_buf_len - len, "failed_req - %llu\n", stats->failed_req);
 	len += snprintf(buf + len, max_buf_len - len, "failed_align - %llu\n", stats->failed_align);
 	len += snprintf(buf + len, max_buf_len - len, "failed_len - %llu\n", stats->failed_len);
+	len += snprintf(buf + len, max_buf_len - len, "batch_full - %llu\n", stats->batch_full);
+	len += snprintf(buf + len, max_buf_len - len, "batch_timeout - %llu\n", stats->batch_timeout);
+	len += snprintf(buf + len, max_buf_len - len, "batch_flush - %llu\n", stats->batch_flush);
+	len += snprintf(buf + len, max_buf_len - len, "coalesced - %llu\n", stats->coalesced);
+	len += snprintf(buf + len, max_buf_len - len, "session_held - %llu\n", stats->session_held);
+
+	/*
+	 * Batch occupancy in log2 buckets; the last bucket holds full batches
+	 */
+	for (i = 0; i < ARRAY_SIZE(stats->batch_hist); i++) {
+		lo = 1 << i;
+		hi = (i == ARRAY_SIZE(stats->batch_hist) - 1) ? NSS_CRYPTOAPI_BATCH_MAX : (2 << i) - 1;
+
+		if (lo == hi)
+			len += snprintf(buf + len, max_buf_len - len, "batch_occ(%d) - %llu\n", lo, stats->batch_hist[i]);
+		else
+			len += snprintf(buf + len, max_buf_len - len, "batch_occ(%d-%d) - %llu\n", lo, hi, stats->batch_hist[i]);
+	}
 
 	/*
 	 * This will autoexpand as crypto adds new error codes
@@ -2129,6 +2538,8 @@ ssize_t nss_cryptoapi_ctx_info_read(struct file *fp, char __user *ubuf, size_t s
 	len += snprintf(buf + len, max_buf_len - len, "digest_size - %d\n", ctx->info->digest_sz);
 	len += snprintf(buf + len, max_buf_len - len, "auth_block_size - %d\n", ctx->info->auth_blocksize);
 	len += snprintf(buf + len, max_buf_len - len, "fallback_req - %d\n", ctx->fallback_req);
+	if (ctx->sess)
+		len += snprintf(buf + len, max_buf_len - len, "session_users - %u\n", kref_read(&ctx->sess->ref));
 
 	ret = simple_read_from_buffer(ubuf, sz, ppos, buf, len);
 	vfree(buf);
@@ -2167,7 +2578,14 @@ void nss_cryptoapi_add_ctx2debugfs(struct nss_cryptoapi_ctx *ctx)
 		return;
 	}
 
-	snprintf(buf, sizeof(buf), "ctx%d", ctx->sid);
+	/*
+	 * Contexts sharing a session get a suffix after the first one
+	 */
+	if (ctx->share)
+		snprintf(buf, sizeof(buf), "ctx%d.%u", ctx->sid, ctx->share);
+	else
+		snprintf(buf, sizeof(buf), "ctx%d", ctx->sid);
+
 	ctx->dentry = debugfs_create_dir(buf, g_cryptoapi.root);
 	if (!ctx->dentry) {
 		nss_cfi_err("%px: Unable to create context debugfs entry", ctx);
@@ -2318,8 +2736,16 @@ EXPORT_SYMBOL(nss_cryptoapi_is_registered);
  */
 int nss_cryptoapi_init(void)
 {
+	struct nss_cryptoapi_done_queue *dq;
+	int cpu;
+
 	nss_cfi_info("module loaded %s\n", NSS_CFI_BUILD_ID);
 
+	for_each_possible_cpu(cpu) {
+		dq = per_cpu_ptr(&nss_cryptoapi_done_queue, cpu);
+		tasklet_init(&dq->tasklet, nss_cryptoapi_done_poll, (unsigned long)dq);
+	}
+
 	/*
 	 * Create debugfs root directory for cryptoapi.
 	 */
@@ -2332,9 +2758,16 @@ int nss_cryptoapi_init(void)
 
 	atomic_set(&g_cryptoapi.registered, 0);
 
+	if (nss_cryptoapi_session_init(g_cryptoapi.root)) {
+		nss_cfi_err("%px: Failed to initialize session cache\n", &g_cryptoapi);
+		debugfs_remove_recursive(g_cryptoapi.root);
+		return -ENOMEM;
+	}
+
 	g_cryptoapi.user = nss_crypto_register_user(&g_cryptoapi.ctx, &g_cryptoapi);
 	if (!g_cryptoapi.user) {
 		nss_cfi_err("%px: Failed to register nss_cryptoapi\n", &g_cryptoapi);
+		nss_cryptoapi_session_deinit();
 		debugfs_remove_recursive(g_cryptoapi.root);
 		return -ENODEV;
 	}
@@ -2348,9 +2781,16 @@ int nss_cryptoapi_init(void)
  */
 void nss_cryptoapi_exit(void)
 {
+	int cpu;
+
 	if (g_cryptoapi.user)
 		nss_crypto_unregister_user(g_cryptoapi.user);
 
+	for_each_possible_cpu(cpu)
+		tasklet_kill(&per_cpu_ptr(&nss_cryptoapi_done_queue, cpu)->tasklet);
+
+	nss_cryptoapi_session_deinit();
+
 	/*
 	 * Cleanup cryptoapi debugfs.
 	 */
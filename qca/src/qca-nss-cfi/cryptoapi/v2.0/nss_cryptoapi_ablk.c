@@ -34,6 +34,7 @@
 #include <linux/crypto.h>
 #include <linux/debugfs.h>
 #include <linux/completion.h>
+#include <linux/hrtimer.h>
 
 #include <crypto/aes.h>
 #include <crypto/des.h>
@@ -66,6 +67,7 @@ int nss_cryptoapi_skcipher_ctx2session(struct crypto_skcipher *sk, uint32_t *sid
 	struct crypto_ablkcipher **actx, *ablk;
 	struct ablkcipher_tfm *ablk_tfm;
 	struct nss_cryptoapi_ctx *ctx;
+	int error;
 
 	if (strncmp("nss-", crypto_tfm_alg_driver_name(tfm), 4))
 		return -EINVAL;
@@ -94,6 +96,13 @@ int nss_cryptoapi_skcipher_ctx2session(struct crypto_skcipher *sk, uint32_t *sid
 	BUG_ON(!ctx);
 	NSS_CRYPTOAPI_VERIFY_MAGIC(ctx);
 
+	/*
+	 * The session may still be created in the background
+	 */
+	error = nss_cryptoapi_session_sync(ctx);
+	if (error)
+		return error;
+
 	*sid = ctx->sid;
 	return 0;
 }
@@ -116,6 +125,7 @@ int nss_cryptoapi_ablkcipher_init(struct crypto_tfm *tfm)
 	ctx->stats.init++;
 	ctx->sid = NSS_CRYPTO_SESSION_MAX;
 	init_completion(&ctx->complete);
+	nss_cryptoapi_batch_init(ctx);
 
 	return 0;
 }
@@ -132,6 +142,11 @@ void nss_cryptoapi_ablkcipher_exit(struct crypto_tfm *tfm)
 	BUG_ON(!ctx);
 	NSS_CRYPTOAPI_VERIFY_MAGIC(ctx);
 
+	/*
+	 * Push out anything still staged for submission
+	 */
+	nss_cryptoapi_batch_deinit(ctx);
+
 	ctx->stats.exit++;
 
 	/*
@@ -163,11 +178,7 @@ void nss_cryptoapi_ablkcipher_exit(struct crypto_tfm *tfm)
 		WARN_ON(!ret);
 	}
 
-	if (ctx->sid != NSS_CRYPTO_SESSION_MAX) {
-		nss_crypto_session_free(ctx->user, ctx->sid);
-		debugfs_remove_recursive(ctx->dentry);
-		ctx->sid = NSS_CRYPTO_SESSION_MAX;
-	}
+	nss_cryptoapi_session_put(ctx);
 
 	NSS_CRYPTOAPI_CLEAR_MAGIC(ctx);
 }
@@ -212,41 +223,31 @@ int nss_cryptoapi_ablk_setkey(struct crypto_ablkcipher *cipher, const u8 *key, u
 	if (data.algo >= NSS_CRYPTO_CMN_ALGO_MAX)
 		return -ERANGE;
 
-	if (ctx->sid != NSS_CRYPTO_SESSION_MAX) {
-		nss_crypto_session_free(ctx->user, ctx->sid);
-		debugfs_remove_recursive(ctx->dentry);
-		ctx->sid = NSS_CRYPTO_SESSION_MAX;
+	if (ctx->sess) {
+		nss_cryptoapi_batch_flush(ctx);
+		nss_cryptoapi_session_put(ctx);
 	}
 
-	status = nss_crypto_session_alloc(ctx->user, &data, &ctx->sid);
+	status = nss_cryptoapi_session_get(ctx, &data);
 	if (status < 0) {
 		nss_cfi_err("%px: Unable to allocate crypto session(%d)\n", ctx, status);
 		crypto_ablkcipher_set_flags(cipher, CRYPTO_TFM_RES_BAD_FLAGS);
 		return status;
 	}
 
-	nss_cryptoapi_add_ctx2debugfs(ctx);
 	atomic_set(&ctx->active, 1);
 	atomic_set(&ctx->refcnt, 1);
 	return 0;
 }
 
 /*
- * nss_cryptoapi_ablkcipher_done()
- * 	Cipher operation completion callback function
+ * nss_cryptoapi_ablkcipher_finish()
+ *	Per request cipher completion work
  */
-void nss_cryptoapi_ablkcipher_done(void *app_data, struct nss_crypto_hdr *ch, uint8_t status)
+static int nss_cryptoapi_ablkcipher_finish(struct nss_cryptoapi_ctx *ctx, struct crypto_async_request *areq,
+						struct nss_crypto_hdr *ch, uint8_t status)
 {
-	struct ablkcipher_request *req = app_data;
-	struct nss_cryptoapi_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	int error;
-
-	BUG_ON(!ch);
-
-	/*
-	 * Check cryptoapi context magic number.
-	 */
-	NSS_CRYPTOAPI_VERIFY_MAGIC(ctx);
+	struct ablkcipher_request *req = ablkcipher_request_cast(areq);
 
 	/*
 	 * For skcipher decryption case, the last block of encrypted data is used as
@@ -267,14 +268,26 @@ void nss_cryptoapi_ablkcipher_done(void *app_data, struct nss_crypto_hdr *ch, ui
 	/*
 	 * Check if there is any error reported by hardware
 	 */
-	error = nss_cryptoapi_status2error(ctx, status);
 	ctx->stats.completed++;
+	return nss_cryptoapi_status2error(ctx, status);
+}
+
+/*
+ * nss_cryptoapi_ablkcipher_done()
+ * 	Cipher operation completion callback function
+ */
+void nss_cryptoapi_ablkcipher_done(void *app_data, struct nss_crypto_hdr *ch, uint8_t status)
+{
+	struct ablkcipher_request *req = app_data;
+	struct nss_cryptoapi_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+
+	BUG_ON(!ch);
 
 	/*
-	 * Decrement cryptoapi reference
+	 * Check cryptoapi context magic number.
 	 */
-	nss_cryptoapi_ref_dec(ctx);
-	req->base.complete(&req->base, error);
+	NSS_CRYPTOAPI_VERIFY_MAGIC(ctx);
+	nss_cryptoapi_done(ctx, &req->base, ch, status, nss_cryptoapi_ablkcipher_finish);
 }
 
 /*
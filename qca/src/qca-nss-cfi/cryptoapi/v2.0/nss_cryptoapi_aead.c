@@ -36,6 +36,7 @@
 #include <linux/rtnetlink.h>
 #include <linux/debugfs.h>
 #include <linux/completion.h>
+#include <linux/hrtimer.h>
 
 #include <crypto/aes.h>
 #include <crypto/des.h>
@@ -64,13 +65,21 @@ int nss_cryptoapi_aead_ctx2session(struct crypto_aead *aead, uint32_t *sid)
 {
 	struct crypto_tfm *tfm = crypto_aead_tfm(aead);
 	struct nss_cryptoapi_ctx *ctx = crypto_aead_ctx(aead);
+	int error;
 
 	if (strncmp("nss-", crypto_tfm_alg_driver_name(tfm), 4))
 		return -EINVAL;
 
 	ctx = crypto_aead_ctx(aead);
-	*sid = ctx->sid;
 
+	/*
+	 * The session may still be created in the background
+	 */
+	error = nss_cryptoapi_session_sync(ctx);
+	if (error)
+		return error;
+
+	*sid = ctx->sid;
 	return 0;
 }
 EXPORT_SYMBOL(nss_cryptoapi_aead_ctx2session);
@@ -95,6 +104,7 @@ int nss_cryptoapi_aead_init(struct crypto_aead *aead)
 	ctx->stats.init++;
 	ctx->sid = NSS_CRYPTO_SESSION_MAX;
 	init_completion(&ctx->complete);
+	nss_cryptoapi_batch_init(ctx);
 
 	need_fallback = crypto_tfm_alg_flags(tfm) & CRYPTO_ALG_NEED_FALLBACK;
 	if (!need_fallback)
@@ -131,6 +141,11 @@ void nss_cryptoapi_aead_exit(struct crypto_aead *aead)
 
 	BUG_ON(!ctx);
 
+	/*
+	 * Push out anything still staged for submission
+	 */
+	nss_cryptoapi_batch_deinit(ctx);
+
 	if (ctx->sw_tfm) {
 		crypto_free_aead(__crypto_aead_cast(ctx->sw_tfm));
 		ctx->sw_tfm = NULL;
@@ -167,11 +182,7 @@ void nss_cryptoapi_aead_exit(struct crypto_aead *aead)
 		WARN_ON(!ret);
 	}
 
-	if (ctx->sid != NSS_CRYPTO_SESSION_MAX) {
-		nss_crypto_session_free(ctx->user, ctx->sid);
-		debugfs_remove_recursive(ctx->dentry);
-		ctx->sid = NSS_CRYPTO_SESSION_MAX;
-	}
+	nss_cryptoapi_session_put(ctx);
 
 	NSS_CRYPTOAPI_CLEAR_MAGIC(ctx);
 }
@@ -204,10 +215,9 @@ int nss_cryptoapi_aead_setkey_noauth(struct crypto_aead *aead, const u8 *key, un
 	if (ctx->info->algo >= NSS_CRYPTO_CMN_ALGO_MAX)
 		return -ERANGE;
 
-	if (ctx->sid != NSS_CRYPTO_SESSION_MAX) {
-		nss_crypto_session_free(ctx->user, ctx->sid);
-		ctx->sid = NSS_CRYPTO_SESSION_MAX;
-		debugfs_remove_recursive(ctx->dentry);
+	if (ctx->sess) {
+		nss_cryptoapi_batch_flush(ctx);
+		nss_cryptoapi_session_put(ctx);
 	}
 
 	nonce_sz = ctx->info->nonce;
@@ -226,14 +236,13 @@ int nss_cryptoapi_aead_setkey_noauth(struct crypto_aead *aead, const u8 *key, un
 	data.sec_key = false;
 	data.nonce = nonce;
 
-	status = nss_crypto_session_alloc(ctx->user, &data, &ctx->sid);
+	status = nss_cryptoapi_session_get(ctx, &data);
 	if (status < 0) {
 		nss_cfi_err("%px: Unable to allocate crypto session(%d)\n", ctx, status);
 		crypto_aead_set_flags(aead, CRYPTO_TFM_RES_BAD_FLAGS);
 		return status;
 	}
 
-	nss_cryptoapi_add_ctx2debugfs(ctx);
 	atomic_set(&ctx->active, 1);
 	atomic_set(&ctx->refcnt, 1);
 	return 0;
@@ -323,20 +332,18 @@ int nss_cryptoapi_aead_setkey(struct crypto_aead *aead, const u8 *key, unsigned
 	data.auth_keylen = keys.authkeylen;
 	data.sec_key = false;
 
-	if (ctx->sid != NSS_CRYPTO_SESSION_MAX) {
-		nss_crypto_session_free(ctx->user, ctx->sid);
-		debugfs_remove_recursive(ctx->dentry);
-		ctx->sid = NSS_CRYPTO_SESSION_MAX;
+	if (ctx->sess) {
+		nss_cryptoapi_batch_flush(ctx);
+		nss_cryptoapi_session_put(ctx);
 	}
 
-	status = nss_crypto_session_alloc(ctx->user, &data, &ctx->sid);
+	status = nss_cryptoapi_session_get(ctx, &data);
 	if (status < 0) {
 		nss_cfi_err("%px: Unable to allocate crypto session(%d)\n", ctx, status);
 		crypto_aead_set_flags(aead, CRYPTO_TFM_RES_BAD_FLAGS);
 		return status;
 	}
 
-	nss_cryptoapi_add_ctx2debugfs(ctx);
 	atomic_set(&ctx->active, 1);
 	atomic_set(&ctx->refcnt, 1);
 	return 0;
@@ -359,6 +366,27 @@ int nss_cryptoapi_aead_setauthsize(struct crypto_aead *authenc, unsigned int aut
 	return 0;
 }
 
+/*
+ * nss_cryptoapi_aead_finish()
+ *	Per request AEAD completion work
+ */
+static int nss_cryptoapi_aead_finish(struct nss_cryptoapi_ctx *ctx, struct crypto_async_request *areq,
+					struct nss_crypto_hdr *ch, uint8_t status)
+{
+	struct aead_request *req = aead_request_cast(areq);
+
+	nss_crypto_hdr_free(ctx->user, ch);
+
+	nss_cfi_dbg("data dump after transformation\n");
+	nss_cfi_dbg_data(sg_virt(req->dst), req->cryptlen, ' ');
+
+	/*
+	 * Check if there is any error reported by hardware
+	 */
+	ctx->stats.completed++;
+	return nss_cryptoapi_status2error(ctx, status);
+}
+
 /*
  * nss_cryptoapi_aead_done()
  * 	Cipher/Auth encrypt request completion callback function
@@ -368,7 +396,6 @@ void nss_cryptoapi_aead_done(void *app_data, struct nss_crypto_hdr *ch, uint8_t
 	struct aead_request *req = (struct aead_request *)app_data;
 	struct crypto_aead *aead = crypto_aead_reqtfm(req);
 	struct nss_cryptoapi_ctx *ctx = crypto_aead_ctx(aead);
-	int error;
 
 	BUG_ON(!ch);
 
@@ -376,22 +403,7 @@ void nss_cryptoapi_aead_done(void *app_data, struct nss_crypto_hdr *ch, uint8_t
 	 * check cryptoapi context magic number.
 	 */
 	NSS_CRYPTOAPI_VERIFY_MAGIC(ctx);
-	nss_crypto_hdr_free(ctx->user, ch);
-
-	nss_cfi_dbg("data dump after transformation\n");
-	nss_cfi_dbg_data(sg_virt(req->dst), req->nbytes, ' ');
-
-	/*
-	 * Check if there is any error reported by hardware
-	 */
-	error = nss_cryptoapi_status2error(ctx, status);
-	ctx->stats.completed++;
-
-	/*
-	 * Decrement cryptoapi reference
-	 */
-	nss_cryptoapi_ref_dec(ctx);
-	aead_request_complete(req, error);
+	nss_cryptoapi_done(ctx, &req->base, ch, status, nss_cryptoapi_aead_finish);
 }
 
 /*
@@ -35,6 +35,7 @@
 #include <linux/crypto.h>
 #include <linux/debugfs.h>
 #include <linux/completion.h>
+#include <linux/hrtimer.h>
 
 #include <crypto/aes.h>
 #include <crypto/des.h>
@@ -26,8 +26,8 @@
  */
 
 #define NSS_CRYPTOAPI_DEBUGFS_MAX_NAME 64
-#define NSS_CRYPTOAPI_DEBUGFS_MAX_CTX_ENTRY 5
-#define NSS_CRYPTOAPI_DEBUGFS_MAX_STATS_ENTRY 11
+#define NSS_CRYPTOAPI_DEBUGFS_MAX_CTX_ENTRY 8
+#define NSS_CRYPTOAPI_DEBUGFS_MAX_STATS_ENTRY 17
 #define NSS_CRYPTOAPI_MAGIC 0x7FED
 #define NSS_CRYPTOAPI_AHASH_MAGIC 0x7FEF
 #define NSS_CRYPTOAPI_HDR_POOL_SZ 1024
@@ -35,6 +35,9 @@
 #define NSS_CRYPTOAPI_TIMEOUT 100 /* msecs */
 #define NSS_CRYPTOAPI_MAX_IV (AES_BLOCK_SIZE/sizeof(uint32_t))
 #define NSS_CRYPTOAPI_REQ_TIMEOUT_TICKS msecs_to_jiffies(NSS_CRYPTOAPI_REQ_TIMEO_SECS * MSEC_PER_SEC)
+#define NSS_CRYPTOAPI_BATCH_MAX 16		/* Maximum requests staged per context */
+#define NSS_CRYPTOAPI_BATCH_HIST 5		/* log2 buckets of batch occupancy */
+#define NSS_CRYPTOAPI_DONE_RING 256		/* Per CPU deferred completions; power of 2 */
 
 /*
  * Cipher mode
@@ -103,9 +106,69 @@ struct nss_cryptoapi_stats {
 	uint64_t failed_req;				/* Packets failing due incorrect request */
 	uint64_t failed_align;				/* Packets failing alignment checks */
 	uint64_t failed_len;				/* Packets failing Supported length checks */
+	uint64_t batch_full;				/* Batches submitted on reaching batch size */
+	uint64_t batch_timeout;				/* Batches submitted on timer expiry */
+	uint64_t batch_flush;				/* Batches submitted on setkey or exit */
+	uint64_t coalesced;				/* Packets completed through the deferred pass */
+	uint64_t session_held;				/* Packets held until the session was created */
+	uint64_t batch_hist[NSS_CRYPTOAPI_BATCH_HIST];	/* Batch occupancy histogram */
 	uint64_t error[NSS_CRYPTO_CMN_RESP_ERROR_MAX];	/* Other packet response errors */
 };
 
+/*
+ * Session creation state
+ */
+enum nss_cryptoapi_session_state {
+	NSS_CRYPTOAPI_SESSION_PENDING = 0,	/* Being created in the background */
+	NSS_CRYPTOAPI_SESSION_READY,		/* Usable for transforms */
+	NSS_CRYPTOAPI_SESSION_FAILED,		/* Creation failed */
+};
+
+/*
+ * NSS crypto session shared by contexts with identical keys
+ */
+struct nss_cryptoapi_session {
+	struct hlist_node node;			/* Session cache node */
+	struct rcu_head rcu;			/* RCU free */
+	struct kref ref;			/* Contexts using the session */
+	struct work_struct work;		/* Background session creation */
+	struct list_head ctxs;			/* Contexts attached; protected by cache lock */
+	struct list_head pending;		/* Requests held until the session is ready */
+	spinlock_t lock;			/* Protects state and pending */
+	enum nss_cryptoapi_session_state state;	/* Creation state */
+	int error;				/* Creation error */
+	uint32_t npending;			/* Number of held requests */
+	uint32_t sid;				/* NSS session index */
+	uint32_t hash;				/* Hash of algorithm and keys */
+	uint32_t shares;			/* Contexts attached so far */
+	enum nss_crypto_cmn_algo algo;		/* NSS crypto algorithm ID */
+	uint16_t cipher_keylen;			/* Cipher key length */
+	uint16_t auth_keylen;			/* Authentication key length */
+	uint16_t nonce_len;			/* Nonce length */
+	bool sec_key;				/* Secure key */
+	uint8_t key[];				/* Cipher key, auth key and nonce */
+};
+
+/*
+ * Request staged for a batched submission
+ */
+struct nss_cryptoapi_batch_entry {
+	struct nss_crypto_hdr *ch;		/* Prepared crypto hdr */
+	nss_crypto_req_callback_t cb;		/* Completion callback */
+	void *app_data;				/* Crypto request */
+};
+
+/*
+ * Per context submission batch
+ */
+struct nss_cryptoapi_batch {
+	struct nss_cryptoapi_batch_entry entry[NSS_CRYPTOAPI_BATCH_MAX];
+	struct hrtimer timer;			/* Bounds the time a request stays staged */
+	spinlock_t lock;			/* Protects staged entries */
+	uint16_t count;				/* Number of staged entries */
+	bool closed;				/* Context going away; submit directly */
+};
+
 /*
  * CryptoAPI context
  */
@@ -117,6 +180,10 @@ struct nss_cryptoapi_ctx {
 	struct crypto_tfm *sw_tfm;		/* SW fallback context */
 
 	struct completion complete;		/* Completion object for outstanding packets */
+	struct nss_cryptoapi_batch batch;	/* Staged requests */
+	struct nss_cryptoapi_session *sess;	/* Shared session */
+	struct list_head sess_node;		/* Session context list node */
+	uint32_t share;				/* Index among the session users */
 
 	atomic_t active;			/* ctx status(active/inactive) */
 	atomic_t refcnt;			/* ctx refcnt */
@@ -159,6 +226,13 @@ struct nss_cryptoapi_info {
 	enum nss_crypto_op_dir op_dir;		/* Operation direction */
 };
 
+/*
+ * Per request completion work; returns the Linux errno for the request.
+ * The context reference is released by the caller.
+ */
+typedef int (*nss_cryptoapi_finish_method_t)(struct nss_cryptoapi_ctx *ctx, struct crypto_async_request *areq,
+		struct nss_crypto_hdr *ch, uint8_t status);
+
 typedef void (*nss_cryptoapi_aead_tx_proc_method_t)(struct nss_cryptoapi_ctx *ctx,
 		struct aead_request *req, struct nss_cryptoapi_info *info, bool encrypt);
 
@@ -225,6 +299,25 @@ extern void nss_cryptoapi_ref_dec(struct nss_cryptoapi_ctx *ctx);
 extern int nss_cryptoapi_status2error(struct nss_cryptoapi_ctx *ctx, uint8_t status);
 extern struct nss_cryptoapi_algo_info *nss_cryptoapi_cra_name2info(const char *cra_name, uint16_t enc_keylen, uint16_t digest_sz);
 extern int nss_cryptoapi_transform(struct nss_cryptoapi_ctx *ctx, struct nss_cryptoapi_info *info, void *app_data, bool ahash);
+
+/*
+ * Batching and completion coalescing
+ */
+extern void nss_cryptoapi_batch_init(struct nss_cryptoapi_ctx *ctx);
+extern void nss_cryptoapi_batch_flush(struct nss_cryptoapi_ctx *ctx);
+extern void nss_cryptoapi_batch_deinit(struct nss_cryptoapi_ctx *ctx);
+extern void nss_cryptoapi_done(struct nss_cryptoapi_ctx *ctx, struct crypto_async_request *areq,
+		struct nss_crypto_hdr *ch, uint8_t status, nss_cryptoapi_finish_method_t finish);
+/*
+ * Session cache
+ */
+extern int nss_cryptoapi_session_init(struct dentry *root);
+extern void nss_cryptoapi_session_deinit(void);
+extern int nss_cryptoapi_session_get(struct nss_cryptoapi_ctx *ctx, struct nss_crypto_session_data *data);
+extern void nss_cryptoapi_session_put(struct nss_cryptoapi_ctx *ctx);
+extern int nss_cryptoapi_session_sync(struct nss_cryptoapi_ctx *ctx);
+extern int nss_cryptoapi_session_hold(struct nss_cryptoapi_ctx *ctx, struct nss_cryptoapi_info *info, void *app_data);
+
 /*
  * Debug fs
  */
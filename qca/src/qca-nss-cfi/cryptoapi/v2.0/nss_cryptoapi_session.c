@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * nss_cryptoapi_session.c
+ * 	Cache of NSS crypto sessions shared between transforms with identical keys.
+ * 	Sessions are created in the background; requests arriving before the
+ * 	session is ready are held and replayed once it completes.
+ */
+
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/crypto.h>
+#include <linux/debugfs.h>
+#include <linux/completion.h>
+#include <linux/hrtimer.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/workqueue.h>
+#include <linux/slab.h>
+
+#include <crypto/aes.h>
+#include <crypto/sha.h>
+#include <crypto/algapi.h>
+#include <crypto/aead.h>
+
+#include <nss_api_if.h>
+#include <nss_crypto_cmn.h>
+#include <nss_cfi_if.h>
+#include <nss_crypto_api.h>
+#include <nss_crypto_hdr.h>
+#include <nss_crypto_defines.h>
+#include "nss_cryptoapi_private.h"
+
+#define NSS_CRYPTOAPI_SESSION_HASH_BITS 6
+#define NSS_CRYPTOAPI_SESSION_PENDING_MAX 128	/* Requests held per session while it is created */
+
+/*
+ * Request waiting for its session
+ */
+struct nss_cryptoapi_session_req {
+	struct list_head node;			/* Session pending list node */
+	struct nss_cryptoapi_ctx *ctx;		/* Context the request was submitted on */
+	struct nss_cryptoapi_info info;		/* Prepared request information */
+	void *app_data;				/* Crypto request */
+};
+
+/*
+ * Session cache statistics
+ */
+struct nss_cryptoapi_session_stats {
+	atomic64_t hit;				/* Setkey served from the cache */
+	atomic64_t miss;			/* Setkey creating a new session */
+	atomic64_t alloc_fail;			/* Background session allocation failed */
+	atomic64_t held;			/* Requests held for a pending session */
+	atomic64_t held_fail;			/* Requests failed as the pending list was full */
+	atomic_t active;			/* Sessions in the cache */
+};
+
+static DEFINE_HASHTABLE(nss_cryptoapi_session_tbl, NSS_CRYPTOAPI_SESSION_HASH_BITS);
+static DEFINE_MUTEX(nss_cryptoapi_session_lock);
+static struct workqueue_struct *nss_cryptoapi_session_wq;
+static struct nss_cryptoapi_session_stats nss_cryptoapi_session_stats;
+
+/*
+ * nss_cryptoapi_session_match()
+ *	Compare a cache entry against a candidate
+ */
+static inline bool nss_cryptoapi_session_match(struct nss_cryptoapi_session *sess, struct nss_cryptoapi_session *cand)
+{
+	if ((sess->hash != cand->hash) || (sess->algo != cand->algo))
+		return false;
+
+	if ((sess->cipher_keylen != cand->cipher_keylen) || (sess->auth_keylen != cand->auth_keylen) ||
+	    (sess->nonce_len != cand->nonce_len) || (sess->sec_key != cand->sec_key))
+		return false;
+
+	return !crypto_memneq(sess->key, cand->key, cand->cipher_keylen + cand->auth_keylen + cand->nonce_len);
+}
+
+/*
+ * nss_cryptoapi_session_find()
+ *	Lookup a usable session and take a reference on it
+ */
+static struct nss_cryptoapi_session *nss_cryptoapi_session_find(struct nss_cryptoapi_session *cand)
+{
+	struct nss_cryptoapi_session *sess;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(nss_cryptoapi_session_tbl, sess, node, cand->hash) {
+		if (READ_ONCE(sess->state) == NSS_CRYPTOAPI_SESSION_FAILED)
+			continue;
+
+		if (!nss_cryptoapi_session_match(sess, cand))
+			continue;
+
+		if (!kref_get_unless_zero(&sess->ref))
+			continue;
+
+		rcu_read_unlock();
+		return sess;
+	}
+
+	rcu_read_unlock();
+	return NULL;
+}
+
+/*
+ * nss_cryptoapi_session_release()
+ *	Free the NSS session once the last user is gone; called with cache lock held
+ */
+static void nss_cryptoapi_session_release(struct kref *ref)
+{
+	struct nss_cryptoapi_session *sess = container_of(ref, struct nss_cryptoapi_session, ref);
+
+	hash_del_rcu(&sess->node);
+	atomic_dec(&nss_cryptoapi_session_stats.active);
+	mutex_unlock(&nss_cryptoapi_session_lock);
+
+	BUG_ON(!list_empty(&sess->pending));
+	BUG_ON(!list_empty(&sess->ctxs));
+
+	if (sess->sid != NSS_CRYPTO_SESSION_MAX)
+		nss_crypto_session_free(g_cryptoapi.user, sess->sid);
+
+	memzero_explicit(sess->key, sess->cipher_keylen + sess->auth_keylen + sess->nonce_len);
+	kfree_rcu(sess, rcu);
+}
+
+/*
+ * nss_cryptoapi_session_replay()
+ *	Submit or fail the requests that were held for a session
+ */
+static void nss_cryptoapi_session_replay(struct nss_cryptoapi_session *sess, struct list_head *head)
+{
+	struct nss_cryptoapi_session_req *req, *tmp;
+	struct crypto_async_request *areq;
+	int error;
+
+	/*
+	 * Requests normally enter the transform path from softirq
+	 */
+	local_bh_disable();
+
+	list_for_each_entry_safe(req, tmp, head, node) {
+		list_del(&req->node);
+		areq = req->app_data;
+
+		if (sess->state == NSS_CRYPTOAPI_SESSION_READY) {
+			error = nss_cryptoapi_transform(req->ctx, &req->info, req->app_data, false);
+		} else {
+			error = sess->error;
+			nss_cryptoapi_ref_dec(req->ctx);
+		}
+
+		if (error != -EINPROGRESS)
+			areq->complete(areq, error);
+
+		kfree(req);
+	}
+
+	local_bh_enable();
+}
+
+/*
+ * nss_cryptoapi_session_work()
+ *	Create the NSS session in the background
+ */
+static void nss_cryptoapi_session_work(struct work_struct *work)
+{
+	struct nss_cryptoapi_session *sess = container_of(work, struct nss_cryptoapi_session, work);
+	struct nss_crypto_session_data data = {0};
+	struct nss_cryptoapi_ctx *ctx;
+	uint32_t sid = NSS_CRYPTO_SESSION_MAX;
+	LIST_HEAD(pending);
+	int status;
+
+	data.algo = sess->algo;
+	data.sec_key = sess->sec_key;
+	data.cipher_key = sess->cipher_keylen ? sess->key : NULL;
+	data.auth_key = sess->auth_keylen ? sess->key + sess->cipher_keylen : NULL;
+	data.auth_keylen = sess->auth_keylen;
+	data.nonce = sess->nonce_len ? sess->key + sess->cipher_keylen + sess->auth_keylen : NULL;
+
+	status = nss_crypto_session_alloc(g_cryptoapi.user, &data, &sid);
+	if (status < 0) {
+		nss_cfi_err("%px: Unable to allocate crypto session(%d)\n", sess, status);
+		atomic64_inc(&nss_cryptoapi_session_stats.alloc_fail);
+	}
+
+	spin_lock_bh(&sess->lock);
+	sess->sid = (status < 0) ? NSS_CRYPTO_SESSION_MAX : sid;
+	sess->error = (status < 0) ? status : 0;
+	WRITE_ONCE(sess->state, (status < 0) ? NSS_CRYPTOAPI_SESSION_FAILED : NSS_CRYPTOAPI_SESSION_READY);
+	list_splice_init(&sess->pending, &pending);
+	sess->npending = 0;
+	spin_unlock_bh(&sess->lock);
+
+	mutex_lock(&nss_cryptoapi_session_lock);
+	if (status < 0) {
+		/*
+		 * Keep the failed entry out of the cache so that the next
+		 * setkey with the same key retries the allocation
+		 */
+		hash_del_rcu(&sess->node);
+	} else {
+		list_for_each_entry(ctx, &sess->ctxs, sess_node) {
+			ctx->sid = sid;
+			if (!ctx->dentry)
+				nss_cryptoapi_add_ctx2debugfs(ctx);
+		}
+	}
+
+	mutex_unlock(&nss_cryptoapi_session_lock);
+
+	nss_cryptoapi_session_replay(sess, &pending);
+
+	/*
+	 * Drop the reference held by the work
+	 */
+	kref_put_mutex(&sess->ref, nss_cryptoapi_session_release, &nss_cryptoapi_session_lock);
+}
+
+/*
+ * nss_cryptoapi_session_get()
+ *	Attach a context to a session for the given keys
+ *
+ * An existing session with identical keys is shared; otherwise a new one
+ * is created in the background and the context can start accepting
+ * requests right away.
+ */
+int nss_cryptoapi_session_get(struct nss_cryptoapi_ctx *ctx, struct nss_crypto_session_data *data)
+{
+	struct nss_cryptoapi_session *sess, *found;
+	uint16_t cipher_keylen, auth_keylen, nonce_len;
+
+	BUG_ON(ctx->sess);
+	might_sleep();
+
+	cipher_keylen = data->cipher_key ? ctx->info->cipher_keylen : 0;
+	auth_keylen = data->auth_key ? data->auth_keylen : 0;
+	nonce_len = data->nonce ? ctx->info->nonce : 0;
+
+	sess = kzalloc(struct_size(sess, key, cipher_keylen + auth_keylen + nonce_len), GFP_KERNEL);
+	if (!sess) {
+		ctx->stats.failed_nomem++;
+		return -ENOMEM;
+	}
+
+	sess->algo = data->algo;
+	sess->sec_key = data->sec_key;
+	sess->cipher_keylen = cipher_keylen;
+	sess->auth_keylen = auth_keylen;
+	sess->nonce_len = nonce_len;
+	memcpy(sess->key, data->cipher_key, cipher_keylen);
+	memcpy(sess->key + cipher_keylen, data->auth_key, auth_keylen);
+	memcpy(sess->key + cipher_keylen + auth_keylen, data->nonce, nonce_len);
+	sess->hash = jhash(sess->key, cipher_keylen + auth_keylen + nonce_len, data->algo);
+
+	/*
+	 * Lockless lookup for the common case of a shared key
+	 */
+	found = nss_cryptoapi_session_find(sess);
+
+	mutex_lock(&nss_cryptoapi_session_lock);
+	if (!found)
+		found = nss_cryptoapi_session_find(sess);
+
+	if (found) {
+		kzfree(sess);
+		sess = found;
+		atomic64_inc(&nss_cryptoapi_session_stats.hit);
+	} else {
+		sess->sid = NSS_CRYPTO_SESSION_MAX;
+		sess->state = NSS_CRYPTOAPI_SESSION_PENDING;
+		spin_lock_init(&sess->lock);
+		INIT_LIST_HEAD(&sess->pending);
+		INIT_LIST_HEAD(&sess->ctxs);
+		INIT_WORK(&sess->work, nss_cryptoapi_session_work);
+
+		/*
+		 * One reference for the context and one for the work
+		 */
+		kref_init(&sess->ref);
+		kref_get(&sess->ref);
+
+		hash_add_rcu(nss_cryptoapi_session_tbl, &sess->node, sess->hash);
+		atomic_inc(&nss_cryptoapi_session_stats.active);
+		atomic64_inc(&nss_cryptoapi_session_stats.miss);
+		queue_work(nss_cryptoapi_session_wq, &sess->work);
+	}
+
+	ctx->sess = sess;
+	ctx->share = sess->shares++;
+	list_add_tail(&ctx->sess_node, &sess->ctxs);
+
+	if (READ_ONCE(sess->state) == NSS_CRYPTOAPI_SESSION_READY) {
+		ctx->sid = sess->sid;
+		nss_cryptoapi_add_ctx2debugfs(ctx);
+	}
+
+	mutex_unlock(&nss_cryptoapi_session_lock);
+	return 0;
+}
+
+/*
+ * nss_cryptoapi_session_put()
+ *	Detach a context from its session
+ */
+void nss_cryptoapi_session_put(struct nss_cryptoapi_ctx *ctx)
+{
+	struct nss_cryptoapi_session *sess = ctx->sess;
+
+	if (!sess)
+		return;
+
+	/*
+	 * Let a pending creation finish so that no held request
+	 * refers to this context afterwards
+	 */
+	flush_work(&sess->work);
+
+	mutex_lock(&nss_cryptoapi_session_lock);
+	list_del(&ctx->sess_node);
+	debugfs_remove_recursive(ctx->dentry);
+	ctx->dentry = NULL;
+	ctx->sess = NULL;
+	ctx->sid = NSS_CRYPTO_SESSION_MAX;
+	mutex_unlock(&nss_cryptoapi_session_lock);
+
+	kref_put_mutex(&sess->ref, nss_cryptoapi_session_release, &nss_cryptoapi_session_lock);
+}
+
+/*
+ * nss_cryptoapi_session_sync()
+ *	Wait for the session of a context to be created
+ */
+int nss_cryptoapi_session_sync(struct nss_cryptoapi_ctx *ctx)
+{
+	struct nss_cryptoapi_session *sess = ctx->sess;
+
+	if (!sess)
+		return 0;
+
+	flush_work(&sess->work);
+
+	if (sess->state != NSS_CRYPTOAPI_SESSION_READY)
+		return sess->error;
+
+	ctx->sid = sess->sid;
+	return 0;
+}
+
+/*
+ * nss_cryptoapi_session_hold()
+ *	Resolve the session for a request or hold the request until it is ready
+ *
+ * Returns 0 when the session is usable, -EINPROGRESS when the request was
+ * held and any other error when it must be failed by the caller.
+ */
+int nss_cryptoapi_session_hold(struct nss_cryptoapi_ctx *ctx, struct nss_cryptoapi_info *info, void *app_data)
+{
+	struct nss_cryptoapi_session *sess = ctx->sess;
+	struct nss_cryptoapi_session_req *req;
+	int error;
+
+	req = kmalloc(sizeof(*req), GFP_ATOMIC);
+
+	spin_lock_bh(&sess->lock);
+	switch (sess->state) {
+	case NSS_CRYPTOAPI_SESSION_READY:
+		ctx->sid = sess->sid;
+		error = 0;
+		goto done;
+
+	case NSS_CRYPTOAPI_SESSION_FAILED:
+		error = sess->error;
+		goto done;
+
+	default:
+		break;
+	}
+
+	if (!req) {
+		ctx->stats.failed_nomem++;
+		error = -ENOMEM;
+		goto done;
+	}
+
+	if (sess->npending >= NSS_CRYPTOAPI_SESSION_PENDING_MAX) {
+		atomic64_inc(&nss_cryptoapi_session_stats.held_fail);
+		error = -EBUSY;
+		goto done;
+	}
+
+	req->ctx = ctx;
+	req->info = *info;
+	req->app_data = app_data;
+	list_add_tail(&req->node, &sess->pending);
+	sess->npending++;
+	spin_unlock_bh(&sess->lock);
+
+	ctx->stats.session_held++;
+	atomic64_inc(&nss_cryptoapi_session_stats.held);
+	return -EINPROGRESS;
+
+done:
+	spin_unlock_bh(&sess->lock);
+	kfree(req);
+	return error;
+}
+
+/*
+ * nss_cryptoapi_session_stats_read()
+ * 	Session cache statistics read function
+ */
+static ssize_t nss_cryptoapi_session_stats_read(struct file *fp, char __user *ubuf, size_t sz, loff_t *ppos)
+{
+	struct nss_cryptoapi_session_stats *stats = &nss_cryptoapi_session_stats;
+	char buf[NSS_CRYPTOAPI_DEBUGFS_MAX_NAME * 6];
+	ssize_t len;
+
+	len = snprintf(buf, sizeof(buf), "active - %d\n", atomic_read(&stats->active));
+	len += snprintf(buf + len, sizeof(buf) - len, "hit - %lld\n", atomic64_read(&stats->hit));
+	len += snprintf(buf + len, sizeof(buf) - len, "miss - %lld\n", atomic64_read(&stats->miss));
+	len += snprintf(buf + len, sizeof(buf) - len, "alloc_fail - %lld\n", atomic64_read(&stats->alloc_fail));
+	len += snprintf(buf + len, sizeof(buf) - len, "held - %lld\n", atomic64_read(&stats->held));
+	len += snprintf(buf + len, sizeof(buf) - len, "held_fail - %lld\n", atomic64_read(&stats->held_fail));
+
+	return simple_read_from_buffer(ubuf, sz, ppos, buf, len);
+}
+
+/*
+ * Session cache file operation structure instance
+ */
+static const struct file_operations session_stats_op = {
+	.open = simple_open,
+	.llseek = default_llseek,
+	.read = nss_cryptoapi_session_stats_read,
+};
+
+/*
+ * nss_cryptoapi_session_init()
+ *	Initialize the session cache
+ */
+int nss_cryptoapi_session_init(struct dentry *root)
+{
+	nss_cryptoapi_session_wq = alloc_workqueue("nss_cryptoapi_session", WQ_UNBOUND, 0);
+	if (!nss_cryptoapi_session_wq)
+		return -ENOMEM;
+
+	if (root)
+		debugfs_create_file("session_cache", S_IRUGO, root, NULL, &session_stats_op);
+
+	return 0;
+}
+
+/*
+ * nss_cryptoapi_session_deinit()
+ *	Wait for outstanding session work and release the workqueue
+ */
+void nss_cryptoapi_session_deinit(void)
+{
+	destroy_workqueue(nss_cryptoapi_session_wq);
+	WARN_ON(!hash_empty(nss_cryptoapi_session_tbl));
+}
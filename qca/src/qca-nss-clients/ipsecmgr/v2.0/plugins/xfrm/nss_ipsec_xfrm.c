@@ -22,6 +22,7 @@
 #include <linux/slab.h>
 #include <linux/if.h>
 #include <linux/list.h>
+#include <linux/rculist.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
 #include <net/xfrm.h>
@@ -201,10 +202,23 @@ static void nss_ipsec_xfrm_init_flow_db(struct nss_ipsec_xfrm_drv *drv)
 	uint32_t i;
 
 	for (i = 0; i < NSS_IPSEC_XFRM_FLOW_DB_MAX; i++) {
-		INIT_LIST_HEAD(&g_ipsec_xfrm.flow_db[i]);
+		INIT_HLIST_HEAD(&drv->flow_db[i]);
 	}
 }
 
+/*
+ * nss_ipsec_xfrm_unlink_flow()
+ *	Remove the flow from the flow DB and from its SA flow list. Caller needs to hold the flow lock.
+ *
+ * The flow stays visible to RCU readers until a grace period elapses; they will fail to take
+ * a reference once the DB reference is released.
+ */
+static inline void nss_ipsec_xfrm_unlink_flow(struct nss_ipsec_xfrm_flow *flow, struct list_head *free_head)
+{
+	hlist_del_init_rcu(&flow->hash_entry);
+	list_move(&flow->sa_entry, free_head);
+}
+
 /*
  * nss_ipsec_xfrm_flush_flow()
  *	Flushes the provided list of flows.
@@ -213,72 +227,84 @@ void nss_ipsec_xfrm_flush_flow(struct list_head *head)
 {
 	struct nss_ipsec_xfrm_flow *flow, *tmp;
 
-	list_for_each_entry_safe(flow, tmp, head, list_entry) {
-		list_del_init(&flow->list_entry);
+	list_for_each_entry_safe(flow, tmp, head, sa_entry) {
+		list_del_init(&flow->sa_entry);
 		nss_ipsec_xfrm_flow_dealloc(flow);
 	}
 }
 
 /*
  * nss_ipsec_xfrm_flush_flow_all()
- *	Flush the flow DB. Caller needs to hold the write lock.
+ *	Flush the flow DB.
  */
 void nss_ipsec_xfrm_flush_flow_all(struct nss_ipsec_xfrm_drv *drv)
 {
+	struct nss_ipsec_xfrm_flow *flow;
+	struct hlist_node *tmp;
 	struct list_head free_head;
 	uint32_t i;
 
 	INIT_LIST_HEAD(&free_head);
 
 	/*
-	 * Splice the database and create list of flows to be freed
+	 * Unlink the database and create list of flows to be freed
 	 */
-	write_lock_bh(&drv->lock);
+	spin_lock_bh(&drv->flow_lock);
 	for (i = 0; i < NSS_IPSEC_XFRM_FLOW_DB_MAX; i++) {
-		list_splice_init(&drv->flow_db[i], &free_head);
+		hlist_for_each_entry_safe(flow, tmp, &drv->flow_db[i], hash_entry) {
+			nss_ipsec_xfrm_unlink_flow(flow, &free_head);
+		}
 	}
 
-	write_unlock_bh(&drv->lock);
+	spin_unlock_bh(&drv->flow_lock);
 
 	nss_ipsec_xfrm_flush_flow(&free_head);
 }
 
 /*
  * nss_ipsec_xfrm_flush_flow_by_sa()
- *	Delete flows corrosponding to an xfrm_state. Caller needs to hold the write lock.
+ *	Delete flows corrosponding to an xfrm_state.
+ *
+ * Only the flow list of the SA is walked; flows migrated to other SA are on that SA's list.
  */
 static void nss_ipsec_xfrm_flush_flow_by_sa(struct nss_ipsec_xfrm_drv *drv, struct nss_ipsec_xfrm_sa *sa)
 {
-	struct list_head *db_head = drv->flow_db;
 	struct nss_ipsec_xfrm_flow *flow, *tmp;
 	struct list_head free_head;
-	uint32_t count;
 
 	INIT_LIST_HEAD(&free_head);
-	write_lock_bh(&drv->lock);
+	spin_lock_bh(&drv->flow_lock);
 
-	for (count = NSS_IPSEC_XFRM_FLOW_DB_MAX; count--; db_head++) {
-		list_for_each_entry_safe(flow, tmp, db_head, list_entry) {
-			if (READ_ONCE(flow->sa) == sa) {
-				list_del_init(&flow->list_entry);
-				list_add(&flow->list_entry, &free_head);
-			}
-		}
+	list_for_each_entry_safe(flow, tmp, &sa->flow_list, sa_entry) {
+		nss_ipsec_xfrm_unlink_flow(flow, &free_head);
 	}
 
-	write_unlock_bh(&drv->lock);
+	spin_unlock_bh(&drv->flow_lock);
 	nss_ipsec_xfrm_flush_flow(&free_head);
 }
 
 /*
  * nss_ipsec_xfrm_del_flow()
- *	Delete the specified flow object. Caller needs to hold the write lock.
+ *	Delete the specified flow object.
  */
 static void nss_ipsec_xfrm_del_flow(struct nss_ipsec_xfrm_drv *drv, struct nss_ipsec_xfrm_flow *flow)
 {
-	write_lock_bh(&drv->lock);
-	list_del_init(&flow->list_entry);
-	write_unlock_bh(&drv->lock);
+	struct list_head free_head;
+
+	INIT_LIST_HEAD(&free_head);
+
+	/*
+	 * The flow may have been unlinked by a flush on other CPU; in which case
+	 * the flush owns the DB reference and will release the flow.
+	 */
+	spin_lock_bh(&drv->flow_lock);
+	if (hlist_unhashed(&flow->hash_entry)) {
+		spin_unlock_bh(&drv->flow_lock);
+		return;
+	}
+
+	nss_ipsec_xfrm_unlink_flow(flow, &free_head);
+	spin_unlock_bh(&drv->flow_lock);
 
 	nss_ipsec_xfrm_trace("%p: Flow deleted from database\n", flow);
 
@@ -286,21 +312,23 @@ static void nss_ipsec_xfrm_del_flow(struct nss_ipsec_xfrm_drv *drv, struct nss_i
 	 * Delete any other objects that could be holding reference to the flow object.
 	 * There is no such object for now. So we directly dealloc the flow object.
 	 */
-	nss_ipsec_xfrm_flow_dealloc(flow);
+	nss_ipsec_xfrm_flush_flow(&free_head);
 }
 
 /*
  * nss_ipsec_xfrm_add_flow()
- *	Add a flow object to the SA, and insert into flow db. The caller needs to hold the write lock.
+ *	Insert the flow into flow db and into the flow list of its SA.
  */
 static void nss_ipsec_xfrm_add_flow(struct nss_ipsec_xfrm_drv *drv, struct nss_ipsec_xfrm_flow *flow)
 {
 	uint32_t hash_idx;
 
-	write_lock_bh(&drv->lock);
 	hash_idx = nss_ipsec_xfrm_hash_flow(&flow->tuple, drv->hash_nonce, NSS_IPSEC_XFRM_FLOW_DB_MAX);
-	list_add(&flow->list_entry, &drv->flow_db[hash_idx]);
-	write_unlock_bh(&drv->lock);
+
+	spin_lock_bh(&drv->flow_lock);
+	list_add(&flow->sa_entry, &READ_ONCE(flow->sa)->flow_list);
+	hlist_add_head_rcu(&flow->hash_entry, &drv->flow_db[hash_idx]);
+	spin_unlock_bh(&drv->flow_lock);
 
 	nss_ipsec_xfrm_trace("%p: Flow added to database (hash_idx:%d)\n", flow, hash_idx);
 }
@@ -309,7 +337,7 @@ static void nss_ipsec_xfrm_add_flow(struct nss_ipsec_xfrm_drv *drv, struct nss_i
  * nss_ipsec_xfrm_ref_flow()
  *	Get flow and acquire reference to it.
  *
- * Note: The caller needs to hold the lock. This function holds the reference to the object
+ * Note: The lookup is lockless under RCU. This function holds the reference to the object
  */
 static struct nss_ipsec_xfrm_flow *nss_ipsec_xfrm_ref_flow(struct nss_ipsec_xfrm_drv *drv,
 					struct nss_ipsecmgr_flow_tuple *tuple)
@@ -320,16 +348,16 @@ static struct nss_ipsec_xfrm_flow *nss_ipsec_xfrm_ref_flow(struct nss_ipsec_xfrm
 	hash_idx = nss_ipsec_xfrm_hash_flow(tuple, drv->hash_nonce, NSS_IPSEC_XFRM_FLOW_DB_MAX);
 	nss_ipsec_xfrm_trace("%p: flow hash_idx (%u)", drv, hash_idx);
 
-	read_lock_bh(&drv->lock);
-	list_for_each_entry(flow, &drv->flow_db[hash_idx], list_entry) {
+	rcu_read_lock_bh();
+	hlist_for_each_entry_rcu(flow, &drv->flow_db[hash_idx], hash_entry) {
 		if (nss_ipsec_xfrm_flow_match(flow, tuple)) {
 			flow = nss_ipsec_xfrm_flow_ref(flow);
-			read_unlock_bh(&drv->lock);
+			rcu_read_unlock_bh();
 			return flow;
 		}
 	}
 
-	read_unlock_bh(&drv->lock);
+	rcu_read_unlock_bh();
 
 	return NULL;
 }
@@ -2321,6 +2349,7 @@ int __init nss_ipsec_xfrm_init_module(void)
 {
 
 	rwlock_init(&g_ipsec_xfrm.lock);
+	spin_lock_init(&g_ipsec_xfrm.flow_lock);
 
 	nss_ipsec_xfrm_init_tun_db(&g_ipsec_xfrm);
 	nss_ipsec_xfrm_init_flow_db(&g_ipsec_xfrm);
@@ -128,13 +128,14 @@ struct nss_ipsec_xfrm_drv_stats {
  */
 struct nss_ipsec_xfrm_drv {
 	struct list_head tun_db[NSS_IPSEC_XFRM_TUN_DB_MAX];	/* Tunnel Hash Database */
-	struct list_head flow_db[NSS_IPSEC_XFRM_FLOW_DB_MAX];	/* Flow Hash Database */
+	struct hlist_head flow_db[NSS_IPSEC_XFRM_FLOW_DB_MAX];	/* Flow Hash Database; lookups under RCU */
 	struct nss_ipsec_xfrm_drv_stats stats;			/* Statistics */
 	struct nss_ipsec_xfrm_fallback xsa;			/* Pointers to original xfrm_state_afinfo instances */
 	struct completion complete;				/* Completion for num of active tunnels to go zero. */
 	struct dentry *dentry;					/* Debugfs root directory. */
 	size_t stats_len;					/* Size of stats */
-	rwlock_t lock;						/* Lock for DB operations */
+	rwlock_t lock;						/* Lock for tunnel DB operations */
+	spinlock_t flow_lock;					/* Lock for flow DB and SA flow list updates */
 	atomic_t num_tunnels;					/* Number of active tunnels */
 	uint32_t hash_nonce;					/* One time random number */
 };
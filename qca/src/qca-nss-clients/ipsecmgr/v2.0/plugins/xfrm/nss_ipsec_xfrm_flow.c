@@ -62,7 +62,11 @@ static void nss_ipsec_xfrm_flow_final(struct kref *kref)
 	}
 
 	atomic64_inc(&drv->stats.flow_freed);
-	kfree(flow);
+
+	/*
+	 * Lookups walk the flow DB under RCU and may still be looking at this flow
+	 */
+	kfree_rcu(flow, rcu);
 }
 
 /*
@@ -179,11 +183,14 @@ void nss_ipsec_xfrm_flow_deref(struct nss_ipsec_xfrm_flow *flow)
 
 /*
  * nss_ipsec_xfrm_flow_ref()
- *	Hold flow ref.
+ *	Hold flow ref; returns NULL if the flow is already being released.
  */
 struct nss_ipsec_xfrm_flow *nss_ipsec_xfrm_flow_ref(struct nss_ipsec_xfrm_flow *flow)
 {
-	kref_get(&flow->ref);
+	if (!kref_get_unless_zero(&flow->ref)) {
+		return NULL;
+	}
+
 	return flow;
 }
 
@@ -219,6 +226,19 @@ bool nss_ipsec_xfrm_flow_update(struct nss_ipsec_xfrm_flow *flow, struct nss_ips
 		return false;
 	}
 
+	/*
+	 * Move the flow to the flow list of the new SA; unless it has already been
+	 * removed from the flow DB by a delete or flush running on other CPU.
+	 * This is done before dropping the old SA reference, as the old SA list
+	 * must stay valid till the flow is unlinked from it.
+	 */
+	spin_lock_bh(&flow->drv->flow_lock);
+	if (!hlist_unhashed(&flow->hash_entry)) {
+		list_move(&flow->sa_entry, &sa->flow_list);
+	}
+
+	spin_unlock_bh(&flow->drv->flow_lock);
+
 	nss_ipsec_xfrm_sa_ref(sa);
 	nss_ipsec_xfrm_sa_deref(flow_sa);
 	nss_ipsec_xfrm_info("%p: Flow migrated from SA %p to SA %p\n", flow, flow_sa, sa);
@@ -271,6 +291,8 @@ struct nss_ipsec_xfrm_flow *nss_ipsec_xfrm_flow_alloc(struct nss_ipsec_xfrm_drv
 
 	flow->drv = drv;
 	memcpy(&flow->tuple, tuple, sizeof(struct nss_ipsecmgr_flow_tuple));
+	INIT_HLIST_NODE(&flow->hash_entry);
+	INIT_LIST_HEAD(&flow->sa_entry);
 	kref_init(&flow->ref);
 
 	atomic64_inc(&drv->stats.flow_alloced);
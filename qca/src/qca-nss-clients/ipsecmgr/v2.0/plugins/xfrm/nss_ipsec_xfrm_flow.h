@@ -20,7 +20,9 @@
  * NSS IPSec xfrm Flow obj
  */
 struct nss_ipsec_xfrm_flow {
-	struct list_head list_entry; 		/* Hash DB Entry */
+	struct hlist_node hash_entry;		/* Hash DB Entry; walked under RCU */
+	struct list_head sa_entry;		/* Entry in the flow list of the owning SA */
+	struct rcu_head rcu;			/* RCU head for deferred free */
 	struct nss_ipsec_xfrm_drv *drv; 	/* Pointer to nss_ipsec_xfrm_drv object */
 	struct nss_ipsecmgr_flow_tuple tuple;	/* Cached Parameters for this Flow object*/
 
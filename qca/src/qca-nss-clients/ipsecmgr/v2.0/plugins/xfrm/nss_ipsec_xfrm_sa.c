@@ -437,6 +437,7 @@ struct nss_ipsec_xfrm_sa *nss_ipsec_xfrm_sa_alloc(struct nss_ipsec_xfrm_tunnel *
 
 	kref_init(&sa->ref);
 	atomic_set(&sa->ecm_accel_outer, 0);
+	INIT_LIST_HEAD(&sa->flow_list);
 
 	/*
 	 * Initialize the SA with common parameters
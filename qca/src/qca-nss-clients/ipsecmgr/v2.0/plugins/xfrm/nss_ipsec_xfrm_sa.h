@@ -34,6 +34,7 @@ struct nss_ipsec_xfrm_sa {
 	struct nss_ipsec_xfrm_drv *drv; 	/* Pointer to nss_ipsec_xfrm_drv */
 	enum nss_ipsecmgr_sa_type type;		/* Encap or decap */
 	atomic_t ecm_accel_outer;		/* Outer flow IPv4 rule is accelerated or not */
+	struct list_head flow_list;		/* Flows using this SA; protected by drv->flow_lock */
 	struct kref ref; 			/* Reference count */
 };
 
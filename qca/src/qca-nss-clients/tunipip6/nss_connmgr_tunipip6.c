@@ -26,6 +26,10 @@
 #include <net/ip.h>
 #include <net/ipv6.h>
 #include <linux/if.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/vmalloc.h>
 #include <net/ip_tunnels.h>
 #include <net/ip6_tunnel.h>
 #include <nss_api_if.h>
@@ -33,7 +37,21 @@
 #include "nss_connmgr_tunipip6_sysctl.h"
 #include "nss_connmgr_tunipip6_priv.h"
 
-#define NSS_TUNIPIP6_MAX_FMR 255	/* Maximum number of forward mapping rule (FMR). */
+#include "nss_connmgr_tunipip6_nl.h"
+
+#define NSS_TUNIPIP6_MAPRULE_WINDOW 32		/* Map rule messages in flight */
+#define NSS_TUNIPIP6_MAPRULE_TIMEOUT_MSECS 5000	/* Map rule response timeout */
+
+/*
+ * Map rule messages sent together; freed when the sender and every
+ * response callback have dropped their reference.
+ */
+struct nss_tunipip6_maprule_batch {
+	struct kref ref;		/* Reference of sender and outstanding messages */
+	wait_queue_head_t wait;		/* Sender waits here for responses */
+	atomic_t pending;		/* Messages without response */
+	atomic_t failed;		/* Messages NACKed by NSS */
+};
 
 /*
  * Frag Id update is disabled by default
@@ -517,41 +535,68 @@ static void nss_connmgr_tunipip6_configure_fmr(struct net_device *netdev)
 {
 	struct ip6_tnl *tunnel;
 	struct __ip6_tnl_fmr *fmr;
+	struct nss_connmgr_tunipip6_maprule_cfg *rule;
 	uint32_t fmr_number = 0;
 	enum nss_connmgr_tunipip6_err_codes status;
-	struct nss_connmgr_tunipip6_maprule_cfg mrcfg = {0};
+	struct nss_connmgr_tunipip6_maprule_cfg *mrcfg;
 
 	tunnel = (struct ip6_tnl *)netdev_priv(netdev);
+	if (!tunnel->parms.fmrs) {
+		return;
+	}
+
+	mrcfg = vzalloc(sizeof(*mrcfg) * NSS_TUNIPIP6_MAX_FMR);
+	if (!mrcfg) {
+		nss_tunipip6_warning("%px: Not able to allocate FMR array\n", netdev);
+		return;
+	}
 
 	/*
 	 * Configure FMR table up to NSS_TUNIPIP6_MAX_FMR, the rest will be forwarded to BR
 	 */
-	for (fmr = tunnel->parms.fmrs; fmr && fmr_number < NSS_TUNIPIP6_MAX_FMR; fmr = fmr->next, fmr_number++) {
+	for (fmr = tunnel->parms.fmrs; fmr && fmr_number < NSS_TUNIPIP6_MAX_FMR; fmr = fmr->next) {
 		/*
 		 * Prepare "rulecfg"
 		 */
-		mrcfg.rule_type = NSS_CONNMGR_TUNIPIP6_RULE_FMR;
-		mrcfg.ipv6_prefix[0] = ntohl(fmr->ip6_prefix.s6_addr32[0]);
-		mrcfg.ipv6_prefix[1] = ntohl(fmr->ip6_prefix.s6_addr32[1]);
-		mrcfg.ipv6_prefix[2] = ntohl(fmr->ip6_prefix.s6_addr32[2]);
-		mrcfg.ipv6_prefix[3] = ntohl(fmr->ip6_prefix.s6_addr32[3]);
-		mrcfg.ipv4_prefix = ntohl(fmr->ip4_prefix.s_addr);
-		mrcfg.ipv6_prefix_len = fmr->ip6_prefix_len;
-		mrcfg.ipv4_prefix_len = fmr->ip4_prefix_len;
-		mrcfg.ea_len = fmr->ea_len;
-		mrcfg.psid_offset = fmr->offset;
+		rule = &mrcfg[fmr_number];
+		rule->rule_type = NSS_CONNMGR_TUNIPIP6_RULE_FMR;
+		rule->ipv6_prefix[0] = ntohl(fmr->ip6_prefix.s6_addr32[0]);
+		rule->ipv6_prefix[1] = ntohl(fmr->ip6_prefix.s6_addr32[1]);
+		rule->ipv6_prefix[2] = ntohl(fmr->ip6_prefix.s6_addr32[2]);
+		rule->ipv6_prefix[3] = ntohl(fmr->ip6_prefix.s6_addr32[3]);
+		rule->ipv4_prefix = ntohl(fmr->ip4_prefix.s_addr);
+		rule->ipv6_prefix_len = fmr->ip6_prefix_len;
+		rule->ipv4_prefix_len = fmr->ip4_prefix_len;
+		rule->ea_len = fmr->ea_len;
+		rule->psid_offset = fmr->offset;
 
 		/*
-		 * Call add maprule API.
+		 * The batch is rejected as a whole on a bad rule; leave such an FMR
+		 * out so that its traffic goes to the BR instead of all FMRs.
 		 */
-		status = nss_connmgr_tunipip6_add_maprule(netdev, &mrcfg);
-		if (status != NSS_CONNMGR_TUNIPIP6_SUCCESS) {
-			nss_tunipip6_trace("%px: Not able to add FMR rule. IPv6 Prefix: %pI6 IPv6 Prefix Lenght: %d\n"
-					"IPv4 Prefix: %pI6 IPv4 Prefix Lenght: %d EA Length: %d PSID Offset: %d\n",
-					netdev, mrcfg.ipv6_prefix, mrcfg.ipv6_prefix_len,&mrcfg.ipv4_prefix,
-					mrcfg.ipv4_prefix_len, mrcfg.ea_len, mrcfg.psid_offset);
+		if (!nss_tunipip6_maprule_validate(rule)) {
+			nss_tunipip6_warning("%px: Skipping invalid FMR %pI6c/%u ea_len %u psid_offset %u\n", netdev,
+					&fmr->ip6_prefix, fmr->ip6_prefix_len, fmr->ea_len, fmr->offset);
+			continue;
 		}
+
+		fmr_number++;
+	}
+
+	if (!fmr_number) {
+		vfree(mrcfg);
+		return;
 	}
+
+	/*
+	 * Program the whole FMR table in one batch.
+	 */
+	status = nss_connmgr_tunipip6_set_maprules(netdev, mrcfg, fmr_number, false);
+	if (status != NSS_CONNMGR_TUNIPIP6_SUCCESS) {
+		nss_tunipip6_trace("%px: Not able to add %u FMR rule(s), error %d\n", netdev, fmr_number, status);
+	}
+
+	vfree(mrcfg);
 }
 #endif
 
@@ -789,15 +834,417 @@ enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_destroy_interface(struc
 }
 EXPORT_SYMBOL(nss_connmgr_tunipip6_destroy_interface);
 
+/*
+ * nss_tunipip6_maprule_msg_init()
+ *	Prepare a map rule message to send to the encap interface.
+ */
+static void nss_tunipip6_maprule_msg_init(struct nss_tunipip6_msg *tnlmsg, int inner_ifnum, int msg_type,
+					struct nss_connmgr_tunipip6_maprule_cfg *rulecfg,
+					nss_tunipip6_msg_callback_t cb, void *app_data)
+{
+	struct nss_tunipip6_map_rule *map_rule;
+
+	memset(tnlmsg, 0, sizeof(struct nss_tunipip6_msg));
+
+	/*
+	 * To delete BMR or flush FMR, only the message type is needed.
+	 */
+	if (rulecfg) {
+		map_rule = &tnlmsg->msg.map_rule;
+		map_rule->ip6_prefix[0] = rulecfg->ipv6_prefix[0];
+		map_rule->ip6_prefix[1] = rulecfg->ipv6_prefix[1];
+		map_rule->ip6_prefix[2] = rulecfg->ipv6_prefix[2];
+		map_rule->ip6_prefix[3] = rulecfg->ipv6_prefix[3];
+		map_rule->ip6_prefix_len = rulecfg->ipv6_prefix_len;
+
+		map_rule->ip4_prefix = rulecfg->ipv4_prefix;
+		map_rule->ip4_prefix_len = rulecfg->ipv4_prefix_len;
+
+		map_rule->ip6_suffix[0] = rulecfg->ipv6_suffix[0];
+		map_rule->ip6_suffix[1] = rulecfg->ipv6_suffix[1];
+		map_rule->ip6_suffix[2] = rulecfg->ipv6_suffix[2];
+		map_rule->ip6_suffix[3] = rulecfg->ipv6_suffix[3];
+		map_rule->ip6_suffix_len = rulecfg->ipv6_suffix_len;
+
+		map_rule->ea_len = rulecfg->ea_len;
+		map_rule->psid_offset = rulecfg->psid_offset;
+	}
+
+	nss_tunipip6_msg_init(tnlmsg, inner_ifnum, msg_type,
+			(msg_type == NSS_TUNIPIP6_FMR_RULE_FLUSH) ? 0 : sizeof(struct nss_tunipip6_map_rule),
+			cb, app_data);
+}
+
+/*
+ * nss_tunipip6_maprule_tx_sync()
+ *	Send a single map rule message and wait for the response.
+ */
+static nss_tx_status_t nss_tunipip6_maprule_tx_sync(struct net_device *netdev, int inner_ifnum, int msg_type,
+					struct nss_connmgr_tunipip6_maprule_cfg *rulecfg)
+{
+	struct nss_tunipip6_msg tnlmsg;
+	struct nss_ctx_instance *nss_ctx;
+
+	nss_tunipip6_maprule_msg_init(&tnlmsg, inner_ifnum, msg_type, rulecfg, NULL, NULL);
+
+	nss_ctx = nss_tunipip6_get_context();
+	nss_tunipip6_trace("%px: Sending IPIP6 tunnel maprule, message type %d command to NSS %p\n", netdev, msg_type, nss_ctx);
+	return nss_tunipip6_tx_sync(nss_ctx, &tnlmsg);
+}
+
+/*
+ * nss_tunipip6_maprule_table_get()
+ *	Copy the map rule table of the tunnel.
+ */
+static bool nss_tunipip6_maprule_table_get(struct net_device *netdev, struct nss_tunipip6_maprule_table *table)
+{
+	struct nss_tunipip6_instance *ntii;
+
+	spin_lock_bh(&tunipip6_ctx.lock);
+	ntii = nss_tunipip6_find_instance(netdev);
+	if (!ntii) {
+		spin_unlock_bh(&tunipip6_ctx.lock);
+		nss_tunipip6_warning("%px: Not able to find tunipip6 instance for dev:%s\n", netdev, netdev->name);
+		return false;
+	}
+
+	memcpy(table, &ntii->rules, sizeof(*table));
+	spin_unlock_bh(&tunipip6_ctx.lock);
+	return true;
+}
+
+/*
+ * nss_tunipip6_maprule_table_set()
+ *	Replace the map rule table of the tunnel.
+ */
+static void nss_tunipip6_maprule_table_set(struct net_device *netdev, struct nss_tunipip6_maprule_table *table)
+{
+	struct nss_tunipip6_instance *ntii;
+
+	spin_lock_bh(&tunipip6_ctx.lock);
+	ntii = nss_tunipip6_find_instance(netdev);
+	if (ntii) {
+		memcpy(&ntii->rules, table, sizeof(*table));
+	}
+
+	spin_unlock_bh(&tunipip6_ctx.lock);
+}
+
+/*
+ * nss_tunipip6_maprule_table_update()
+ *	Mirror a single map rule change in the map rule table of the tunnel.
+ */
+static void nss_tunipip6_maprule_table_update(struct net_device *netdev, int msg_type,
+					struct nss_connmgr_tunipip6_maprule_cfg *rulecfg)
+{
+	struct nss_tunipip6_instance *ntii;
+
+	spin_lock_bh(&tunipip6_ctx.lock);
+	ntii = nss_tunipip6_find_instance(netdev);
+	if (!ntii) {
+		spin_unlock_bh(&tunipip6_ctx.lock);
+		return;
+	}
+
+	switch (msg_type) {
+	case NSS_TUNIPIP6_BMR_RULE_ADD:
+	case NSS_TUNIPIP6_FMR_RULE_ADD:
+		nss_tunipip6_maprule_table_add(&ntii->rules, rulecfg);
+		break;
+	case NSS_TUNIPIP6_BMR_RULE_DEL:
+	case NSS_TUNIPIP6_FMR_RULE_DEL:
+		nss_tunipip6_maprule_table_del(&ntii->rules, rulecfg);
+		break;
+	case NSS_TUNIPIP6_FMR_RULE_FLUSH:
+		nss_tunipip6_maprule_table_flush_fmr(&ntii->rules);
+		break;
+	}
+
+	spin_unlock_bh(&tunipip6_ctx.lock);
+}
+
+/*
+ * nss_tunipip6_maprule_batch_release()
+ *	Free the batch once the sender and all responses are done with it.
+ */
+static void nss_tunipip6_maprule_batch_release(struct kref *ref)
+{
+	struct nss_tunipip6_maprule_batch *batch = container_of(ref, struct nss_tunipip6_maprule_batch, ref);
+
+	kfree(batch);
+}
+
+/*
+ * nss_tunipip6_maprule_batch_cb()
+ *	Response of a map rule message sent as part of a batch.
+ */
+static void nss_tunipip6_maprule_batch_cb(void *app_data, struct nss_tunipip6_msg *tnlmsg)
+{
+	struct nss_tunipip6_maprule_batch *batch = (struct nss_tunipip6_maprule_batch *)app_data;
+
+	if (tnlmsg->cm.response != NSS_CMN_RESPONSE_ACK) {
+		nss_tunipip6_warning("%px: Map rule message type %d failed, error %d\n", batch, tnlmsg->cm.type, tnlmsg->cm.error);
+		atomic_inc(&batch->failed);
+	}
+
+	atomic_dec(&batch->pending);
+	wake_up(&batch->wait);
+	kref_put(&batch->ref, nss_tunipip6_maprule_batch_release);
+}
+
+/*
+ * nss_tunipip6_maprule_batch_tx()
+ *	Send a map rule message of a batch without waiting for its response.
+ *
+ * At most NSS_TUNIPIP6_MAPRULE_WINDOW messages are kept in flight.
+ */
+static bool nss_tunipip6_maprule_batch_tx(struct nss_tunipip6_maprule_batch *batch, struct nss_ctx_instance *nss_ctx,
+					int inner_ifnum, int msg_type, struct nss_connmgr_tunipip6_maprule_cfg *rulecfg)
+{
+	struct nss_tunipip6_msg tnlmsg;
+	nss_tx_status_t status;
+
+	if (!wait_event_timeout(batch->wait, atomic_read(&batch->pending) < NSS_TUNIPIP6_MAPRULE_WINDOW,
+				msecs_to_jiffies(NSS_TUNIPIP6_MAPRULE_TIMEOUT_MSECS))) {
+		nss_tunipip6_warning("%px: Timed out waiting for map rule responses\n", batch);
+		return false;
+	}
+
+	nss_tunipip6_maprule_msg_init(&tnlmsg, inner_ifnum, msg_type, rulecfg, nss_tunipip6_maprule_batch_cb, batch);
+
+	kref_get(&batch->ref);
+	atomic_inc(&batch->pending);
+	status = nss_tunipip6_tx(nss_ctx, &tnlmsg);
+	if (status != NSS_TX_SUCCESS) {
+		nss_tunipip6_warning("%px: Map rule message type %d send error %d\n", batch, msg_type, status);
+		atomic_dec(&batch->pending);
+		kref_put(&batch->ref, nss_tunipip6_maprule_batch_release);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * nss_tunipip6_maprule_program()
+ *	Add or delete all rules of a table in NSS, pipelining the messages.
+ *
+ * The BMR is sent first; NSS handles the messages of an interface in order.
+ */
+static bool nss_tunipip6_maprule_program(struct net_device *netdev, int inner_ifnum,
+					struct nss_tunipip6_maprule_table *table, bool add)
+{
+	struct nss_tunipip6_maprule_batch *batch;
+	struct nss_ctx_instance *nss_ctx;
+	bool sent = true;
+	bool ret;
+	uint32_t i;
+
+	if (!table->bmr_valid && !table->fmr_count) {
+		return true;
+	}
+
+	batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch) {
+		nss_tunipip6_warning("%px: Not able to allocate map rule batch\n", netdev);
+		return false;
+	}
+
+	kref_init(&batch->ref);
+	init_waitqueue_head(&batch->wait);
+	atomic_set(&batch->pending, 0);
+	atomic_set(&batch->failed, 0);
+
+	nss_ctx = nss_tunipip6_get_context();
+	nss_tunipip6_trace("%px: Sending %u FMR(s), BMR %d, add %d to NSS %p\n", netdev, table->fmr_count,
+			table->bmr_valid, add, nss_ctx);
+
+	if (table->bmr_valid) {
+		sent = nss_tunipip6_maprule_batch_tx(batch, nss_ctx, inner_ifnum,
+				add ? NSS_TUNIPIP6_BMR_RULE_ADD : NSS_TUNIPIP6_BMR_RULE_DEL, &table->bmr);
+	}
+
+	for (i = 0; sent && (i < table->fmr_count); i++) {
+		sent = nss_tunipip6_maprule_batch_tx(batch, nss_ctx, inner_ifnum,
+				add ? NSS_TUNIPIP6_FMR_RULE_ADD : NSS_TUNIPIP6_FMR_RULE_DEL, &table->fmr[i]);
+	}
+
+	/*
+	 * Wait for the messages in flight, even after a send failure, so the
+	 * caller can safely follow up with a rollback.
+	 */
+	if (!wait_event_timeout(batch->wait, !atomic_read(&batch->pending),
+				msecs_to_jiffies(NSS_TUNIPIP6_MAPRULE_TIMEOUT_MSECS))) {
+		nss_tunipip6_warning("%px: Timed out waiting for %d map rule responses\n", netdev, atomic_read(&batch->pending));
+		sent = false;
+	}
+
+	ret = sent && !atomic_read(&batch->failed);
+	kref_put(&batch->ref, nss_tunipip6_maprule_batch_release);
+	return ret;
+}
+
+/*
+ * nss_tunipip6_maprule_clear()
+ *	Remove all FMR(s) and optionally the BMR from NSS.
+ */
+static bool nss_tunipip6_maprule_clear(struct net_device *netdev, int inner_ifnum, bool bmr)
+{
+	bool ret = true;
+
+	if (nss_tunipip6_maprule_tx_sync(netdev, inner_ifnum, NSS_TUNIPIP6_FMR_RULE_FLUSH, NULL) != NSS_TX_SUCCESS) {
+		nss_tunipip6_warning("%px: FMR rule flush command error\n", netdev);
+		ret = false;
+	}
+
+	if (!bmr) {
+		return ret;
+	}
+
+	if (nss_tunipip6_maprule_tx_sync(netdev, inner_ifnum, NSS_TUNIPIP6_BMR_RULE_DEL, NULL) != NSS_TX_SUCCESS) {
+		nss_tunipip6_warning("%px: BMR rule delete command error\n", netdev);
+		ret = false;
+	}
+
+	return ret;
+}
+
+/*
+ * nss_tunipip6_maprule_apply()
+ *	Program a validated rule set; either all of it takes effect or none of it.
+ *
+ * With replace the set becomes the complete rule set of the tunnel; otherwise
+ * it is added to the rules already present.
+ */
+static enum nss_connmgr_tunipip6_err_codes nss_tunipip6_maprule_apply(struct net_device *netdev,
+					struct nss_tunipip6_maprule_table *set, bool replace)
+{
+	enum nss_connmgr_tunipip6_err_codes ret = NSS_CONNMGR_TUNIPIP6_SUCCESS;
+	struct nss_tunipip6_maprule_table *cur;
+	int inner_ifnum;
+	uint32_t i;
+
+	inner_ifnum = nss_cmn_get_interface_number_by_dev_and_type(netdev, NSS_DYNAMIC_INTERFACE_TYPE_TUNIPIP6_INNER);
+	if (inner_ifnum < 0) {
+		nss_tunipip6_warning("%px: Invalid inner interface number: %d\n", netdev, inner_ifnum);
+		return NSS_CONNMGR_TUNIPIP6_NO_DEV;
+	}
+
+	cur = vzalloc(sizeof(*cur));
+	if (!cur) {
+		nss_tunipip6_warning("%px: Not able to allocate map rule table\n", netdev);
+		return NSS_CONNMGR_TUNIPIP6_MAPRULE_ADD_FAILURE;
+	}
+
+	mutex_lock(&tunipip6_ctx.maprule_lock);
+	if (!nss_tunipip6_maprule_table_get(netdev, cur)) {
+		ret = NSS_CONNMGR_TUNIPIP6_CONTEXT_FAILURE;
+		goto done;
+	}
+
+	if (!replace) {
+		/*
+		 * Send only the rules which are not present yet, so that a failure
+		 * is undone by deleting exactly the rules sent here.
+		 */
+		nss_tunipip6_maprule_table_subtract(set, cur);
+		if ((set->bmr_valid && cur->bmr_valid) || ((set->fmr_count + cur->fmr_count) > NSS_TUNIPIP6_MAX_FMR)) {
+			nss_tunipip6_warning("%px: Rule set does not fit the rules present\n", netdev);
+			ret = NSS_CONNMGR_TUNIPIP6_INVALID_PARAM;
+			goto done;
+		}
+
+		if (!nss_tunipip6_maprule_program(netdev, inner_ifnum, set, true)) {
+			nss_tunipip6_maprule_program(netdev, inner_ifnum, set, false);
+			ret = NSS_CONNMGR_TUNIPIP6_MAPRULE_ADD_FAILURE;
+			goto done;
+		}
+
+		if (set->bmr_valid) {
+			nss_tunipip6_maprule_table_add(cur, &set->bmr);
+		}
+
+		for (i = 0; i < set->fmr_count; i++) {
+			nss_tunipip6_maprule_table_add(cur, &set->fmr[i]);
+		}
+
+		nss_tunipip6_maprule_table_set(netdev, cur);
+		goto done;
+	}
+
+	if (!nss_tunipip6_maprule_clear(netdev, inner_ifnum, cur->bmr_valid)) {
+		ret = NSS_CONNMGR_TUNIPIP6_FMR_RULE_FLUSH_FAILURE;
+		goto done;
+	}
+
+	if (nss_tunipip6_maprule_program(netdev, inner_ifnum, set, true)) {
+		nss_tunipip6_maprule_table_set(netdev, set);
+		goto done;
+	}
+
+	/*
+	 * Restore the previous rule set. If even that fails leave the tunnel
+	 * without rules, so that the table matches what NSS has.
+	 */
+	nss_tunipip6_warning("%px: Rule set replace failed, restoring %u FMR(s)\n", netdev, cur->fmr_count);
+	nss_tunipip6_maprule_clear(netdev, inner_ifnum, set->bmr_valid);
+	if (!nss_tunipip6_maprule_program(netdev, inner_ifnum, cur, true)) {
+		nss_tunipip6_warning("%px: Not able to restore rule set, flushing all rules\n", netdev);
+		nss_tunipip6_maprule_clear(netdev, inner_ifnum, cur->bmr_valid);
+		memset(cur, 0, sizeof(*cur));
+	}
+
+	nss_tunipip6_maprule_table_set(netdev, cur);
+	ret = NSS_CONNMGR_TUNIPIP6_MAPRULE_ADD_FAILURE;
+
+done:
+	mutex_unlock(&tunipip6_ctx.maprule_lock);
+	vfree(cur);
+	return ret;
+}
+
+/*
+ * nss_connmgr_tunipip6_set_maprules()
+ * 	Add an array of BMR/FMR entries, or replace all entries with it.
+ *
+ * The array is validated before anything is sent to NSS.
+ */
+enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_set_maprules(struct net_device *netdev,
+					struct nss_connmgr_tunipip6_maprule_cfg *rules, uint32_t num, bool replace)
+{
+	enum nss_connmgr_tunipip6_err_codes ret;
+	struct nss_tunipip6_maprule_table *set;
+	int bad;
+
+	if (!netdev || (num && !rules)) {
+		return NSS_CONNMGR_TUNIPIP6_INVALID_PARAM;
+	}
+
+	set = vzalloc(sizeof(*set));
+	if (!set) {
+		nss_tunipip6_warning("%px: Not able to allocate map rule table\n", netdev);
+		return NSS_CONNMGR_TUNIPIP6_MAPRULE_ADD_FAILURE;
+	}
+
+	bad = nss_tunipip6_maprule_table_build(set, rules, num);
+	if (bad >= 0) {
+		nss_tunipip6_warning("%px: Invalid map rule at index %d of %u\n", netdev, bad, num);
+		vfree(set);
+		return NSS_CONNMGR_TUNIPIP6_INVALID_PARAM;
+	}
+
+	ret = nss_tunipip6_maprule_apply(netdev, set, replace);
+	vfree(set);
+	return ret;
+}
+EXPORT_SYMBOL(nss_connmgr_tunipip6_set_maprules);
+
 /*
  * nss_connmgr_tunipip6_add_maprule()
  * 	Add new BMR/FMR entry.
  */
 enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_add_maprule(struct net_device *netdev, struct nss_connmgr_tunipip6_maprule_cfg *rulecfg)
 {
-	struct nss_tunipip6_msg tnlmsg;
-	struct nss_tunipip6_map_rule *rule_add;
-	struct nss_ctx_instance *nss_ctx;
 	nss_tx_status_t status;
 	int inner_ifnum;
 	int msg_type;
@@ -824,44 +1271,19 @@ enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_add_maprule(struct net_
 		return NSS_CONNMGR_TUNIPIP6_INVALID_RULE_TYPE;
 	}
 
-	/*
-	 * Prepare the mapping rule parameter to send to nss
-	 */
-	memset(&tnlmsg, 0, sizeof(struct nss_tunipip6_msg));
-	rule_add = &tnlmsg.msg.map_rule;
-
-	rule_add->ip6_prefix[0] = rulecfg->ipv6_prefix[0];
-	rule_add->ip6_prefix[1] = rulecfg->ipv6_prefix[1];
-	rule_add->ip6_prefix[2] = rulecfg->ipv6_prefix[2];
-	rule_add->ip6_prefix[3] = rulecfg->ipv6_prefix[3];
-	rule_add->ip6_prefix_len = rulecfg->ipv6_prefix_len;
-
-	rule_add->ip4_prefix = rulecfg->ipv4_prefix;
-	rule_add->ip4_prefix_len = rulecfg->ipv4_prefix_len;
-
-	rule_add->ip6_suffix[0] = rulecfg->ipv6_suffix[0];
-	rule_add->ip6_suffix[1] = rulecfg->ipv6_suffix[1];
-	rule_add->ip6_suffix[2] = rulecfg->ipv6_suffix[2];
-	rule_add->ip6_suffix[3] = rulecfg->ipv6_suffix[3];
-	rule_add->ip6_suffix_len = rulecfg->ipv6_suffix_len;
-
-	rule_add->ea_len = rulecfg->ea_len;
-	rule_add->psid_offset = rulecfg->psid_offset;
-
 	/*
 	 * Send maprule add message to encap interface.
 	 */
-	nss_tunipip6_msg_init(&tnlmsg, inner_ifnum, msg_type,
-			sizeof(struct nss_tunipip6_map_rule), NULL, NULL);
-
-	nss_ctx = nss_tunipip6_get_context();
-	nss_tunipip6_trace("%px: Sending IPIP6 tunnel maprule, message type %d add command to NSS %p\n", netdev, msg_type, nss_ctx);
-	status = nss_tunipip6_tx_sync(nss_ctx, &tnlmsg);
+	mutex_lock(&tunipip6_ctx.maprule_lock);
+	status = nss_tunipip6_maprule_tx_sync(netdev, inner_ifnum, msg_type, rulecfg);
 	if (status != NSS_TX_SUCCESS) {
+		mutex_unlock(&tunipip6_ctx.maprule_lock);
 		nss_tunipip6_warning("%px: Tunnel maprule add command error %d\n", netdev, status);
 		return NSS_CONNMGR_TUNIPIP6_MAPRULE_ADD_FAILURE;
 	}
 
+	nss_tunipip6_maprule_table_update(netdev, msg_type, rulecfg);
+	mutex_unlock(&tunipip6_ctx.maprule_lock);
 	return NSS_CONNMGR_TUNIPIP6_SUCCESS;
 }
 EXPORT_SYMBOL(nss_connmgr_tunipip6_add_maprule);
@@ -872,9 +1294,6 @@ EXPORT_SYMBOL(nss_connmgr_tunipip6_add_maprule);
  */
 enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_del_maprule(struct net_device *netdev, struct nss_connmgr_tunipip6_maprule_cfg *rulecfg)
 {
-	struct nss_tunipip6_msg tnlmsg;
-	struct nss_tunipip6_map_rule *map_rule;
-	struct nss_ctx_instance *nss_ctx;
 	nss_tx_status_t status;
 	int inner_ifnum;
 	int msg_type;
@@ -889,22 +1308,10 @@ enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_del_maprule(struct net_
 		return NSS_CONNMGR_TUNIPIP6_NO_DEV;
 	}
 
-	/*
-	 * Intialize tunnel message.
-	 */
-	memset(&tnlmsg, 0, sizeof(struct nss_tunipip6_msg));
-
-	/*
-	 * To delete BMR, only delete message is needed.
-	 */
 	switch (rulecfg->rule_type) {
 	case NSS_CONNMGR_TUNIPIP6_RULE_BMR:
 		msg_type = NSS_TUNIPIP6_BMR_RULE_DEL;
-
-		/*
-		 * To delete BMR, only delete message is needed.
-		 */
-		goto del_bmr;
+		break;
 	case NSS_CONNMGR_TUNIPIP6_RULE_FMR:
 		msg_type = NSS_TUNIPIP6_FMR_RULE_DEL;
 		break;
@@ -913,42 +1320,21 @@ enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_del_maprule(struct net_
 		return NSS_CONNMGR_TUNIPIP6_INVALID_RULE_TYPE;
 	}
 
-	/*
-	 * Prepare the maprule rule parameter to send to NSS
-	 */
-	map_rule = &tnlmsg.msg.map_rule;
-	map_rule->ip6_prefix[0] = rulecfg->ipv6_prefix[0];
-	map_rule->ip6_prefix[1] = rulecfg->ipv6_prefix[1];
-	map_rule->ip6_prefix[2] = rulecfg->ipv6_prefix[2];
-	map_rule->ip6_prefix[3] = rulecfg->ipv6_prefix[3];
-	map_rule->ip6_prefix_len = rulecfg->ipv6_prefix_len;
-
-	map_rule->ip4_prefix = rulecfg->ipv4_prefix;
-	map_rule->ip4_prefix_len = rulecfg->ipv4_prefix_len;
-
-	map_rule->ip6_suffix[0] = rulecfg->ipv6_suffix[0];
-	map_rule->ip6_suffix[1] = rulecfg->ipv6_suffix[1];
-	map_rule->ip6_suffix[2] = rulecfg->ipv6_suffix[2];
-	map_rule->ip6_suffix[3] = rulecfg->ipv6_suffix[3];
-	map_rule->ip6_suffix_len = rulecfg->ipv6_suffix_len;
-
-	map_rule->ea_len = rulecfg->ea_len;
-	map_rule->psid_offset = rulecfg->psid_offset;
-
-del_bmr:
 	/*
 	 * Send map rule delete message to encap interface.
+	 * To delete BMR, only delete message is needed.
 	 */
-	nss_tunipip6_msg_init(&tnlmsg, inner_ifnum, msg_type,
-			sizeof(struct nss_tunipip6_map_rule), NULL, NULL);
-	nss_ctx = nss_tunipip6_get_context();
-	nss_tunipip6_trace("%px: Sending IPIP6 tunnel maprule, message type %d delete command to NSS %p\n", netdev, msg_type, nss_ctx);
-	status = nss_tunipip6_tx_sync(nss_ctx, &tnlmsg);
+	mutex_lock(&tunipip6_ctx.maprule_lock);
+	status = nss_tunipip6_maprule_tx_sync(netdev, inner_ifnum, msg_type,
+			(msg_type == NSS_TUNIPIP6_BMR_RULE_DEL) ? NULL : rulecfg);
 	if (status != NSS_TX_SUCCESS) {
+		mutex_unlock(&tunipip6_ctx.maprule_lock);
 		nss_tunipip6_warning("%px: Tunnel maprule delete command error %d\n", netdev, status);
 		return NSS_CONNMGR_TUNIPIP6_MAPRULE_DEL_FAILURE;
 	}
 
+	nss_tunipip6_maprule_table_update(netdev, msg_type, rulecfg);
+	mutex_unlock(&tunipip6_ctx.maprule_lock);
 	return NSS_CONNMGR_TUNIPIP6_SUCCESS;
 }
 EXPORT_SYMBOL(nss_connmgr_tunipip6_del_maprule);
@@ -959,8 +1345,6 @@ EXPORT_SYMBOL(nss_connmgr_tunipip6_del_maprule);
  */
 enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_flush_fmr_rule(struct net_device *netdev)
 {
-	struct nss_tunipip6_msg tnlmsg;
-	struct nss_ctx_instance *nss_ctx;
 	nss_tx_status_t status;
 	int inner_ifnum;
 
@@ -977,17 +1361,16 @@ enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_flush_fmr_rule(struct n
 		return NSS_CONNMGR_TUNIPIP6_NO_DEV;
 	}
 
-	nss_tunipip6_msg_init(&tnlmsg, inner_ifnum, NSS_TUNIPIP6_FMR_RULE_FLUSH,
-			0, NULL, NULL);
-
-	nss_ctx = nss_tunipip6_get_context();
-	nss_tunipip6_trace("%px: Sending IPIP6 tunnel FMR rule flush command to NSS %p\n", netdev, nss_ctx);
-	status = nss_tunipip6_tx_sync(nss_ctx, &tnlmsg);
+	mutex_lock(&tunipip6_ctx.maprule_lock);
+	status = nss_tunipip6_maprule_tx_sync(netdev, inner_ifnum, NSS_TUNIPIP6_FMR_RULE_FLUSH, NULL);
 	if (status != NSS_TX_SUCCESS) {
+		mutex_unlock(&tunipip6_ctx.maprule_lock);
 		nss_tunipip6_warning("%px: FMR rule flush command error %d\n", netdev, status);
 		return NSS_CONNMGR_TUNIPIP6_FMR_RULE_FLUSH_FAILURE;
 	}
 
+	nss_tunipip6_maprule_table_update(netdev, NSS_TUNIPIP6_FMR_RULE_FLUSH, NULL);
+	mutex_unlock(&tunipip6_ctx.maprule_lock);
 	return NSS_CONNMGR_TUNIPIP6_SUCCESS;
 }
 EXPORT_SYMBOL(nss_connmgr_tunipip6_flush_fmr_rule);
@@ -1105,6 +1488,7 @@ int __init nss_tunipip6_init_module(void)
 	 */
 	INIT_LIST_HEAD(&tunipip6_ctx.dev_list);
 	spin_lock_init(&tunipip6_ctx.lock);
+	mutex_init(&tunipip6_ctx.maprule_lock);
 
 	/*
 	 * Create the debugfs directory for statistics.
@@ -1130,6 +1514,14 @@ int __init nss_tunipip6_init_module(void)
 	nss_tunipip6_sysctl_register();
 	nss_tunipip6_trace("Sysctl registerd\n");
 
+	/*
+	 * Register generic netlink for bulk map rule programming.
+	 */
+	if (!nss_tunipip6_nl_register()) {
+		nss_tunipip6_warning("Failed to register generic netlink\n");
+	}
+
+
 	return 0;
 }
 
@@ -1149,6 +1541,13 @@ void __exit nss_tunipip6_exit_module(void)
 	}
 #endif
 
+	/*
+	 * Stop taking map rule requests before the instances they refer to go away.
+	 */
+	nss_tunipip6_nl_unregister();
+	nss_tunipip6_sysctl_unregister();
+	nss_tunipip6_trace("Generic netlink and sysctl unregisterd\n");
+
 	/*
 	 * Free Host and NSS tunipip6 instances.
 	 */
@@ -1167,12 +1566,6 @@ void __exit nss_tunipip6_exit_module(void)
 		nss_tunipip6_trace("Netdev Notifier unregisterd\n");
 	}
 
-	/*
-	 * Unregister sysctl.
-	 */
-	nss_tunipip6_sysctl_unregister();
-	nss_tunipip6_trace("Sysctl unregisterd\n");
-
 	nss_tunipip6_info("module unloaded\n");
 }
 
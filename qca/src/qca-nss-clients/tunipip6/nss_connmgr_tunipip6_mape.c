@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * MAP-E (RFC 7597) rule matching and address synthesis, without kernel dependencies.
+ */
+#include "nss_connmgr_tunipip6_mape.h"
+
+/*
+ * nss_tunipip6_mape_mask()
+ *	Returns a host order IPv4 mask of the given prefix length.
+ */
+static inline uint32_t nss_tunipip6_mape_mask(uint32_t len)
+{
+	return len ? ~0U << (32 - len) : 0;
+}
+
+/*
+ * nss_tunipip6_mape_set_bits()
+ *	Write the low len bits of val into a host order IPv6 address, starting at bit pos.
+ */
+static void nss_tunipip6_mape_set_bits(uint32_t *addr, uint32_t pos, uint32_t len, uint64_t val)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		uint32_t bit = pos + i;
+		uint32_t word = bit / 32;
+		uint32_t shift = 31 - (bit % 32);
+
+		if ((val >> (len - 1 - i)) & 1) {
+			addr[word] |= (1U << shift);
+		} else {
+			addr[word] &= ~(1U << shift);
+		}
+	}
+}
+
+/*
+ * nss_tunipip6_mape_psid_len()
+ *	Number of PSID bits carried in the EA bits of a rule.
+ */
+uint32_t nss_tunipip6_mape_psid_len(const struct nss_tunipip6_mape_rule *rule)
+{
+	if ((rule->ea_len + rule->ipv4_prefix_len) <= 32) {
+		return 0;
+	}
+
+	return rule->ea_len + rule->ipv4_prefix_len - 32;
+}
+
+/*
+ * nss_tunipip6_mape_valid()
+ *	Returns true if the prefix, EA and PSID bounds of the rule are consistent.
+ */
+bool nss_tunipip6_mape_valid(const struct nss_tunipip6_mape_rule *rule)
+{
+	if ((rule->ipv4_prefix_len > 32) || (rule->ipv6_prefix_len > 128)) {
+		return false;
+	}
+
+	if ((rule->ea_len > NSS_TUNIPIP6_MAPRULE_MAX_EA_LEN) ||
+			(rule->psid_offset > NSS_TUNIPIP6_MAPRULE_MAX_PSID_OFFSET)) {
+		return false;
+	}
+
+	/*
+	 * End-user IPv6 prefix can not extend into the interface identifier,
+	 * and the PSID has to fit in the port after the offset bits.
+	 */
+	if ((rule->ipv6_prefix_len + rule->ea_len) > 64) {
+		return false;
+	}
+
+	if ((rule->psid_offset + nss_tunipip6_mape_psid_len(rule)) > 16) {
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * nss_tunipip6_mape_match()
+ *	Returns true if the IPv4 prefix of the rule covers the address.
+ */
+bool nss_tunipip6_mape_match(const struct nss_tunipip6_mape_rule *rule, uint32_t ipv4_addr)
+{
+	return !((ipv4_addr ^ rule->ipv4_prefix) & nss_tunipip6_mape_mask(rule->ipv4_prefix_len));
+}
+
+/*
+ * nss_tunipip6_mape_addr()
+ *	Compute the MAP IPv6 address of an IPv4 address and port under the given rule.
+ *
+ * Layout is rule IPv6 prefix | EA bits | zero subnet-id | 16 bit zero | IPv4 address | PSID.
+ * Rules added through the single rule API are not validated, so check the rule here.
+ */
+bool nss_tunipip6_mape_addr(const struct nss_tunipip6_mape_rule *rule, uint32_t ipv4_addr,
+				uint16_t port, uint32_t *ipv6_addr)
+{
+	uint32_t psid_len = nss_tunipip6_mape_psid_len(rule);
+	uint32_t ipv4_len = rule->ipv4_prefix_len;
+	uint32_t ea_len = rule->ea_len;
+	uint32_t psid = 0;
+	uint64_t ea;
+	int i;
+
+	if (!nss_tunipip6_mape_valid(rule)) {
+		return false;
+	}
+
+	for (i = 0; i < 4; i++) {
+		int bits = (int)rule->ipv6_prefix_len - (i * 32);
+
+		bits = (bits < 0) ? 0 : ((bits > 32) ? 32 : bits);
+		ipv6_addr[i] = rule->ipv6_prefix[i] & nss_tunipip6_mape_mask(bits);
+	}
+
+	if (!psid_len) {
+		/*
+		 * The rule maps an IPv4 prefix; EA bits are the bits following the rule IPv4 prefix.
+		 */
+		ea = ea_len ? (ipv4_addr >> (32 - ipv4_len - ea_len)) & ((1ULL << ea_len) - 1) : 0;
+		ipv4_addr &= nss_tunipip6_mape_mask(ipv4_len + ea_len);
+	} else {
+		/*
+		 * The rule maps a shared IPv4 address; EA bits are the IPv4 suffix followed by the PSID
+		 * taken from the port, after skipping psid_offset bits.
+		 */
+		psid = (port >> (16 - rule->psid_offset - psid_len)) & ((1U << psid_len) - 1);
+		ea = ((uint64_t)(ipv4_addr & ~nss_tunipip6_mape_mask(ipv4_len)) << psid_len) | psid;
+	}
+
+	nss_tunipip6_mape_set_bits(ipv6_addr, rule->ipv6_prefix_len, ea_len, ea);
+
+	ipv6_addr[2] = ipv4_addr >> 16;
+	ipv6_addr[3] = (ipv4_addr << 16) | psid;
+	return true;
+}
+
+/*
+ * nss_tunipip6_mape_fmr_lookup()
+ *	Returns the index of the FMR with the longest IPv4 prefix covering the address, or -1.
+ */
+int nss_tunipip6_mape_fmr_lookup(const struct nss_tunipip6_mape_rule *fmr, uint32_t num, uint32_t ipv4_addr)
+{
+	int best = -1;
+	uint32_t i;
+
+	for (i = 0; i < num; i++) {
+		if (!nss_tunipip6_mape_match(&fmr[i], ipv4_addr)) {
+			continue;
+		}
+
+		if ((best < 0) || (fmr[i].ipv4_prefix_len > fmr[best].ipv4_prefix_len)) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * nss_tunipip6_mape_encap()
+ *	Compute the IPv6 destination of an IPv4 packet.
+ *
+ * Returns false if no FMR matches; the packet is then sent to the border relay.
+ */
+bool nss_tunipip6_mape_encap(const struct nss_tunipip6_mape_rule *fmr, uint32_t num, uint32_t ipv4_daddr,
+				uint16_t dport, uint32_t *ipv6_daddr)
+{
+	int idx = nss_tunipip6_mape_fmr_lookup(fmr, num, ipv4_daddr);
+
+	if (idx < 0) {
+		return false;
+	}
+
+	return nss_tunipip6_mape_addr(&fmr[idx], ipv4_daddr, dport, ipv6_daddr);
+}
+
+/*
+ * nss_tunipip6_mape_decap()
+ *	Returns true if the IPv6 source of a decapsulated packet is the MAP address
+ *	of its inner IPv4 source and port, as derived from the matching FMR.
+ */
+bool nss_tunipip6_mape_decap(const struct nss_tunipip6_mape_rule *fmr, uint32_t num, const uint32_t *ipv6_saddr,
+				uint32_t ipv4_saddr, uint16_t sport)
+{
+	uint32_t expected[4];
+
+	if (!nss_tunipip6_mape_encap(fmr, num, ipv4_saddr, sport, expected)) {
+		return false;
+	}
+
+	return (expected[0] == ipv6_saddr[0]) && (expected[1] == ipv6_saddr[1]) &&
+		(expected[2] == ipv6_saddr[2]) && (expected[3] == ipv6_saddr[3]);
+}
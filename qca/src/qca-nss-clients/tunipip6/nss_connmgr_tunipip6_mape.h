@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __NSS_CONNMGR_TUNIPIP6_MAPE_H_
+#define __NSS_CONNMGR_TUNIPIP6_MAPE_H_
+
+/*
+ * MAP-E (RFC 7597) rule matching and address synthesis.
+ *
+ * Nothing here depends on the kernel, so the same file is built into the
+ * module and into the host test under test/.
+ */
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#define NSS_TUNIPIP6_MAPRULE_MAX_EA_LEN 48	/* Maximum embedded address bits of a rule. */
+#define NSS_TUNIPIP6_MAPRULE_MAX_PSID_OFFSET 15	/* Maximum PSID offset of a rule. */
+
+/*
+ * Address fields of a BMR/FMR, in host byte order.
+ */
+struct nss_tunipip6_mape_rule {
+	uint32_t ipv6_prefix[4];	/* Rule IPv6 prefix */
+	uint32_t ipv4_prefix;		/* Rule IPv4 prefix */
+	uint32_t ipv6_prefix_len;	/* Rule IPv6 prefix length */
+	uint32_t ipv4_prefix_len;	/* Rule IPv4 prefix length */
+	uint32_t ea_len;		/* Embedded address bits length */
+	uint32_t psid_offset;		/* PSID offset in the port */
+};
+
+uint32_t nss_tunipip6_mape_psid_len(const struct nss_tunipip6_mape_rule *rule);
+bool nss_tunipip6_mape_valid(const struct nss_tunipip6_mape_rule *rule);
+bool nss_tunipip6_mape_match(const struct nss_tunipip6_mape_rule *rule, uint32_t ipv4_addr);
+bool nss_tunipip6_mape_addr(const struct nss_tunipip6_mape_rule *rule, uint32_t ipv4_addr,
+				uint16_t port, uint32_t *ipv6_addr);
+
+/*
+ * Software reference of the FMR handling done by the offload engine.
+ */
+int nss_tunipip6_mape_fmr_lookup(const struct nss_tunipip6_mape_rule *fmr, uint32_t num, uint32_t ipv4_addr);
+bool nss_tunipip6_mape_encap(const struct nss_tunipip6_mape_rule *fmr, uint32_t num, uint32_t ipv4_daddr,
+				uint16_t dport, uint32_t *ipv6_daddr);
+bool nss_tunipip6_mape_decap(const struct nss_tunipip6_mape_rule *fmr, uint32_t num, const uint32_t *ipv6_saddr,
+				uint32_t ipv4_saddr, uint16_t sport);
+
+#endif /* __NSS_CONNMGR_TUNIPIP6_MAPE_H_ */
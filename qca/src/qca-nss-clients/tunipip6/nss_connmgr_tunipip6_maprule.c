@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Host copy of the map rules programmed for a tunnel.
+ *
+ * Matching and address synthesis live in nss_connmgr_tunipip6_mape.c, which
+ * builds on a host as well; the functions here only adapt the rule table.
+ */
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/netdevice.h>
+#include "nss_connmgr_tunipip6.h"
+#include "nss_connmgr_tunipip6_mape.h"
+#include "nss_connmgr_tunipip6_maprule.h"
+
+/*
+ * nss_tunipip6_maprule_to_mape()
+ *	Copy the address fields of a rule for the MAP-E helpers.
+ */
+static void nss_tunipip6_maprule_to_mape(struct nss_connmgr_tunipip6_maprule_cfg *cfg, struct nss_tunipip6_mape_rule *rule)
+{
+	memcpy(rule->ipv6_prefix, cfg->ipv6_prefix, sizeof(rule->ipv6_prefix));
+	rule->ipv4_prefix = cfg->ipv4_prefix;
+	rule->ipv6_prefix_len = cfg->ipv6_prefix_len;
+	rule->ipv4_prefix_len = cfg->ipv4_prefix_len;
+	rule->ea_len = cfg->ea_len;
+	rule->psid_offset = cfg->psid_offset;
+}
+
+/*
+ * nss_tunipip6_maprule_validate()
+ *	Returns true if the rule can be programmed.
+ */
+bool nss_tunipip6_maprule_validate(struct nss_connmgr_tunipip6_maprule_cfg *rule)
+{
+	struct nss_tunipip6_mape_rule mape;
+
+	if ((rule->rule_type != NSS_CONNMGR_TUNIPIP6_RULE_BMR) &&
+			(rule->rule_type != NSS_CONNMGR_TUNIPIP6_RULE_FMR)) {
+		return false;
+	}
+
+	if (rule->ipv6_suffix_len > 128) {
+		return false;
+	}
+
+	nss_tunipip6_maprule_to_mape(rule, &mape);
+	return nss_tunipip6_mape_valid(&mape);
+}
+
+/*
+ * nss_tunipip6_maprule_equal()
+ *	Returns true if both rules have the same parameters.
+ */
+bool nss_tunipip6_maprule_equal(struct nss_connmgr_tunipip6_maprule_cfg *a, struct nss_connmgr_tunipip6_maprule_cfg *b)
+{
+	return (a->rule_type == b->rule_type) &&
+		(a->ipv6_prefix[0] == b->ipv6_prefix[0]) && (a->ipv6_prefix[1] == b->ipv6_prefix[1]) &&
+		(a->ipv6_prefix[2] == b->ipv6_prefix[2]) && (a->ipv6_prefix[3] == b->ipv6_prefix[3]) &&
+		(a->ipv6_prefix_len == b->ipv6_prefix_len) &&
+		(a->ipv4_prefix == b->ipv4_prefix) && (a->ipv4_prefix_len == b->ipv4_prefix_len) &&
+		(a->ipv6_suffix[0] == b->ipv6_suffix[0]) && (a->ipv6_suffix[1] == b->ipv6_suffix[1]) &&
+		(a->ipv6_suffix[2] == b->ipv6_suffix[2]) && (a->ipv6_suffix[3] == b->ipv6_suffix[3]) &&
+		(a->ipv6_suffix_len == b->ipv6_suffix_len) &&
+		(a->ea_len == b->ea_len) && (a->psid_offset == b->psid_offset);
+}
+
+/*
+ * nss_tunipip6_maprule_table_find()
+ *	Returns true if the rule is present in the table.
+ */
+bool nss_tunipip6_maprule_table_find(struct nss_tunipip6_maprule_table *table, struct nss_connmgr_tunipip6_maprule_cfg *rule)
+{
+	uint32_t i;
+
+	if (rule->rule_type == NSS_CONNMGR_TUNIPIP6_RULE_BMR) {
+		return table->bmr_valid && nss_tunipip6_maprule_equal(&table->bmr, rule);
+	}
+
+	for (i = 0; i < table->fmr_count; i++) {
+		if (nss_tunipip6_maprule_equal(&table->fmr[i], rule)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * nss_tunipip6_maprule_table_add()
+ *	Add a rule to the table; adding a rule which is already present succeeds.
+ */
+bool nss_tunipip6_maprule_table_add(struct nss_tunipip6_maprule_table *table, struct nss_connmgr_tunipip6_maprule_cfg *rule)
+{
+	if (nss_tunipip6_maprule_table_find(table, rule)) {
+		return true;
+	}
+
+	if (rule->rule_type == NSS_CONNMGR_TUNIPIP6_RULE_BMR) {
+		if (table->bmr_valid) {
+			return false;
+		}
+
+		table->bmr = *rule;
+		table->bmr_valid = true;
+		return true;
+	}
+
+	if (table->fmr_count == NSS_TUNIPIP6_MAX_FMR) {
+		return false;
+	}
+
+	table->fmr[table->fmr_count++] = *rule;
+	return true;
+}
+
+/*
+ * nss_tunipip6_maprule_table_del()
+ *	Delete a rule from the table. Only the rule type is used to delete the BMR.
+ */
+bool nss_tunipip6_maprule_table_del(struct nss_tunipip6_maprule_table *table, struct nss_connmgr_tunipip6_maprule_cfg *rule)
+{
+	uint32_t i;
+
+	if (rule->rule_type == NSS_CONNMGR_TUNIPIP6_RULE_BMR) {
+		if (!table->bmr_valid) {
+			return false;
+		}
+
+		table->bmr_valid = false;
+		return true;
+	}
+
+	for (i = 0; i < table->fmr_count; i++) {
+		if (nss_tunipip6_maprule_equal(&table->fmr[i], rule)) {
+			table->fmr[i] = table->fmr[--table->fmr_count];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * nss_tunipip6_maprule_table_flush_fmr()
+ *	Remove all FMR entries from the table.
+ */
+void nss_tunipip6_maprule_table_flush_fmr(struct nss_tunipip6_maprule_table *table)
+{
+	table->fmr_count = 0;
+}
+
+/*
+ * nss_tunipip6_maprule_table_subtract()
+ *	Remove from the set every rule that is already present in the table.
+ */
+void nss_tunipip6_maprule_table_subtract(struct nss_tunipip6_maprule_table *set, struct nss_tunipip6_maprule_table *table)
+{
+	uint32_t i = 0;
+
+	if (set->bmr_valid && table->bmr_valid && nss_tunipip6_maprule_equal(&set->bmr, &table->bmr)) {
+		set->bmr_valid = false;
+	}
+
+	while (i < set->fmr_count) {
+		if (nss_tunipip6_maprule_table_find(table, &set->fmr[i])) {
+			set->fmr[i] = set->fmr[--set->fmr_count];
+			continue;
+		}
+
+		i++;
+	}
+}
+
+/*
+ * nss_tunipip6_maprule_table_build()
+ *	Validate a rule array in one pass and build a table out of it.
+ *
+ * Returns -1 on success, otherwise the index of the first rule that is invalid,
+ * is a second BMR or does not fit in the table.
+ */
+int nss_tunipip6_maprule_table_build(struct nss_tunipip6_maprule_table *table,
+				struct nss_connmgr_tunipip6_maprule_cfg *rules, uint32_t num)
+{
+	uint32_t i;
+
+	memset(table, 0, sizeof(*table));
+
+	for (i = 0; i < num; i++) {
+		if (!nss_tunipip6_maprule_validate(&rules[i])) {
+			return i;
+		}
+
+		if (!nss_tunipip6_maprule_table_add(table, &rules[i])) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * nss_tunipip6_maprule_fmr_lookup()
+ *	Find the FMR with the longest IPv4 prefix covering the address.
+ */
+struct nss_connmgr_tunipip6_maprule_cfg *nss_tunipip6_maprule_fmr_lookup(struct nss_tunipip6_maprule_table *table,
+				uint32_t ipv4_addr)
+{
+	struct nss_connmgr_tunipip6_maprule_cfg *best = NULL;
+	struct nss_tunipip6_mape_rule mape;
+	uint32_t i;
+
+	for (i = 0; i < table->fmr_count; i++) {
+		nss_tunipip6_maprule_to_mape(&table->fmr[i], &mape);
+		if (!nss_tunipip6_mape_match(&mape, ipv4_addr)) {
+			continue;
+		}
+
+		if (!best || (table->fmr[i].ipv4_prefix_len > best->ipv4_prefix_len)) {
+			best = &table->fmr[i];
+		}
+	}
+
+	return best;
+}
+
+/*
+ * nss_tunipip6_maprule_encap()
+ *	Compute the IPv6 destination of an IPv4 packet.
+ *
+ * Returns false if no FMR matches; the packet is then sent to the border relay.
+ */
+bool nss_tunipip6_maprule_encap(struct nss_tunipip6_maprule_table *table, uint32_t ipv4_daddr,
+				uint16_t dport, uint32_t *ipv6_daddr)
+{
+	struct nss_connmgr_tunipip6_maprule_cfg *fmr;
+	struct nss_tunipip6_mape_rule mape;
+
+	fmr = nss_tunipip6_maprule_fmr_lookup(table, ipv4_daddr);
+	if (!fmr) {
+		return false;
+	}
+
+	nss_tunipip6_maprule_to_mape(fmr, &mape);
+	return nss_tunipip6_mape_encap(&mape, 1, ipv4_daddr, dport, ipv6_daddr);
+}
+
+/*
+ * nss_tunipip6_maprule_decap()
+ *	Returns true if the IPv6 source of a decapsulated packet is the MAP address
+ *	of its inner IPv4 source and port, as derived from the matching FMR.
+ */
+bool nss_tunipip6_maprule_decap(struct nss_tunipip6_maprule_table *table, uint32_t *ipv6_saddr,
+				uint32_t ipv4_saddr, uint16_t sport)
+{
+	struct nss_connmgr_tunipip6_maprule_cfg *fmr;
+	struct nss_tunipip6_mape_rule mape;
+
+	fmr = nss_tunipip6_maprule_fmr_lookup(table, ipv4_saddr);
+	if (!fmr) {
+		return false;
+	}
+
+	nss_tunipip6_maprule_to_mape(fmr, &mape);
+	return nss_tunipip6_mape_decap(&mape, 1, ipv6_saddr, ipv4_saddr, sport);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __NSS_CONNMGR_TUNIPIP6_MAPRULE_H_
+#define __NSS_CONNMGR_TUNIPIP6_MAPRULE_H_
+
+#define NSS_TUNIPIP6_MAX_FMR 255		/* Maximum number of forward mapping rule (FMR). */
+
+/*
+ * Host copy of the BMR/FMR set programmed for a tunnel.
+ *
+ * All addresses are in host byte order, as in nss_connmgr_tunipip6_maprule_cfg.
+ */
+struct nss_tunipip6_maprule_table {
+	struct nss_connmgr_tunipip6_maprule_cfg bmr;			/* Basic mapping rule */
+	struct nss_connmgr_tunipip6_maprule_cfg fmr[NSS_TUNIPIP6_MAX_FMR];	/* Forward mapping rules */
+	uint32_t fmr_count;						/* Number of valid entries in fmr */
+	bool bmr_valid;							/* BMR is present */
+};
+
+bool nss_tunipip6_maprule_validate(struct nss_connmgr_tunipip6_maprule_cfg *rule);
+bool nss_tunipip6_maprule_equal(struct nss_connmgr_tunipip6_maprule_cfg *a, struct nss_connmgr_tunipip6_maprule_cfg *b);
+
+bool nss_tunipip6_maprule_table_find(struct nss_tunipip6_maprule_table *table, struct nss_connmgr_tunipip6_maprule_cfg *rule);
+bool nss_tunipip6_maprule_table_add(struct nss_tunipip6_maprule_table *table, struct nss_connmgr_tunipip6_maprule_cfg *rule);
+bool nss_tunipip6_maprule_table_del(struct nss_tunipip6_maprule_table *table, struct nss_connmgr_tunipip6_maprule_cfg *rule);
+void nss_tunipip6_maprule_table_flush_fmr(struct nss_tunipip6_maprule_table *table);
+void nss_tunipip6_maprule_table_subtract(struct nss_tunipip6_maprule_table *set, struct nss_tunipip6_maprule_table *table);
+int nss_tunipip6_maprule_table_build(struct nss_tunipip6_maprule_table *table,
+				struct nss_connmgr_tunipip6_maprule_cfg *rules, uint32_t num);
+
+/*
+ * Software reference of the MAP-E rule matching done by the offload engine.
+ */
+struct nss_connmgr_tunipip6_maprule_cfg *nss_tunipip6_maprule_fmr_lookup(struct nss_tunipip6_maprule_table *table,
+				uint32_t ipv4_addr);
+bool nss_tunipip6_maprule_encap(struct nss_tunipip6_maprule_table *table, uint32_t ipv4_daddr,
+				uint16_t dport, uint32_t *ipv6_daddr);
+bool nss_tunipip6_maprule_decap(struct nss_tunipip6_maprule_table *table, uint32_t *ipv6_saddr,
+				uint32_t ipv4_saddr, uint16_t sport);
+
+/*
+ * Bulk programming; the array is validated as a whole before anything reaches NSS.
+ */
+enum nss_connmgr_tunipip6_err_codes nss_connmgr_tunipip6_set_maprules(struct net_device *netdev,
+				struct nss_connmgr_tunipip6_maprule_cfg *rules, uint32_t num, bool replace);
+
+#endif /* __NSS_CONNMGR_TUNIPIP6_MAPRULE_H_ */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Generic netlink interface to program a whole BMR/FMR set in one request.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/netdevice.h>
+#include <net/genetlink.h>
+#include <nss_api_if.h>
+#include "nss_connmgr_tunipip6.h"
+#include "nss_connmgr_tunipip6_priv.h"
+#include "nss_connmgr_tunipip6_nl.h"
+
+/*
+ * nss_tunipip6_nl_policy
+ *	Policy attributes
+ */
+static struct nla_policy nss_tunipip6_nl_policy[NSS_TUNIPIP6_NL_ATTR_MAX + 1] = {
+	[NSS_TUNIPIP6_NL_ATTR_IFNAME]	= { .type = NLA_NUL_STRING, .len = IFNAMSIZ - 1 },
+	[NSS_TUNIPIP6_NL_ATTR_REPLACE]	= { .type = NLA_FLAG, },
+	[NSS_TUNIPIP6_NL_ATTR_RULES]	= { .type = NLA_NESTED, },
+	[NSS_TUNIPIP6_NL_ATTR_RULE]	= { .len = sizeof(struct nss_tunipip6_nl_maprule) },
+};
+
+/*
+ * nss_tunipip6_nl_errno()
+ *	Map a connection manager error code to an errno.
+ */
+static int nss_tunipip6_nl_errno(enum nss_connmgr_tunipip6_err_codes status)
+{
+	switch (status) {
+	case NSS_CONNMGR_TUNIPIP6_SUCCESS:
+		return 0;
+	case NSS_CONNMGR_TUNIPIP6_INVALID_PARAM:
+	case NSS_CONNMGR_TUNIPIP6_INVALID_RULE_TYPE:
+		return -EINVAL;
+	case NSS_CONNMGR_TUNIPIP6_NO_DEV:
+	case NSS_CONNMGR_TUNIPIP6_CONTEXT_FAILURE:
+		return -ENODEV;
+	default:
+		return -EIO;
+	}
+}
+
+/*
+ * nss_tunipip6_nl_set_maprules()
+ *	Handler of NSS_TUNIPIP6_NL_CMD_SET_MAPRULES.
+ */
+static int nss_tunipip6_nl_set_maprules(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nss_connmgr_tunipip6_maprule_cfg *rules = NULL;
+	enum nss_connmgr_tunipip6_err_codes status;
+	struct nss_tunipip6_nl_maprule *nlrule;
+	struct net_device *netdev;
+	struct nlattr *nla;
+	uint32_t num = 0;
+	bool replace;
+	int rem;
+
+	if (!info->attrs[NSS_TUNIPIP6_NL_ATTR_IFNAME]) {
+		nss_tunipip6_warning("%px: Tunnel name is missing\n", info);
+		return -EINVAL;
+	}
+
+	replace = nla_get_flag(info->attrs[NSS_TUNIPIP6_NL_ATTR_REPLACE]);
+
+	/*
+	 * Size the array first; the NSS can hold one BMR and NSS_TUNIPIP6_MAX_FMR FMR(s).
+	 */
+	if (info->attrs[NSS_TUNIPIP6_NL_ATTR_RULES]) {
+		nla_for_each_nested(nla, info->attrs[NSS_TUNIPIP6_NL_ATTR_RULES], rem) {
+			if ((nla_type(nla) != NSS_TUNIPIP6_NL_ATTR_RULE) || (nla_len(nla) < sizeof(*nlrule))) {
+				nss_tunipip6_warning("%px: Malformed rule attribute at index %u\n", info, num);
+				return -EINVAL;
+			}
+
+			if (++num > (NSS_TUNIPIP6_MAX_FMR + 1)) {
+				nss_tunipip6_warning("%px: Too many rules\n", info);
+				return -E2BIG;
+			}
+		}
+	}
+
+	/*
+	 * An empty set is only meaningful as a replace, where it removes all rules.
+	 */
+	if (!num && !replace) {
+		return 0;
+	}
+
+	if (num) {
+		rules = kmalloc_array(num, sizeof(*rules), GFP_KERNEL);
+		if (!rules) {
+			return -ENOMEM;
+		}
+
+		num = 0;
+		nla_for_each_nested(nla, info->attrs[NSS_TUNIPIP6_NL_ATTR_RULES], rem) {
+			nlrule = nla_data(nla);
+			memset(&rules[num], 0, sizeof(rules[num]));
+			rules[num].rule_type = nlrule->rule_type;
+			memcpy(rules[num].ipv6_prefix, nlrule->ipv6_prefix, sizeof(nlrule->ipv6_prefix));
+			rules[num].ipv6_prefix_len = nlrule->ipv6_prefix_len;
+			rules[num].ipv4_prefix = nlrule->ipv4_prefix;
+			rules[num].ipv4_prefix_len = nlrule->ipv4_prefix_len;
+			memcpy(rules[num].ipv6_suffix, nlrule->ipv6_suffix, sizeof(nlrule->ipv6_suffix));
+			rules[num].ipv6_suffix_len = nlrule->ipv6_suffix_len;
+			rules[num].ea_len = nlrule->ea_len;
+			rules[num].psid_offset = nlrule->psid_offset;
+			num++;
+		}
+	}
+
+	netdev = dev_get_by_name(&init_net, nla_data(info->attrs[NSS_TUNIPIP6_NL_ATTR_IFNAME]));
+	if (!netdev) {
+		nss_tunipip6_warning("%px: Tunnel %s not found\n", info, (char *)nla_data(info->attrs[NSS_TUNIPIP6_NL_ATTR_IFNAME]));
+		kfree(rules);
+		return -ENODEV;
+	}
+
+	status = nss_connmgr_tunipip6_set_maprules(netdev, rules, num, replace);
+	if (status != NSS_CONNMGR_TUNIPIP6_SUCCESS) {
+		nss_tunipip6_warning("%px: Not able to set %u rule(s), replace %d, error %d\n", netdev, num, replace, status);
+	}
+
+	dev_put(netdev);
+	kfree(rules);
+	return nss_tunipip6_nl_errno(status);
+}
+
+/*
+ * tunipip6 generic netlink operations
+ */
+static const struct genl_ops nss_tunipip6_nl_ops[] = {
+	{
+		.cmd = NSS_TUNIPIP6_NL_CMD_SET_MAPRULES,
+		.doit = nss_tunipip6_nl_set_maprules,
+		.validate = GENL_DONT_VALIDATE_STRICT | GENL_DONT_VALIDATE_DUMP,
+		.flags = GENL_ADMIN_PERM,
+	},
+};
+
+/*
+ * tunipip6 generic netlink family
+ */
+static struct genl_family nss_tunipip6_nl_family = {
+	.name		= NSS_TUNIPIP6_NL_FAMILY,
+	.version	= NSS_TUNIPIP6_NL_VERSION,
+	.hdrsize	= 0,
+	.maxattr	= NSS_TUNIPIP6_NL_ATTR_MAX,
+	.policy		= nss_tunipip6_nl_policy,
+	.netnsok	= false,
+	.module		= THIS_MODULE,
+	.ops		= nss_tunipip6_nl_ops,
+	.n_ops		= ARRAY_SIZE(nss_tunipip6_nl_ops),
+};
+
+/*
+ * nss_tunipip6_nl_register()
+ *	Register generic netlink family for tunipip6.
+ */
+bool nss_tunipip6_nl_register(void)
+{
+	int err;
+
+	err = genl_register_family(&nss_tunipip6_nl_family);
+	if (err) {
+		nss_tunipip6_warning("Failed to register tunipip6 generic netlink family, error %d\n", err);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * nss_tunipip6_nl_unregister()
+ *	Unregister generic netlink family for tunipip6.
+ */
+void nss_tunipip6_nl_unregister(void)
+{
+	genl_unregister_family(&nss_tunipip6_nl_family);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __NSS_CONNMGR_TUNIPIP6_NL_H_
+#define __NSS_CONNMGR_TUNIPIP6_NL_H_
+
+#define NSS_TUNIPIP6_NL_FAMILY "nss_tunipip6"	/* Generic netlink family name */
+#define NSS_TUNIPIP6_NL_VERSION 1		/* Generic netlink family version */
+
+/*
+ * Generic netlink commands.
+ */
+enum nss_tunipip6_nl_cmd {
+	NSS_TUNIPIP6_NL_CMD_UNSPEC,
+	NSS_TUNIPIP6_NL_CMD_SET_MAPRULES,	/* Add or replace a set of BMR/FMR entries */
+	__NSS_TUNIPIP6_NL_CMD_MAX
+};
+#define NSS_TUNIPIP6_NL_CMD_MAX (__NSS_TUNIPIP6_NL_CMD_MAX - 1)
+
+/*
+ * Generic netlink attributes.
+ *
+ * NSS_TUNIPIP6_NL_ATTR_RULES nests one NSS_TUNIPIP6_NL_ATTR_RULE per map rule.
+ */
+enum nss_tunipip6_nl_attr {
+	NSS_TUNIPIP6_NL_ATTR_UNSPEC,
+	NSS_TUNIPIP6_NL_ATTR_IFNAME,		/* Tunnel netdevice name */
+	NSS_TUNIPIP6_NL_ATTR_REPLACE,		/* Flag: the rules replace all rules of the tunnel */
+	NSS_TUNIPIP6_NL_ATTR_RULES,		/* Nested list of rules */
+	NSS_TUNIPIP6_NL_ATTR_RULE,		/* struct nss_tunipip6_nl_maprule */
+	__NSS_TUNIPIP6_NL_ATTR_MAX
+};
+#define NSS_TUNIPIP6_NL_ATTR_MAX (__NSS_TUNIPIP6_NL_ATTR_MAX - 1)
+
+/*
+ * Map rule as carried in NSS_TUNIPIP6_NL_ATTR_RULE; all fields in host order.
+ */
+struct nss_tunipip6_nl_maprule {
+	uint32_t rule_type;		/* NSS_CONNMGR_TUNIPIP6_RULE_BMR/FMR */
+	uint32_t ipv6_prefix[4];	/* IPv6 prefix */
+	uint32_t ipv6_prefix_len;	/* IPv6 prefix length */
+	uint32_t ipv4_prefix;		/* IPv4 prefix */
+	uint32_t ipv4_prefix_len;	/* IPv4 prefix length */
+	uint32_t ipv6_suffix[4];	/* IPv6 suffix */
+	uint32_t ipv6_suffix_len;	/* IPv6 suffix length */
+	uint32_t ea_len;		/* Embedded address bits */
+	uint32_t psid_offset;		/* PSID offset */
+};
+
+#ifdef __KERNEL__
+bool nss_tunipip6_nl_register(void);
+void nss_tunipip6_nl_unregister(void);
+#endif
+
+#endif /* __NSS_CONNMGR_TUNIPIP6_NL_H_ */
@@ -20,6 +20,7 @@
 #define __NSS_CONNMGR_TUNIPIP6_PRIV_H_
 
 #include "nss_connmgr_tunipip6_stats.h"
+#include "nss_connmgr_tunipip6_maprule.h"
 #include <linux/debugfs.h>
 
 /*
@@ -75,6 +76,7 @@ struct nss_tunipip6_context {
 	struct list_head dev_list;		/* List of tunipip6 interface instances */
 	struct dentry *tunipip6_dentry_dir;	/* tunipip6 debugfs directory entry */
 	spinlock_t lock;			/* Lock to protect list. */
+	struct mutex maprule_lock;		/* Serializes map rule programming */
 };
 
 /*
@@ -87,6 +89,7 @@ struct nss_tunipip6_instance {
 	struct nss_tunipip6_stats stats;	/* tunipip6 statistics */
 	uint32_t inner_ifnum;			/* tunipip6 inner dynamic interface */
 	uint32_t outer_ifnum;			/* tunipip6 outer dynamic interface */
+	struct nss_tunipip6_maprule_table rules;	/* Map rules programmed in NSS */
 };
 
 struct nss_tunipip6_instance *nss_tunipip6_find_instance(struct net_device *dev);
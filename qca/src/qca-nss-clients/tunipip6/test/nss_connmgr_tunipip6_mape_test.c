@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * nss_connmgr_tunipip6_mape_test.c
+ *	Host test of MAP-E FMR matching and address synthesis.
+ *
+ * Addresses follow the examples of RFC 7597 appendix A.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "nss_connmgr_tunipip6_mape.h"
+
+#define IPV4(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+/*
+ * Port with the given PSID, for a PSID offset of 6 and 8 PSID bits.
+ */
+#define PORT(a, psid, m) ((uint16_t)(((a) << 10) | ((psid) << 2) | (m)))
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+/*
+ * FMR table of the test.
+ */
+static const struct nss_tunipip6_mape_rule fmr[] = {
+	/*
+	 * 192.0.2.0/24 shared, 2001:db8::/40, 16 EA bits: 8 bit IPv4 suffix and 8 bit PSID.
+	 */
+	{{0x20010db8, 0, 0, 0}, IPV4(192, 0, 2, 0), 40, 24, 16, 6},
+	/*
+	 * 192.0.2.128/25 overrides the above with another IPv6 prefix.
+	 */
+	{{0x20010db8, 0xff000000, 0, 0}, IPV4(192, 0, 2, 128), 40, 25, 15, 6},
+	/*
+	 * 198.51.100.0/24 mapped as /32 prefixes, no PSID.
+	 */
+	{{0x20010db8, 0x01000000, 0, 0}, IPV4(198, 51, 100, 0), 48, 24, 8, 6},
+};
+
+#define FMR_NUM (sizeof(fmr) / sizeof(fmr[0]))
+
+/*
+ * addr_equal()
+ *	Compare a computed address with the expected one.
+ */
+static int addr_equal(const uint32_t *addr, uint32_t w0, uint32_t w1, uint32_t w2, uint32_t w3)
+{
+	if ((addr[0] == w0) && (addr[1] == w1) && (addr[2] == w2) && (addr[3] == w3)) {
+		return 1;
+	}
+
+	printf("got %08x:%08x:%08x:%08x expected %08x:%08x:%08x:%08x\n",
+		addr[0], addr[1], addr[2], addr[3], w0, w1, w2, w3);
+	return 0;
+}
+
+/*
+ * test_lookup()
+ *	Longest IPv4 prefix wins, addresses outside every FMR go to the BR.
+ */
+static void test_lookup(void)
+{
+	CHECK(nss_tunipip6_mape_fmr_lookup(fmr, FMR_NUM, IPV4(192, 0, 2, 18)) == 0);
+	CHECK(nss_tunipip6_mape_fmr_lookup(fmr, FMR_NUM, IPV4(192, 0, 2, 200)) == 1);
+	CHECK(nss_tunipip6_mape_fmr_lookup(fmr, FMR_NUM, IPV4(198, 51, 100, 7)) == 2);
+	CHECK(nss_tunipip6_mape_fmr_lookup(fmr, FMR_NUM, IPV4(203, 0, 113, 1)) == -1);
+	CHECK(nss_tunipip6_mape_fmr_lookup(fmr, 0, IPV4(192, 0, 2, 18)) == -1);
+}
+
+/*
+ * test_encap()
+ *	MAP address of shared and prefix mapped IPv4 destinations.
+ */
+static void test_encap(void)
+{
+	uint32_t addr[4];
+
+	/*
+	 * 192.0.2.18 PSID 0x34 -> 2001:db8:12:3400:0:c000:212:34
+	 */
+	memset(addr, 0xff, sizeof(addr));
+	CHECK(nss_tunipip6_mape_encap(fmr, FMR_NUM, IPV4(192, 0, 2, 18), PORT(1, 0x34, 0), addr));
+	CHECK(addr_equal(addr, 0x20010db8, 0x00123400, 0x0000c000, 0x02120034));
+
+	/*
+	 * Offset and trailing port bits do not change the address.
+	 */
+	CHECK(nss_tunipip6_mape_encap(fmr, FMR_NUM, IPV4(192, 0, 2, 18), PORT(63, 0x34, 3), addr));
+	CHECK(addr_equal(addr, 0x20010db8, 0x00123400, 0x0000c000, 0x02120034));
+
+	/*
+	 * 192.0.2.200 PSID 0x01 under the /25 FMR: 7 bit suffix 0x48, EA bits 0x4801
+	 */
+	CHECK(nss_tunipip6_mape_encap(fmr, FMR_NUM, IPV4(192, 0, 2, 200), PORT(1, 0x01, 0), addr));
+	CHECK(addr_equal(addr, 0x20010db8, 0xff900200, 0x0000c000, 0x02c80001));
+
+	/*
+	 * 198.51.100.7 -> 2001:db8:100:700:0:c633:6407:0, port is not used
+	 */
+	CHECK(nss_tunipip6_mape_encap(fmr, FMR_NUM, IPV4(198, 51, 100, 7), 80, addr));
+	CHECK(addr_equal(addr, 0x20010db8, 0x01000700, 0x0000c633, 0x64070000));
+
+	CHECK(!nss_tunipip6_mape_encap(fmr, FMR_NUM, IPV4(203, 0, 113, 1), 80, addr));
+}
+
+/*
+ * test_decap()
+ *	Source check of decapsulated packets.
+ */
+static void test_decap(void)
+{
+	const uint32_t saddr[4] = {0x20010db8, 0x00123400, 0x0000c000, 0x02120034};
+	const uint32_t spoofed[4] = {0x20010db8, 0x00123500, 0x0000c000, 0x02120035};
+
+	CHECK(nss_tunipip6_mape_decap(fmr, FMR_NUM, saddr, IPV4(192, 0, 2, 18), PORT(1, 0x34, 0)));
+	CHECK(nss_tunipip6_mape_decap(fmr, FMR_NUM, saddr, IPV4(192, 0, 2, 18), PORT(2, 0x34, 1)));
+
+	/*
+	 * Port of another PSID, or another IPv4 address, is not owned by this CE.
+	 */
+	CHECK(!nss_tunipip6_mape_decap(fmr, FMR_NUM, saddr, IPV4(192, 0, 2, 18), PORT(1, 0x35, 0)));
+	CHECK(!nss_tunipip6_mape_decap(fmr, FMR_NUM, saddr, IPV4(192, 0, 2, 19), PORT(1, 0x34, 0)));
+	CHECK(!nss_tunipip6_mape_decap(fmr, FMR_NUM, spoofed, IPV4(192, 0, 2, 18), PORT(1, 0x34, 0)));
+
+	/*
+	 * No FMR covers the source.
+	 */
+	CHECK(!nss_tunipip6_mape_decap(fmr, FMR_NUM, saddr, IPV4(203, 0, 113, 1), PORT(1, 0x34, 0)));
+}
+
+/*
+ * test_invalid()
+ *	Rules out of bounds are refused instead of producing an address.
+ */
+static void test_invalid(void)
+{
+	struct nss_tunipip6_mape_rule rule = fmr[0];
+	uint32_t addr[4];
+
+	CHECK(nss_tunipip6_mape_valid(&rule));
+	CHECK(nss_tunipip6_mape_psid_len(&rule) == 8);
+
+	/*
+	 * EA bits run into the interface identifier.
+	 */
+	rule.ipv6_prefix_len = 56;
+	CHECK(!nss_tunipip6_mape_valid(&rule));
+	CHECK(!nss_tunipip6_mape_addr(&rule, IPV4(192, 0, 2, 18), PORT(1, 0x34, 0), addr));
+
+	/*
+	 * PSID does not fit in the port after the offset.
+	 */
+	rule = fmr[0];
+	rule.psid_offset = 10;
+	CHECK(!nss_tunipip6_mape_valid(&rule));
+
+	rule = fmr[0];
+	rule.ea_len = NSS_TUNIPIP6_MAPRULE_MAX_EA_LEN + 1;
+	CHECK(!nss_tunipip6_mape_valid(&rule));
+}
+
+int main(void)
+{
+	test_lookup();
+	test_encap();
+	test_decap();
+	test_invalid();
+
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
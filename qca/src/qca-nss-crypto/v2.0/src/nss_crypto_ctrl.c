@@ -677,6 +677,9 @@ static struct nss_crypto_algo_info g_algo_info[NSS_CRYPTO_CMN_ALGO_MAX] = {
  */
 bool nss_crypto_algo_is_supp(uint32_t algo)
 {
+	if (nss_crypto_sw_mode)
+		return nss_crypto_sw_algo_is_supp(algo);
+
 	return g_algo_info[algo].is_supp;
 }
 EXPORT_SYMBOL(nss_crypto_algo_is_supp);
@@ -830,6 +833,24 @@ void nss_crypto_free(struct nss_crypto_ctx *ctx)
 	struct nss_crypto_ctrl *ctrl = &g_control;
 	int32_t status;
 
+	/*
+	 * Software sessions have nothing to release at NSS; wait for
+	 * the inflight transforms to return before dropping the keys
+	 */
+	if (nss_crypto_sw_mode) {
+		atomic_set(&ctx->active, 0);
+		smp_mb__after_atomic();
+
+		if (kref_read(&ctx->ref) > 1) {
+			atomic_inc(&ctrl->cstats.free_fail_inuse);
+			schedule_delayed_work(&ctx->free_work, ctx->free_timeout);
+			return;
+		}
+
+		nss_crypto_sw_ctx_free(ctx);
+		goto free;
+	}
+
 	/*
 	 * If, the NSS queue is congested then try few more times to see
 	 * if the message goes through. Otherwise the index will remain
@@ -972,7 +993,7 @@ int nss_crypto_session_alloc(struct nss_crypto_user *user, struct nss_crypto_ses
 		 * only one of the nodes will be capable of handling a
 		 * particular algorithm
 		 */
-		if (node->algo[data->algo]) {
+		if (node->algo[data->algo] || nss_crypto_sw_mode) {
 			found = true;
 			break;
 		}
@@ -1021,6 +1042,21 @@ int nss_crypto_session_alloc(struct nss_crypto_user *user, struct nss_crypto_ses
 		memcpy((uint8_t *)&msg->nonce[0], data->nonce, ctx->info->nonce_sz);
 	}
 
+	/*
+	 * Software sessions are keyed on the host; the node is
+	 * only used for mapping the transform buffers
+	 */
+	if (nss_crypto_sw_mode) {
+		error = nss_crypto_sw_ctx_alloc(ctx, data);
+		if (error < 0) {
+			atomic_inc(&ctrl->cstats.alloc_fail_node);
+			kref_put(&ctx->ref, nss_crypto_ctx_free);
+			return error;
+		}
+
+		goto done;
+	}
+
 	/*
 	 * Fill Hardware specific information
 	 */
@@ -1062,6 +1098,7 @@ int nss_crypto_session_alloc(struct nss_crypto_user *user, struct nss_crypto_ses
 		return -EBUSY;
 	}
 
+done:
 	/*
 	 * Initialize the delayed free
 	 */
@@ -1374,6 +1411,7 @@ void nss_crypto_node_free(struct nss_crypto_node *node)
 void nss_crypto_user_free(struct kref *ref)
 {
 	struct nss_crypto_user *user = container_of(ref, struct nss_crypto_user, ref);
+	struct nss_crypto_user_pvt *pvt = nss_crypto_user_to_pvt(user);
 	struct sk_buff_head *sk_head = &user->sk_head;
 	struct nss_crypto_ctrl *ctrl = &g_control;
 	struct sk_buff *skb;
@@ -1389,6 +1427,8 @@ void nss_crypto_user_free(struct kref *ref)
 	 * user has dropped to zero protects this list from being
 	 * accessed by any other legitimate caller
 	 */
+	nss_crypto_hdr_cache_drain(pvt);
+
 	do {
 		skb = __skb_dequeue(sk_head);
 		if (!skb)
@@ -1397,7 +1437,10 @@ void nss_crypto_user_free(struct kref *ref)
 		dev_kfree_skb_any(skb);
 	} while (!skb_queue_empty(sk_head));
 
-	vfree(user);
+	if (pvt->cache)
+		free_percpu(pvt->cache);
+
+	vfree(pvt);
 }
 
 /*
@@ -1408,6 +1451,7 @@ struct nss_crypto_user *nss_crypto_register_user(struct nss_crypto_user_ctx *ctx
 {
 	struct nss_crypto_ctrl *ctrl = &g_control;
 	uint16_t hdr_pool_sz, default_hdr_sz;
+	struct nss_crypto_user_pvt *pvt;
 	struct nss_crypto_user *user;
 	size_t aligned_offset;
 	struct sk_buff *skb;
@@ -1430,12 +1474,14 @@ struct nss_crypto_user *nss_crypto_register_user(struct nss_crypto_user_ctx *ctx
 		return NULL;
 	}
 
-	user = vzalloc(sizeof(struct nss_crypto_user));
-	if (!user) {
+	pvt = vzalloc(sizeof(struct nss_crypto_user_pvt));
+	if (!pvt) {
 		nss_crypto_warn("%px: unable to allocate user\n", ctx);
 		return NULL;
 	}
 
+	user = &pvt->user;
+
 	memcpy(&user->ctx, ctx, sizeof(user->ctx));
 
 	spin_lock_init(&user->lock);
@@ -1454,7 +1500,7 @@ struct nss_crypto_user *nss_crypto_register_user(struct nss_crypto_user_ctx *ctx
 	skb = alloc_skb(aligned_size, GFP_KERNEL);
 	if (!skb) {
 		nss_crypto_warn("%px:unable to allocate atleast 1 skb\n", ctx);
-		vfree(user);
+		vfree(pvt);
 		return NULL;
 	}
 
@@ -1490,7 +1536,24 @@ struct nss_crypto_user *nss_crypto_register_user(struct nss_crypto_user_ctx *ctx
 		__skb_queue_head(&user->sk_head, skb);
 	}
 
-	nss_crypto_info("%px: registered user(%s), pool size(%d)\n", user, ctx->name, num_skb);
+	/*
+	 * Size the per CPU caches so that they can hold at most
+	 * half of the pool; a cache smaller than 2 SKB(s) cannot
+	 * batch anything and the shared pool is used directly
+	 */
+	pvt->cache_sz = min_t(uint32_t, NSS_CRYPTO_HDR_CACHE_MAX, num_skb / (2 * num_possible_cpus()));
+	if (pvt->cache_sz >= 2)
+		pvt->cache = alloc_percpu(struct nss_crypto_hdr_cache);
+
+	if (!pvt->cache)
+		pvt->cache_sz = 0;
+
+	pvt->cache_batch = pvt->cache_sz / 2;
+	pvt->cache_lowat = pvt->cache_batch / 2;
+	nss_crypto_debugfs_add_user(pvt, ctrl->dentry);
+
+	nss_crypto_info("%px: registered user(%s), pool size(%d), cpu cache size(%d)\n", user, ctx->name,
+			num_skb, pvt->cache_sz);
 
 	/*
 	 * We only register ourselves for a pending attach if the
@@ -1521,6 +1584,7 @@ void nss_crypto_unregister_user(struct nss_crypto_user *user)
 	struct nss_crypto_ctrl *ctrl = &g_control;
 
 	user->ctx.detach(user->app_data, user);
+	nss_crypto_debugfs_del_user(nss_crypto_user_to_pvt(user));
 
 	/*
 	 * If there are packets which are still getting
@@ -1693,9 +1757,9 @@ void nss_crypto_delayed_probe(struct work_struct *work)
 	ctrl = container_of(to_delayed_work(work), struct nss_crypto_ctrl, probe_work);
 
 	/*
-	 * Check if NSS FW is active
+	 * Check if NSS FW is active; software crypto does not need it
 	 */
-	if (!atomic_read(&ctrl->nss_active)) {
+	if (!nss_crypto_sw_mode && !atomic_read(&ctrl->nss_active)) {
 		schedule_delayed_work(&ctrl->probe_work, NSS_CRYPTO_DELAYED_INIT_TICKS);
 		return;
 	}
@@ -1750,6 +1814,7 @@ static int __init nss_crypto_module_init(void)
 	 */
 	ctrl->active = false;
 	atomic_set(&ctrl->nss_active, 0);
+	nss_crypto_transform_init();
 
 	if (!of_find_compatible_node(NULL, NULL, "qcom,nss-crypto")) {
 		nss_crypto_info_always("module loaded for symbol link\n");
@@ -1785,6 +1850,7 @@ static void __exit nss_crypto_module_exit(void)
 {
 	platform_driver_unregister(&nss_crypto_drv);
 	platform_driver_unregister(&nss_crypto_device);
+	nss_crypto_transform_deinit();
 }
 module_exit(nss_crypto_module_exit);
 
@@ -28,6 +28,7 @@
 
 struct nss_crypto_engine;
 struct nss_crypto_ctx;
+struct nss_crypto_hdr;
 
 typedef int (*nss_crypto_ctx_fill_method_t)(struct nss_crypto_ctx *ctx, struct nss_crypto_session_data *data,
 						struct nss_crypto_cmn_ctx *msg);
@@ -107,6 +108,47 @@ struct nss_crypto_ctrl_stats {
 	atomic_t free_delayed;		/**< Session free delayed */
 };
 
+/*
+ * Per CPU crypto header cache
+ *
+ * Note: each user keeps its preallocated header SKB(s) in a shared pool
+ * protected by the user lock. To avoid taking that lock for every
+ * request, a slice of the pool is cached per CPU; the cache is refilled
+ * from (and flushed back to) the shared pool in batches. The cache is
+ * sized so that at most half of the pool can be parked on the CPU(s).
+ */
+#define NSS_CRYPTO_HDR_CACHE_MAX 64	/* Max SKB(s) cached per CPU */
+
+/*
+ * nss_crypto_hdr_cache
+ *	per CPU header cache of a user
+ */
+struct nss_crypto_hdr_cache {
+	struct sk_buff *skb[NSS_CRYPTO_HDR_CACHE_MAX];	/* cached SKB(s) */
+	uint32_t count;				/* number of cached SKB(s) */
+
+	uint64_t hit;				/* allocation served from the cache */
+	uint64_t miss;				/* allocation at the low water mark */
+	uint64_t empty;				/* allocation failed, pool exhausted */
+	uint64_t refill;			/* SKB(s) moved from the shared pool */
+	uint64_t flush;				/* SKB(s) moved to the shared pool */
+};
+
+/*
+ * nss_crypto_user_pvt
+ *	driver private view of a crypto user
+ */
+struct nss_crypto_user_pvt {
+	struct nss_crypto_user user;		/* user handle returned to the caller */
+	struct nss_crypto_hdr_cache __percpu *cache;	/* per CPU header cache */
+	uint32_t cache_sz;			/* per CPU cache capacity, '0' if disabled */
+	uint32_t cache_batch;			/* SKB(s) moved per refill/flush */
+	uint32_t cache_lowat;			/* refill when at or below this count */
+	struct dentry *dentry;			/* debugfs entry for pool stats */
+};
+
+#define nss_crypto_user_to_pvt(u) container_of(u, struct nss_crypto_user_pvt, user)
+
 /*
  * nss_crypto_ctrl
  *	crypto driver control
@@ -207,4 +249,14 @@ extern void nss_crypto_user_free(struct kref *ref);
 
 extern void nss_crypto_process_event(void *app_data, struct nss_crypto_cmn_msg *msg);
 extern void nss_crypto_transform_done(struct net_device *net, struct sk_buff *skb, struct napi_struct *napi);
+
+extern void nss_crypto_hdr_cache_drain(struct nss_crypto_user_pvt *pvt);
+extern void nss_crypto_transform_init(void);
+extern void nss_crypto_transform_deinit(void);
+
+extern bool nss_crypto_sw_mode;
+extern bool nss_crypto_sw_algo_is_supp(uint32_t algo);
+extern int nss_crypto_sw_ctx_alloc(struct nss_crypto_ctx *ctx, struct nss_crypto_session_data *data);
+extern void nss_crypto_sw_ctx_free(struct nss_crypto_ctx *ctx);
+extern void nss_crypto_sw_transform(struct nss_crypto_ctx *ctx, struct nss_crypto_hdr *ch);
 #endif /* __NSS_CRYPTO_CTRL_H*/
@@ -17,6 +17,7 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "nss_crypto_hlos.h"
 #include <nss_api_if.h>
@@ -213,3 +214,82 @@ void nss_crypto_debugfs_del_ctx(struct nss_crypto_ctx *ctx)
 	debugfs_remove_recursive(ctx->dentry);
 	ctx->dentry = NULL;
 }
+
+/*
+ * nss_crypto_debugfs_hdr_pool_show()
+ *	show per CPU header cache statistics of a user
+ */
+static int nss_crypto_debugfs_hdr_pool_show(struct seq_file *m, void *p)
+{
+	struct nss_crypto_user_pvt *pvt = m->private;
+	struct nss_crypto_hdr_cache *cache;
+	int cpu;
+
+	seq_printf(m, "cache_size: %u\n", pvt->cache_sz);
+	seq_printf(m, "cache_batch: %u\n", pvt->cache_batch);
+	seq_printf(m, "cache_lowat: %u\n", pvt->cache_lowat);
+
+	if (!pvt->cache)
+		return 0;
+
+	seq_printf(m, "%-6s %10s %20s %20s %20s %20s %20s\n",
+			"cpu", "cached", "hit", "miss", "empty", "refill", "flush");
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(pvt->cache, cpu);
+		seq_printf(m, "%-6d %10u %20llu %20llu %20llu %20llu %20llu\n", cpu, cache->count,
+				cache->hit, cache->miss, cache->empty, cache->refill, cache->flush);
+	}
+
+	return 0;
+}
+
+/*
+ * nss_crypto_debugfs_hdr_pool_open()
+ *	open the header pool statistics file
+ */
+static int nss_crypto_debugfs_hdr_pool_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nss_crypto_debugfs_hdr_pool_show, inode->i_private);
+}
+
+static const struct file_operations nss_crypto_debugfs_hdr_pool_ops = {
+	.owner = THIS_MODULE,
+	.open = nss_crypto_debugfs_hdr_pool_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * nss_crypto_debugfs_add_user()
+ *	add user specific header pool stats entry
+ */
+void nss_crypto_debugfs_add_user(struct nss_crypto_user_pvt *pvt, struct dentry *root)
+{
+	char buf[NSS_CRYPTO_DEBUGFS_NAME_SZ] = {0};
+
+	if (!root)
+		return;
+
+	scnprintf(buf, sizeof(buf), "user-%s", pvt->user.ctx.name);
+
+	pvt->dentry = debugfs_create_dir(buf, root);
+	if (!pvt->dentry)
+		return;
+
+	debugfs_create_file("hdr_pool", S_IRUGO, pvt->dentry, pvt, &nss_crypto_debugfs_hdr_pool_ops);
+}
+
+/*
+ * nss_crypto_debugfs_del_user()
+ *	delete user specific header pool stats entry
+ */
+void nss_crypto_debugfs_del_user(struct nss_crypto_user_pvt *pvt)
+{
+	if (!pvt->dentry)
+		return;
+
+	debugfs_remove_recursive(pvt->dentry);
+	pvt->dentry = NULL;
+}
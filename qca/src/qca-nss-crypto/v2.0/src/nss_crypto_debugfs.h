@@ -31,4 +31,6 @@ extern void nss_crypto_debugfs_add_engine(struct nss_crypto_engine *eng, struct
 extern void nss_crypto_debugfs_del_engine(struct nss_crypto_engine *eng);
 extern void nss_crypto_debugfs_add_ctx(struct nss_crypto_ctx *ctx, struct dentry *root);
 extern void nss_crypto_debugfs_del_ctx(struct nss_crypto_ctx *ctx);
+extern void nss_crypto_debugfs_add_user(struct nss_crypto_user_pvt *pvt, struct dentry *root);
+extern void nss_crypto_debugfs_del_user(struct nss_crypto_user_pvt *pvt);
 
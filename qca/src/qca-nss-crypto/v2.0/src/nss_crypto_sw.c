@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <linux/dma-direct.h>
+#include <linux/scatterlist.h>
+#include <crypto/algapi.h>
+#include <crypto/hash.h>
+#include <crypto/skcipher.h>
+#include <crypto/scatterwalk.h>
+#include <crypto/sha.h>
+#include <crypto/aes.h>
+#include <crypto/ctr.h>
+#include <nss_crypto_hlos.h>
+#include <nss_api_if.h>
+#include <nss_crypto_hdr.h>
+#include <nss_crypto_api.h>
+#include <nss_crypto_ctrl.h>
+
+/*
+ * Software crypto
+ *
+ * When enabled at load time, sessions are created on the host through the
+ * kernel crypto API instead of the NSS firmware, and every transform is
+ * completed by the host: the mapped fragments are unmapped, ciphered and/or
+ * hashed in software and handed back to the user through the normal
+ * completion path. The driver comes up without waiting for the firmware,
+ * which makes it possible to verify data and compare the host side of the
+ * transform path against a real crypto reference. GCM is not supported.
+ */
+bool nss_crypto_sw_mode;
+module_param_named(sw_crypto, nss_crypto_sw_mode, bool, S_IRUGO);
+MODULE_PARM_DESC(sw_crypto, "Complete sessions and transforms in software through the kernel crypto API");
+
+#define NSS_CRYPTO_SW_MAX_FRAGS 16	/* maximum fragments per transform */
+
+/*
+ * nss_crypto_sw_algo
+ *	kernel crypto API names for each NSS algorithm
+ */
+struct nss_crypto_sw_algo {
+	const char *cipher;		/* skcipher name */
+	const char *auth;		/* shash name */
+};
+
+static const struct nss_crypto_sw_algo nss_crypto_sw_algo[NSS_CRYPTO_CMN_ALGO_MAX] = {
+	[NSS_CRYPTO_CMN_ALGO_3DES_CBC] = { "cbc(des3_ede)", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CBC] = { "cbc(aes)", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CBC] = { "cbc(aes)", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CBC] = { "cbc(aes)", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CTR] = { "rfc3686(ctr(aes))", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CTR] = { "rfc3686(ctr(aes))", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CTR] = { "rfc3686(ctr(aes))", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES128_ECB] = { "ecb(aes)", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES192_ECB] = { "ecb(aes)", NULL },
+	[NSS_CRYPTO_CMN_ALGO_AES256_ECB] = { "ecb(aes)", NULL },
+	[NSS_CRYPTO_CMN_ALGO_MD5_HASH] = { NULL, "md5" },
+	[NSS_CRYPTO_CMN_ALGO_SHA160_HASH] = { NULL, "sha1" },
+	[NSS_CRYPTO_CMN_ALGO_SHA224_HASH] = { NULL, "sha224" },
+	[NSS_CRYPTO_CMN_ALGO_SHA256_HASH] = { NULL, "sha256" },
+	[NSS_CRYPTO_CMN_ALGO_SHA384_HASH] = { NULL, "sha384" },
+	[NSS_CRYPTO_CMN_ALGO_SHA512_HASH] = { NULL, "sha512" },
+	[NSS_CRYPTO_CMN_ALGO_MD5_HMAC] = { NULL, "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_SHA160_HMAC] = { NULL, "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_SHA224_HMAC] = { NULL, "hmac(sha224)" },
+	[NSS_CRYPTO_CMN_ALGO_SHA256_HMAC] = { NULL, "hmac(sha256)" },
+	[NSS_CRYPTO_CMN_ALGO_SHA384_HMAC] = { NULL, "hmac(sha384)" },
+	[NSS_CRYPTO_CMN_ALGO_SHA512_HMAC] = { NULL, "hmac(sha512)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CBC_MD5_HMAC] = { "cbc(aes)", "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CBC_SHA160_HMAC] = { "cbc(aes)", "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CBC_SHA256_HMAC] = { "cbc(aes)", "hmac(sha256)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CBC_SHA384_HMAC] = { "cbc(aes)", "hmac(sha384)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CBC_SHA512_HMAC] = { "cbc(aes)", "hmac(sha512)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CTR_MD5_HMAC] = { "rfc3686(ctr(aes))", "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CTR_SHA160_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CTR_SHA256_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha256)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CTR_SHA384_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha384)" },
+	[NSS_CRYPTO_CMN_ALGO_AES128_CTR_SHA512_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha512)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CBC_MD5_HMAC] = { "cbc(aes)", "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CBC_SHA160_HMAC] = { "cbc(aes)", "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CBC_SHA256_HMAC] = { "cbc(aes)", "hmac(sha256)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CBC_SHA384_HMAC] = { "cbc(aes)", "hmac(sha384)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CBC_SHA512_HMAC] = { "cbc(aes)", "hmac(sha512)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CTR_MD5_HMAC] = { "rfc3686(ctr(aes))", "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CTR_SHA160_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CTR_SHA256_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha256)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CTR_SHA384_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha384)" },
+	[NSS_CRYPTO_CMN_ALGO_AES192_CTR_SHA512_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha512)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CBC_MD5_HMAC] = { "cbc(aes)", "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CBC_SHA160_HMAC] = { "cbc(aes)", "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CBC_SHA256_HMAC] = { "cbc(aes)", "hmac(sha256)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CBC_SHA384_HMAC] = { "cbc(aes)", "hmac(sha384)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CBC_SHA512_HMAC] = { "cbc(aes)", "hmac(sha512)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CTR_MD5_HMAC] = { "rfc3686(ctr(aes))", "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CTR_SHA160_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CTR_SHA256_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha256)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CTR_SHA384_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha384)" },
+	[NSS_CRYPTO_CMN_ALGO_AES256_CTR_SHA512_HMAC] = { "rfc3686(ctr(aes))", "hmac(sha512)" },
+	[NSS_CRYPTO_CMN_ALGO_3DES_CBC_MD5_HMAC] = { "cbc(des3_ede)", "hmac(md5)" },
+	[NSS_CRYPTO_CMN_ALGO_3DES_CBC_SHA160_HMAC] = { "cbc(des3_ede)", "hmac(sha1)" },
+	[NSS_CRYPTO_CMN_ALGO_3DES_CBC_SHA256_HMAC] = { "cbc(des3_ede)", "hmac(sha256)" },
+};
+
+/*
+ * nss_crypto_sw_ctx
+ *	software transforms of a session, stored in ctx->hw_info
+ */
+struct nss_crypto_sw_ctx {
+	struct crypto_sync_skcipher *cipher;	/* cipher transform */
+	struct crypto_shash *auth;		/* hash/HMAC transform */
+};
+
+/*
+ * nss_crypto_sw_scratch
+ *	per CPU scratch space for the completion tasklet
+ */
+struct nss_crypto_sw_scratch {
+	struct scatterlist src[NSS_CRYPTO_SW_MAX_FRAGS];	/* input fragments */
+	struct scatterlist dst[NSS_CRYPTO_SW_MAX_FRAGS];	/* output fragments */
+	struct scatterlist src_skip[2];				/* input past cipher skip */
+	struct scatterlist dst_skip[2];				/* output past cipher skip */
+	uint8_t digest[SHA512_DIGEST_SIZE];			/* computed digest */
+	uint8_t icv[SHA512_DIGEST_SIZE];			/* received digest */
+	uint8_t iv[AES_BLOCK_SIZE];				/* working IV */
+};
+
+static DEFINE_PER_CPU(struct nss_crypto_sw_scratch, nss_crypto_sw_scratch);
+
+/*
+ * nss_crypto_sw_algo_is_supp()
+ *	check if the algorithm can be run in software
+ */
+bool nss_crypto_sw_algo_is_supp(uint32_t algo)
+{
+	return (algo < NSS_CRYPTO_CMN_ALGO_MAX) && (nss_crypto_sw_algo[algo].cipher || nss_crypto_sw_algo[algo].auth);
+}
+
+/*
+ * nss_crypto_sw_ctx_free()
+ *	release the software transforms of a session
+ */
+void nss_crypto_sw_ctx_free(struct nss_crypto_ctx *ctx)
+{
+	struct nss_crypto_sw_ctx *sw = ctx->hw_info;
+
+	if (!sw)
+		return;
+
+	if (sw->cipher)
+		crypto_free_sync_skcipher(sw->cipher);
+
+	if (sw->auth)
+		crypto_free_shash(sw->auth);
+
+	ctx->hw_info = NULL;
+	kfree(sw);
+}
+
+/*
+ * nss_crypto_sw_ctx_alloc()
+ *	allocate and key the software transforms of a session
+ */
+int nss_crypto_sw_ctx_alloc(struct nss_crypto_ctx *ctx, struct nss_crypto_session_data *data)
+{
+	const struct nss_crypto_sw_algo *algo = &nss_crypto_sw_algo[ctx->algo];
+	uint8_t key[AES_MAX_KEY_SIZE + CTR_RFC3686_NONCE_SIZE];
+	struct nss_crypto_sw_ctx *sw;
+	uint16_t keylen;
+	int error;
+
+	if (!nss_crypto_sw_algo_is_supp(ctx->algo)) {
+		nss_crypto_warn("%px: algo(%d) not supported in software\n", ctx, ctx->algo);
+		return -EOPNOTSUPP;
+	}
+
+	sw = kzalloc(sizeof(*sw), GFP_KERNEL);
+	if (!sw)
+		return -ENOMEM;
+
+	ctx->hw_info = sw;
+
+	if (algo->cipher) {
+		sw->cipher = crypto_alloc_sync_skcipher(algo->cipher, 0, 0);
+		if (IS_ERR(sw->cipher)) {
+			error = PTR_ERR(sw->cipher);
+			sw->cipher = NULL;
+			goto fail;
+		}
+
+		/*
+		 * RFC3686 takes the nonce at the end of the key
+		 */
+		keylen = ctx->info->cipher_key_len;
+		BUG_ON(keylen > AES_MAX_KEY_SIZE);
+		memcpy(key, data->cipher_key, keylen);
+
+		if (ctx->info->nonce_sz) {
+			BUG_ON(ctx->info->nonce_sz > CTR_RFC3686_NONCE_SIZE);
+			memcpy(key + keylen, data->nonce, ctx->info->nonce_sz);
+			keylen += ctx->info->nonce_sz;
+		}
+
+		error = crypto_sync_skcipher_setkey(sw->cipher, key, keylen);
+		memzero_explicit(key, sizeof(key));
+		if (error)
+			goto fail;
+	}
+
+	if (algo->auth) {
+		sw->auth = crypto_alloc_shash(algo->auth, 0, 0);
+		if (IS_ERR(sw->auth)) {
+			error = PTR_ERR(sw->auth);
+			sw->auth = NULL;
+			goto fail;
+		}
+
+		if (data->auth_key) {
+			error = crypto_shash_setkey(sw->auth, data->auth_key, data->auth_keylen);
+			if (error)
+				goto fail;
+		}
+	}
+
+	return 0;
+
+fail:
+	nss_crypto_warn("%px: unable to set up software algo(%d), error(%d)\n", ctx, ctx->algo, error);
+	nss_crypto_sw_ctx_free(ctx);
+	return error;
+}
+
+/*
+ * nss_crypto_sw_frag_to_sg()
+ *	load crypto fragments into a scatterlist
+ *
+ * Note: the fragments carry DMA addresses of already unmapped lowmem
+ * buffers; translate them back to kernel virtual addresses.
+ */
+static int nss_crypto_sw_frag_to_sg(struct device *dev, struct scatterlist *sg, struct nss_crypto_frag *frag,
+					uint16_t frag_cnt)
+{
+	int nents = 0;
+
+	if (!frag_cnt || (frag_cnt > NSS_CRYPTO_SW_MAX_FRAGS))
+		return -E2BIG;
+
+	sg_init_table(sg, frag_cnt);
+	for (; frag_cnt--; frag++) {
+		if (!frag->len)
+			continue;
+
+		sg_set_buf(&sg[nents++], phys_to_virt(dma_to_phys(dev, frag->addr)), frag->len);
+	}
+
+	if (!nents)
+		return -EINVAL;
+
+	sg_mark_end(&sg[nents - 1]);
+	return nents;
+}
+
+/*
+ * nss_crypto_sw_hash()
+ *	compute the digest of the first len bytes of a scatterlist
+ */
+static int nss_crypto_sw_hash(struct crypto_shash *tfm, struct scatterlist *sg, uint16_t len, uint8_t *digest)
+{
+	SHASH_DESC_ON_STACK(desc, tfm);
+	struct scatterlist *cur;
+	uint16_t seg;
+	int error;
+
+	desc->tfm = tfm;
+	error = crypto_shash_init(desc);
+
+	for (cur = sg; !error && cur && len; cur = sg_next(cur)) {
+		seg = min_t(uint16_t, cur->length, len);
+		error = crypto_shash_update(desc, sg_virt(cur), seg);
+		len -= seg;
+	}
+
+	if (!error)
+		error = crypto_shash_final(desc, digest);
+
+	shash_desc_zero(desc);
+	return error;
+}
+
+/*
+ * nss_crypto_sw_cipher()
+ *	run the cipher over the payload past the skip
+ */
+static int nss_crypto_sw_cipher(struct crypto_sync_skcipher *tfm, struct nss_crypto_sw_scratch *s,
+				struct nss_crypto_hdr *ch, bool encrypt)
+{
+	SYNC_SKCIPHER_REQUEST_ON_STACK(req, tfm);
+	struct scatterlist *src, *dst;
+	uint16_t ivsize;
+	int error;
+
+	if (ch->skip >= ch->data_len)
+		return -EINVAL;
+
+	ivsize = crypto_sync_skcipher_ivsize(tfm);
+	if (ivsize > min_t(uint16_t, ch->iv_len, sizeof(s->iv)))
+		return -EINVAL;
+
+	memcpy(s->iv, nss_crypto_hdr_get_iv(ch), ivsize);
+
+	src = scatterwalk_ffwd(s->src_skip, s->src, ch->skip);
+	dst = scatterwalk_ffwd(s->dst_skip, s->dst, ch->skip);
+
+	skcipher_request_set_sync_tfm(req, tfm);
+	skcipher_request_set_callback(req, 0, NULL, NULL);
+	skcipher_request_set_crypt(req, src, dst, ch->data_len - ch->skip, s->iv);
+
+	error = encrypt ? crypto_skcipher_encrypt(req) : crypto_skcipher_decrypt(req);
+	skcipher_request_zero(req);
+	return error;
+}
+
+/*
+ * nss_crypto_sw_transform()
+ *	apply the session transform to an unmapped request and set ch->error
+ *
+ * Note: the payload is data_len bytes; the cipher covers it past the skip
+ * and the hash covers all of it. The digest lives right after the payload
+ * in the output fragments (for ahash that is the header HMAC fragment).
+ */
+void nss_crypto_sw_transform(struct nss_crypto_ctx *ctx, struct nss_crypto_hdr *ch)
+{
+	struct nss_crypto_sw_ctx *sw = ctx->hw_info;
+	struct device *dev = ctx->node->dev;
+	struct nss_crypto_sw_scratch *s;
+	int src_nents, dst_nents;
+	uint16_t hmac_len;
+	int error = 0;
+
+	s = this_cpu_ptr(&nss_crypto_sw_scratch);
+
+	src_nents = nss_crypto_sw_frag_to_sg(dev, s->src, nss_crypto_hdr_get_in_frag(ch), ch->in_frags);
+	dst_nents = nss_crypto_sw_frag_to_sg(dev, s->dst, nss_crypto_hdr_get_out_frag(ch), ch->out_frags);
+	if ((src_nents < 0) || (dst_nents < 0)) {
+		ch->error = NSS_CRYPTO_CMN_RESP_ERROR_DATA_LEN;
+		return;
+	}
+
+	hmac_len = sw->auth ? min_t(uint16_t, ch->hmac_len, crypto_shash_digestsize(sw->auth)) : 0;
+
+	switch (ch->op) {
+	case NSS_CRYPTO_OP_DIR_ENC:
+	case NSS_CRYPTO_OP_DIR_DEC:
+		if (!sw->cipher) {
+			ch->error = NSS_CRYPTO_CMN_RESP_ERROR_CIPHER_ALGO;
+			return;
+		}
+
+		error = nss_crypto_sw_cipher(sw->cipher, s, ch, ch->op == NSS_CRYPTO_OP_DIR_ENC);
+		break;
+
+	case NSS_CRYPTO_OP_DIR_AUTH:
+		if (!sw->auth)
+			break;
+
+		error = nss_crypto_sw_hash(sw->auth, s->src, ch->data_len, s->digest);
+		if (!error)
+			sg_pcopy_from_buffer(s->dst, dst_nents, s->digest, hmac_len, ch->data_len);
+
+		break;
+
+	case NSS_CRYPTO_OP_DIR_ENC_AUTH:
+		if (!sw->cipher || !sw->auth) {
+			ch->error = NSS_CRYPTO_CMN_RESP_ERROR_CIPHER_ALGO;
+			return;
+		}
+
+		error = nss_crypto_sw_cipher(sw->cipher, s, ch, true);
+		if (!error)
+			error = nss_crypto_sw_hash(sw->auth, s->dst, ch->data_len, s->digest);
+
+		if (!error)
+			sg_pcopy_from_buffer(s->dst, dst_nents, s->digest, hmac_len, ch->data_len);
+
+		break;
+
+	case NSS_CRYPTO_OP_DIR_AUTH_DEC:
+		if (!sw->cipher || !sw->auth) {
+			ch->error = NSS_CRYPTO_CMN_RESP_ERROR_CIPHER_ALGO;
+			return;
+		}
+
+		/*
+		 * Verify over the ciphertext before it is decrypted in place
+		 */
+		error = nss_crypto_sw_hash(sw->auth, s->src, ch->data_len, s->digest);
+		if (error)
+			break;
+
+		if (sg_pcopy_to_buffer(s->src, src_nents, s->icv, hmac_len, ch->data_len) != hmac_len) {
+			ch->error = NSS_CRYPTO_CMN_RESP_ERROR_DATA_LEN;
+			return;
+		}
+
+		error = nss_crypto_sw_cipher(sw->cipher, s, ch, false);
+		if (!error && crypto_memneq(s->digest, s->icv, hmac_len)) {
+			ch->error = NSS_CRYPTO_CMN_RESP_ERROR_HASH_CHECK;
+			return;
+		}
+
+		break;
+
+	default:
+		ch->error = NSS_CRYPTO_CMN_RESP_ERROR_CIPHER_MODE;
+		return;
+	}
+
+	/*
+	 * The block ciphers reject payloads that are not block aligned
+	 */
+	if (error)
+		ch->error = (error == -EINVAL) ? NSS_CRYPTO_CMN_RESP_ERROR_CIPHER_BLK_LEN :
+						NSS_CRYPTO_CMN_RESP_ERROR_DATA_LEN;
+}
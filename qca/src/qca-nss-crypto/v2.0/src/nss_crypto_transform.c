@@ -18,10 +18,239 @@
 #include <nss_crypto_hlos.h>
 #include <nss_api_if.h>
 #include <nss_crypto_hdr.h>
-#include <nss_crypto_ctrl.h>
 #include <nss_crypto_api.h>
+#include <nss_crypto_ctrl.h>
 #include <linux/scatterlist.h>
 
+/*
+ * DMA loopback
+ *
+ * When enabled, mapped transforms are completed on the host instead of
+ * being sent to NSS. No cipher or hash is applied: the output buffers
+ * hold whatever the caller put there and every request is reported as
+ * successful. This only measures the host side of the transform path
+ * (header pools, DMA mapping, completion); throughput numbers are not
+ * crypto numbers and data verification is meaningless in this mode. Use
+ * the sw_crypto parameter for a loopback that does apply the transform.
+ */
+static bool dma_loopback;
+module_param(dma_loopback, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dma_loopback, "Pure DMA loopback: complete mapped transforms on the host without any crypto");
+
+/*
+ * nss_crypto_loopback
+ *	per CPU DMA loopback completion queue
+ */
+struct nss_crypto_loopback {
+	struct sk_buff_head queue;		/* submitted SKB(s) */
+	struct tasklet_struct tasklet;		/* completion tasklet */
+};
+
+static DEFINE_PER_CPU(struct nss_crypto_loopback, nss_crypto_loopback);
+
+/*
+ * nss_crypto_hdr_cache_refill()
+ *	top up the per CPU cache with a batch of SKB(s) from the user pool
+ */
+static void nss_crypto_hdr_cache_refill(struct nss_crypto_user_pvt *pvt, struct nss_crypto_hdr_cache *cache)
+{
+	struct nss_crypto_user *user = &pvt->user;
+	struct sk_buff *skb;
+
+	spin_lock(&user->lock);
+	while (cache->count < pvt->cache_lowat + pvt->cache_batch) {
+		skb = __skb_dequeue(&user->sk_head);
+		if (!skb)
+			break;
+
+		cache->skb[cache->count++] = skb;
+		cache->refill++;
+	}
+	spin_unlock(&user->lock);
+}
+
+/*
+ * nss_crypto_hdr_cache_flush()
+ *	move a batch of SKB(s) from the per CPU cache back to the user pool
+ */
+static void nss_crypto_hdr_cache_flush(struct nss_crypto_user_pvt *pvt, struct nss_crypto_hdr_cache *cache)
+{
+	struct nss_crypto_user *user = &pvt->user;
+	uint32_t count = pvt->cache_batch;
+
+	spin_lock(&user->lock);
+	while (count-- && cache->count) {
+		__skb_queue_head(&user->sk_head, cache->skb[--cache->count]);
+		cache->flush++;
+	}
+	spin_unlock(&user->lock);
+}
+
+/*
+ * nss_crypto_hdr_cache_drain()
+ *	return all cached SKB(s) to the user pool
+ *
+ * Note: this is called when the user has no more references, hence
+ * none of the CPU(s) can be using its cache.
+ */
+void nss_crypto_hdr_cache_drain(struct nss_crypto_user_pvt *pvt)
+{
+	struct nss_crypto_hdr_cache *cache;
+	int cpu;
+
+	if (!pvt->cache)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(pvt->cache, cpu);
+		while (cache->count)
+			__skb_queue_head(&pvt->user.sk_head, cache->skb[--cache->count]);
+	}
+}
+
+/*
+ * nss_crypto_hdr_pool_get()
+ *	get a header SKB, from the per CPU cache if possible
+ */
+static struct sk_buff *nss_crypto_hdr_pool_get(struct nss_crypto_user *user)
+{
+	struct nss_crypto_user_pvt *pvt = nss_crypto_user_to_pvt(user);
+	struct nss_crypto_hdr_cache *cache;
+	struct sk_buff *skb = NULL;
+
+	if (!pvt->cache_sz) {
+		spin_lock_bh(&user->lock);
+		skb = __skb_dequeue(&user->sk_head);
+		if (skb)
+			skb_set_queue_mapping(skb, smp_processor_id());
+
+		spin_unlock_bh(&user->lock);
+		return skb;
+	}
+
+	local_bh_disable();
+	cache = this_cpu_ptr(pvt->cache);
+
+	/*
+	 * Refill at the low water mark rather than when empty, so that
+	 * a burst does not hit an empty cache and the shared pool lock
+	 */
+	if (likely(cache->count > pvt->cache_lowat)) {
+		cache->hit++;
+	} else {
+		cache->miss++;
+		nss_crypto_hdr_cache_refill(pvt, cache);
+	}
+
+	if (likely(cache->count)) {
+		skb = cache->skb[--cache->count];
+
+		/*
+		 * Set skb->queue_mapping to the core on which this transformation is scheduled.
+		 */
+		skb_set_queue_mapping(skb, smp_processor_id());
+	} else {
+		cache->empty++;
+	}
+
+	local_bh_enable();
+	return skb;
+}
+
+/*
+ * nss_crypto_hdr_pool_put()
+ *	return a header SKB, to the per CPU cache if possible
+ */
+static void nss_crypto_hdr_pool_put(struct nss_crypto_user *user, struct sk_buff *skb)
+{
+	struct nss_crypto_user_pvt *pvt = nss_crypto_user_to_pvt(user);
+	struct nss_crypto_hdr_cache *cache;
+
+	if (!pvt->cache_sz) {
+		spin_lock_bh(&user->lock);
+		__skb_queue_head(&user->sk_head, skb);
+		spin_unlock_bh(&user->lock);
+		return;
+	}
+
+	local_bh_disable();
+	cache = this_cpu_ptr(pvt->cache);
+
+	if (unlikely(cache->count == pvt->cache_sz))
+		nss_crypto_hdr_cache_flush(pvt, cache);
+
+	cache->skb[cache->count++] = skb;
+	local_bh_enable();
+}
+
+/*
+ * nss_crypto_loopback_done()
+ *	complete the SKB(s) queued for DMA loopback or software crypto
+ */
+static void nss_crypto_loopback_done(unsigned long data)
+{
+	struct nss_crypto_loopback *lb = (struct nss_crypto_loopback *)data;
+	struct nss_crypto_ctrl *ctrl = &g_control;
+	struct sk_buff_head queue;
+	struct nss_crypto_hdr *ch;
+	struct sk_buff *skb;
+
+	__skb_queue_head_init(&queue);
+	skb_queue_splice_init(&lb->queue, &queue);
+
+	while ((skb = __skb_dequeue(&queue))) {
+		ch = (struct nss_crypto_hdr *)skb->data;
+		ch->error = NSS_CRYPTO_CMN_RESP_ERROR_NONE;
+		nss_crypto_transform_done(ctrl->ctx_tbl[ch->index].node->ndev, skb, NULL);
+	}
+}
+
+/*
+ * nss_crypto_loopback_tx()
+ *	queue a transform for DMA loopback completion
+ */
+static void nss_crypto_loopback_tx(struct sk_buff *skb)
+{
+	struct nss_crypto_loopback *lb;
+
+	local_bh_disable();
+	lb = this_cpu_ptr(&nss_crypto_loopback);
+	__skb_queue_tail(&lb->queue, skb);
+	tasklet_schedule(&lb->tasklet);
+	local_bh_enable();
+}
+
+/*
+ * nss_crypto_transform_init()
+ *	initialize the transform path
+ */
+void nss_crypto_transform_init(void)
+{
+	struct nss_crypto_loopback *lb;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		lb = per_cpu_ptr(&nss_crypto_loopback, cpu);
+		__skb_queue_head_init(&lb->queue);
+		tasklet_init(&lb->tasklet, nss_crypto_loopback_done, (unsigned long)lb);
+	}
+}
+
+/*
+ * nss_crypto_transform_deinit()
+ *	de-initialize the transform path
+ */
+void nss_crypto_transform_deinit(void)
+{
+	struct nss_crypto_loopback *lb;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		lb = per_cpu_ptr(&nss_crypto_loopback, cpu);
+		tasklet_kill(&lb->tasklet);
+	}
+}
+
 /*
  * nss_crypto_hdr_alloc()
  *	allocate a crypto header buf for the user to submit transform requests
@@ -72,20 +301,12 @@ struct nss_crypto_hdr *nss_crypto_hdr_alloc(struct nss_crypto_user *user, uint32
 	/*
 	 * Get hold of a preallocated SKB
 	 */
-	spin_lock_bh(&user->lock);
-	if (skb_queue_empty(&user->sk_head)) {
-		spin_unlock_bh(&user->lock);
+	skb = nss_crypto_hdr_pool_get(user);
+	if (!skb) {
 		kref_put(&user->ref, nss_crypto_user_free);
 		return NULL;
 	}
 
-	skb = __skb_dequeue(&user->sk_head);
-	/*
-	 * Set skb->queue_mapping to the core on which this transformation is scheduled.
-	 */
-	skb_set_queue_mapping(skb, smp_processor_id());
-	spin_unlock_bh(&user->lock);
-
 	ch = (struct nss_crypto_hdr *)skb_put(skb, size);
 	memset(ch, 0, skb->len);
 
@@ -135,9 +356,7 @@ void nss_crypto_hdr_free(struct nss_crypto_user *user, struct nss_crypto_hdr *ch
 	 */
 	__skb_trim(skb, 0);
 
-	spin_lock_bh(&user->lock);
-	__skb_queue_head(&user->sk_head, skb);
-	spin_unlock_bh(&user->lock);
+	nss_crypto_hdr_pool_put(user, skb);
 
 	kref_put(&user->ref, nss_crypto_user_free);
 }
@@ -185,6 +404,17 @@ int nss_crypto_transform_payload(struct nss_crypto_user *user, struct nss_crypto
 	buf->comp = cb;
 	buf->app_data = app_data;
 
+	if (unlikely(nss_crypto_sw_mode)) {
+		nss_crypto_loopback_tx(skb);
+		return 0;
+	}
+
+	if (unlikely(dma_loopback)) {
+		pr_warn_once("<NSS-CRYPTO>:DMA loopback enabled, transforms complete without any crypto\n");
+		nss_crypto_loopback_tx(skb);
+		return 0;
+	}
+
 	error = nss_crypto_cmn_tx_buf(node->nss_data_hdl, node->nss_ifnum, skb);
 	if (error != NSS_TX_SUCCESS) {
 		kref_put(&ctx->ref, nss_crypto_ctx_free);
@@ -230,6 +460,12 @@ void nss_crypto_transform_done(struct net_device *net, struct sk_buff *skb,
 	if (unlikely(!buf->in_place))
 		nss_crypto_unmap_frag(node, nss_crypto_hdr_get_in_frag(ch), ch->in_frags);
 
+	/*
+	 * Software crypto runs on the CPU owned buffers after the unmap
+	 */
+	if (unlikely(nss_crypto_sw_mode))
+		nss_crypto_sw_transform(ctx, ch);
+
 	buf->mapped = false;
 	buf->comp(buf->app_data, ch, ch->error);
 	kref_put(&ctx->ref, nss_crypto_ctx_free);
@@ -37,6 +37,8 @@
 #include <nss_crypto_defines.h>
 #include <nss_crypto_hdr.h>
 
+#include "nss_crypto_bench.h"
+
 #define NSS_CRYPTO_MAX_IVLEN_AES 16
 #define NSS_CRYPTO_MAX_IVLEN_DES 8
 
@@ -958,10 +960,13 @@ void  crypto_bench_attach(void *app_data, struct nss_crypto_user *user)
 	debugfs_create_u32("peak_mbps", CRYPTO_BENCH_PERM_RO, droot, &param.peak_mbps);
 	debugfs_create_u32("avg_mbps", CRYPTO_BENCH_PERM_RO, droot, &param.avg_mbps);
 	debugfs_create_u32("enqueue_errors", CRYPTO_BENCH_PERM_RO, droot, &param.tx_err);
+
+	crypto_bench_load_attach(user);
 }
 
 void crypto_bench_detach(void *app_data, struct nss_crypto_user *user)
 {
+	crypto_bench_load_detach();
 	crypto_bench_flush();
 	kmem_cache_destroy(crypto_op_zone);
 }
@@ -977,6 +982,7 @@ int __init crypto_bench_init(void)
 	crypto_bench_info("crypto bench loaded - %s\n", NSS_CRYPTO_BUILD_ID);
 
 	droot = debugfs_create_dir("crypto_bench", NULL);
+	crypto_bench_load_init(droot);
 
 	ctx->attach = crypto_bench_attach;
 	ctx->detach = crypto_bench_detach;
@@ -995,6 +1001,7 @@ void __exit crypto_bench_exit(void)
 {
 	crypto_bench_info("Crypto bench unloaded\n");
 
+	crypto_bench_load_deinit();
 	nss_crypto_unregister_user(crypto_hdl);
 }
 
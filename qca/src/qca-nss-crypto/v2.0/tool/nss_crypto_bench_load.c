@@ -0,0 +1,1194 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Multi-threaded crypto load generator
+ *
+ * N submitter threads, each bound to a CPU, keep up to 'window' requests
+ * in flight for 'duration_ms'. Every request picks an entry of the
+ * workload (algorithm, size, direction, weight) at random, and its
+ * completion latency is accounted in a per entry log2 histogram.
+ *
+ * The requests are driven through a backend:
+ *	0 (nss)	- NSS crypto sessions via nss_crypto_transform_payload()
+ *	1 (sw)	- the kernel crypto API with synchronous (generic software)
+ *		  implementations, for a baseline on any Linux system
+ *
+ * Usage (debugfs, under crypto_bench/load):
+ *	echo "aes128-cbc-sha1 256 3 enc" > workload
+ *	echo "aes256-gcm 1024 1 dec" > workload
+ *	echo 4 > threads; echo 32 > window; echo 1 > backend
+ *	echo start > cmd; sleep 10; cat results
+ *
+ * 'format' selects CSV (0) or JSON (1) results. Decrypting synthetic
+ * data fails authentication; such completions are counted as 'auth_fail'
+ * by the software backend and as 'errors' by the NSS backend, but the
+ * work was done and it is included in the throughput.
+ */
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/kthread.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/random.h>
+#include <linux/scatterlist.h>
+#include <linux/timekeeping.h>
+#include <linux/rtnetlink.h>
+#include <crypto/aead.h>
+#include <crypto/authenc.h>
+
+#include <nss_api_if.h>
+#include <nss_crypto_api.h>
+#include <nss_crypto_hlos.h>
+#include <nss_crypto_defines.h>
+#include <nss_crypto_hdr.h>
+
+#include "nss_crypto_bench.h"
+
+#define CRYPTO_BENCH_LOAD_PERM_RO	0444
+#define CRYPTO_BENCH_LOAD_PERM_RW	0666
+
+#define CRYPTO_BENCH_LOAD_MAX_ENTRIES	16	/* workload entries */
+#define CRYPTO_BENCH_LOAD_MAX_THREADS	NR_CPUS	/* submitter threads */
+#define CRYPTO_BENCH_LOAD_MAX_WINDOW	256	/* in-flight requests per thread */
+#define CRYPTO_BENCH_LOAD_MAX_DATA_SZ	1536	/* bytes, NSS limit */
+#define CRYPTO_BENCH_LOAD_MAX_KEY_SZ	32	/* bytes */
+#define CRYPTO_BENCH_LOAD_MAX_IV_SZ	16	/* bytes */
+#define CRYPTO_BENCH_LOAD_MAX_ICV_SZ	32	/* bytes */
+#define CRYPTO_BENCH_LOAD_HIST_SZ	20	/* log2(usecs) buckets */
+
+#define crypto_bench_load_err(fmt, args...)	pr_err("crypto_bench_load: " fmt, ##args)
+#define crypto_bench_load_info(fmt, args...)	pr_info("crypto_bench_load: " fmt, ##args)
+
+enum crypto_bench_load_backend {
+	CRYPTO_BENCH_LOAD_BACKEND_NSS = 0,
+	CRYPTO_BENCH_LOAD_BACKEND_SW = 1,
+	CRYPTO_BENCH_LOAD_BACKEND_MAX
+};
+
+enum crypto_bench_load_format {
+	CRYPTO_BENCH_LOAD_FORMAT_CSV = 0,
+	CRYPTO_BENCH_LOAD_FORMAT_JSON = 1,
+};
+
+/*
+ * crypto_bench_load_algo
+ *	algorithm as known to NSS and to the Linux crypto API
+ */
+struct crypto_bench_load_algo {
+	const char *name;			/* workload name */
+	enum nss_crypto_cmn_algo nss_algo;	/* NSS algorithm */
+	const char *sw_name;			/* Linux AEAD name */
+	uint16_t cipher_keylen;			/* cipher key length */
+	uint16_t auth_keylen;			/* auth key length, '0' for GCM */
+	uint16_t blk_len;			/* cipher block length */
+	uint16_t iv_len;			/* NSS IV length */
+	uint16_t icv_len;			/* truncated ICV length */
+};
+
+static const struct crypto_bench_load_algo crypto_bench_load_algos[] = {
+	{"aes128-cbc-sha1", NSS_CRYPTO_CMN_ALGO_AES128_CBC_SHA160_HMAC, "authenc(hmac(sha1),cbc(aes))", 16, 20, 16, 16, 12},
+	{"aes128-cbc-sha256", NSS_CRYPTO_CMN_ALGO_AES128_CBC_SHA256_HMAC, "authenc(hmac(sha256),cbc(aes))", 16, 32, 16, 16, 16},
+	{"aes256-cbc-sha1", NSS_CRYPTO_CMN_ALGO_AES256_CBC_SHA160_HMAC, "authenc(hmac(sha1),cbc(aes))", 32, 20, 16, 16, 12},
+	{"aes256-cbc-sha256", NSS_CRYPTO_CMN_ALGO_AES256_CBC_SHA256_HMAC, "authenc(hmac(sha256),cbc(aes))", 32, 32, 16, 16, 16},
+	{"3des-cbc-sha1", NSS_CRYPTO_CMN_ALGO_3DES_CBC_SHA160_HMAC, "authenc(hmac(sha1),cbc(des3_ede))", 24, 20, 8, 8, 12},
+	{"aes128-gcm", NSS_CRYPTO_CMN_ALGO_AES128_GCM_GMAC, "gcm(aes)", 16, 0, 1, 16, 16},
+	{"aes256-gcm", NSS_CRYPTO_CMN_ALGO_AES256_GCM_GMAC, "gcm(aes)", 32, 0, 1, 16, 16},
+};
+
+/*
+ * crypto_bench_load_entry
+ *	workload entry
+ */
+struct crypto_bench_load_entry {
+	const struct crypto_bench_load_algo *algo;	/* algorithm */
+	uint32_t len;				/* payload length */
+	uint32_t weight;			/* relative share of requests */
+	bool encrypt;				/* encrypt or decrypt */
+
+	int32_t sid;				/* NSS session */
+	struct crypto_aead *tfm;		/* software transform */
+};
+
+/*
+ * crypto_bench_load_stats
+ *	per thread, per workload entry statistics
+ */
+struct crypto_bench_load_stats {
+	uint64_t completed;			/* requests completed */
+	uint64_t errors;			/* submit or completion errors */
+	uint64_t auth_fail;			/* authentication failures */
+	uint64_t bytes;				/* payload bytes completed */
+	uint64_t lat_sum;			/* sum of latencies (nsecs) */
+	uint64_t lat_min;			/* minimum latency (nsecs) */
+	uint64_t lat_max;			/* maximum latency (nsecs) */
+	uint64_t hist[CRYPTO_BENCH_LOAD_HIST_SZ];	/* latency histogram */
+};
+
+struct crypto_bench_load_thread;
+
+/*
+ * crypto_bench_load_req
+ *	request slot of a thread
+ */
+struct crypto_bench_load_req {
+	struct crypto_bench_load_thread *thread;	/* owner */
+	struct crypto_bench_load_entry *entry;	/* workload entry in use */
+	struct scatterlist sg;			/* data SG */
+	uint8_t *payload;			/* allocated buffer */
+	uint8_t *data;				/* aligned data */
+	struct aead_request *aead;		/* software request */
+	uint64_t start;				/* submit time (nsecs) */
+	uint8_t iv[CRYPTO_BENCH_LOAD_MAX_IV_SZ];	/* IV */
+};
+
+/*
+ * crypto_bench_load_thread
+ *	submitter thread
+ */
+struct crypto_bench_load_thread {
+	struct task_struct *task;		/* kthread */
+	wait_queue_head_t wq;			/* wait for free slots */
+	spinlock_t lock;			/* protects free slots and stats */
+	struct crypto_bench_load_req *reqs;	/* request slots */
+	struct crypto_bench_load_req **free;	/* free slot stack */
+	uint32_t num_free;			/* free slots */
+	struct rnd_state rnd;			/* workload selection */
+	int cpu;				/* bound CPU */
+	bool done;				/* submission ended */
+	struct crypto_bench_load_stats stats[CRYPTO_BENCH_LOAD_MAX_ENTRIES];
+};
+
+/*
+ * crypto_bench_load_backend
+ *	request engine
+ */
+struct crypto_bench_load_backend {
+	const char *name;
+	int (*entry_init)(struct crypto_bench_load_entry *e);
+	void (*entry_deinit)(struct crypto_bench_load_entry *e);
+	int (*submit)(struct crypto_bench_load_req *req);
+};
+
+/*
+ * crypto_bench_load
+ *	load generator state
+ */
+struct crypto_bench_load {
+	struct mutex mutex;			/* serializes control */
+	struct dentry *dentry;			/* debugfs directory */
+	struct nss_crypto_user *user;		/* NSS crypto user */
+
+	uint32_t threads;			/* number of threads */
+	uint32_t window;			/* in-flight requests per thread */
+	uint32_t duration_ms;			/* run time */
+	uint32_t backend;			/* enum crypto_bench_load_backend */
+	uint32_t format;			/* enum crypto_bench_load_format */
+
+	struct crypto_bench_load_entry entries[CRYPTO_BENCH_LOAD_MAX_ENTRIES];
+	uint32_t num_entries;			/* workload entries */
+	uint32_t total_weight;			/* sum of entry weights */
+
+	const struct crypto_bench_load_backend *ops;	/* backend of the current run */
+	struct crypto_bench_load_thread *thread;	/* threads of the current run */
+	uint32_t num_threads;			/* threads of the current run */
+	uint32_t run_window;			/* window of the current run */
+	atomic_t running;			/* threads still submitting */
+	atomic_t inflight;			/* requests owned by the engine */
+	wait_queue_head_t drained;		/* wait for inflight to drop to 0 */
+	uint64_t start;				/* run start (nsecs) */
+	uint64_t end;				/* run end (nsecs) */
+
+	uint8_t cipher_key[CRYPTO_BENCH_LOAD_MAX_KEY_SZ];	/* cipher key */
+	uint8_t auth_key[CRYPTO_BENCH_LOAD_MAX_KEY_SZ];	/* auth key */
+};
+
+static struct crypto_bench_load load = {
+	.threads = 1,
+	.window = 32,
+	.duration_ms = 10000,
+	.backend = CRYPTO_BENCH_LOAD_BACKEND_NSS,
+	.format = CRYPTO_BENCH_LOAD_FORMAT_CSV,
+};
+
+static const uint8_t *crypto_bench_load_help = "start stop clear";
+
+/*
+ * crypto_bench_load_hist_idx()
+ *	histogram bucket for a latency
+ */
+static inline uint32_t crypto_bench_load_hist_idx(uint64_t nsecs)
+{
+	uint32_t idx = fls64(div_u64(nsecs, NSEC_PER_USEC));
+
+	return min_t(uint32_t, idx, CRYPTO_BENCH_LOAD_HIST_SZ - 1);
+}
+
+/*
+ * crypto_bench_load_complete()
+ *	account a completed request and release its slot
+ */
+static void crypto_bench_load_complete(struct crypto_bench_load_req *req, int error)
+{
+	struct crypto_bench_load_thread *t = req->thread;
+	struct crypto_bench_load_entry *e = req->entry;
+	struct crypto_bench_load_stats *s = &t->stats[e - load.entries];
+	uint64_t lat = ktime_get_ns() - req->start;
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+
+	if (error == -EBADMSG)
+		s->auth_fail++;
+	else if (error)
+		s->errors++;
+
+	s->completed++;
+	s->bytes += e->len;
+	s->lat_sum += lat;
+	s->lat_max = max(s->lat_max, lat);
+	s->lat_min = s->lat_min ? min(s->lat_min, lat) : lat;
+	s->hist[crypto_bench_load_hist_idx(lat)]++;
+
+	t->free[t->num_free++] = req;
+	spin_unlock_irqrestore(&t->lock, flags);
+
+	wake_up(&t->wq);
+
+	if (atomic_dec_and_test(&load.inflight))
+		wake_up(&load.drained);
+}
+
+/*
+ * crypto_bench_load_nss_entry_init()
+ *	allocate an NSS session for the entry
+ */
+static int crypto_bench_load_nss_entry_init(struct crypto_bench_load_entry *e)
+{
+	struct nss_crypto_session_data data = {0};
+	int status;
+
+	if (!load.user)
+		return -ENODEV;
+
+	data.algo = e->algo->nss_algo;
+	data.cipher_key = load.cipher_key;
+	data.auth_key = load.auth_key;
+	data.auth_keylen = e->algo->auth_keylen;
+
+	status = nss_crypto_session_alloc(load.user, &data, &e->sid);
+	if (status < 0) {
+		e->sid = -1;
+		return status;
+	}
+
+	return 0;
+}
+
+/*
+ * crypto_bench_load_nss_entry_deinit()
+ *	free the NSS session of the entry
+ */
+static void crypto_bench_load_nss_entry_deinit(struct crypto_bench_load_entry *e)
+{
+	if (e->sid < 0)
+		return;
+
+	nss_crypto_session_free(load.user, e->sid);
+	e->sid = -1;
+}
+
+/*
+ * crypto_bench_load_nss_done()
+ *	NSS completion
+ */
+static void crypto_bench_load_nss_done(void *app_data, struct nss_crypto_hdr *ch, uint8_t status)
+{
+	struct crypto_bench_load_req *req = app_data;
+
+	nss_crypto_hdr_free(load.user, ch);
+	crypto_bench_load_complete(req, status ? -EIO : 0);
+}
+
+/*
+ * crypto_bench_load_nss_submit()
+ *	submit a request to NSS
+ */
+static int crypto_bench_load_nss_submit(struct crypto_bench_load_req *req)
+{
+	struct crypto_bench_load_entry *e = req->entry;
+	uint16_t iv_len = e->algo->iv_len;
+	uint16_t icv_len = e->algo->icv_len;
+	uint16_t data_len = iv_len + e->len;
+	uint16_t fixed_size, tot_len;
+	struct nss_crypto_hdr *ch;
+	int error;
+
+	sg_init_one(&req->sg, req->data, data_len + icv_len);
+
+	ch = nss_crypto_hdr_alloc(load.user, e->sid, 1, 1, iv_len, icv_len, false);
+	if (!ch)
+		return -ENOMEM;
+
+	nss_crypto_hdr_set_skip(ch, iv_len);
+	nss_crypto_hdr_set_op(ch, e->encrypt ? NSS_CRYPTO_OP_DIR_ENC_AUTH : NSS_CRYPTO_OP_DIR_AUTH_DEC);
+	nss_crypto_hdr_map_sglist(ch, &req->sg, &req->sg, data_len, data_len + icv_len, true);
+
+	fixed_size = 2 * ch->in_frags * sizeof(struct nss_crypto_frag) + sizeof(struct nss_crypto_hdr);
+	tot_len = ch->iv_len + ch->hmac_len + ch->buf_len + ch->priv_len + fixed_size;
+	nss_crypto_hdr_set_tot_len(ch, tot_len);
+
+	memcpy(nss_crypto_hdr_get_iv(ch), req->iv, iv_len);
+
+	error = nss_crypto_transform_payload(load.user, ch, crypto_bench_load_nss_done, req);
+	if (error < 0) {
+		nss_crypto_hdr_free(load.user, ch);
+		return error;
+	}
+
+	return 0;
+}
+
+/*
+ * crypto_bench_load_sw_entry_init()
+ *	allocate a synchronous software transform for the entry
+ */
+static int crypto_bench_load_sw_entry_init(struct crypto_bench_load_entry *e)
+{
+	const struct crypto_bench_load_algo *algo = e->algo;
+	uint8_t key[RTA_SPACE(sizeof(struct crypto_authenc_key_param)) + 2 * CRYPTO_BENCH_LOAD_MAX_KEY_SZ];
+	struct crypto_authenc_key_param *param;
+	struct crypto_aead *tfm;
+	struct rtattr *rta;
+	unsigned int keylen;
+	int error;
+
+	/*
+	 * Masking CRYPTO_ALG_ASYNC leaves only synchronous implementations,
+	 * i.e. the generic (or CPU accelerated) software ones
+	 */
+	tfm = crypto_alloc_aead(algo->sw_name, 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	if (algo->auth_keylen) {
+		rta = (struct rtattr *)key;
+		rta->rta_type = CRYPTO_AUTHENC_KEYA_PARAM;
+		rta->rta_len = RTA_LENGTH(sizeof(*param));
+		param = RTA_DATA(rta);
+		param->enckeylen = cpu_to_be32(algo->cipher_keylen);
+
+		keylen = RTA_SPACE(sizeof(*param));
+		memcpy(key + keylen, load.auth_key, algo->auth_keylen);
+		keylen += algo->auth_keylen;
+		memcpy(key + keylen, load.cipher_key, algo->cipher_keylen);
+		keylen += algo->cipher_keylen;
+	} else {
+		memcpy(key, load.cipher_key, algo->cipher_keylen);
+		keylen = algo->cipher_keylen;
+	}
+
+	error = crypto_aead_setkey(tfm, key, keylen);
+	if (!error)
+		error = crypto_aead_setauthsize(tfm, algo->icv_len);
+
+	if (error) {
+		crypto_free_aead(tfm);
+		return error;
+	}
+
+	e->tfm = tfm;
+	return 0;
+}
+
+/*
+ * crypto_bench_load_sw_entry_deinit()
+ *	free the software transform of the entry
+ */
+static void crypto_bench_load_sw_entry_deinit(struct crypto_bench_load_entry *e)
+{
+	if (!e->tfm)
+		return;
+
+	crypto_free_aead(e->tfm);
+	e->tfm = NULL;
+}
+
+/*
+ * crypto_bench_load_sw_done()
+ *	software completion, only used if an async transform slips through
+ */
+static void crypto_bench_load_sw_done(struct crypto_async_request *base, int error)
+{
+	if (error == -EINPROGRESS)
+		return;
+
+	crypto_bench_load_complete(base->data, error);
+}
+
+/*
+ * crypto_bench_load_sw_submit()
+ *	run a request through the kernel crypto API
+ */
+static int crypto_bench_load_sw_submit(struct crypto_bench_load_req *req)
+{
+	struct crypto_bench_load_entry *e = req->entry;
+	uint16_t icv_len = e->algo->icv_len;
+	int error;
+
+	sg_init_one(&req->sg, req->data, e->len + icv_len);
+
+	aead_request_set_tfm(req->aead, e->tfm);
+	aead_request_set_callback(req->aead, 0, crypto_bench_load_sw_done, req);
+	aead_request_set_crypt(req->aead, &req->sg, &req->sg, e->encrypt ? e->len : e->len + icv_len, req->iv);
+	aead_request_set_ad(req->aead, 0);
+
+	error = e->encrypt ? crypto_aead_encrypt(req->aead) : crypto_aead_decrypt(req->aead);
+	if ((error == -EINPROGRESS) || (error == -EBUSY))
+		return 0;
+
+	crypto_bench_load_complete(req, error);
+	return 0;
+}
+
+static const struct crypto_bench_load_backend crypto_bench_load_backends[CRYPTO_BENCH_LOAD_BACKEND_MAX] = {
+	[CRYPTO_BENCH_LOAD_BACKEND_NSS] = {
+		.name = "nss",
+		.entry_init = crypto_bench_load_nss_entry_init,
+		.entry_deinit = crypto_bench_load_nss_entry_deinit,
+		.submit = crypto_bench_load_nss_submit,
+	},
+	[CRYPTO_BENCH_LOAD_BACKEND_SW] = {
+		.name = "sw",
+		.entry_init = crypto_bench_load_sw_entry_init,
+		.entry_deinit = crypto_bench_load_sw_entry_deinit,
+		.submit = crypto_bench_load_sw_submit,
+	},
+};
+
+/*
+ * crypto_bench_load_pick()
+ *	select a workload entry according to the weights
+ */
+static struct crypto_bench_load_entry *crypto_bench_load_pick(struct crypto_bench_load_thread *t)
+{
+	uint32_t val = prandom_u32_state(&t->rnd) % load.total_weight;
+	struct crypto_bench_load_entry *e = load.entries;
+
+	while (val >= e->weight) {
+		val -= e->weight;
+		e++;
+	}
+
+	return e;
+}
+
+/*
+ * crypto_bench_load_get()
+ *	get a free request slot
+ */
+static struct crypto_bench_load_req *crypto_bench_load_get(struct crypto_bench_load_thread *t)
+{
+	struct crypto_bench_load_req *req = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	if (t->num_free)
+		req = t->free[--t->num_free];
+
+	spin_unlock_irqrestore(&t->lock, flags);
+	return req;
+}
+
+/*
+ * crypto_bench_load_idle()
+ *	check if all the request slots of a thread are free
+ */
+static bool crypto_bench_load_idle(struct crypto_bench_load_thread *t)
+{
+	return READ_ONCE(t->num_free) == load.run_window;
+}
+
+/*
+ * crypto_bench_load_tx()
+ *	submitter thread
+ */
+static int crypto_bench_load_tx(void *arg)
+{
+	struct crypto_bench_load_thread *t = arg;
+	unsigned long deadline = jiffies + msecs_to_jiffies(load.duration_ms);
+	struct crypto_bench_load_req *req;
+	unsigned long flags;
+	int error;
+
+	while (!kthread_should_stop() && time_before(jiffies, deadline)) {
+		req = crypto_bench_load_get(t);
+		if (!req) {
+			wait_event_interruptible_timeout(t->wq, READ_ONCE(t->num_free) || kthread_should_stop(),
+					msecs_to_jiffies(100));
+			continue;
+		}
+
+		req->entry = crypto_bench_load_pick(t);
+		req->start = ktime_get_ns();
+
+		atomic_inc(&load.inflight);
+		error = load.ops->submit(req);
+		if (error) {
+			spin_lock_irqsave(&t->lock, flags);
+			t->stats[req->entry - load.entries].errors++;
+			t->free[t->num_free++] = req;
+			spin_unlock_irqrestore(&t->lock, flags);
+
+			if (atomic_dec_and_test(&load.inflight))
+				wake_up(&load.drained);
+
+			cond_resched();
+		}
+	}
+
+	/*
+	 * Let the in-flight requests drain before the run is
+	 * marked complete
+	 */
+	wait_event_timeout(t->wq, crypto_bench_load_idle(t), 2 * HZ);
+	t->done = true;
+
+	if (atomic_dec_and_test(&load.running)) {
+		load.end = ktime_get_ns();
+		crypto_bench_load_info("run complete\n");
+	}
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+	}
+
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+/*
+ * crypto_bench_load_free_thread()
+ *	free the request slots of a thread
+ */
+static void crypto_bench_load_free_thread(struct crypto_bench_load_thread *t)
+{
+	int i;
+
+	if (!t->reqs)
+		return;
+
+	/*
+	 * Requests still owned by the engine can't be freed
+	 */
+	if (!crypto_bench_load_idle(t)) {
+		crypto_bench_load_err("%px: requests still in flight, leaking them\n", t);
+		return;
+	}
+
+	for (i = 0; i < load.run_window; i++) {
+		kfree(t->reqs[i].payload);
+		kfree(t->reqs[i].aead);
+	}
+
+	kfree(t->free);
+	kfree(t->reqs);
+	t->free = NULL;
+	t->reqs = NULL;
+}
+
+/*
+ * crypto_bench_load_alloc_thread()
+ *	allocate the request slots of a thread
+ *
+ * Note: an AEAD request is allocated for every slot when the backend uses
+ * kernel crypto transforms, even if their request context size is zero
+ */
+static int crypto_bench_load_alloc_thread(struct crypto_bench_load_thread *t, bool aead, unsigned int reqsize)
+{
+	struct crypto_bench_load_req *req;
+	size_t len;
+	int i;
+
+	t->reqs = kcalloc(load.run_window, sizeof(*t->reqs), GFP_KERNEL);
+	t->free = kcalloc(load.run_window, sizeof(*t->free), GFP_KERNEL);
+	if (!t->reqs || !t->free)
+		return -ENOMEM;
+
+	len = CRYPTO_BENCH_LOAD_MAX_IV_SZ + CRYPTO_BENCH_LOAD_MAX_DATA_SZ + CRYPTO_BENCH_LOAD_MAX_ICV_SZ;
+
+	for (i = 0; i < load.run_window; i++) {
+		req = &t->reqs[i];
+		req->thread = t;
+
+		req->payload = kmalloc(len + SMP_CACHE_BYTES, GFP_DMA);
+		if (!req->payload)
+			return -ENOMEM;
+
+		req->data = PTR_ALIGN(req->payload, SMP_CACHE_BYTES);
+		prandom_bytes_state(&t->rnd, req->data, len);
+		prandom_bytes_state(&t->rnd, req->iv, sizeof(req->iv));
+
+		if (aead) {
+			req->aead = kzalloc(sizeof(struct aead_request) + reqsize, GFP_KERNEL);
+			if (!req->aead)
+				return -ENOMEM;
+		}
+
+		t->free[t->num_free++] = req;
+	}
+
+	return 0;
+}
+
+/*
+ * crypto_bench_load_stop()
+ *	stop the current run and release its resources
+ *
+ * Note: the results are kept until the next run
+ */
+static void crypto_bench_load_stop(void)
+{
+	struct crypto_bench_load_entry *e;
+	int i;
+
+	if (!load.thread)
+		return;
+
+	for (i = 0; i < load.num_threads; i++) {
+		if (load.thread[i].task) {
+			kthread_stop(load.thread[i].task);
+			put_task_struct(load.thread[i].task);
+			load.thread[i].task = NULL;
+		}
+	}
+
+	/*
+	 * Sessions, transforms and request slots are still referenced
+	 * by the requests the engine owns; wait for all of them to
+	 * complete before tearing anything down
+	 */
+	while (!wait_event_timeout(load.drained, !atomic_read(&load.inflight), 5 * HZ))
+		crypto_bench_load_info("waiting for %d requests in flight\n", atomic_read(&load.inflight));
+
+	for (i = 0; i < load.num_entries; i++) {
+		e = &load.entries[i];
+		load.ops->entry_deinit(e);
+	}
+
+	for (i = 0; i < load.num_threads; i++)
+		crypto_bench_load_free_thread(&load.thread[i]);
+
+	if (!load.end)
+		load.end = ktime_get_ns();
+}
+
+/*
+ * crypto_bench_load_start()
+ *	start a run with the current parameters and workload
+ */
+static int crypto_bench_load_start(void)
+{
+	const struct crypto_bench_load_backend *ops;
+	struct crypto_bench_load_thread *t;
+	struct crypto_bench_load_entry *e;
+	unsigned int reqsize = 0;
+	bool aead = false;
+	int cpu, i, error;
+
+	if (load.thread && atomic_read(&load.running))
+		return -EBUSY;
+
+	if (!load.threads || (load.threads > CRYPTO_BENCH_LOAD_MAX_THREADS))
+		return -EINVAL;
+
+	if (!load.window || (load.window > CRYPTO_BENCH_LOAD_MAX_WINDOW))
+		return -EINVAL;
+
+	if (load.backend >= CRYPTO_BENCH_LOAD_BACKEND_MAX)
+		return -EINVAL;
+
+	/*
+	 * Release the previous run; its results go away now
+	 */
+	crypto_bench_load_stop();
+	kfree(load.thread);
+	load.thread = NULL;
+
+	/*
+	 * Default workload
+	 */
+	if (!load.num_entries) {
+		e = &load.entries[load.num_entries++];
+		e->algo = &crypto_bench_load_algos[0];
+		e->len = 256;
+		e->weight = 1;
+		e->encrypt = true;
+		load.total_weight = 1;
+	}
+
+	ops = &crypto_bench_load_backends[load.backend];
+	load.ops = ops;
+
+	load.thread = kcalloc(load.threads, sizeof(*load.thread), GFP_KERNEL);
+	if (!load.thread)
+		return -ENOMEM;
+
+	load.num_threads = load.threads;
+	load.run_window = load.window;
+	load.start = load.end = 0;
+
+	for (i = 0; i < load.num_entries; i++) {
+		e = &load.entries[i];
+		e->sid = -1;
+		e->tfm = NULL;
+
+		error = ops->entry_init(e);
+		if (error) {
+			crypto_bench_load_err("%s: unable to set up %s, error(%d)\n", ops->name, e->algo->name, error);
+			goto fail;
+		}
+
+		if (e->tfm) {
+			reqsize = max(reqsize, crypto_aead_reqsize(e->tfm));
+			aead = true;
+		}
+	}
+
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < load.num_threads; i++) {
+		t = &load.thread[i];
+		t->cpu = cpu;
+		spin_lock_init(&t->lock);
+		init_waitqueue_head(&t->wq);
+		prandom_seed_state(&t->rnd, get_random_u64());
+
+		error = crypto_bench_load_alloc_thread(t, aead, reqsize);
+		if (error)
+			goto fail;
+
+		t->task = kthread_create(crypto_bench_load_tx, t, "crypto_load/%d", i);
+		if (IS_ERR(t->task)) {
+			error = PTR_ERR(t->task);
+			t->task = NULL;
+			goto fail;
+		}
+
+		get_task_struct(t->task);
+		kthread_bind(t->task, cpu);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	atomic_set(&load.running, load.num_threads);
+	load.start = ktime_get_ns();
+
+	for (i = 0; i < load.num_threads; i++)
+		wake_up_process(load.thread[i].task);
+
+	crypto_bench_load_info("%s: started %u thread(s), window %u, %u entries\n", ops->name,
+			load.num_threads, load.run_window, load.num_entries);
+	return 0;
+
+fail:
+	atomic_set(&load.running, 0);
+	crypto_bench_load_stop();
+	kfree(load.thread);
+	load.thread = NULL;
+	return error;
+}
+
+/*
+ * crypto_bench_load_sum()
+ *	sum the statistics of an entry over all the threads
+ */
+static void crypto_bench_load_sum(uint32_t idx, struct crypto_bench_load_stats *sum)
+{
+	struct crypto_bench_load_stats *s;
+	struct crypto_bench_load_thread *t;
+	unsigned long flags;
+	int i, j;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for (i = 0; i < load.num_threads; i++) {
+		t = &load.thread[i];
+		s = &t->stats[idx];
+
+		spin_lock_irqsave(&t->lock, flags);
+		sum->completed += s->completed;
+		sum->errors += s->errors;
+		sum->auth_fail += s->auth_fail;
+		sum->bytes += s->bytes;
+		sum->lat_sum += s->lat_sum;
+		sum->lat_max = max(sum->lat_max, s->lat_max);
+		if (s->lat_min)
+			sum->lat_min = sum->lat_min ? min(sum->lat_min, s->lat_min) : s->lat_min;
+
+		for (j = 0; j < CRYPTO_BENCH_LOAD_HIST_SZ; j++)
+			sum->hist[j] += s->hist[j];
+
+		spin_unlock_irqrestore(&t->lock, flags);
+	}
+}
+
+/*
+ * crypto_bench_load_percentile()
+ *	upper bound (usecs) of the bucket holding the given percentile
+ */
+static uint64_t crypto_bench_load_percentile(struct crypto_bench_load_stats *s, uint32_t pct)
+{
+	uint64_t target = div_u64(s->completed * pct + 99, 100);
+	uint64_t count = 0;
+	int i;
+
+	for (i = 0; i < CRYPTO_BENCH_LOAD_HIST_SZ; i++) {
+		count += s->hist[i];
+		if (count && (count >= target))
+			return 1ULL << i;
+	}
+
+	return 0;
+}
+
+/*
+ * crypto_bench_load_results_show()
+ *	print the results of the current (or last) run
+ */
+static int crypto_bench_load_results_show(struct seq_file *m, void *p)
+{
+	struct crypto_bench_load_stats sum;
+	struct crypto_bench_load_entry *e;
+	bool json = (load.format == CRYPTO_BENCH_LOAD_FORMAT_JSON);
+	uint64_t elapsed_us, lat_avg, mbps;
+	int i, j;
+
+	mutex_lock(&load.mutex);
+
+	if (!load.thread) {
+		mutex_unlock(&load.mutex);
+		return 0;
+	}
+
+	elapsed_us = div_u64((load.end ? load.end : ktime_get_ns()) - load.start, NSEC_PER_USEC);
+
+	if (json) {
+		seq_printf(m, "{\"backend\":\"%s\",\"threads\":%u,\"window\":%u,\"running\":%s,\"elapsed_us\":%llu,\"results\":[",
+				load.ops->name, load.num_threads, load.run_window,
+				atomic_read(&load.running) ? "true" : "false", elapsed_us);
+	} else {
+		seq_puts(m, "backend,threads,window,algo,len,dir,completed,errors,auth_fail,bytes,mbps,"
+				"lat_min_us,lat_avg_us,lat_max_us,lat_p50_us,lat_p90_us,lat_p99_us");
+		for (j = 0; j < CRYPTO_BENCH_LOAD_HIST_SZ; j++)
+			seq_printf(m, ",hist_%u", j);
+
+		seq_puts(m, "\n");
+	}
+
+	for (i = 0; i < load.num_entries; i++) {
+		e = &load.entries[i];
+		crypto_bench_load_sum(i, &sum);
+
+		lat_avg = sum.completed ? div64_u64(sum.lat_sum, sum.completed) : 0;
+		mbps = elapsed_us ? div64_u64(sum.bytes * 8, elapsed_us) : 0;
+
+		if (json) {
+			seq_printf(m, "%s{\"algo\":\"%s\",\"len\":%u,\"dir\":\"%s\",\"completed\":%llu,\"errors\":%llu,"
+					"\"auth_fail\":%llu,\"bytes\":%llu,\"mbps\":%llu,\"lat_min_us\":%llu,"
+					"\"lat_avg_us\":%llu,\"lat_max_us\":%llu,\"lat_p50_us\":%llu,\"lat_p90_us\":%llu,"
+					"\"lat_p99_us\":%llu,\"hist\":[",
+					i ? "," : "", e->algo->name, e->len, e->encrypt ? "enc" : "dec",
+					sum.completed, sum.errors, sum.auth_fail, sum.bytes, mbps,
+					div_u64(sum.lat_min, NSEC_PER_USEC), div_u64(lat_avg, NSEC_PER_USEC),
+					div_u64(sum.lat_max, NSEC_PER_USEC), crypto_bench_load_percentile(&sum, 50),
+					crypto_bench_load_percentile(&sum, 90), crypto_bench_load_percentile(&sum, 99));
+
+			for (j = 0; j < CRYPTO_BENCH_LOAD_HIST_SZ; j++)
+				seq_printf(m, "%s%llu", j ? "," : "", sum.hist[j]);
+
+			seq_puts(m, "]}");
+			continue;
+		}
+
+		seq_printf(m, "%s,%u,%u,%s,%u,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu",
+				load.ops->name, load.num_threads, load.run_window, e->algo->name, e->len,
+				e->encrypt ? "enc" : "dec", sum.completed, sum.errors, sum.auth_fail,
+				sum.bytes, mbps, div_u64(sum.lat_min, NSEC_PER_USEC),
+				div_u64(lat_avg, NSEC_PER_USEC), div_u64(sum.lat_max, NSEC_PER_USEC),
+				crypto_bench_load_percentile(&sum, 50), crypto_bench_load_percentile(&sum, 90),
+				crypto_bench_load_percentile(&sum, 99));
+
+		for (j = 0; j < CRYPTO_BENCH_LOAD_HIST_SZ; j++)
+			seq_printf(m, ",%llu", sum.hist[j]);
+
+		seq_puts(m, "\n");
+	}
+
+	if (json)
+		seq_puts(m, "]}\n");
+
+	mutex_unlock(&load.mutex);
+	return 0;
+}
+
+static int crypto_bench_load_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, crypto_bench_load_results_show, inode->i_private);
+}
+
+static const struct file_operations crypto_bench_load_results_ops = {
+	.open = crypto_bench_load_results_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * crypto_bench_load_workload_show()
+ *	print the configured workload
+ */
+static int crypto_bench_load_workload_show(struct seq_file *m, void *p)
+{
+	struct crypto_bench_load_entry *e;
+	int i;
+
+	mutex_lock(&load.mutex);
+
+	for (i = 0; i < load.num_entries; i++) {
+		e = &load.entries[i];
+		seq_printf(m, "%s %u %u %s\n", e->algo->name, e->len, e->weight, e->encrypt ? "enc" : "dec");
+	}
+
+	mutex_unlock(&load.mutex);
+	return 0;
+}
+
+static int crypto_bench_load_workload_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, crypto_bench_load_workload_show, inode->i_private);
+}
+
+/*
+ * crypto_bench_load_parse()
+ *	parse one "<algo> <len> [<weight> [enc|dec]]" workload line
+ */
+static int crypto_bench_load_parse(char *line)
+{
+	const struct crypto_bench_load_algo *algo = NULL;
+	struct crypto_bench_load_entry *e;
+	char name[32] = {0}, dir[4] = "enc";
+	uint32_t len, weight = 1;
+	int i;
+
+	if (sscanf(line, "%31s %u %u %3s", name, &len, &weight, dir) < 2)
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(crypto_bench_load_algos); i++) {
+		if (!strcmp(name, crypto_bench_load_algos[i].name)) {
+			algo = &crypto_bench_load_algos[i];
+			break;
+		}
+	}
+
+	if (!algo || !weight || !len || (len > CRYPTO_BENCH_LOAD_MAX_DATA_SZ) || (len % algo->blk_len))
+		return -EINVAL;
+
+	if (strcmp(dir, "enc") && strcmp(dir, "dec"))
+		return -EINVAL;
+
+	if (load.num_entries == CRYPTO_BENCH_LOAD_MAX_ENTRIES)
+		return -ENOSPC;
+
+	e = &load.entries[load.num_entries++];
+	e->algo = algo;
+	e->len = len;
+	e->weight = weight;
+	e->encrypt = !strcmp(dir, "enc");
+	e->sid = -1;
+	e->tfm = NULL;
+
+	load.total_weight += weight;
+	return 0;
+}
+
+/*
+ * crypto_bench_load_workload_write()
+ *	append workload entries, one per line
+ */
+static ssize_t crypto_bench_load_workload_write(struct file *fp, const char __user *ubuf, size_t cnt, loff_t *pos)
+{
+	char *buf, *cur, *line;
+	int error = 0;
+
+	if (cnt > PAGE_SIZE)
+		return -EINVAL;
+
+	buf = memdup_user_nul(ubuf, cnt);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	mutex_lock(&load.mutex);
+
+	if (load.thread && atomic_read(&load.running)) {
+		error = -EBUSY;
+		goto done;
+	}
+
+	cur = buf;
+	while ((line = strsep(&cur, "\n")) != NULL) {
+		line = strim(line);
+		if (!*line || (*line == '#'))
+			continue;
+
+		error = crypto_bench_load_parse(line);
+		if (error) {
+			crypto_bench_load_err("invalid workload line \"%s\"\n", line);
+			break;
+		}
+	}
+
+done:
+	mutex_unlock(&load.mutex);
+	kfree(buf);
+	return error ? error : cnt;
+}
+
+static const struct file_operations crypto_bench_load_workload_ops = {
+	.open = crypto_bench_load_workload_open,
+	.read = seq_read,
+	.write = crypto_bench_load_workload_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t crypto_bench_load_cmd_read(struct file *fp, char __user *ubuf, size_t cnt, loff_t *pos)
+{
+	return simple_read_from_buffer(ubuf, cnt, pos, crypto_bench_load_help, strlen(crypto_bench_load_help));
+}
+
+static ssize_t crypto_bench_load_cmd_write(struct file *fp, const char __user *ubuf, size_t cnt, loff_t *pos)
+{
+	uint8_t buf[16] = {0};
+	int error = 0;
+
+	if (copy_from_user(buf, ubuf, min(cnt, sizeof(buf) - 1)))
+		return -EFAULT;
+
+	mutex_lock(&load.mutex);
+
+	if (!strncmp(buf, "start", strlen("start"))) {
+		error = crypto_bench_load_start();
+	} else if (!strncmp(buf, "stop", strlen("stop"))) {
+		crypto_bench_load_stop();
+	} else if (!strncmp(buf, "clear", strlen("clear"))) {
+		if (load.thread && atomic_read(&load.running)) {
+			error = -EBUSY;
+		} else {
+			load.num_entries = 0;
+			load.total_weight = 0;
+		}
+	} else {
+		error = -EINVAL;
+	}
+
+	mutex_unlock(&load.mutex);
+	return error ? error : cnt;
+}
+
+static const struct file_operations crypto_bench_load_cmd_ops = {
+	.read = crypto_bench_load_cmd_read,
+	.write = crypto_bench_load_cmd_write,
+};
+
+/*
+ * crypto_bench_load_attach()
+ *	NSS crypto user is available
+ */
+void crypto_bench_load_attach(struct nss_crypto_user *user)
+{
+	mutex_lock(&load.mutex);
+	load.user = user;
+	mutex_unlock(&load.mutex);
+}
+
+/*
+ * crypto_bench_load_detach()
+ *	NSS crypto user is going away
+ */
+void crypto_bench_load_detach(void)
+{
+	mutex_lock(&load.mutex);
+
+	if (load.ops == &crypto_bench_load_backends[CRYPTO_BENCH_LOAD_BACKEND_NSS])
+		crypto_bench_load_stop();
+
+	load.user = NULL;
+	mutex_unlock(&load.mutex);
+}
+
+/*
+ * crypto_bench_load_init()
+ *	create the load generator debugfs interface
+ */
+void crypto_bench_load_init(struct dentry *root)
+{
+	mutex_init(&load.mutex);
+	init_waitqueue_head(&load.drained);
+	atomic_set(&load.inflight, 0);
+	get_random_bytes(load.cipher_key, sizeof(load.cipher_key));
+	get_random_bytes(load.auth_key, sizeof(load.auth_key));
+
+	if (!root)
+		return;
+
+	load.dentry = debugfs_create_dir("load", root);
+	if (!load.dentry)
+		return;
+
+	debugfs_create_u32("threads", CRYPTO_BENCH_LOAD_PERM_RW, load.dentry, &load.threads);
+	debugfs_create_u32("window", CRYPTO_BENCH_LOAD_PERM_RW, load.dentry, &load.window);
+	debugfs_create_u32("duration_ms", CRYPTO_BENCH_LOAD_PERM_RW, load.dentry, &load.duration_ms);
+	debugfs_create_u32("backend", CRYPTO_BENCH_LOAD_PERM_RW, load.dentry, &load.backend);
+	debugfs_create_u32("format", CRYPTO_BENCH_LOAD_PERM_RW, load.dentry, &load.format);
+
+	debugfs_create_file("workload", CRYPTO_BENCH_LOAD_PERM_RW, load.dentry, NULL, &crypto_bench_load_workload_ops);
+	debugfs_create_file("cmd", CRYPTO_BENCH_LOAD_PERM_RW, load.dentry, NULL, &crypto_bench_load_cmd_ops);
+	debugfs_create_file("results", CRYPTO_BENCH_LOAD_PERM_RO, load.dentry, NULL, &crypto_bench_load_results_ops);
+}
+
+/*
+ * crypto_bench_load_deinit()
+ *	stop any run and remove the debugfs interface
+ */
+void crypto_bench_load_deinit(void)
+{
+	debugfs_remove_recursive(load.dentry);
+	load.dentry = NULL;
+
+	mutex_lock(&load.mutex);
+	crypto_bench_load_stop();
+	kfree(load.thread);
+	load.thread = NULL;
+	mutex_unlock(&load.mutex);
+}
@@ -210,6 +210,12 @@ int __init eip_init_module(void)
 		return -EBADF;
 	}
 
+	/*
+	 * Software flow table model and DMA ring emulator; usable without the EIP.
+	 */
+	eip_flow_model_init(drv->dentry);
+	eip_dma_loopback_init(drv->dentry);
+
 	/*
 	 * Register platform driver.
 	 */
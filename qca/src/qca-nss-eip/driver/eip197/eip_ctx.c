@@ -40,6 +40,7 @@ static const char *svcname[EIP_SVC_MAX] = {
 static ssize_t eip_ctx_read_tr_stats(struct file *filep, char __user *ubuf, size_t count, loff_t *ppos)
 {
 	struct eip_ctx *ctx = filep->private_data;
+	struct eip_flow_tbl_stats fstats;
 	struct eip_flow_tbl *tbl;
 	struct eip_tr *tr;
 	ssize_t max_buf_len;
@@ -94,7 +95,7 @@ static ssize_t eip_ctx_read_tr_stats(struct file *filep, char __user *ubuf, size
 		if(tr->flow) {
 			struct eip_flow_tuple *tuple = &tr->flow->tuple;
 			uint32_t idx;
-			idx = EIP_FLOW_HASH_IDX(tr->flow->hash);
+			idx = eip_flow_get_index(tr->flow);
 
 			if (tuple->ip_ver == 6) {
 				len += snprintf(buf + len, max_buf_len - len, "Flow Src:%pI6n Dst:%pI6n spi:0x%X sport:%u dport:%u proto:%u index %u\n", tuple->src_ip, tuple->dst_ip, tuple->spi, ntohs(tuple->src_port), ntohs(tuple->dst_port), tuple->ip_proto, idx);
@@ -109,12 +110,13 @@ static ssize_t eip_ctx_read_tr_stats(struct file *filep, char __user *ubuf, size
 
 	read_unlock_bh(&ctx->tr.lock);
 
-	spin_lock_bh(&tbl->lock);
-        len += snprintf(buf + len, max_buf_len - len, "Flows allocated - %llu \n", tbl->stats.alloc);
-        len += snprintf(buf + len, max_buf_len - len, "Flows deallocated - %llu \n", tbl->stats.free);
-        len += snprintf(buf + len, max_buf_len - len, "Total collisions - %llu \n", tbl->stats.collision);
-        len += snprintf(buf + len, max_buf_len - len, "Active collisions - %llu \n", tbl->stats.active_collision);
-	spin_unlock_bh(&tbl->lock);
+	eip_flow_get_stats(tbl, &fstats);
+	len += snprintf(buf + len, max_buf_len - len, "Flows allocated - %llu \n", fstats.alloc);
+	len += snprintf(buf + len, max_buf_len - len, "Flows deallocated - %llu \n", fstats.free);
+	len += snprintf(buf + len, max_buf_len - len, "Total collisions - %llu \n", fstats.collision);
+	len += snprintf(buf + len, max_buf_len - len, "Active collisions - %llu \n", fstats.active_collision);
+	len += snprintf(buf + len, max_buf_len - len, "Flow add failures - %llu \n", fstats.fail);
+	len += snprintf(buf + len, max_buf_len - len, "Flow table resizes - %llu \n", fstats.resize);
 
 	ret = simple_read_from_buffer(ubuf, count, ppos, buf, len);
 	vfree(buf);
@@ -26,6 +26,9 @@
 #include <linux/slab.h>
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
+#include <linux/smp.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
 #include <asm/cacheflush.h>
 
 #include "eip_priv.h"
@@ -35,6 +38,16 @@ const char *irq_name[] = {"eip_irq_ring_0", "eip_irq_ring_1", "eip_irq_ring_2",
 const char *dma_name[] = {"ring_0", "ring_1", "ring_2", "ring_3",
 	"ring_4", "ring_5", "ring_6", "ring_7"};
 
+#define EIP_DMA_STEER_SCHED 0		/* Steering NAPI is scheduled or about to be */
+
+static uint dma_sched = EIP_DMA_SCHED_SA;
+module_param(dma_sched, uint, 0644);
+MODULE_PARM_DESC(dma_sched, "Lookaside ring selection: 0 - submitting CPU, 1 - SA affinity");
+
+static bool dma_steer = true;
+module_param(dma_steer, bool, 0644);
+MODULE_PARM_DESC(dma_steer, "Complete lookaside requests on the submitting CPU");
+
 /*
  * eip_dma_notify()
  *	Notify HW for new descriptor.
@@ -136,29 +149,15 @@ static inline void eip_dma_tx_cmd(struct eip_dma *dma, struct eip_sw_desc *sw, s
 }
 
 /*
- * eip_dma_read_dma_stats()
- *	Read DMA statistics.
+ * eip_dma_stats_print()
+ *	Print DMA statistics into buf.
  */
-static ssize_t eip_dma_read_dma_stats(struct file *filep, char __user *ubuf, size_t count, loff_t *ppos)
+static ssize_t eip_dma_stats_print(struct eip_dma *dma, char *buf, ssize_t max_buf_len)
 {
-	struct eip_dma *dma = filep->private_data;
 	struct eip_dma_stats *stats = &dma->stats;
-	ssize_t max_buf_len;
 	ssize_t len;
-	ssize_t ret;
-	char *buf;
 	int i;
 
-	/*
-	 * We need to allocate space for the string and the value
-	 */
-	max_buf_len = (sizeof(*stats)/sizeof(uint64_t)) * EIP_DEBUGFS_MAX_NAME;
-	max_buf_len += (4 * EIP_DEBUGFS_MAX_NAME);
-
-	buf = vzalloc(max_buf_len);
-	if (!buf)
-		return 0;
-
 	/*
 	 * Create strings
 	 */
@@ -166,11 +165,13 @@ static ssize_t eip_dma_read_dma_stats(struct file *filep, char __user *ubuf, siz
 	len += snprintf(buf + len, max_buf_len - len, "Tx fragments - %llu\n", stats->tx_frags);
 	len += snprintf(buf + len, max_buf_len - len, "Tx bytes - %llu\n", stats->tx_bytes);
 	len += snprintf(buf + len, max_buf_len - len, "Tx Error - %llu\n", stats->tx_error);
+	len += snprintf(buf + len, max_buf_len - len, "Tx Remote CPU - %llu\n", stats->tx_remote);
 	len += snprintf(buf + len, max_buf_len - len, "Rx Packets - %llu\n", stats->rx_pkts);
 	len += snprintf(buf + len, max_buf_len - len, "Rx fragment - %llu\n", stats->rx_frags);
 	len += snprintf(buf + len, max_buf_len - len, "Rx bytes - %llu\n", stats->rx_bytes);
 	len += snprintf(buf + len, max_buf_len - len, "Rx Error - %llu\n", stats->rx_error);
 	len += snprintf(buf + len, max_buf_len - len, "Rx Dropped - %llu\n", stats->rx_dropped);
+	len += snprintf(buf + len, max_buf_len - len, "Rx Steered - %llu\n", stats->rx_steered);
 
 	len += snprintf(buf + len, max_buf_len - len, "Cmd Prod Idx - %u\n",
 		atomic_read(&dma->in.prod_idx));
@@ -181,6 +182,23 @@ static ssize_t eip_dma_read_dma_stats(struct file *filep, char __user *ubuf, siz
 	len += snprintf(buf + len, max_buf_len - len, "Res Cons Idx - %u\n",
 		atomic_read(&dma->out.cons_idx));
 
+	/*
+	 * Occupancy of the command ring when a request was added.
+	 */
+	for (i = 0; i < EIP_DMA_OCC_HIST; i++) {
+		len += snprintf(buf + len, max_buf_len - len, "Occupancy %u-%u - %llu\n",
+				(i * EIP_DMA_DESC_MAX) / EIP_DMA_OCC_HIST,
+				(((i + 1) * EIP_DMA_DESC_MAX) / EIP_DMA_OCC_HIST) - 1, stats->occ_hist[i]);
+	}
+
+	/*
+	 * Latency from submission to completion; last bucket is open ended.
+	 */
+	for (i = 0; i < EIP_DMA_LAT_HIST; i++) {
+		len += snprintf(buf + len, max_buf_len - len, "Latency < %uus%s - %llu\n", 1U << i,
+				(i == EIP_DMA_LAT_HIST - 1) ? "+" : "", stats->lat_hist[i]);
+	}
+
 	for (i = 0; i < ARRAY_SIZE(stats->rx_err_code); i++) {
 		if (stats->rx_err_code[i]) {
 			len += snprintf(buf + len, max_buf_len - len, "Rx error seen for %u = %u\n",
@@ -188,12 +206,128 @@ static ssize_t eip_dma_read_dma_stats(struct file *filep, char __user *ubuf, siz
 		}
 	}
 
+	return len;
+}
+
+/*
+ * eip_dma_read_dma_stats()
+ *	Read DMA statistics.
+ */
+static ssize_t eip_dma_read_dma_stats(struct file *filep, char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct eip_dma *dma = filep->private_data;
+	ssize_t max_buf_len;
+	ssize_t len;
+	ssize_t ret;
+	char *buf;
+
+	/*
+	 * We need to allocate space for the string and the value
+	 */
+	max_buf_len = (sizeof(dma->stats)/sizeof(uint64_t)) * EIP_DEBUGFS_MAX_NAME;
+	max_buf_len += (6 * EIP_DEBUGFS_MAX_NAME);
+
+	buf = vzalloc(max_buf_len);
+	if (!buf)
+		return 0;
+
+	len = eip_dma_stats_print(dma, buf, max_buf_len);
 	ret = simple_read_from_buffer(ubuf, count, ppos, buf, len);
 	vfree(buf);
 
 	return ret;
 }
 
+/*
+ * eip_dma_steer_ipi()
+ *	Schedule steering NAPI on this CPU.
+ */
+static void eip_dma_steer_ipi(void *info)
+{
+	struct eip_dma_steer *steer = info;
+
+	napi_schedule(&steer->napi);
+}
+
+/*
+ * eip_dma_steer_kick()
+ *	Make the submitting CPU process its steered completions.
+ *
+ * If the submitting CPU went offline the IPI is never delivered; poll the
+ * steering NAPI on this CPU instead so that the bit is cleared and the
+ * queued completions are not stranded.
+ */
+static inline void eip_dma_steer_kick(struct eip_dma_steer *steer, int cpu)
+{
+	if (test_and_set_bit(EIP_DMA_STEER_SCHED, &steer->state)) {
+		return;
+	}
+
+	if (unlikely(!cpu_online(cpu)) || smp_call_function_single_async(cpu, &steer->csd)) {
+		napi_schedule(&steer->napi);
+	}
+}
+
+/*
+ * eip_dma_steer_comp()
+ *	Call completion callback of a steered request.
+ *
+ * The result descriptor has already been reused by the ring; the lookaside
+ * callbacks do not look at it and get NULL.
+ */
+static inline void eip_dma_steer_comp(struct eip_sw_desc *sw)
+{
+	if (unlikely(sw->cle_err || sw->tr_err)) {
+		sw->err_comp(sw->tr, NULL, sw, sw->cle_err, sw->tr_err);
+		return;
+	}
+
+	sw->comp(sw->tr, NULL, sw);
+}
+
+/*
+ * eip_dma_steer_poll()
+ *	NAPI poll callback to complete requests on the submitting CPU.
+ */
+static int eip_dma_steer_poll(struct napi_struct *napi, int budget)
+{
+	struct eip_dma_steer *steer = container_of(napi, struct eip_dma_steer, napi);
+	struct eip_sw_desc *sw;
+	int processed = 0;
+
+	while (processed < budget) {
+		/*
+		 * llist is LIFO; reverse it to complete in submission order.
+		 */
+		if (!steer->backlog) {
+			steer->backlog = llist_reverse_order(llist_del_all(&steer->list));
+			if (!steer->backlog) {
+				break;
+			}
+		}
+
+		sw = llist_entry(steer->backlog, struct eip_sw_desc, node);
+		steer->backlog = steer->backlog->next;
+		eip_dma_steer_comp(sw);
+		processed++;
+	}
+
+	if (processed < budget) {
+		napi_complete_done(napi, processed);
+
+		/*
+		 * Entries queued after the list was emptied did not kick us.
+		 */
+		clear_bit(EIP_DMA_STEER_SCHED, &steer->state);
+		smp_mb__after_atomic();
+		if (!llist_empty(&steer->list) && !test_and_set_bit(EIP_DMA_STEER_SCHED, &steer->state)) {
+			napi_schedule(napi);
+		}
+	}
+
+	return processed;
+}
+
 /*
  * eip_dma_rx()
  *	Process all recieved packet on DMA.
@@ -201,8 +335,12 @@ static ssize_t eip_dma_read_dma_stats(struct file *filep, char __user *ubuf, siz
 static int eip_dma_rx(struct eip_dma *dma, int budget)
 {
 	uint32_t hw_prod_idx, out_cons_idx, in_cons_idx;
+	bool steer = dma_steer && dma->ep;
 	uint32_t avail, processed;
 	uint32_t prod_words;
+	cpumask_t kick;
+	uint64_t now;
+	int cpu;
 
 	/*
 	 * Calculate Descriptor produced by HW.
@@ -220,6 +358,9 @@ static int eip_dma_rx(struct eip_dma *dma, int budget)
 
 	avail = avail > budget ? budget : avail;
 	processed = avail;
+	cpu = smp_processor_id();
+	now = ktime_get_ns();
+	cpumask_clear(&kick);
 
 	/*
 	 * Invalidate the descriptor we are going to read.
@@ -241,6 +382,7 @@ static int eip_dma_rx(struct eip_dma *dma, int budget)
 		uint16_t data_len;
 		uint16_t cle_err;
 		uint16_t tr_err;
+		uint64_t lat;
 		void *data;
 		bool err;
 
@@ -301,12 +443,27 @@ static int eip_dma_rx(struct eip_dma *dma, int budget)
 		dma_stats->rx_pkts++;
 		dma_stats->rx_bytes += data_len;
 		dma_stats->rx_error += err;
+		dma_stats->rx_err_code[tr_err] += err;
+
+		lat = (now - sw->tstamp) >> 10;
+		dma_stats->lat_hist[min_t(uint32_t, fls64(lat), EIP_DMA_LAT_HIST - 1)]++;
+
+		/*
+		 * Hand over to the submitting CPU; callbacks are called there.
+		 */
+		if (steer && unlikely(sw->cpu != cpu)) {
+			sw->cle_err = cle_err;
+			sw->tr_err = tr_err;
+			llist_add(&sw->node, &dma->ep->steer[sw->cpu].list);
+			cpumask_set_cpu(sw->cpu, &kick);
+			dma_stats->rx_steered++;
+			continue;
+		}
 
 		/*
 		 * Call completion callback.
 		 */
 		if (unlikely(err)) {
-			dma->stats.rx_err_code[tr_err]++;
 			sw->err_comp(sw->tr, res, sw, cle_err, tr_err);
 			continue;
 		}
@@ -325,6 +482,10 @@ static int eip_dma_rx(struct eip_dma *dma, int budget)
 	atomic_set(&dma->out.cons_idx, out_cons_idx);
 	atomic_set(&dma->in.cons_idx, in_cons_idx);
 
+	for_each_cpu(cpu, &kick) {
+		eip_dma_steer_kick(&dma->ep->steer[cpu], cpu);
+	}
+
 	return processed;
 }
 
@@ -371,6 +532,40 @@ static int eip_dma_napi_rx_poll(struct napi_struct *napi, int budget)
 	return processed;
 }
 
+/*
+ * eip_dma_tx_account()
+ *	Record submitting CPU, time and ring occupancy of a filled request. Called with ring locked.
+ */
+static inline void eip_dma_tx_account(struct eip_dma *dma, struct eip_sw_desc *sw, uint32_t avail)
+{
+	uint32_t used = EIP_DMA_DESC_MAX - 1 - avail;
+
+	sw->cpu = smp_processor_id();
+	sw->tstamp = ktime_get_ns();
+
+	dma->stats.tx_remote += (sw->cpu != dma->tx_cpu);
+	dma->stats.occ_hist[(used * EIP_DMA_OCC_HIST) / EIP_DMA_DESC_MAX]++;
+}
+
+/*
+ * eip_dma_la_select()
+ *	Select lookaside DMA for a request on the given TR.
+ *
+ * With SA affinity all requests of a TR use the same ring, which keeps them
+ * in order, while TRs are spread over all configured rings.
+ */
+struct eip_dma *eip_dma_la_select(struct eip_pdev *ep, struct eip_tr *tr)
+{
+	struct eip_dma *dma = &ep->la[smp_processor_id()];
+	uint32_t active_cnt = READ_ONCE(ep->la_active_cnt);
+
+	if ((dma_sched == EIP_DMA_SCHED_LOCAL && dma->active) || unlikely(!active_cnt)) {
+		return dma;
+	}
+
+	return ep->la_active[tr->dma_sel % active_cnt];
+}
+
 /*
  * eip_dma_tx_linear_skb()
  *	Schedule linear SKB for transformation. The function must be called with prempt disabled.
@@ -385,11 +580,15 @@ int eip_dma_tx_linear_skb(struct eip_dma *dma, struct eip_sw_desc *sw, struct sk
 
 	BUG_ON(skb_is_nonlinear(skb));
 
+	if (unlikely(!dma->active)) {
+		return -ENODEV;
+	}
+
 	/*
 	 * We may be in process context. disable bottom half to prevent preemption.
-	 * We have per cpu DMA object. So this ensures that there is no race condition.
+	 * The ring may be shared with other CPUs when selected by SA affinity.
 	 */
-	local_bh_disable();
+	spin_lock_bh(&dma->tx_lock);
 
 	in_count = eip_dma_avail_idx_and_count(&dma->in, &src.idx);
 	out_count = eip_dma_avail_idx_and_count(&dma->out, &dst.idx);
@@ -427,16 +626,17 @@ int eip_dma_tx_linear_skb(struct eip_dma *dma, struct eip_sw_desc *sw, struct sk
 	tr_stats->tx_bytes += src.len;
 	dma->stats.tx_bytes += src.len;
 
+	eip_dma_tx_account(dma, sw, in_count);
 	eip_dma_notify(dma, 1, 1, EIP_DMA_IDX_INC(src.idx), EIP_DMA_IDX_INC(dst.idx));
 
 	/*
 	 * Re-enable preemption.
 	 */
-	local_bh_enable();
+	spin_unlock_bh(&dma->tx_lock);
 	return 0;
 
 fail:
-	local_bh_enable();
+	spin_unlock_bh(&dma->tx_lock);
 	return -EBUSY;
 }
 
@@ -464,13 +664,17 @@ int eip_dma_tx_sg(struct eip_dma *dma, struct eip_sw_desc *sw, struct scatterlis
 	uint32_t src_nsegs, dst_nsegs;
 	uint32_t cmd_idx, res_idx;
 	uint32_t src_len, len;
-	uint32_t count;
+	uint32_t count, avail;
+
+	if (unlikely(!dma->active)) {
+		return -ENODEV;
+	}
 
 	/*
 	 * We may be in process context. disable bottom half to prevent preemption.
-	 * We have per cpu DMA object. So this ensures that there is no race condition.
+	 * The ring may be shared with other CPUs when selected by SA affinity.
 	 */
-	local_bh_disable();
+	spin_lock_bh(&dma->tx_lock);
 
 	/*
 	 * Map only required data to descriptor.
@@ -482,7 +686,7 @@ int eip_dma_tx_sg(struct eip_dma *dma, struct eip_sw_desc *sw, struct scatterlis
 	 * Walk through all source scatterlist.
 	 * There is no cleanup for error as actual HW index will be updated in notify().
 	 */
-	count = eip_dma_avail_idx_and_count(&dma->in, &cmd_idx);
+	count = avail = eip_dma_avail_idx_and_count(&dma->in, &cmd_idx);
 
 	for (src_nsegs = 0, iter = src, len = src_len; iter; src_nsegs++, iter = sg_next(iter)) {
 		struct eip_frag frag;
@@ -547,6 +751,7 @@ int eip_dma_tx_sg(struct eip_dma *dma, struct eip_sw_desc *sw, struct scatterlis
 	dma_stats->tx_frags += src_nsegs;
 	dma_stats->tx_pkts++;
 	dma_stats->tx_bytes += src_len;
+	eip_dma_tx_account(dma, sw, avail);
 
 	/*
 	 * Notify the HW for new descriptor.
@@ -556,11 +761,11 @@ int eip_dma_tx_sg(struct eip_dma *dma, struct eip_sw_desc *sw, struct scatterlis
 	/*
 	 * Re-enable preemption.
 	 */
-	local_bh_enable();
+	spin_unlock_bh(&dma->tx_lock);
 	return 0;
 
 fail:
-	local_bh_enable();
+	spin_unlock_bh(&dma->tx_lock);
 	return -ENOMEM;
 }
 
@@ -572,13 +777,11 @@ struct file_operations dma_stats_ops = {
 };
 
 /*
- * eip_dma_cmd_init()
- *	Initialize the DMA HW ring.
+ * eip_dma_ring_alloc()
+ *	Allocate descriptor memory of a ring; returns size of descriptor FIFO.
  */
-int eip_dma_cmd_init(struct eip_dma *dma, void __iomem *base_addr, bool irq, uint8_t rx_cpu)
+static size_t eip_dma_ring_alloc(struct eip_hw_ring *ring)
 {
-	struct eip_hw_ring *cmd = &dma->in;
-	uint32_t ring_id = dma->ring_id;
 	size_t total_sz;
 	size_t dma_sz;
 	void *addr;
@@ -594,16 +797,33 @@ int eip_dma_cmd_init(struct eip_dma *dma, void __iomem *base_addr, bool irq, uin
 	total_sz += (sizeof(uintptr_t) * EIP_DMA_DESC_MAX);
 	addr = kzalloc(total_sz, GFP_KERNEL);
 	if (!addr) {
+		return 0;
+	}
+
+	ring->kaddr = addr;
+	ring->desc = PTR_ALIGN(addr, L1_CACHE_BYTES);
+	ring->meta = (uintptr_t *)((uint8_t *)ring->desc + dma_sz);
+	atomic_set(&ring->prod_idx, 0);
+	atomic_set(&ring->cons_idx, 0);
+	return dma_sz;
+}
+
+/*
+ * eip_dma_cmd_init()
+ *	Initialize the DMA HW ring.
+ */
+int eip_dma_cmd_init(struct eip_dma *dma, void __iomem *base_addr, bool irq, uint8_t rx_cpu)
+{
+	struct eip_hw_ring *cmd = &dma->in;
+	uint32_t ring_id = dma->ring_id;
+	size_t dma_sz;
+
+	dma_sz = eip_dma_ring_alloc(cmd);
+	if (!dma_sz) {
 		pr_err("%px: Failed to allocate in ring memory\n", cmd);
 		return -ENOMEM;
 	}
 
-	cmd->kaddr = addr;
-	cmd->desc = PTR_ALIGN(addr, L1_CACHE_BYTES);
-	cmd->meta = (void *)cmd->desc + dma_sz;
-	atomic_set(&cmd->prod_idx, 0);
-	atomic_set(&cmd->cons_idx, 0);
-
 	/*
 	 * Initialize register address.
 	 */
@@ -658,31 +878,14 @@ int eip_dma_res_init(struct eip_dma *dma, void __iomem *base_addr, bool irq, uin
 {
 	struct eip_hw_ring *res = &dma->out;
 	uint32_t ring_id = dma->ring_id;
-	size_t total_sz;
 	size_t dma_sz;
-	void *addr;
 
-	/*
-	 * Allocate memory for
-	 * - DMA FIFO
-	 * - Extra padding for cache alignment
-	 * - Software shadow FIFO for meta pointers.
-	 */
-	dma_sz = sizeof(struct eip_hw_desc) * EIP_DMA_DESC_MAX;
-	total_sz = dma_sz + L1_CACHE_BYTES + L1_CACHE_BYTES;
-	total_sz += (sizeof(uintptr_t) * EIP_DMA_DESC_MAX);
-	addr = kzalloc(total_sz, GFP_KERNEL);
-	if (!addr) {
+	dma_sz = eip_dma_ring_alloc(res);
+	if (!dma_sz) {
 		pr_err("%px: Failed to allocate in ring memory\n", res);
 		return -ENOMEM;
 	}
 
-	res->kaddr = addr;
-	res->desc = PTR_ALIGN(addr, L1_CACHE_BYTES);
-	res->meta = (uintptr_t *)((uint8_t *)res->desc + dma_sz);
-	atomic_set(&res->prod_idx, 0);
-	atomic_set(&res->cons_idx, 0);
-
 	/*
 	 * Initialize register address.
 	 */
@@ -766,6 +969,10 @@ int eip_dma_la_init(struct eip_dma *dma, struct platform_device *pdev, uint8_t t
 
 	dma->type = EIP_DMA_TYPE_LA;
 	dma->ring_id = ring_id;
+	dma->tx_cpu = tx_cpu;
+	dma->rx_cpu = rx_cpu;
+	dma->ep = ep;
+	spin_lock_init(&dma->tx_lock);
 	dma->irq_mask = EIP_HW_RDR_PROC_IRQ_STATUS;
 	dma->irq_status = base_addr + EIP_HW_HIA_RDR_STAT(ring_id);
 	dma->irq = platform_get_irq(ep->pdev, rx_cpu);
@@ -820,3 +1027,431 @@ fail_res:
 	kfree(dma->in.kaddr);
 	return status;
 }
+
+/*
+ * eip_dma_steer_init()
+ *	Initialize per CPU completion steering.
+ */
+void eip_dma_steer_init(struct eip_pdev *ep)
+{
+	int i;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		struct eip_dma_steer *steer = &ep->steer[i];
+
+		init_llist_head(&steer->list);
+		steer->backlog = NULL;
+		steer->state = 0;
+		steer->csd.func = eip_dma_steer_ipi;
+		steer->csd.info = steer;
+
+		init_dummy_netdev(&steer->ndev);
+		netif_napi_add(&steer->ndev, &steer->napi, eip_dma_steer_poll, EIP_DMA_STEER_NAPI_WEIGHT);
+		napi_enable(&steer->napi);
+		steer->active = true;
+	}
+}
+
+/*
+ * eip_dma_steer_deinit()
+ *	De-initialize per CPU completion steering. Rings must be stopped.
+ */
+void eip_dma_steer_deinit(struct eip_pdev *ep)
+{
+	struct llist_node *node;
+	int i;
+
+	for (i = 0; i < NR_CPUS; i++) {
+		struct eip_dma_steer *steer = &ep->steer[i];
+
+		if (!steer->active) {
+			continue;
+		}
+
+		napi_disable(&steer->napi);
+		netif_napi_del(&steer->napi);
+
+		/*
+		 * Complete whatever was handed over but not processed.
+		 */
+		local_bh_disable();
+		while ((node = steer->backlog ?: llist_reverse_order(llist_del_all(&steer->list)))) {
+			steer->backlog = node->next;
+			eip_dma_steer_comp(llist_entry(node, struct eip_sw_desc, node));
+		}
+
+		local_bh_enable();
+		steer->active = false;
+	}
+}
+
+#define EIP_DMA_LB_BUF_SZ 256U		/* Buffer per loopback request */
+#define EIP_DMA_LB_RESULT_SZ 2048U	/* Result string of the loopback run */
+
+/*
+ * eip_dma_lb_reg
+ *	Registers emulated by the loopback ring.
+ */
+enum eip_dma_lb_reg {
+	EIP_DMA_LB_REG_CMD_PREP,
+	EIP_DMA_LB_REG_CMD_PROC,
+	EIP_DMA_LB_REG_CMD_PREP_CNT,
+	EIP_DMA_LB_REG_CMD_PROC_CNT,
+	EIP_DMA_LB_REG_CMD_THRESH,
+	EIP_DMA_LB_REG_CMD_STAT,
+	EIP_DMA_LB_REG_RES_PREP,
+	EIP_DMA_LB_REG_RES_PROC,
+	EIP_DMA_LB_REG_RES_PREP_CNT,
+	EIP_DMA_LB_REG_RES_PROC_CNT,
+	EIP_DMA_LB_REG_RES_THRESH,
+	EIP_DMA_LB_REG_RES_STAT,
+	EIP_DMA_LB_REG_MAX
+};
+
+/*
+ * eip_dma_lb_req
+ *	Loopback request.
+ */
+struct eip_dma_lb_req {
+	struct eip_sw_desc sw;		/* SW descriptor submitted to the ring */
+	struct scatterlist sg[2];	/* Source and destination */
+	uint32_t seq;			/* Submission sequence */
+};
+
+/*
+ * eip_dma_lb
+ *	Loopback ring emulator.
+ *
+ * The ring pair is driven by the regular submit and receive code. Register
+ * pointers refer to memory and the HW side is emulated by eip_dma_lb_hw().
+ */
+struct eip_dma_lb {
+	struct eip_dma dma;		/* Ring under test */
+	uint32_t regs[EIP_DMA_LB_REG_MAX];	/* Emulated ring registers */
+	uint32_t hw_cmd_idx;		/* Next command descriptor read by HW */
+	uint32_t hw_res_idx;		/* Next result descriptor written by HW */
+
+	struct eip_tr *tr;		/* Dummy TR for statistics */
+	struct eip_dma_lb_req *req;	/* Request pool; one per descriptor */
+	uint8_t *buf;			/* Data buffers; must be in the linear map */
+
+	uint32_t next_seq;		/* Sequence expected by the next completion */
+	uint32_t completed;		/* Completed requests */
+	uint32_t out_of_order;		/* Completions out of submission order */
+	uint32_t errors;		/* Completions with error */
+};
+
+/*
+ * Loopback emulator debugfs state
+ */
+static struct {
+	struct mutex lock;			/* Serializes loopback runs */
+	struct eip_dma_lb *lb;			/* Emulator of the current run */
+	char result[EIP_DMA_LB_RESULT_SZ];	/* Result of the last run */
+} eip_dma_lb_g;
+
+/*
+ * eip_dma_lb_done()
+ *	Completion callback for loopback request.
+ */
+static void eip_dma_lb_done(struct eip_tr *tr, struct eip_hw_desc *hw, struct eip_sw_desc *sw)
+{
+	struct eip_dma_lb_req *req = container_of(sw, struct eip_dma_lb_req, sw);
+	struct eip_dma_lb *lb = eip_dma_lb_g.lb;
+
+	lb->out_of_order += (req->seq != lb->next_seq);
+	lb->next_seq = req->seq + 1;
+	lb->completed++;
+}
+
+/*
+ * eip_dma_lb_err()
+ *	Error completion callback for loopback request.
+ */
+static void eip_dma_lb_err(struct eip_tr *tr, struct eip_hw_desc *hw, struct eip_sw_desc *sw, uint16_t cle_err, uint16_t tr_err)
+{
+	eip_dma_lb_g.lb->errors++;
+	eip_dma_lb_done(tr, hw, sw);
+}
+
+/*
+ * eip_dma_lb_hw()
+ *	Emulate HW processing of up to budget requests; returns requests processed.
+ *
+ * Each request is passed through unchanged. Result descriptors are written
+ * back to memory as the engine would, ahead of the invalidate on receive.
+ */
+static uint32_t eip_dma_lb_hw(struct eip_dma_lb *lb, uint32_t budget)
+{
+	struct eip_dma *dma = &lb->dma;
+	uint32_t prod_idx = atomic_read(&dma->in.prod_idx);
+	uint32_t processed = 0;
+
+	while ((lb->hw_cmd_idx != prod_idx) && (processed < budget)) {
+		struct eip_hw_desc *cmd = &dma->in.desc[lb->hw_cmd_idx];
+		struct eip_sw_desc *sw = *((struct eip_sw_desc **)&cmd->bypass);
+		uint32_t len = EIP_HW_CMD_DATA_LEN(cmd->token[2]);
+		struct eip_hw_desc *res;
+		bool last;
+
+		/*
+		 * Consume all command descriptors of the request.
+		 */
+		do {
+			cmd = &dma->in.desc[lb->hw_cmd_idx];
+			last = !!(cmd->frag[0] & EIP_HW_CMD_FLAGS(0, 1));
+			lb->hw_cmd_idx = EIP_DMA_IDX_INC(lb->hw_cmd_idx);
+		} while (!last);
+
+		/*
+		 * Fill all result descriptors of the request.
+		 */
+		do {
+			res = &dma->out.desc[lb->hw_res_idx];
+			last = !!(res->frag[0] & EIP_HW_RES_FLAGS_LAST);
+			res->token[0] = last ? EIP_HW_RES_DATA_LEN(len) : 0;
+			res->token[1] = 0;
+			*((struct eip_sw_desc **)&res->bypass) = last ? sw : NULL;
+			dmac_clean_range(res, res + 1);
+			lb->hw_res_idx = EIP_DMA_IDX_INC(lb->hw_res_idx);
+		} while (!last);
+
+		processed++;
+	}
+
+	lb->regs[EIP_DMA_LB_REG_RES_PROC] = lb->hw_res_idx * EIP_HW_DESC_WORDS * sizeof(uint32_t);
+	return processed;
+}
+
+/*
+ * eip_dma_lb_free()
+ *	Free loopback emulator.
+ */
+static void eip_dma_lb_free(struct eip_dma_lb *lb)
+{
+	if (lb->tr) {
+		free_percpu(lb->tr->stats_pcpu);
+		kfree(lb->tr);
+	}
+
+	kfree(lb->dma.out.kaddr);
+	kfree(lb->dma.in.kaddr);
+	kfree(lb->buf);
+	vfree(lb->req);
+	kfree(lb);
+}
+
+/*
+ * eip_dma_lb_alloc()
+ *	Allocate loopback emulator.
+ */
+static struct eip_dma_lb *eip_dma_lb_alloc(void)
+{
+	struct eip_dma_lb *lb;
+	struct eip_dma *dma;
+
+	lb = kzalloc(sizeof(*lb), GFP_KERNEL);
+	if (!lb) {
+		return NULL;
+	}
+
+	dma = &lb->dma;
+	lb->req = vzalloc(EIP_DMA_DESC_MAX * sizeof(*lb->req));
+	lb->buf = kzalloc(EIP_DMA_DESC_MAX * EIP_DMA_LB_BUF_SZ, GFP_KERNEL);
+	lb->tr = kzalloc(sizeof(*lb->tr), GFP_KERNEL);
+	if (!lb->req || !lb->buf || !lb->tr) {
+		goto fail;
+	}
+
+	lb->tr->stats_pcpu = alloc_percpu_gfp(struct eip_tr_stats, GFP_KERNEL | __GFP_ZERO);
+	if (!lb->tr->stats_pcpu) {
+		goto fail;
+	}
+
+	if (!eip_dma_ring_alloc(&dma->in) || !eip_dma_ring_alloc(&dma->out)) {
+		goto fail;
+	}
+
+	dma->in.prep = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_CMD_PREP];
+	dma->in.proc = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_CMD_PROC];
+	dma->in.prep_cnt = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_CMD_PREP_CNT];
+	dma->in.proc_cnt = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_CMD_PROC_CNT];
+	dma->in.proc_thresh = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_CMD_THRESH];
+	dma->in.proc_status = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_CMD_STAT];
+	dma->out.prep = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_RES_PREP];
+	dma->out.proc = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_RES_PROC];
+	dma->out.prep_cnt = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_RES_PREP_CNT];
+	dma->out.proc_cnt = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_RES_PROC_CNT];
+	dma->out.proc_thresh = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_RES_THRESH];
+	dma->out.proc_status = (void __iomem *)&lb->regs[EIP_DMA_LB_REG_RES_STAT];
+
+	dma->type = EIP_DMA_TYPE_LA;
+	dma->tx_cpu = raw_smp_processor_id();
+	dma->rx_cpu = dma->tx_cpu;
+	spin_lock_init(&dma->tx_lock);
+	dma->active = true;
+	return lb;
+
+fail:
+	eip_dma_lb_free(lb);
+	return NULL;
+}
+
+/*
+ * eip_dma_lb_run()
+ *	Push count requests through the loopback ring.
+ *
+ * Requests alternate between one and two fragments so that multi descriptor
+ * requests wrap around the ring. The emulated engine processes random bursts,
+ * which also fills the ring now and then to exercise the ring full path.
+ */
+static void eip_dma_lb_run(uint32_t count)
+{
+	uint32_t submitted = 0, full = 0;
+	uint32_t hw_done, rx_done;
+	struct eip_dma_lb *lb;
+	struct eip_dma *dma;
+	uint64_t elapsed;
+	ktime_t start;
+	ssize_t len;
+
+	lb = eip_dma_lb_alloc();
+	if (!lb) {
+		snprintf(eip_dma_lb_g.result, sizeof(eip_dma_lb_g.result), "error - no memory\n");
+		return;
+	}
+
+	dma = &lb->dma;
+	eip_dma_lb_g.lb = lb;
+	start = ktime_get();
+
+	while (lb->completed < count) {
+		while (submitted < count) {
+			struct eip_dma_lb_req *req = &lb->req[submitted % EIP_DMA_DESC_MAX];
+			uint8_t *buf = lb->buf + ((submitted % EIP_DMA_DESC_MAX) * EIP_DMA_LB_BUF_SZ);
+			uint32_t nsegs = (submitted & 1) + 1;
+			int i;
+
+			memset(&req->sw, 0, sizeof(req->sw));
+			req->seq = submitted;
+			req->sw.tr = lb->tr;
+			req->sw.comp = eip_dma_lb_done;
+			req->sw.err_comp = eip_dma_lb_err;
+			req->sw.cmd_token_hdr = EIP_HW_CMD_DATA_LEN(EIP_DMA_LB_BUF_SZ);
+			req->sw.hw_svc = EIP_HW_CMD_HWSERVICE_LAC;
+
+			sg_init_table(req->sg, nsegs);
+			for (i = 0; i < nsegs; i++) {
+				sg_set_buf(&req->sg[i], buf + (i * (EIP_DMA_LB_BUF_SZ / nsegs)), EIP_DMA_LB_BUF_SZ / nsegs);
+			}
+
+			if (eip_dma_tx_sg(dma, &req->sw, req->sg, req->sg)) {
+				full++;
+				break;
+			}
+
+			submitted++;
+
+			/*
+			 * Leave requests in the ring now and then.
+			 */
+			if (!(prandom_u32() & 0x3)) {
+				break;
+			}
+		}
+
+		hw_done = eip_dma_lb_hw(lb, (prandom_u32() & 0x1F) + 1);
+
+		local_bh_disable();
+		rx_done = eip_dma_rx(dma, EIP_DMA_RX_LA_NAPI_WEIGHT);
+		local_bh_enable();
+
+		/*
+		 * Nothing left to submit and nothing moving; completions were lost.
+		 */
+		if (!hw_done && !rx_done && (submitted == count)) {
+			break;
+		}
+
+		cond_resched();
+	}
+
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	len = snprintf(eip_dma_lb_g.result, sizeof(eip_dma_lb_g.result),
+			"requests - %u\ncompleted - %u\nring full - %u\nout of order - %u\nerrors - %u\n"
+			"ns/request - %llu\nrings idle - %s\nresult - %s\n",
+			count, lb->completed, full, lb->out_of_order, lb->errors, div_u64(elapsed, count),
+			(atomic_read(&dma->in.cons_idx) == atomic_read(&dma->in.prod_idx) &&
+			 atomic_read(&dma->out.cons_idx) == atomic_read(&dma->out.prod_idx)) ? "yes" : "no",
+			(lb->out_of_order || lb->errors || lb->completed != count) ? "FAIL" : "PASS");
+	eip_dma_stats_print(dma, eip_dma_lb_g.result + len, sizeof(eip_dma_lb_g.result) - len);
+
+	eip_dma_lb_g.lb = NULL;
+	eip_dma_lb_free(lb);
+}
+
+/*
+ * eip_dma_lb_write()
+ *	Run the loopback emulator with the number of requests written.
+ */
+static ssize_t eip_dma_lb_write(struct file *fp, const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	uint32_t requests;
+	int ret;
+
+	ret = kstrtou32_from_user(ubuf, count, 0, &requests);
+	if (ret) {
+		return ret;
+	}
+
+	if (!requests) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&eip_dma_lb_g.lock);
+	eip_dma_lb_run(requests);
+	mutex_unlock(&eip_dma_lb_g.lock);
+
+	return count;
+}
+
+/*
+ * eip_dma_lb_read()
+ *	Read the result of the last loopback run.
+ */
+static ssize_t eip_dma_lb_read(struct file *fp, char __user *ubuf, size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&eip_dma_lb_g.lock);
+	ret = simple_read_from_buffer(ubuf, count, ppos, eip_dma_lb_g.result, strlen(eip_dma_lb_g.result));
+	mutex_unlock(&eip_dma_lb_g.lock);
+
+	return ret;
+}
+
+/*
+ * Loopback emulator file operation structure instance
+ */
+static const struct file_operations dma_lb_ops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.llseek = default_llseek,
+	.read = eip_dma_lb_read,
+	.write = eip_dma_lb_write,
+};
+
+/*
+ * eip_dma_loopback_init()
+ *	Create the loopback ring emulator debugfs entry.
+ *
+ * Writing a number of requests to dma_loopback runs them through a ring pair
+ * that is not bound to the EIP; reading the file returns the result.
+ */
+void eip_dma_loopback_init(struct dentry *root)
+{
+	mutex_init(&eip_dma_lb_g.lock);
+	snprintf(eip_dma_lb_g.result, sizeof(eip_dma_lb_g.result), "not run\n");
+	debugfs_create_file("dma_loopback", S_IRUGO | S_IWUSR, root, NULL, &dma_lb_ops);
+}
@@ -28,9 +28,14 @@
 #define EIP_DMA_TX_COMPL_NAPI_WEIGHT 128U
 #define EIP_DMA_RX_HY_NAPI_WEIGHT 64U
 #define EIP_DMA_RX_LA_NAPI_WEIGHT 64U
+#define EIP_DMA_STEER_NAPI_WEIGHT 64U
+
+#define EIP_DMA_OCC_HIST 8U		/* Command ring occupancy histogram; 1/8th of ring per bucket */
+#define EIP_DMA_LAT_HIST 12U		/* Completion latency histogram; log2 of microseconds */
 
 
 struct eip_sw_desc;
+struct eip_pdev;
 
 /*
  * eip_dma_type
@@ -42,6 +47,16 @@ enum eip_dma_type {
 	EIP_DMA_TYPE_MAX
 };
 
+/*
+ * eip_dma_sched
+ *	Lookaside ring selection policy.
+ */
+enum eip_dma_sched {
+	EIP_DMA_SCHED_LOCAL = 0,	/* Ring of the submitting CPU */
+	EIP_DMA_SCHED_SA,		/* Ring bound to the SA; spreads SAs over all rings */
+	EIP_DMA_SCHED_MAX
+};
+
 /*
  * eip_hw_desc
  *	HW descriptors.
@@ -89,7 +104,11 @@ struct eip_dma_stats {
 	uint64_t rx_bytes;		/* bytes recieved on this DMA */
 	uint64_t rx_error;		/* buffer/packet recieved with error on this DMA */
 	uint64_t rx_dropped;		/* buffer/packet dropped in driver due to unknown TR */
+	uint64_t tx_remote;		/* buffer/packet submitted by a CPU other than tx_cpu */
+	uint64_t rx_steered;		/* completion handed to the submitting CPU */
 
+	uint64_t occ_hist[EIP_DMA_OCC_HIST];	/* Command ring occupancy seen at submission */
+	uint64_t lat_hist[EIP_DMA_LAT_HIST];	/* Submission to completion latency */
 	uint32_t rx_err_code[256];	/* Detailed error stats for received packet */
 };
 
@@ -108,10 +127,30 @@ struct eip_dma {
 	uint32_t irq_mask;		/* IRQ mask for this ring */
 	void __iomem *irq_status;	/* HW status register */
 
+	uint8_t tx_cpu;			/* CPU the ring is assigned to */
+	uint8_t rx_cpu;			/* CPU handling the ring interrupt */
+	spinlock_t tx_lock;		/* Serializes submission from several CPUs */
+	struct eip_pdev *ep;		/* Parent device; NULL for the loopback emulator */
+
 	struct eip_dma_stats stats;	/* Stats */
 	struct dentry *dentry;		/* debugfs dentry */
 };
 
+/*
+ * eip_dma_steer
+ *	Per CPU completion queue for requests submitted on a remote ring.
+ */
+struct eip_dma_steer {
+	struct llist_head list;		/* Completions queued by ring NAPI */
+	struct llist_node *backlog;	/* Completions taken but not yet processed */
+	call_single_data_t csd;		/* IPI to schedule NAPI on the submitting CPU */
+	unsigned long state;		/* EIP_DMA_STEER_SCHED */
+	bool active;			/* NAPI is initialized */
+
+	struct net_device ndev;		/* Dummy_netdev for NAPI */
+	struct napi_struct napi;	/* NAPI handler */
+};
+
 /*
  * eip_dma_avail_idx_and_count()
  *	Return available descriptor count & producer index in a ring.
@@ -131,6 +170,7 @@ extern const char *irq_name[];
 extern const char *dma_name[];
 extern struct file_operations dma_stats_ops;
 
+struct eip_dma *eip_dma_la_select(struct eip_pdev *ep, struct eip_tr *tr);
 int eip_dma_tx_sg(struct eip_dma *dma, struct eip_sw_desc *sw, struct scatterlist *src, struct scatterlist *dst);
 int eip_dma_hy_tx_linear_skb(struct eip_dma *dma, struct eip_sw_desc *sw, struct sk_buff *skb);
 int eip_dma_hy_tx_nonlinear_skb(struct eip_dma *dma, struct eip_sw_desc *sw, struct sk_buff *skb);
@@ -145,4 +185,8 @@ int eip_dma_hy_init(struct eip_dma *dma, struct platform_device *pdev, uint8_t t
 		uint8_t rx_cpu,	uint32_t ring_id, void __iomem *base_addr);
 void eip_dma_hy_deinit(struct eip_dma *dma);
 
+void eip_dma_steer_init(struct eip_pdev *ep);
+void eip_dma_steer_deinit(struct eip_pdev *ep);
+void eip_dma_loopback_init(struct dentry *root);
+
 #endif /* __EIP_DMA_H */
@@ -27,54 +27,38 @@
 #include <linux/dmapool.h>
 #include <linux/dma-direct.h>
 #include <linux/spinlock.h>
+#include <linux/rculist.h>
+#include <linux/bitmap.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/iopoll.h>
 
 #include "eip_priv.h"
 #include "eip_flow.h"
 
-/*
- * eip_flow_get_tail
- * 	Obtain the flow at the tail
- */
-static struct eip_flow *eip_flow_get_tail(struct hlist_head *flow_head)
-{
-	struct hlist_node *entry;
-	hlist_for_each(entry, flow_head) {
-		if (entry->next == NULL) {
-			return hlist_entry(entry, struct eip_flow, node);
-		}
-	}
-	return NULL;
-}
+#define EIP_FLOW_MODEL_RESULT_SZ 512U	/* Result string of the software model run */
+#define EIP_FLOW_BULK_MAX 32U		/* Flows per table section in bulk calls */
+#define EIP_FLOW_HW_ACK_TIMEOUT_US 1000U	/* Wait for the FLUE to latch a new table */
+#define EIP_FLOW_HW_DRAIN_US 100U	/* Lookup started on the old table finishes within this */
 
 /*
- * eip_flow_get_next
- * 	Obtain the next flow
+ * Software model state
  */
-static struct eip_flow *eip_flow_get_next(struct eip_flow *flow)
-{
-	return hlist_entry(flow->node.next, struct eip_flow, node);
-
-}
-
-/*
- * eip_flow_get_prev
- * 	Obtain the previous flow
- */
-static struct eip_flow *eip_flow_get_prev(struct eip_flow *flow)
-{
-	return hlist_entry(flow->node.pprev, struct eip_flow, node.next);
-}
+static struct {
+	struct mutex lock;			/* Serializes model runs */
+	char result[EIP_FLOW_MODEL_RESULT_SZ];	/* Result of the last run */
+} eip_flow_model;
 
 /*
  * eip_flow_get_hash()
  * 	Calculate hash for flow tuple
  */
-static eip_flow_hash_t eip_flow_get_hash(struct eip_flow_tuple *flow)
+static eip_flow_hash_t eip_flow_get_hash(struct eip_flow_tbl *tbl, struct eip_flow_tuple *flow)
 {
-	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
 	uint32_t data[EIP_FLOW_HASH_DATA_SZ];
 	eip_flow_hash_t hash;
-	void __iomem *base_addr = ep->dev_vaddr;
 	int i;
 
 	memset(data, 0, sizeof(data));
@@ -109,10 +93,10 @@ static eip_flow_hash_t eip_flow_get_hash(struct eip_flow_tuple *flow)
 		data[12] = flow->src_ip[3];
 	}
 
-	hash.words[0] = ioread32(base_addr + EIP_HW_FHASH_IV0);
-	hash.words[1] = ioread32(base_addr + EIP_HW_FHASH_IV1);
-	hash.words[2] = ioread32(base_addr + EIP_HW_FHASH_IV2);
-	hash.words[3] = ioread32(base_addr + EIP_HW_FHASH_IV3);
+	/*
+	 * Initial value is read from the FLUE once at table init
+	 */
+	hash = tbl->iv;
 
 	/*
 	 * Algorithm referred from Security-IP-197_HW3.3_Programmer-Manual_RevC
@@ -141,28 +125,198 @@ static eip_flow_hash_t eip_flow_get_hash(struct eip_flow_tuple *flow)
 }
 
 /*
- * _eip_flow_lookup()
- *      Lookup the Flow in table using the provided hash.
+ * eip_flow_ht_free()
+ *	Free a table instance; flows are not touched
  */
-static struct eip_flow *_eip_flow_lookup(struct eip_flow_tbl *flow_table, eip_flow_hash_t hash)
+static void eip_flow_ht_free(struct eip_flow_tbl *tbl, struct eip_flow_ht *ht)
 {
-	struct hlist_head *flow_head;
-	struct hlist_node *entry;
-	struct eip_flow *flow;
-	uint32_t idx;
-
-	assert_spin_locked(&flow_table->lock);
+	if (tbl->dev)
+		dma_free_coherent(tbl->dev, ht->hw_sz, ht->hw_head, ht->hw_head_paddr);
+	else
+		vfree(ht->hw_head);
+
+	bitmap_free(ht->coll_map);
+	kvfree(ht->sw_head);
+	kfree(ht);
+}
 
-	idx = EIP_FLOW_HASH_IDX(hash);
-	flow_head = &flow_table->sw_head[idx];
+/*
+ * eip_flow_ht_alloc()
+ *	Allocate a table instance with 2^order buckets
+ *
+ * Collision records are placed right after the buckets so that the
+ * next_flow_offset of every record is relative to the table base.
+ */
+static struct eip_flow_ht *eip_flow_ht_alloc(struct eip_flow_tbl *tbl, uint32_t order)
+{
+	uint32_t buckets = 1U << order;
+	struct eip_flow_ht *ht;
+	size_t tbl_sz;
+	uint32_t i;
 
-	if (hlist_empty(flow_head)) {
+	ht = kzalloc(sizeof(*ht), GFP_KERNEL);
+	if (!ht)
 		return NULL;
+
+	ht->order = order;
+	ht->mask = buckets - 1;
+	ht->coll_max = max(EIP_FLOW_MAX_COLLISION, buckets >> 2);
+
+	ht->sw_head = kvcalloc(buckets, sizeof(*ht->sw_head), GFP_KERNEL);
+	if (!ht->sw_head)
+		goto fail_sw;
+
+	ht->coll_map = bitmap_zalloc(ht->coll_max, GFP_KERNEL);
+	if (!ht->coll_map)
+		goto fail_map;
+
+	tbl_sz = buckets * sizeof(struct eip_flow_hw);
+	ht->hw_sz = tbl_sz + (ht->coll_max * sizeof(struct eip_flow_hw));
+
+	/*
+	 * The software model has no device; any virtually contiguous memory
+	 * works and the bus address is only used for offsets.
+	 */
+	if (tbl->dev) {
+		ht->hw_head = dma_alloc_coherent(tbl->dev, ht->hw_sz, &ht->hw_head_paddr, GFP_KERNEL);
+	} else {
+		ht->hw_head = vzalloc(ht->hw_sz);
+		ht->hw_head_paddr = (dma_addr_t)(uintptr_t)ht->hw_head;
 	}
 
-	hlist_for_each(entry, flow_head) {
-		flow = hlist_entry (entry, struct eip_flow, node);
-		if (EIP_HASH_EQUAL(flow->hash,hash))
+	if (!ht->hw_head)
+		goto fail_hw;
+
+	memset(ht->hw_head, 0, ht->hw_sz);
+	ht->hw_coll = (struct eip_flow_hw *)((uint8_t *)ht->hw_head + tbl_sz);
+	ht->hw_coll_paddr = ht->hw_head_paddr + tbl_sz;
+
+	for (i = 0; i < buckets; i++)
+		INIT_HLIST_HEAD(&ht->sw_head[i]);
+
+	return ht;
+
+fail_hw:
+	bitmap_free(ht->coll_map);
+fail_map:
+	kvfree(ht->sw_head);
+fail_sw:
+	kfree(ht);
+	return NULL;
+}
+
+/*
+ * eip_flow_hw_commit()
+ *	Point the FLUE to a table instance
+ *
+ * The base is written as two registers, so lookups are disabled while it
+ * is switched; the engine never sees a half written address. Packets that
+ * arrive meanwhile miss and take the exception path to the host like any
+ * other unknown flow.
+ */
+static void eip_flow_hw_commit(struct eip_flow_tbl *tbl, struct eip_flow_ht *ht)
+{
+	void __iomem *base_addr = tbl->base_addr;
+	uint32_t cfg = EIP_HW_FLUE_CONFIG_SZ(ht->order - 5);
+
+	if (!base_addr)
+		return;
+
+	wmb();
+	iowrite32(cfg & ~EIP_HW_ENB_FLUE, base_addr + EIP_HW_FLUE_CONFIG(0));
+	ioread32(base_addr + EIP_HW_FLUE_CONFIG(0));
+
+	iowrite32(0x0, base_addr + EIP_HW_FLUE_HASHBASE_HI(0));
+	iowrite32(ht->hw_head_paddr, base_addr + EIP_HW_FLUE_HASHBASE_LO(0));
+	iowrite32(cfg, base_addr + EIP_HW_FLUE_CONFIG(0));
+}
+
+/*
+ * eip_flow_hw_switched()
+ *	Check that the FLUE took a committed table instance
+ *
+ * The FLUE has no idle indication. Poll until it reports the new base and
+ * configuration; called atomic, with the resize lock held for write.
+ * Returns false if the engine did not take the new table.
+ */
+static bool eip_flow_hw_switched(struct eip_flow_tbl *tbl, struct eip_flow_ht *ht)
+{
+	void __iomem *base_addr = tbl->base_addr;
+	uint32_t cfg = EIP_HW_FLUE_CONFIG_SZ(ht->order - 5);
+	uint32_t val;
+
+	if (!base_addr)
+		return true;
+
+	if (readl_poll_timeout_atomic(base_addr + EIP_HW_FLUE_HASHBASE_LO(0), val,
+				val == (uint32_t)ht->hw_head_paddr, 10, EIP_FLOW_HW_ACK_TIMEOUT_US))
+		return false;
+
+	return !readl_poll_timeout_atomic(base_addr + EIP_HW_FLUE_CONFIG(0), val, val == cfg, 10,
+				EIP_FLOW_HW_ACK_TIMEOUT_US);
+}
+
+/*
+ * eip_flow_hw_quiesce()
+ *	Give lookups that were already walking the previous table time to finish
+ */
+static void eip_flow_hw_quiesce(struct eip_flow_tbl *tbl)
+{
+	if (tbl->base_addr)
+		usleep_range(EIP_FLOW_HW_DRAIN_US, EIP_FLOW_HW_DRAIN_US * 2);
+}
+
+/*
+ * eip_flow_hw_fill()
+ *	Fill a hardware flow; the record becomes valid with the TR address
+ */
+static void eip_flow_hw_fill(struct eip_flow_hw *hflow, struct eip_flow *flow)
+{
+	hflow->tr_addr_type_1 = EIP_FLOW_TR_DISABLE;
+	hflow->hashid_1 = flow->hash;
+	hflow->next_flow_offset = 0;
+	wmb();
+	hflow->tr_addr_type_1 = flow->tr_addr_type;
+}
+
+/*
+ * eip_flow_coll_alloc()
+ *	Reserve a collision record
+ */
+static int32_t eip_flow_coll_alloc(struct eip_flow_ht *ht)
+{
+	uint32_t idx;
+
+	do {
+		idx = find_first_zero_bit(ht->coll_map, ht->coll_max);
+		if (idx >= ht->coll_max)
+			return -1;
+	} while (test_and_set_bit(idx, ht->coll_map));
+
+	return idx;
+}
+
+/*
+ * eip_flow_coll_free()
+ *	Release a collision record
+ */
+static void eip_flow_coll_free(struct eip_flow_ht *ht, int32_t coll)
+{
+	memset(ht->hw_coll + coll, 0, sizeof(struct eip_flow_hw));
+	clear_bit(coll, ht->coll_map);
+}
+
+/*
+ * eip_flow_ht_find()
+ *	Find the flow with the given hash in a bucket; bucket lock or resize lock held
+ */
+static struct eip_flow *eip_flow_ht_find(struct eip_flow_ht *ht, uint32_t idx, eip_flow_hash_t hash)
+{
+	uint32_t ver = ht->node_ver;
+	struct eip_flow *flow;
+
+	hlist_for_each_entry(flow, &ht->sw_head[idx], node[ver]) {
+		if (EIP_HASH_EQUAL(flow->hash, hash))
 			return flow;
 	}
 
@@ -170,177 +324,841 @@ static struct eip_flow *_eip_flow_lookup(struct eip_flow_tbl *flow_table, eip_fl
 }
 
 /*
- * eip_flow_alloc
- * 	Allocate flow
+ * eip_flow_ht_link()
+ *	Add a flow to a bucket of a table instance
+ *
+ * The first flow of a bucket takes the bucket record; later ones take a
+ * collision record linked from the tail of the chain.
  */
-static struct eip_flow *eip_flow_alloc(struct eip_flow_tuple *flow_tuple, struct eip_tr *tr)
+static bool eip_flow_ht_link(struct eip_flow_ht *ht, uint32_t idx, struct eip_flow *flow, bool *collision)
 {
-	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
-	struct hlist_head *flow_head = NULL;
-	struct eip_flow_hw *hflow = NULL;
-	struct eip_flow_tbl *tbl = NULL;
-	struct eip_flow *flow = NULL;
-	eip_flow_hash_t hash;
-	uint32_t idx;
-	int i;
+	uint32_t ver = ht->node_ver;
+	struct eip_flow_slot *slot = &flow->slot[ver];
+	struct hlist_head *head = &ht->sw_head[idx];
+	struct eip_flow *tail = NULL, *pos;
+	int32_t coll;
+
+	*collision = false;
+
+	if (hlist_empty(head)) {
+		slot->hflow = ht->hw_head + idx;
+		slot->hflow_paddr = ht->hw_head_paddr + (idx * sizeof(struct eip_flow_hw));
+		slot->coll = -1;
+		slot->sentinel = true;
+
+		eip_flow_hw_fill(slot->hflow, flow);
+		hlist_add_head_rcu(&flow->node[ver], head);
+		return true;
+	}
 
-	hash = eip_flow_get_hash(flow_tuple);
-	idx = EIP_FLOW_HASH_IDX(hash);
-	tbl = &ep->flow_table;
-	flow_head = &tbl->sw_head[idx];
+	coll = eip_flow_coll_alloc(ht);
+	if (coll < 0)
+		return false;
 
-	assert_spin_locked(&tbl->lock);
-	if (_eip_flow_lookup(tbl, hash) != NULL) {
-		pr_warn("%px: Flow already exists \n", tr);
-		return NULL;
+	slot->hflow = ht->hw_coll + coll;
+	slot->hflow_paddr = ht->hw_coll_paddr + (coll * sizeof(struct eip_flow_hw));
+	slot->coll = coll;
+	slot->sentinel = false;
+	eip_flow_hw_fill(slot->hflow, flow);
+
+	hlist_for_each_entry(pos, head, node[ver]) {
+		tail = pos;
 	}
 
 	/*
-	 * Allocate the software flow.
+	 * Here, atleast one node is already present, hence tail can't be null.
 	 */
-	flow = kmem_cache_alloc(ep->flow_swcache, GFP_ATOMIC);
-	if (!flow) {
-		return NULL;
+	BUG_ON(!tail);
+	wmb();
+	tail->slot[ver].hflow->next_flow_offset = (slot->hflow_paddr - ht->hw_head_paddr) | EIP_FLOW_VALID_BIT;
+	hlist_add_behind_rcu(&flow->node[ver], &tail->node[ver]);
+
+	*collision = true;
+	return true;
+}
+
+/*
+ * eip_flow_ht_unlink()
+ *	Remove a flow from a bucket of a table instance
+ */
+static void eip_flow_ht_unlink(struct eip_flow_ht *ht, uint32_t idx, struct eip_flow *flow)
+{
+	uint32_t ver = ht->node_ver;
+	struct eip_flow_slot *slot = &flow->slot[ver];
+	struct hlist_head *head = &ht->sw_head[idx];
+	struct eip_flow *prev = NULL, *next = NULL, *pos;
+	struct eip_flow_slot *nslot;
+	int32_t coll;
+
+	hlist_for_each_entry(pos, head, node[ver]) {
+		if (pos == flow)
+			break;
+
+		prev = pos;
 	}
 
-	memset(flow, 0, sizeof(struct eip_flow));
-	INIT_HLIST_NODE(&flow->node);
-	flow->hash = hash;
-	flow->tuple = *flow_tuple;
+	if (flow->node[ver].next)
+		next = hlist_entry(flow->node[ver].next, struct eip_flow, node[ver]);
 
 	/*
-	 * Check if hardware flow is available in the hash table
+	 * This the only flow in the chain, Reset the flow.
 	 */
-	if(hlist_empty(flow_head)) {
-		hflow = tbl->hw_head + idx;
-		memset(hflow, 0, sizeof(struct eip_flow_hw));
-		hflow->tr_addr_type_1 = tr->tr_addr_type;
-		hflow->next_flow_offset = 0;
-		hflow->hashid_1 = hash;
+	if (!prev && !next) {
+		slot->hflow->tr_addr_type_1 = EIP_FLOW_TR_DISABLE;
+		memset(slot->hflow, 0, sizeof(*slot->hflow));
+		goto done;
+	}
+
+	/*
+	 * There are more flows in the chain, But we are deleting the head flow.
+	 * Move the second hardware flow to the head and release its collision record.
+	 */
+	if (!prev) {
+		nslot = &next->slot[ver];
+		coll = nslot->coll;
+
+		slot->hflow->tr_addr_type_1 = EIP_FLOW_TR_DISABLE;
+		wmb();
+		slot->hflow->hashid_1 = nslot->hflow->hashid_1;
+		slot->hflow->next_flow_offset = nslot->hflow->next_flow_offset;
+		wmb();
+		slot->hflow->tr_addr_type_1 = nslot->hflow->tr_addr_type_1;
+
+		eip_flow_coll_free(ht, coll);
+		*nslot = *slot;
+		goto done;
+	}
 
+	/*
+	 * We are deleting the non-sentinel (not at the Head) flow.
+	 * Make previous hflow to point the next flow (or NULL).
+	 */
+	prev->slot[ver].hflow->next_flow_offset = slot->hflow->next_flow_offset;
+	wmb();
+	eip_flow_coll_free(ht, slot->coll);
 
-		flow->hflow = hflow ;
-		flow->hflow_paddr = tbl->hw_head_paddr + (idx * sizeof(*hflow));
-		flow->sentinel = true;
-		pr_debug("%px: Hardware flow allocated %pad\n", tr, &flow->hflow_paddr);
+done:
+	hlist_del_rcu(&flow->node[ver]);
+}
 
-		return flow;
+/*
+ * eip_flow_ht_coll_used()
+ *	Number of collision records in use
+ */
+static inline uint32_t eip_flow_ht_coll_used(struct eip_flow_ht *ht)
+{
+	return bitmap_weight(ht->coll_map, ht->coll_max);
+}
+
+/*
+ * eip_flow_need_grow()
+ *	Check the load of a table instance
+ */
+static bool eip_flow_need_grow(struct eip_flow_tbl *tbl, struct eip_flow_ht *ht)
+{
+	if (ht->order >= EIP_FLOW_ORDER_MAX)
+		return false;
+
+	/*
+	 * Grow at one flow per bucket or when collision records run low
+	 */
+	if (atomic_read(&tbl->count) > (ht->mask + 1))
+		return true;
+
+	return eip_flow_ht_coll_used(ht) > ((ht->coll_max * 3) / 4);
+}
+
+/*
+ * eip_flow_resize_work()
+ *	Move all flows into a table instance twice the size
+ */
+static void eip_flow_resize_work(struct work_struct *work)
+{
+	struct eip_flow_tbl *tbl = container_of(work, struct eip_flow_tbl, resize_work);
+	struct eip_flow_ht *old, *new;
+	struct eip_flow *flow;
+	bool collision;
+	uint32_t i;
+
+	mutex_lock(&tbl->resize_mutex);
+	if (tbl->dying)
+		goto done;
+
+	old = rcu_dereference_protected(tbl->ht, lockdep_is_held(&tbl->resize_mutex));
+	if (!eip_flow_need_grow(tbl, old))
+		goto done;
+
+	new = eip_flow_ht_alloc(tbl, old->order + 1);
+	if (!new) {
+		pr_warn("%px: Failed to allocate flow table of order %u\n", tbl, old->order + 1);
+		goto done;
 	}
 
+	new->node_ver = !old->node_ver;
+
 	/*
-	 * Look up the available hardware flow memory from the collision pool.
+	 * Flows stay linked in the old instance through the other node,
+	 * so lockless readers keep finding them while they are moved.
 	 */
-	for (i = 0; i < EIP_FLOW_MAX_COLLISION; i++) {
-		hflow = ep->flow_hwcache + i;
-		if (hflow->tr_addr_type_1 == 0) {
-			hflow->tr_addr_type_1 = tr->tr_addr_type;
-			hflow->next_flow_offset = 0;
-			hflow->hashid_1 = hash;
+	write_lock_bh(&tbl->resize_lock);
+	for (i = 0; i <= old->mask; i++) {
+		hlist_for_each_entry(flow, &old->sw_head[i], node[old->node_ver]) {
+			if (!eip_flow_ht_link(new, EIP_FLOW_HASH_IDX(flow->hash, new->mask), flow, &collision)) {
+				write_unlock_bh(&tbl->resize_lock);
+				pr_warn("%px: Out of collision records while growing to order %u\n", tbl, new->order);
+				eip_flow_ht_free(tbl, new);
+				goto done;
+			}
+		}
+	}
 
-			flow->hflow = hflow;
-			flow->hflow_paddr = ep->hwcache_paddr + (i * sizeof(*hflow));
-			pr_debug("%px: Hardware flow allocated from collision memory %pad\n", tr, &flow->hflow_paddr);
+	/*
+	 * Switch the hardware before publishing; if the FLUE does not take
+	 * the new instance, point it back to the old one, which still holds
+	 * every flow, and drop the new one
+	 */
+	eip_flow_hw_commit(tbl, new);
+	if (!eip_flow_hw_switched(tbl, new)) {
+		eip_flow_hw_commit(tbl, old);
+		write_unlock_bh(&tbl->resize_lock);
+		pr_warn("%px: FLUE did not switch to the new table, keeping the old one\n", tbl);
+		eip_flow_hw_quiesce(tbl);
+		eip_flow_ht_free(tbl, new);
+		goto done;
+	}
 
-			return flow;
+	rcu_assign_pointer(tbl->ht, new);
+	write_unlock_bh(&tbl->resize_lock);
+
+	atomic64_inc(&tbl->stats.resize);
+	pr_info("%px: Flow table resized to %u buckets\n", tbl, new->mask + 1);
+
+	/*
+	 * Wait for lockless readers and the hardware to leave the old instance;
+	 * synchronize_rcu() only covers the CPU(s)
+	 */
+	synchronize_rcu();
+	eip_flow_hw_quiesce(tbl);
+	eip_flow_ht_free(tbl, old);
+
+done:
+	mutex_unlock(&tbl->resize_mutex);
+}
+
+/*
+ * eip_flow_free_rcu()
+ *	Free the flow once readers are done
+ */
+static void eip_flow_free_rcu(struct rcu_head *head)
+{
+	struct eip_flow *flow = container_of(head, struct eip_flow, rcu);
+
+	kmem_cache_free(flow->tbl->cache, flow);
+}
+
+/*
+ * eip_flow_tbl_link()
+ *	Add a prepared flow; resize lock held for read
+ */
+static int eip_flow_tbl_link(struct eip_flow_tbl *tbl, struct eip_flow_ht *ht, struct eip_flow *flow)
+{
+	uint32_t idx = EIP_FLOW_HASH_IDX(flow->hash, ht->mask);
+	spinlock_t *lock = &tbl->lock[idx & (EIP_FLOW_LOCKS - 1)];
+	bool collision;
+	int err = 0;
+
+	spin_lock(lock);
+	if (eip_flow_ht_find(ht, idx, flow->hash)) {
+		err = -EEXIST;
+	} else if (!eip_flow_ht_link(ht, idx, flow, &collision)) {
+		err = -ENOSPC;
+	}
+
+	spin_unlock(lock);
+
+	if (err) {
+		atomic64_inc(&tbl->stats.fail);
+		return err;
+	}
+
+	atomic_inc(&tbl->count);
+	atomic64_inc(&tbl->stats.alloc);
+	if (collision)
+		atomic64_inc(&tbl->stats.collision);
+
+	return 0;
+}
+
+/*
+ * eip_flow_tbl_unlink()
+ *	Remove the flow with the given hash; resize lock held for read
+ */
+static struct eip_flow *eip_flow_tbl_unlink(struct eip_flow_tbl *tbl, struct eip_flow_ht *ht, eip_flow_hash_t hash)
+{
+	uint32_t idx = EIP_FLOW_HASH_IDX(hash, ht->mask);
+	spinlock_t *lock = &tbl->lock[idx & (EIP_FLOW_LOCKS - 1)];
+	struct eip_flow *flow;
+
+	spin_lock(lock);
+	flow = eip_flow_ht_find(ht, idx, hash);
+	if (flow)
+		eip_flow_ht_unlink(ht, idx, flow);
+
+	spin_unlock(lock);
+
+	if (!flow)
+		return NULL;
+
+	atomic_dec(&tbl->count);
+	atomic64_inc(&tbl->stats.free);
+	return flow;
+}
+
+/*
+ * eip_flow_tbl_add()
+ *	Add flows to a table; returns the number added
+ *
+ * flow[i] is set to NULL for a tuple that could not be added.
+ */
+static uint32_t eip_flow_tbl_add(struct eip_flow_tbl *tbl, struct eip_flow_tuple *tuple, uint32_t *tr_addr_type,
+				struct eip_flow **flow, uint32_t count)
+{
+	struct eip_flow_ht *ht;
+	uint32_t added = 0;
+	uint32_t i;
+
+	/*
+	 * Allocate and hash outside the table locks
+	 */
+	for (i = 0; i < count; i++) {
+		flow[i] = kmem_cache_zalloc(tbl->cache, GFP_ATOMIC);
+		if (!flow[i]) {
+			atomic64_inc(&tbl->stats.fail);
+			continue;
+		}
+
+		INIT_HLIST_NODE(&flow[i]->node[0]);
+		INIT_HLIST_NODE(&flow[i]->node[1]);
+		flow[i]->tbl = tbl;
+		flow[i]->hash = eip_flow_get_hash(tbl, &tuple[i]);
+		flow[i]->tuple = tuple[i];
+		flow[i]->tr_addr_type = tr_addr_type[i];
+	}
+
+	read_lock_bh(&tbl->resize_lock);
+	ht = rcu_dereference_protected(tbl->ht, 1);
+
+	for (i = 0; i < count; i++) {
+		if (!flow[i])
+			continue;
+
+		if (eip_flow_tbl_link(tbl, ht, flow[i]) < 0) {
+			kmem_cache_free(tbl->cache, flow[i]);
+			flow[i] = NULL;
+			continue;
+		}
+
+		added++;
+	}
+
+	if (!tbl->dying && eip_flow_need_grow(tbl, ht))
+		schedule_work(&tbl->resize_work);
+
+	read_unlock_bh(&tbl->resize_lock);
+	return added;
+}
+
+/*
+ * eip_flow_tbl_del()
+ *	Remove flows by hash from a table; returns the number removed
+ */
+static uint32_t eip_flow_tbl_del(struct eip_flow_tbl *tbl, eip_flow_hash_t *hash, uint32_t count)
+{
+	struct eip_flow_ht *ht;
+	struct eip_flow *flow;
+	uint32_t deleted = 0;
+	uint32_t i;
+
+	read_lock_bh(&tbl->resize_lock);
+	ht = rcu_dereference_protected(tbl->ht, 1);
+
+	for (i = 0; i < count; i++) {
+		flow = eip_flow_tbl_unlink(tbl, ht, hash[i]);
+		if (flow) {
+			call_rcu(&flow->rcu, eip_flow_free_rcu);
+			deleted++;
 		}
 	}
 
-	kmem_cache_free(ep->flow_swcache, flow);
+	read_unlock_bh(&tbl->resize_lock);
+	return deleted;
+}
+
+/*
+ * eip_flow_tbl_lookup()
+ *	Lockless lookup; caller holds RCU read lock
+ */
+static struct eip_flow *eip_flow_tbl_lookup(struct eip_flow_tbl *tbl, eip_flow_hash_t hash)
+{
+	struct eip_flow_ht *ht = rcu_dereference(tbl->ht);
+	struct eip_flow *flow;
+	uint32_t ver;
+
+	if (!ht)
+		return NULL;
+
+	ver = ht->node_ver;
+	hlist_for_each_entry_rcu(flow, &ht->sw_head[EIP_FLOW_HASH_IDX(hash, ht->mask)], node[ver]) {
+		if (EIP_HASH_EQUAL(flow->hash, hash))
+			return flow;
+	}
+
 	return NULL;
 }
 
 /*
- * eip_flow_free()
- *      Reset and free the flow
+ * eip_flow_tbl_verify()
+ *	Check that the HW chains mirror the SW chains; returns the number of errors
  */
-static void eip_flow_free(struct eip_flow *flow, struct eip_pdev *ep)
+static uint32_t eip_flow_tbl_verify(struct eip_flow_tbl *tbl)
 {
-	hlist_del_init(&flow->node);
+	struct eip_flow_hw *cursor;
+	struct eip_flow_ht *ht;
+	struct eip_flow *flow;
+	uint32_t err = 0;
+	uint32_t off;
+	uint32_t ver;
+	uint32_t i;
+
+	read_lock_bh(&tbl->resize_lock);
+	ht = rcu_dereference_protected(tbl->ht, 1);
+	ver = ht->node_ver;
+
+	for (i = 0; i <= ht->mask; i++) {
+		cursor = ht->hw_head + i;
+
+		if (hlist_empty(&ht->sw_head[i])) {
+			err += (cursor->tr_addr_type_1 != EIP_FLOW_TR_DISABLE);
+			continue;
+		}
 
-	flow->hflow->tr_addr_type_1 = EIP_FLOW_TR_DISABLE;
-	memset(flow->hflow, 0, sizeof(*(flow->hflow)));
-	memset(flow, 0, sizeof(struct eip_flow));
-	kmem_cache_free(ep->flow_swcache, flow);
+		hlist_for_each_entry(flow, &ht->sw_head[i], node[ver]) {
+			if (!cursor) {
+				err++;
+				break;
+			}
+
+			err += (cursor != flow->slot[ver].hflow);
+			err += !EIP_HASH_EQUAL(cursor->hashid_1, flow->hash);
+			err += (cursor->tr_addr_type_1 != flow->tr_addr_type);
+			err += (EIP_FLOW_HASH_IDX(flow->hash, ht->mask) != i);
+
+			off = cursor->next_flow_offset;
+			cursor = (off & EIP_FLOW_VALID_BIT) ?
+				(struct eip_flow_hw *)((uint8_t *)ht->hw_head + (off & ~EIP_FLOW_VALID_BIT)) : NULL;
+		}
+
+		/*
+		 * Hardware chain longer than the software one
+		 */
+		err += !!cursor;
+	}
+
+	read_unlock_bh(&tbl->resize_lock);
+	return err;
 }
 
 /*
- * eip_flow_swap_hflow()
- *      copy and swap hflow memory for next_flow->hflow to flow->hflow.
+ * eip_flow_tbl_init()
+ *	Initialize a flow table; dev and base_addr are NULL for the software model
  */
-static void eip_flow_swap_hflow(struct eip_flow *flow, struct eip_flow *next_flow)
+static bool eip_flow_tbl_init(struct eip_flow_tbl *tbl, struct device *dev, void __iomem *base_addr,
+				const char *name)
 {
-	flow->hflow->tr_addr_type_1 = EIP_FLOW_TR_DISABLE;
-	flow->hflow->hashid_1 = next_flow->hflow->hashid_1;
-	flow->hflow->tr_addr_type_1 = next_flow->hflow->tr_addr_type_1;
-	flow->hflow->next_flow_offset = next_flow->hflow->next_flow_offset;
+	struct eip_flow_ht *ht;
+	int i;
+
+	tbl->dev = dev;
+	tbl->base_addr = base_addr;
+	rwlock_init(&tbl->resize_lock);
+	mutex_init(&tbl->resize_mutex);
+	INIT_WORK(&tbl->resize_work, eip_flow_resize_work);
+	atomic_set(&tbl->count, 0);
+
+	for (i = 0; i < EIP_FLOW_LOCKS; i++)
+		spin_lock_init(&tbl->lock[i]);
+
+	if (base_addr) {
+		tbl->iv.words[0] = ioread32(base_addr + EIP_HW_FHASH_IV0);
+		tbl->iv.words[1] = ioread32(base_addr + EIP_HW_FHASH_IV1);
+		tbl->iv.words[2] = ioread32(base_addr + EIP_HW_FHASH_IV2);
+		tbl->iv.words[3] = ioread32(base_addr + EIP_HW_FHASH_IV3);
+	} else {
+		tbl->iv.words[0] = EIP_HW_FHASH_IV0_CFG;
+		tbl->iv.words[1] = EIP_HW_FHASH_IV1_CFG;
+		tbl->iv.words[2] = EIP_HW_FHASH_IV2_CFG;
+		tbl->iv.words[3] = EIP_HW_FHASH_IV3_CFG;
+	}
+
+	tbl->cache = kmem_cache_create(name, sizeof(struct eip_flow), 0, 0, NULL);
+	if (!tbl->cache) {
+		pr_err("%px: Failed to allocate flow swcache\n", tbl);
+		return false;
+	}
 
-	flow->hflow = xchg(&next_flow->hflow, flow->hflow);
-	flow->hflow_paddr = xchg(&next_flow->hflow_paddr, flow->hflow_paddr);
-	next_flow->sentinel = flow->sentinel;
-	flow->sentinel =  false;
+	ht = eip_flow_ht_alloc(tbl, EIP_FLOW_ORDER_MIN);
+	if (!ht) {
+		pr_err("%px: Failed to allocate entries\n", tbl);
+		kmem_cache_destroy(tbl->cache);
+		return false;
+	}
+
+	pr_debug("%px: DMA Address %px\n", tbl, ht->hw_head);
+	pr_debug("%px: DMA Physical address %pad\n", tbl, &ht->hw_head_paddr);
+
+	if (base_addr) {
+		iowrite32(0x0, base_addr + EIP_HW_FLUE_CACHEBASE_LO(0));
+		iowrite32(0x0, base_addr + EIP_HW_FLUE_CACHEBASE_HI(0));
+	}
+
+	eip_flow_hw_commit(tbl, ht);
+	RCU_INIT_POINTER(tbl->ht, ht);
+	return true;
 }
 
 /*
- * eip_flow_add()
+ * eip_flow_tbl_deinit()
+ *	Free a flow table and any flow left in it
  */
-struct eip_flow *eip_flow_add(struct eip_flow_tuple *flow_tuple, struct eip_tr *tr)
+static void eip_flow_tbl_deinit(struct eip_flow_tbl *tbl)
 {
-	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
-	struct eip_flow *flow, *tail_flow;
-	struct hlist_head *flow_head;
-	struct eip_flow_tbl *tbl;
-	uint32_t idx;
+	struct eip_flow *flow;
+	struct hlist_node *tmp;
+	struct eip_flow_ht *ht;
+	uint32_t i;
 
-	tbl = &ep->flow_table;
+	mutex_lock(&tbl->resize_mutex);
+	tbl->dying = true;
+	mutex_unlock(&tbl->resize_mutex);
+	cancel_work_sync(&tbl->resize_work);
 
-	spin_lock_bh(&tbl->lock);
-	flow = eip_flow_alloc(flow_tuple, tr);
-	if (!flow) {
-		spin_unlock_bh(&tbl->lock);
-		pr_err("%px: Failed to allocate EIP flow\n", tr);
-		return NULL;
+	ht = rcu_dereference_protected(tbl->ht, 1);
+
+	/*
+	 * Stop lookups before the table memory goes away
+	 */
+	if (tbl->base_addr) {
+		iowrite32(EIP_HW_FLUE_CONFIG_SZ(ht->order - 5) & ~EIP_HW_ENB_FLUE,
+				tbl->base_addr + EIP_HW_FLUE_CONFIG(0));
+		ioread32(tbl->base_addr + EIP_HW_FLUE_CONFIG(0));
+		usleep_range(EIP_FLOW_HW_DRAIN_US, EIP_FLOW_HW_DRAIN_US * 2);
 	}
 
-	idx = EIP_FLOW_HASH_IDX(flow->hash);
-	flow_head = &tbl->sw_head[idx];
+	RCU_INIT_POINTER(tbl->ht, NULL);
+	synchronize_rcu();
+
+	for (i = 0; i <= ht->mask; i++) {
+		hlist_for_each_entry_safe(flow, tmp, &ht->sw_head[i], node[ht->node_ver]) {
+			hlist_del(&flow->node[ht->node_ver]);
+			kmem_cache_free(tbl->cache, flow);
+		}
+	}
 
 	/*
-	 * Fast addition: Addition of a new node at the begining of hlist
+	 * Wait for flows freed through RCU before the cache goes away
 	 */
-	if (flow->sentinel) {
-		hlist_add_head(&flow->node, flow_head);
-		tbl->stats.alloc++;
-
-		spin_unlock_bh(&tbl->lock);
-		if (flow_tuple->ip_ver == 6) {
-			pr_debug("%px Flow (src:%pI6n dst:%pI6n spi:0x%X) added at the head at index %u\n", flow, flow_tuple->src_ip, flow_tuple->dst_ip, ntohl(flow_tuple->spi), idx);
-		} else {
-			pr_debug("%px Flow (src:%pI4n dst:%pI4n spi:0x%X) added at the head at index %u\n", flow, flow_tuple->src_ip, flow_tuple->dst_ip, ntohl(flow_tuple->spi), idx);
+	rcu_barrier();
+	eip_flow_ht_free(tbl, ht);
+	kmem_cache_destroy(tbl->cache);
+}
+
+/*
+ * eip_flow_tbl_stats_print()
+ *	Print table layout and statistics into buf
+ */
+static ssize_t eip_flow_tbl_stats_print(struct eip_flow_tbl *tbl, char *buf, ssize_t max_buf_len)
+{
+	uint32_t hist[EIP_FLOW_CHAIN_HIST] = {0};
+	struct eip_flow_tbl_stats stats;
+	uint32_t max_chain = 0;
+	struct eip_flow_ht *ht;
+	struct eip_flow *flow;
+	uint32_t chain;
+	ssize_t len = 0;
+	uint32_t i;
+
+	eip_flow_get_stats(tbl, &stats);
+
+	rcu_read_lock();
+	ht = rcu_dereference(tbl->ht);
+	if (!ht) {
+		rcu_read_unlock();
+		return snprintf(buf, max_buf_len, "Flow table not initialized\n");
+	}
+
+	for (i = 0; i <= ht->mask; i++) {
+		chain = 0;
+		hlist_for_each_entry_rcu(flow, &ht->sw_head[i], node[ht->node_ver]) {
+			chain++;
+		}
+
+		hist[min(chain, EIP_FLOW_CHAIN_HIST - 1)]++;
+		max_chain = max(max_chain, chain);
+	}
+
+	len += snprintf(buf + len, max_buf_len - len, "Buckets - %u\n", ht->mask + 1);
+	len += snprintf(buf + len, max_buf_len - len, "Flows - %d\n", atomic_read(&tbl->count));
+	len += snprintf(buf + len, max_buf_len - len, "Collision records - %u/%u\n", eip_flow_ht_coll_used(ht), ht->coll_max);
+	rcu_read_unlock();
+
+	len += snprintf(buf + len, max_buf_len - len, "Longest chain - %u\n", max_chain);
+	len += snprintf(buf + len, max_buf_len - len, "Flows allocated - %llu\n", stats.alloc);
+	len += snprintf(buf + len, max_buf_len - len, "Flows deallocated - %llu\n", stats.free);
+	len += snprintf(buf + len, max_buf_len - len, "Total collisions - %llu\n", stats.collision);
+	len += snprintf(buf + len, max_buf_len - len, "Active collisions - %llu\n", stats.active_collision);
+	len += snprintf(buf + len, max_buf_len - len, "Add failures - %llu\n", stats.fail);
+	len += snprintf(buf + len, max_buf_len - len, "Resizes - %llu\n", stats.resize);
+
+	for (i = 0; i < EIP_FLOW_CHAIN_HIST; i++) {
+		len += snprintf(buf + len, max_buf_len - len, "Chain length %u%s - %u\n", i,
+				(i == EIP_FLOW_CHAIN_HIST - 1) ? "+" : "", hist[i]);
+	}
+
+	return len;
+}
+
+/*
+ * eip_flow_tbl_stats_read()
+ *	Read flow table statistics
+ */
+static ssize_t eip_flow_tbl_stats_read(struct file *fp, char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct eip_flow_tbl *tbl = fp->private_data;
+	ssize_t max_buf_len;
+	ssize_t len;
+	ssize_t ret;
+	char *buf;
+
+	max_buf_len = (EIP_FLOW_CHAIN_HIST + 12) * EIP_DEBUGFS_MAX_NAME;
+	buf = vzalloc(max_buf_len);
+	if (!buf)
+		return 0;
+
+	len = eip_flow_tbl_stats_print(tbl, buf, max_buf_len);
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, len);
+	vfree(buf);
+	return ret;
+}
+
+/*
+ * Flow table statistics file operation structure instance
+ */
+static const struct file_operations flow_tbl_stats_ops = {
+	.open = simple_open,
+	.llseek = default_llseek,
+	.read = eip_flow_tbl_stats_read,
+};
+
+/*
+ * eip_flow_model_run()
+ *	Exercise a software table with the given number of flows
+ */
+static void eip_flow_model_run(uint32_t count)
+{
+	struct eip_flow_tuple *tuple = NULL;
+	uint64_t t_add, t_lookup, t_del;
+	struct eip_flow **flow = NULL;
+	uint32_t *tr_addr_type = NULL;
+	eip_flow_hash_t *hash = NULL;
+	struct eip_flow_tbl *tbl;
+	uint32_t miss = 0, err = 0;
+	uint32_t added, i;
+	uint32_t order;
+	ktime_t start;
+
+	tbl = vzalloc(sizeof(*tbl));
+	tuple = vzalloc(count * sizeof(*tuple));
+	flow = vzalloc(count * sizeof(*flow));
+	hash = vzalloc(count * sizeof(*hash));
+	tr_addr_type = vzalloc(count * sizeof(*tr_addr_type));
+	if (!tbl || !tuple || !flow || !hash || !tr_addr_type) {
+		snprintf(eip_flow_model.result, sizeof(eip_flow_model.result), "error - no memory for %u flows\n", count);
+		goto free;
+	}
+
+	if (!eip_flow_tbl_init(tbl, NULL, NULL, "eip_sw_flow_model")) {
+		snprintf(eip_flow_model.result, sizeof(eip_flow_model.result), "error - table init failed\n");
+		goto free;
+	}
+
+	/*
+	 * Road warrior like population: one ESP SA per client towards one gateway
+	 */
+	for (i = 0; i < count; i++) {
+		tuple[i].ip_ver = IPVERSION;
+		tuple[i].ip_proto = IPPROTO_ESP;
+		tuple[i].src_ip[0] = htonl(0x0a000000 | (i + 1));
+		tuple[i].dst_ip[0] = htonl(0xc0a80101);
+		tuple[i].spi = htonl(0x1000 + i);
+		tr_addr_type[i] = (i + 1) << 4;
+	}
+
+	/*
+	 * Add in chunks so that the table gets a chance to grow in between,
+	 * retrying what did not fit.
+	 */
+	start = ktime_get();
+	added = 0;
+	for (i = 0; i < count; i += EIP_FLOW_BULK_MAX) {
+		uint32_t n = min(count - i, EIP_FLOW_BULK_MAX);
+		uint32_t j;
+
+		added += eip_flow_tbl_add(tbl, &tuple[i], &tr_addr_type[i], &flow[i], n);
+		flush_work(&tbl->resize_work);
+
+		for (j = i; j < i + n; j++) {
+			if (!flow[j])
+				added += eip_flow_tbl_add(tbl, &tuple[j], &tr_addr_type[j], &flow[j], 1);
 		}
+	}
+
+	t_add = ktime_to_ns(ktime_sub(ktime_get(), start));
 
-		return flow;
+	start = ktime_get();
+	rcu_read_lock();
+	for (i = 0; i < count; i++) {
+		if (!flow[i])
+			continue;
+
+		hash[i] = flow[i]->hash;
+		miss += (eip_flow_tbl_lookup(tbl, hash[i]) != flow[i]);
 	}
 
+	rcu_read_unlock();
+	t_lookup = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	err += eip_flow_tbl_verify(tbl);
+	order = rcu_dereference_protected(tbl->ht, 1)->order;
+
 	/*
-	 * Slow addition : Allocate a new hardware flow at tail.
-	 * Obtain the tail of the current chain. Here, atleast one node will be already present,hence tail can't be null.
+	 * Delete every other flow, check the rest is still found, then delete all
 	 */
-	tail_flow = eip_flow_get_tail(flow_head);
-	BUG_ON(tail_flow == NULL);
+	start = ktime_get();
+	for (i = 0; i < count; i += 2) {
+		if (flow[i])
+			eip_flow_tbl_del(tbl, &hash[i], 1);
+	}
+
+	rcu_read_lock();
+	for (i = 0; i < count; i++) {
+		if (!flow[i])
+			continue;
+
+		if (i & 1)
+			miss += (eip_flow_tbl_lookup(tbl, hash[i]) != flow[i]);
+		else
+			miss += (eip_flow_tbl_lookup(tbl, hash[i]) != NULL);
+	}
+
+	rcu_read_unlock();
+	err += eip_flow_tbl_verify(tbl);
+
+	for (i = 1; i < count; i += 2) {
+		if (flow[i])
+			eip_flow_tbl_del(tbl, &hash[i], 1);
+	}
+
+	t_del = ktime_to_ns(ktime_sub(ktime_get(), start));
+	err += eip_flow_tbl_verify(tbl);
+	err += (atomic_read(&tbl->count) != 0);
+	err += (eip_flow_ht_coll_used(rcu_dereference_protected(tbl->ht, 1)) != 0);
+
+	snprintf(eip_flow_model.result, sizeof(eip_flow_model.result),
+			"flows - %u\nadded - %u\nbuckets - %u\nresizes - %llu\n"
+			"add ns/flow - %llu\nlookup ns/flow - %llu\ndel ns/flow - %llu\n"
+			"lookup errors - %u\nverify errors - %u\nresult - %s\n",
+			count, added, 1U << order, (uint64_t)atomic64_read(&tbl->stats.resize),
+			added ? div_u64(t_add, added) : 0, added ? div_u64(t_lookup, added) : 0,
+			added ? div_u64(t_del, added) : 0,
+			miss, err, (miss || err || (added != count)) ? "FAIL" : "PASS");
+
+	eip_flow_tbl_deinit(tbl);
 
-	pr_debug("%px: Physical address of hardware head: %pad\n", tr, &tbl->hw_head_paddr);
-	tail_flow->hflow->next_flow_offset = (flow->hflow_paddr - tbl->hw_head_paddr) | EIP_FLOW_VALID_BIT;
+free:
+	vfree(tr_addr_type);
+	vfree(hash);
+	vfree(flow);
+	vfree(tuple);
+	vfree(tbl);
+}
+
+/*
+ * eip_flow_model_write()
+ *	Run the software model with the number of flows written
+ */
+static ssize_t eip_flow_model_write(struct file *fp, const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	uint32_t flows;
+	int ret;
+
+	ret = kstrtou32_from_user(ubuf, count, 0, &flows);
+	if (ret)
+		return ret;
 
-	hlist_add_behind(&flow->node, &tail_flow->node);
-	tbl->stats.alloc++;
-	tbl->stats.collision++;
-	tbl->stats.active_collision++;
+	if (!flows || (flows > (1U << EIP_FLOW_ORDER_MAX)))
+		return -EINVAL;
+
+	mutex_lock(&eip_flow_model.lock);
+	eip_flow_model_run(flows);
+	mutex_unlock(&eip_flow_model.lock);
+
+	return count;
+}
+
+/*
+ * eip_flow_model_read()
+ *	Read the result of the last model run
+ */
+static ssize_t eip_flow_model_read(struct file *fp, char __user *ubuf, size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&eip_flow_model.lock);
+	ret = simple_read_from_buffer(ubuf, count, ppos, eip_flow_model.result, strlen(eip_flow_model.result));
+	mutex_unlock(&eip_flow_model.lock);
+
+	return ret;
+}
+
+/*
+ * Software model file operation structure instance
+ */
+static const struct file_operations flow_model_ops = {
+	.open = simple_open,
+	.llseek = default_llseek,
+	.read = eip_flow_model_read,
+	.write = eip_flow_model_write,
+};
+
+/*
+ * eip_flow_add()
+ */
+struct eip_flow *eip_flow_add(struct eip_flow_tuple *flow_tuple, struct eip_tr *tr)
+{
+	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
+	struct eip_flow *flow;
+
+	if (!eip_flow_tbl_add(&ep->flow_table, flow_tuple, &tr->tr_addr_type, &flow, 1)) {
+		pr_err("%px: Failed to allocate EIP flow\n", tr);
+		return NULL;
+	}
 
-	spin_unlock_bh(&tbl->lock);
 	if (flow_tuple->ip_ver == 6) {
-		pr_debug("%px Flow (src:%pI6n dst:%pI6n spi:0x%X) added after collision at index %u\n", flow, flow_tuple->src_ip, flow_tuple->dst_ip, ntohl(flow_tuple->spi), idx);
+		pr_debug("%px Flow (src:%pI6n dst:%pI6n spi:0x%X) added at index %u\n", flow, flow_tuple->src_ip,
+				flow_tuple->dst_ip, ntohl(flow_tuple->spi), eip_flow_get_index(flow));
 	} else {
-		pr_debug("%px Flow (src:%pI4n dst:%pI4n spi:0x%X) added after collision at index %u\n", flow, flow_tuple->src_ip, flow_tuple->dst_ip, ntohl(flow_tuple->spi), idx);
+		pr_debug("%px Flow (src:%pI4n dst:%pI4n spi:0x%X) added at index %u\n", flow, flow_tuple->src_ip,
+				flow_tuple->dst_ip, ntohl(flow_tuple->spi), eip_flow_get_index(flow));
 	}
 
 	return flow;
@@ -353,124 +1171,130 @@ struct eip_flow *eip_flow_add(struct eip_flow_tuple *flow_tuple, struct eip_tr *
 void eip_flow_del(struct eip_flow_tuple *flow_tuple, struct eip_tr *tr)
 {
 	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
-	struct eip_flow *flow, *prev_flow;
-	struct hlist_head *flow_head;
-	struct eip_flow_tbl *tbl;
+	struct eip_flow_tbl *tbl = &ep->flow_table;
 	eip_flow_hash_t hash;
-	uint32_t idx;
 
-	hash = eip_flow_get_hash(flow_tuple);
-	idx = EIP_FLOW_HASH_IDX(hash);
-	tbl = &ep->flow_table;
-	flow_head = &tbl->sw_head[idx];
-
-	spin_lock_bh(&tbl->lock);
-	flow = _eip_flow_lookup(tbl, hash);
-	if (flow == NULL) {
-		spin_unlock_bh(&tbl->lock);
+	hash = eip_flow_get_hash(tbl, flow_tuple);
+	if (!eip_flow_tbl_del(tbl, &hash, 1)) {
 		pr_err("%px: Flow doesn't exist \n", tr);
 		return;
 	}
 
-	/*
-	 * This the only flow in the chain, Reset & free the flow.
-	 */
-	if (hlist_is_singular_node(&flow->node, flow_head)) {
-		ASSERT(flow->sentinel);
-		pr_debug("%px Flow (src:%pI4n dst:%pI4n spi:0x%X) deleted at head at index %u\n",
-				flow, flow_tuple->src_ip, flow_tuple->dst_ip, ntohl(flow_tuple->spi), idx);
-		goto free;
-	}
+	pr_debug("%px Flow (src:%pI4n dst:%pI4n spi:0x%X) deleted\n", tr, flow_tuple->src_ip, flow_tuple->dst_ip,
+			ntohl(flow_tuple->spi));
+}
 
-	/*
-	 * There are more flows in the chain, But we are deleting the head flow.
-	 * Move the second hardware flow to the head. Then, reset & free the flow.
-	 */
-	if (flow->sentinel) {
-		struct eip_flow *next_flow;
-
-		next_flow = eip_flow_get_next(flow);
-		eip_flow_swap_hflow(flow, next_flow);
-		pr_debug("%px Flow (src:%pI4n dst:%pI4n spi:0x%X) deleted at head (with collision) at index %u\n",
-				flow, flow_tuple->src_ip, flow_tuple->dst_ip, ntohl(flow_tuple->spi), idx);
-		tbl->stats.active_collision--;
-		goto free;
-	}
+/*
+ * eip_flow_add_bulk()
+ *	Add several flows under a single table section; returns the number added
+ */
+uint32_t eip_flow_add_bulk(struct eip_flow_tuple *flow_tuple, struct eip_tr **tr, struct eip_flow **flow, uint32_t count)
+{
+	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
+	uint32_t tr_addr_type[EIP_FLOW_BULK_MAX];
+	uint32_t added = 0;
+	uint32_t i, n;
 
-	/*
-	 * We are deleting the non-sentinel (not at the Head) flow.
-	 * Make previous hflow to point the next flow (or NULL). Then reset and free the flow.
-	 */
-	prev_flow = eip_flow_get_prev(flow);
-	prev_flow->hflow->next_flow_offset = flow->hflow->next_flow_offset;
-	tbl->stats.active_collision--;
-	pr_debug("%px Flow (src:%pI4n dst:%pI4n spi:0x%X) deleted (after collision) at index %u\n",
-			flow, flow_tuple->src_ip, flow_tuple->dst_ip, ntohl(flow_tuple->spi), idx);
+	for (; count; count -= n, flow_tuple += n, tr += n, flow += n) {
+		n = min(count, EIP_FLOW_BULK_MAX);
 
-free:
-	tbl->stats.free++;
-	eip_flow_free(flow, ep);
-	spin_unlock_bh(&tbl->lock);
+		for (i = 0; i < n; i++)
+			tr_addr_type[i] = tr[i]->tr_addr_type;
+
+		added += eip_flow_tbl_add(&ep->flow_table, flow_tuple, tr_addr_type, flow, n);
+	}
+
+	return added;
 }
 
 /*
- * eip_flow_table_init()
- * 	Allocate flow entries for hardware table
+ * eip_flow_del_bulk()
+ *	Delete several flows under a single table section
  */
-bool eip_flow_table_init(struct platform_device *pdev)
+void eip_flow_del_bulk(struct eip_flow **flow, uint32_t count)
 {
-	struct eip_pdev *ep = platform_get_drvdata(pdev);
-	void __iomem *base_addr = ep->dev_vaddr;
-	struct eip_flow_tbl *tbl;
-	size_t tbl_sz, collision_sz;
-	dma_addr_t paddr;
-	void *addr;
+	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
+	eip_flow_hash_t hash[EIP_FLOW_BULK_MAX];
+	uint32_t i, n;
 
-	int i;
+	for (; count; count -= n, flow += n) {
+		n = min(count, EIP_FLOW_BULK_MAX);
 
-	ep->flow_swcache = kmem_cache_create("eip_sw_flow", sizeof(struct eip_flow), 0, 0, NULL);
-	if (!ep->flow_swcache) {
-		pr_err("%px: Failed to allocate flow swcache\n",pdev);
-		return false;
+		for (i = 0; i < n; i++)
+			hash[i] = flow[i]->hash;
+
+		eip_flow_tbl_del(&ep->flow_table, hash, n);
 	}
+}
 
-	tbl = &ep->flow_table;
-	tbl_sz = EIP_FLOW_MAX * sizeof(struct eip_flow_hw);
-	collision_sz = EIP_FLOW_MAX_COLLISION * sizeof(struct eip_flow_hw);
+/*
+ * eip_flow_lookup()
+ *	Lockless flow lookup; caller holds RCU read lock
+ */
+struct eip_flow *eip_flow_lookup(struct eip_flow_tuple *flow_tuple)
+{
+	struct eip_pdev *ep = platform_get_drvdata(eip_drv_g.pdev);
+	struct eip_flow_tbl *tbl = &ep->flow_table;
 
-	/*
-	 * Allocate contiguous memory for hash table and collision list
-	 */
-	addr = dma_alloc_coherent(&pdev->dev, (tbl_sz + collision_sz), &paddr, GFP_DMA);
-	if (!addr) {
-		pr_err("%px: Failed to allocate entries\n",pdev);
-		goto fail_dma;
-	}
+	return eip_flow_tbl_lookup(tbl, eip_flow_get_hash(tbl, flow_tuple));
+}
 
-	memset(addr, 0, (tbl_sz + collision_sz));
-	tbl->hw_head = addr;
-	tbl->hw_head_paddr = paddr;
-	ep->flow_hwcache = addr + tbl_sz;
-	ep->hwcache_paddr = paddr + tbl_sz;
+/*
+ * eip_flow_get_index()
+ *	Bucket index of a flow in the current table
+ */
+uint32_t eip_flow_get_index(struct eip_flow *flow)
+{
+	struct eip_flow_ht *ht;
+	uint32_t idx = 0;
 
-	pr_debug("%px: DMA Address %px\n", pdev, tbl->hw_head);
-	pr_debug("%px: DMA Physical address %pad\n", pdev, &tbl->hw_head_paddr);
+	rcu_read_lock();
+	ht = rcu_dereference(flow->tbl->ht);
+	if (ht)
+		idx = EIP_FLOW_HASH_IDX(flow->hash, ht->mask);
 
-	iowrite32(EIP_HW_FLUE_CONFIG_VAL, base_addr + EIP_HW_FLUE_CONFIG(0));
-	iowrite32(0x0, base_addr + EIP_HW_FLUE_CACHEBASE_LO(0));
-	iowrite32(0x0, base_addr + EIP_HW_FLUE_CACHEBASE_HI(0));
-	iowrite32(tbl->hw_head_paddr, base_addr + EIP_HW_FLUE_HASHBASE_LO(0));
-	iowrite32(0x0, base_addr + EIP_HW_FLUE_HASHBASE_HI(0));
+	rcu_read_unlock();
+	return idx;
+}
 
-	for (i = 0; i < EIP_FLOW_MAX; i++){
-		INIT_HLIST_HEAD(&tbl->sw_head[i]);
+/*
+ * eip_flow_get_stats()
+ *	Snapshot of flow table statistics
+ */
+void eip_flow_get_stats(struct eip_flow_tbl *tbl, struct eip_flow_tbl_stats *stats)
+{
+	struct eip_flow_ht *ht;
+
+	stats->alloc = atomic64_read(&tbl->stats.alloc);
+	stats->free = atomic64_read(&tbl->stats.free);
+	stats->collision = atomic64_read(&tbl->stats.collision);
+	stats->fail = atomic64_read(&tbl->stats.fail);
+	stats->resize = atomic64_read(&tbl->stats.resize);
+
+	rcu_read_lock();
+	ht = rcu_dereference(tbl->ht);
+	stats->active_collision = ht ? eip_flow_ht_coll_used(ht) : 0;
+	rcu_read_unlock();
+}
+
+/*
+ * eip_flow_table_init()
+ * 	Allocate flow entries for hardware table
+ */
+bool eip_flow_table_init(struct platform_device *pdev)
+{
+	struct eip_pdev *ep = platform_get_drvdata(pdev);
+	struct eip_flow_tbl *tbl = &ep->flow_table;
+
+	iowrite32(EIP_HW_FLUE_CONFIG_VAL, ep->dev_vaddr + EIP_HW_FLUE_CONFIG(0));
+
+	if (!eip_flow_tbl_init(tbl, &pdev->dev, ep->dev_vaddr, "eip_sw_flow")) {
+		pr_err("%px: Failed to initialize flow table\n", pdev);
+		return false;
 	}
 
+	tbl->dentry = debugfs_create_file("flow_table", S_IRUGO, ep->dentry, tbl, &flow_tbl_stats_ops);
 	return true;
-
-fail_dma:
-	kmem_cache_destroy(ep->flow_swcache);
-	return false;
 }
 
 /*
@@ -480,12 +1304,29 @@ fail_dma:
 void eip_flow_table_deinit(struct platform_device *pdev)
 {
 	struct eip_pdev *ep = platform_get_drvdata(pdev);
-	void __iomem *base_addr = ep->dev_vaddr;
-	struct eip_flow_tbl *tbl;
+	struct eip_flow_tbl *tbl = &ep->flow_table;
 
-	tbl = &ep->flow_table;
-	iowrite32(0x0, base_addr + EIP_HW_FLUE_HASHBASE_LO(0));
-	kmem_cache_destroy(ep->flow_swcache);
-	dma_free_coherent(&pdev->dev, EIP_FLOW_MAX * sizeof(struct eip_flow_hw), tbl->hw_head, tbl->hw_head_paddr);
+	/*
+	 * Table is only set up when redirection is enabled
+	 */
+	if (!rcu_access_pointer(tbl->ht))
+		return;
+
+	debugfs_remove(tbl->dentry);
+	eip_flow_tbl_deinit(tbl);
 }
 
+/*
+ * eip_flow_model_init()
+ *	Create the software model debugfs entry
+ *
+ * Writing a number of flows to flow_model builds a table in plain memory,
+ * without any register access, runs add/lookup/delete over it and checks the
+ * hardware chains; reading the file returns the result.
+ */
+void eip_flow_model_init(struct dentry *root)
+{
+	mutex_init(&eip_flow_model.lock);
+	snprintf(eip_flow_model.result, sizeof(eip_flow_model.result), "not run\n");
+	debugfs_create_file("flow_model", S_IRUGO | S_IWUSR, root, NULL, &flow_model_ops);
+}
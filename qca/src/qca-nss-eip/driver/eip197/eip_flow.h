@@ -17,11 +17,13 @@
 #ifndef __EIP_FLOW_H
 #define __EIP_FLOW_H
 
-#define EIP_FLOW_MAX (1U << (EIP_HW_FLUE_CONFIG_TABLE_SZ + 5))
-#define EIP_FLOW_MASK (EIP_FLOW_MAX - 1)
-#define EIP_FLOW_HASH_IDX(hash) ((hash.words[0] >> 6) & EIP_FLOW_MASK)
+#define EIP_FLOW_ORDER_MIN (EIP_HW_FLUE_CONFIG_TABLE_SZ + 5)	/* Initial log2 of buckets */
+#define EIP_FLOW_ORDER_MAX 14U		/* Largest table grown to; FLUE allows up to 20 */
+#define EIP_FLOW_HASH_IDX(hash, mask) ((hash.words[0] >> 6) & (mask))
 #define EIP_FLOW_HASH_DATA_SZ 13U /* Iterations for hash function */
-#define EIP_FLOW_MAX_COLLISION 64U
+#define EIP_FLOW_MAX_COLLISION 64U	/* Collision records for the initial table size */
+#define EIP_FLOW_LOCKS 256U		/* Bucket locks; power of 2, not above the initial bucket count */
+#define EIP_FLOW_CHAIN_HIST 8U		/* Chain length histogram buckets */
 #define EIP_HASH_EQUAL(H1,H2) ((H1.words[0] == H2.words[0]) && (H1.words[1] == H2.words[1]) && (H1.words[2] == H2.words[2]) && (H1.words[3] == H2.words[3]))
 #define EIP_FLOW_TR_DISABLE 0x0
 #define EIP_FLOW_VALID_BIT 0x1U
@@ -63,39 +65,106 @@ struct eip_flow_hw {
 	uint32_t next_flow_offset;	/* Bucket offset in the presence of collision */
 }__attribute((__packed__));
 
+/*
+ * eip_flow_slot
+ *      Placement of a flow in one table instance
+ */
+struct eip_flow_slot {
+	struct eip_flow_hw *hflow;	/* Pointer to HW flow */
+	dma_addr_t hflow_paddr;		/* Physical address of hardware flow */
+	int32_t coll;			/* Collision record index; -1 for bucket head */
+	bool sentinel;			/* Sentinel to check if a node is the head node */
+};
+
 /*
  * eip_flow
  *      SW flow object
+ *
+ * A flow is linked in at most two table instances at a time; the table in use
+ * and the one being built during a resize. node_ver of the instance selects
+ * the node and slot.
  */
+struct eip_flow_tbl;
 struct eip_flow {
-	struct hlist_node node;         /* Hlist node to traverse the collision list */
-	struct eip_flow_hw *hflow;      /* Pointer to HW flow */
-	dma_addr_t hflow_paddr;         /* Physical address of hardware flow */
+	struct hlist_node node[2];      /* Hlist node to traverse the collision list */
+	struct eip_flow_slot slot[2];   /* HW flow per table instance */
+	struct rcu_head rcu;            /* RCU free */
 	eip_flow_hash_t hash;           /* Hash value calculated from flow tuple */
 	struct eip_flow_tuple tuple;    /* Flow tuple */
-	bool sentinel;                  /* Sentinel to check if a node is the head node */
+	uint32_t tr_addr_type;          /* Transform record the flow points to */
+	struct eip_flow_tbl *tbl;       /* Table the flow belongs to */
+};
+
+/*
+ * eip_flow_ht
+ * 	Flow table instance; replaced as a whole on resize
+ */
+struct eip_flow_ht {
+	struct hlist_head *sw_head;                     /* SW flow chains, one per bucket */
+	struct eip_flow_hw *hw_head;                    /* Pointer to HW flow in the flow table */
+	dma_addr_t hw_head_paddr;                       /* Physical address of the flow table */
+	struct eip_flow_hw *hw_coll;                    /* Collision records after the buckets */
+	dma_addr_t hw_coll_paddr;                       /* Physical address of collision records */
+	unsigned long *coll_map;                        /* Collision records in use */
+	size_t hw_sz;                                   /* Size of the HW allocation */
+	uint32_t order;                                 /* log2 of number of buckets */
+	uint32_t mask;                                  /* Bucket index mask */
+	uint32_t coll_max;                              /* Number of collision records */
+	uint32_t node_ver;                              /* Flow node and slot used by this instance */
+};
+
+/*
+ * eip_flow_tbl_stats
+ * 	Flow table statistics snapshot
+ */
+struct eip_flow_tbl_stats {
+	uint64_t alloc;                                 /* Counter for number of flows allocated */
+	uint64_t free;                                  /* Counter for number of flows freed */
+	uint64_t collision;                             /* Counter for total number of collisions */
+	uint64_t active_collision;                      /* Counter for total collisions that are active */
+	uint64_t fail;                                  /* Flows not added; duplicate or no collision record */
+	uint64_t resize;                                /* Number of times the table grew */
 };
 
 /*
  * eip_flow_tbl
  * 	Flow table
+ *
+ * Lookups are lockless under RCU. Add and delete take the resize lock shared
+ * and the lock of the bucket; resize takes the resize lock exclusively while
+ * it relinks all flows into the new instance.
  */
 struct eip_flow_tbl {
-	struct hlist_head sw_head[EIP_FLOW_MAX];        /* Pointer to SW flow object in the flow table */
-	struct eip_flow_hw *hw_head;                    /* Pointer to HW flow in the flow table */
-	dma_addr_t hw_head_paddr;                       /* Physical address of the flow table */
-	spinlock_t lock;                                /* Spinlock */
-	struct eip_flow_tbl_stats {
-		uint64_t alloc;                         /* Counter for number of flows allocated */
-		uint64_t free;                          /* Counter for number of flows freed */
-		uint64_t collision;                     /* Counter for total number of collisions */
-		uint64_t active_collision;              /* Counter for total collisions that are active */
+	struct eip_flow_ht __rcu *ht;                   /* Current table instance */
+	struct device *dev;                             /* DMA device; NULL for the software model */
+	void __iomem *base_addr;                        /* FLUE registers; NULL for the software model */
+	struct kmem_cache *cache;                       /* SW flow cache */
+	eip_flow_hash_t iv;                             /* Flow hash initial value */
+	rwlock_t resize_lock;                           /* Excludes writers during resize */
+	spinlock_t lock[EIP_FLOW_LOCKS];                /* Bucket locks */
+	struct work_struct resize_work;                 /* Grow the table */
+	struct mutex resize_mutex;                      /* Serializes resize and teardown */
+	atomic_t count;                                 /* Flows in the table */
+	struct dentry *dentry;                          /* Statistics debugfs file */
+	bool dying;                                     /* No further resize */
+	struct {
+		atomic64_t alloc;
+		atomic64_t free;
+		atomic64_t collision;
+		atomic64_t fail;
+		atomic64_t resize;
 	} stats;
-} ;
+};
 
 struct eip_flow *eip_flow_add(struct eip_flow_tuple *flow_tuple, struct eip_tr *tr);
 void eip_flow_del(struct eip_flow_tuple *flow_tuple, struct eip_tr *tr);
+uint32_t eip_flow_add_bulk(struct eip_flow_tuple *flow_tuple, struct eip_tr **tr, struct eip_flow **flow, uint32_t count);
+void eip_flow_del_bulk(struct eip_flow **flow, uint32_t count);
+struct eip_flow *eip_flow_lookup(struct eip_flow_tuple *flow_tuple);
+uint32_t eip_flow_get_index(struct eip_flow *flow);
+void eip_flow_get_stats(struct eip_flow_tbl *tbl, struct eip_flow_tbl_stats *stats);
 bool eip_flow_table_init(struct platform_device *pdev);
 void eip_flow_table_deinit(struct platform_device *pdev);
+void eip_flow_model_init(struct dentry *root);
 
 #endif /* __EIP_FLOW_H */
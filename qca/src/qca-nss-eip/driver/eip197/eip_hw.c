@@ -681,10 +681,13 @@ void eip_hw_deinit(struct platform_device *pdev)
 	/*
 	 * We just need to deinitialize DMA. Other HW register does not require any deinit.
 	 */
+	WRITE_ONCE(ep->la_active_cnt, 0);
 	for (i = 0; i < NR_CPUS; i++) {
 		eip_dma_la_deinit(&ep->la[i]);
 	}
 
+	eip_dma_steer_deinit(ep);
+
 	if (!ep->redirect_en) {
 		return;
 	}
@@ -759,6 +762,11 @@ int eip_hw_init(struct platform_device *pdev)
 			base_addr + EIP_HW_OCE_OPUE_PACKET_ID_CFG);
 
 
+	/*
+	 * Completion steering must be ready before any ring raises an interrupt.
+	 */
+	eip_dma_steer_init(ep);
+
 	/*
 	 * Initialize all lookaside DMA.
 	 */
@@ -806,6 +814,8 @@ int eip_hw_init(struct platform_device *pdev)
 			pr_err("%px: LA DMA initialization failed for cpu(%u)\n", pdev, tx_cpu);
 			goto fail_init;
 		}
+
+		ep->la_active[ep->la_active_cnt++] = dma;
 	}
 
 	/*
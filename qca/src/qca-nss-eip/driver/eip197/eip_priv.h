@@ -19,6 +19,7 @@
 
 #include <linux/platform_device.h>
 #include <linux/ip.h>
+#include <linux/llist.h>
 #include "../exports/eip.h"
 #include "eip_dma.h"
 #include "eip_hw.h"
@@ -93,6 +94,11 @@ struct eip_sw_desc {
 
 	uint16_t src_nsegs;		/* Source data segments */
 	uint16_t dst_nsegs;		/* Destination data segments */
+	uint16_t cpu;			/* Submitting CPU */
+	uint16_t cle_err;		/* Classification error for steered completion */
+	uint16_t tr_err;		/* Transform error for steered completion */
+	uint64_t tstamp;		/* Submission time in ns */
+	struct llist_node node;		/* Node in the steering queue of the submitting CPU */
 
 	eip_req_t req;			/* Request associated with desc */
 };
@@ -114,13 +120,14 @@ struct eip_pdev {
 	struct platform_device *pdev;		/* Device associated with the driver */
 	struct eip_dma la[NR_CPUS];		/* Lookaside DMA object per CPU */
 	struct eip_dma hy[NR_CPUS];		/* Hybrid DMA object per CPU */
+	struct eip_dma *la_active[NR_CPUS];	/* Configured lookaside DMA objects */
+	uint32_t la_active_cnt;			/* Number of configured lookaside DMA objects */
+	atomic_t la_sel;			/* Lookaside DMA selector for the next TR */
+	struct eip_dma_steer steer[NR_CPUS];	/* Completion steering per CPU */
 	struct kmem_cache *tr_cache;		/* Transform Record cache */
-	struct kmem_cache *flow_swcache;	/* Flow Record cache */
-	struct eip_flow_hw *flow_hwcache;       /* DMA memory for HW flow */
 	struct dentry *dentry;			/* Driver debugfs dentry */
 	void __iomem *dev_vaddr;		/* starting virtual address of device */
 	dma_addr_t dev_paddr;			/* starting physical address of device */
-	dma_addr_t hwcache_paddr;		/* Physical address for HW flow */
 	bool redirect_en;			/* Redirection / Hybrid mode is configured */
 	struct eip_flow_tbl flow_table;		/* Flow table */
 };
@@ -189,7 +189,7 @@ static void eip_tr_inval(struct work_struct *work)
 	 * There is potential chance that DMA fails to schedule this request during peak
 	 * traffic. In that case we need to reschedule the invalidation.
 	 */
-	dma = &ctx->ep->la[smp_processor_id()];
+	dma = eip_dma_la_select(ctx->ep, tr);
 
 	if (eip_dma_tx_sg(dma, sw, &sg, &sg)) {
 		pr_warn("%px: DMA is busy for invalidation schedule\n", tr);
@@ -290,6 +290,7 @@ struct eip_tr *eip_tr_alloc(struct eip_ctx *ctx, struct eip_tr_info *info)
 	 */
 	tr->ctx = eip_ctx_ref(ctx);
 	tr->svc = ctx->svc;
+	tr->dma_sel = atomic_inc_return(&ctx->ep->la_sel);
 	kref_init(&tr->ref);
 	INIT_DELAYED_WORK(&tr->inval_work, eip_tr_inval);
 
@@ -326,7 +327,7 @@ struct eip_tr *eip_tr_alloc(struct eip_ctx *ctx, struct eip_tr_info *info)
 			pr_warn("%px: Failed to add the outer flow : src ip(%px) dst ip(%px) protocol(%d) \n",
 				       	ctx, ftuple.src_ip,ftuple.dst_ip,ftuple.ip_proto);
 		} else {
-			pr_debug("Flow added at index %u , sentinel value %i\n", EIP_FLOW_HASH_IDX(tr->flow->hash), tr->flow->sentinel);
+			pr_debug("Flow added at index %u\n", eip_flow_get_index(tr->flow));
 		}
 
 	}
@@ -175,6 +175,7 @@ struct eip_tr {
 	uint32_t tr_flags;			/* Flags for TR */
 	uint16_t iv_len;			/* IV length for configured algo */
 	uint16_t digest_len;			/* HMAC length for configured algo */
+	uint32_t dma_sel;			/* Lookaside DMA selector for SA affinity */
 
 	struct eip_tr_stats __percpu *stats_pcpu;	/* Statistisc */
 	struct kref ref;			/* Reference incremented per packet */
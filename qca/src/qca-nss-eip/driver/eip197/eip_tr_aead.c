@@ -566,7 +566,7 @@ int eip_tr_aead_encauth(struct eip_tr *tr, struct aead_request *req)
 	sw->hw_svc = EIP_HW_CMD_HWSERVICE_LAC;
 	sw->req = req;
 
-	dma = &ctx->dma[smp_processor_id()];
+	dma = eip_dma_la_select(ctx->ep, tr);
 
 	status = eip_dma_tx_sg(dma, sw, req->src, req->dst);
 	if (status < 0) {
@@ -638,7 +638,7 @@ int eip_tr_aead_authdec(struct eip_tr *tr, struct aead_request *req)
 	sw->hw_svc = EIP_HW_CMD_HWSERVICE_LAC;
 	sw->req = req;
 
-	dma = &ctx->dma[smp_processor_id()];
+	dma = eip_dma_la_select(ctx->ep, tr);
 
 	status = eip_dma_tx_sg(dma, sw, req->src, req->dst);
 	if (status < 0) {
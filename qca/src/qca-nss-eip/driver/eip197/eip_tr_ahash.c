@@ -448,7 +448,7 @@ bool eip_tr_ahash_key2digest(struct eip_tr *tr, struct eip_tr_info *info, const
 	 * There is potential chance that DMA fails to schedule this request during peak
 	 * traffic. In that case we need to reschedule the digest calculation.
 	 */
-	dma = &ctx->ep->la[smp_processor_id()];
+	dma = eip_dma_la_select(ctx->ep, tr);
 
 retry:
 	if (eip_dma_tx_sg(dma, sw, &sg, &sg)) {
@@ -593,7 +593,7 @@ int eip_tr_ahash_auth(struct eip_tr *tr, struct ahash_request *req, struct scatt
 	sw->hw_svc = EIP_HW_CMD_HWSERVICE_LAC;
 	sw->req = req;
 
-	dma = &ctx->dma[smp_processor_id()];
+	dma = eip_dma_la_select(ctx->ep, tr);
 
 	status = eip_dma_tx_sg(dma, sw, req->src, res);
 	if (status < 0) {
@@ -369,7 +369,7 @@ int eip_tr_skcipher_enc(struct eip_tr *tr, struct skcipher_request *req)
 	sw->hw_svc = EIP_HW_CMD_HWSERVICE_LAC;
 	sw->req = req;
 
-	dma = &ctx->dma[smp_processor_id()];
+	dma = eip_dma_la_select(ctx->ep, tr);
 
 	status = eip_dma_tx_sg(dma, sw, req->src, req->dst);
 	if (status < 0) {
@@ -441,7 +441,7 @@ int eip_tr_skcipher_dec(struct eip_tr *tr, struct skcipher_request *req)
 	sw->hw_svc = EIP_HW_CMD_HWSERVICE_LAC;
 	sw->req = req;
 
-	dma = &ctx->dma[smp_processor_id()];
+	dma = eip_dma_la_select(ctx->ep, tr);
 
 	status = eip_dma_tx_sg(dma, sw, req->src, req->dst);
 	if (status < 0) {
@@ -16,6 +16,7 @@
 #define _NSS_MACSEC_MIB_H_
 
 #include "nss_macsec_types.h"
+#include "nss_macsec_secy.h"
 
 typedef struct {
 	u64 protected_pkts;
@@ -74,6 +75,15 @@ typedef struct {
 	u64 ecc_error_pkts;
 } fal_rx_mib_t;
 
+typedef struct {
+	u32 sc_num;
+	fal_tx_mib_t tx;
+	fal_rx_mib_t rx;
+	fal_tx_sc_mib_t tx_sc[FAL_SECY_SC_MAX_NUM];
+	fal_tx_sa_mib_t tx_sa[FAL_SECY_SC_MAX_NUM][FAL_AN_MAX + 1];
+	fal_rx_sa_mib_t rx_sa[FAL_SECY_SC_MAX_NUM][FAL_AN_MAX + 1];
+} fal_secy_mib_t;
+
 /**
 * @param[in] secy_id
 * @param[in] channel
@@ -142,4 +152,15 @@ u32 nss_macsec_secy_rx_mib_clear(u32 secy_id);
 **/
 u32 nss_macsec_secy_rx_sa_mib_clear(u32 secy_id, u32 channel, u32 an);
 
+/**
+* Snapshot of SecY, SC and SA counters of channels [0, sc_num), taken with
+* one batch of requests instead of one request per counter block.
+* Blocks that could not be read are zero, the first failure is returned.
+* @param[in] secy_id
+* @param[in] sc_num
+* @param[out] pmib
+**/
+u32 nss_macsec_secy_mib_get_all(u32 secy_id, u32 sc_num,
+				fal_secy_mib_t *pmib);
+
 #endif /* _NSS_MACSEC_MIB_H_ */
@@ -41,4 +41,35 @@ struct sdk_msg_header {
 	unsigned short reserved1;
 } __attribute__ ((packed));
 
+#ifndef __KERNEL__
+/*
+ * One request of a batch. data is a complete netlink message buffer and
+ * receives the reply in place; ret is the status returned by the driver.
+ */
+struct nss_macsec_sdk_msg {
+	int msg_type;
+	unsigned char *data;
+	int data_len;
+	int ret;
+};
+
+int nss_macsec_sdk_netlink_msg(int msg_type, unsigned char *data, int data_len,
+			       int netlink_key);
+/* returns the number of requests that succeeded */
+int nss_macsec_sdk_netlink_batch(struct nss_macsec_sdk_msg *msgs, int num,
+				 int netlink_key);
+void nss_macsec_sdk_netlink_close(void);
+
+/*
+ * Between begin and end, FAL calls of this thread are queued and sent
+ * together; each returns SDK_RET_SUCCESS at once. Calls with output
+ * parameters (get) are not queued: the queue is sent first and the get
+ * runs at once, returning its own status. end returns the status of the
+ * first failed queued call and its position among the queued calls in
+ * *failed_idx, or SDK_RET_SUCCESS and -1.
+ */
+int nss_macsec_sdk_batch_begin(void);
+int nss_macsec_sdk_batch_end(int *failed_idx);
+#endif
+
 #endif
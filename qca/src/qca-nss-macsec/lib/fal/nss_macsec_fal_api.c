@@ -12,6 +12,7 @@
  * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#define _GNU_SOURCE
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,6 +20,7 @@
 #include <sys/socket.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #include <linux/if_ether.h>
@@ -41,111 +43,418 @@
 #define SDK_MSG_HEADER(p)      ((void*)(((char*)p) + NLMSG_LENGTH(0)))
 #define SDK_MSG_DATA(p)      ((void*)(((char*)p) + NLMSG_LENGTH(0) + SDK_MSG_HDRLEN))
 
+#define SDK_NETLINK_TIMEOUT	3000	/* ms */
+#define SDK_NETLINK_RCVBUF	(256 * 1024)
+#define SDK_BATCH_SEND_MAX	32	/* messages per sendmmsg() */
+#define SDK_BATCH_QUEUE_MAX	256	/* deferred messages before a flush */
+
 #define DEBUG_SDK_NETLINK
 
-int nss_macsec_sdk_netlink_msg(int msg_type, unsigned char *data, int data_len,
-			       int netlink_key)
+/*
+ * One netlink socket per process, shared by all threads. It is reopened
+ * after fork() and after a timeout, so a late reply is never taken as the
+ * answer to a later request.
+ */
+struct sdk_netlink_channel {
+	pthread_mutex_t lock;
+	int sock_fd;
+	int netlink_key;
+	pid_t pid;
+	unsigned int port_id;
+	unsigned int seq;
+};
+
+static struct sdk_netlink_channel sdk_chan = {
+	PTHREAD_MUTEX_INITIALIZER, -1, 0, 0, 0, 0
+};
+
+/*
+ * Messages deferred between nss_macsec_sdk_batch_begin() and
+ * nss_macsec_sdk_batch_end(), kept per thread.
+ */
+struct sdk_batch_queue {
+	int netlink_key;
+	int num;
+	int done;
+	int failed_idx;
+	int failed_ret;
+	struct nss_macsec_sdk_msg msgs[SDK_BATCH_QUEUE_MAX];
+};
+
+static __thread struct sdk_batch_queue *sdk_batch;
+
+static void sdk_chan_close(void)
 {
-	struct sockaddr_nl src_addr, dest_addr;
-	struct nlmsghdr *nlh = NULL;
-	socklen_t fromlen;
-	int ret = SDK_RET_UNKOWN_ERR;
+	if (sdk_chan.sock_fd >= 0)
+		close(sdk_chan.sock_fd);
+	sdk_chan.sock_fd = -1;
+}
+
+static int sdk_chan_open(int netlink_key)
+{
+	struct sockaddr_nl src_addr;
+	socklen_t addr_len = sizeof(src_addr);
+	int rcvbuf = SDK_NETLINK_RCVBUF;
+	pid_t pid = getpid();
 	int sock_fd;
-	struct sdk_msg_header *msg_header;
-	static pid_t myPid = 0;
 
-	/* Do it only once per context, save a system call */
-	if (!myPid)
-		myPid = getpid();
+	if (sdk_chan.sock_fd >= 0 && sdk_chan.pid == pid &&
+	    sdk_chan.netlink_key == netlink_key)
+		return 0;
 
-	do {
-		sock_fd = socket(AF_NETLINK, SOCK_RAW, netlink_key);
-		if (sock_fd <= 0) {
+	sdk_chan_close();
+
+	sock_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, netlink_key);
+	if (sock_fd < 0) {
 #ifdef DEBUG_SDK_NETLINK
-			printf("netlink socket create failed\n");
+		printf("netlink socket create failed\n");
 #endif
-			break;
-		}
+		return -1;
+	}
 
-		/* Set nonblock. */
-		if (fcntl
-		    (sock_fd, F_SETFL, fcntl(sock_fd, F_GETFL) | O_NONBLOCK)) {
+	/* Let the kernel pick a unique port id, the process may own others */
+	memset(&src_addr, 0, sizeof(src_addr));
+	src_addr.nl_family = AF_NETLINK;
+	if (bind(sock_fd, (struct sockaddr *)&src_addr, sizeof(src_addr)) ||
+	    getsockname(sock_fd, (struct sockaddr *)&src_addr, &addr_len)) {
 #ifdef DEBUG_SDK_NETLINK
-			perror("fcntl():");
+		perror("bind():");
 #endif
-			break;
-		}
+		close(sock_fd);
+		return -1;
+	}
 
-		fromlen = sizeof(src_addr);
-		memset(&src_addr, 0, sizeof(src_addr));
-		src_addr.nl_family = AF_NETLINK;
-		src_addr.nl_pid = myPid;	/* self pid */
-		src_addr.nl_groups = 0;	/* not in mcast groups */
-
-		bind(sock_fd, (struct sockaddr *)&src_addr, sizeof(src_addr));
-		memset(&dest_addr, 0, sizeof(dest_addr));
-		dest_addr.nl_family = AF_NETLINK;
-		dest_addr.nl_pid = 0;	/* For Linux Kernel */
-		dest_addr.nl_groups = 0;	/* unicast */
-		nlh = (struct nlmsghdr *)data;
+	/* Replies of a whole batch queue up before the first one is read */
+	setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	sdk_chan.sock_fd = sock_fd;
+	sdk_chan.netlink_key = netlink_key;
+	sdk_chan.pid = pid;
+	sdk_chan.port_id = src_addr.nl_pid;
+	return 0;
+}
+
+/*
+ * Send up to SDK_BATCH_SEND_MAX messages with one system call and collect
+ * their replies in order. Every reply is written over its request buffer.
+ */
+static void sdk_chan_xfer(struct nss_macsec_sdk_msg *msgs, int num)
+{
+	struct mmsghdr mmsg[SDK_BATCH_SEND_MAX];
+	struct iovec iov[SDK_BATCH_SEND_MAX];
+	struct sockaddr_nl dest_addr;
+	struct nlmsghdr *nlh;
+	struct sdk_msg_header *msg_header;
+	struct pollfd pollfd;
+	unsigned int first_seq = sdk_chan.seq + 1;
+	int i, ret, sent = 0, done = 0;
+
+	memset(&dest_addr, 0, sizeof(dest_addr));
+	dest_addr.nl_family = AF_NETLINK;
+	dest_addr.nl_pid = 0;	/* For Linux Kernel */
+	dest_addr.nl_groups = 0;	/* unicast */
+
+	memset(mmsg, 0, sizeof(mmsg));
+	for (i = 0; i < num; i++) {
+		nlh = (struct nlmsghdr *)msgs[i].data;
 		/* Fill the netlink message header */
-		nlh->nlmsg_type = msg_type;
-		nlh->nlmsg_len = NLMSG_SPACE(SDK_MSG_HDRLEN + data_len);
-		nlh->nlmsg_pid = myPid;	/* self pid */
+		nlh->nlmsg_type = msgs[i].msg_type;
+		nlh->nlmsg_len = NLMSG_SPACE(SDK_MSG_HDRLEN + msgs[i].data_len);
+		nlh->nlmsg_pid = sdk_chan.port_id;
 		nlh->nlmsg_flags = 0;
+		nlh->nlmsg_seq = ++sdk_chan.seq;
+		msgs[i].ret = SDK_RET_UNKOWN_ERR;
+
+		iov[i].iov_base = nlh;
+		iov[i].iov_len = nlh->nlmsg_len;
+		mmsg[i].msg_hdr.msg_name = &dest_addr;
+		mmsg[i].msg_hdr.msg_namelen = sizeof(dest_addr);
+		mmsg[i].msg_hdr.msg_iov = &iov[i];
+		mmsg[i].msg_hdr.msg_iovlen = 1;
+	}
 
-		if (sendto(sock_fd,
-			   (void *)nlh,
-			   nlh->nlmsg_len,
-			   0,
-			   (struct sockaddr *)&dest_addr,
-			   sizeof(struct sockaddr_nl)) <= 0) {
+	while (sent < num) {
+		ret = sendmmsg(sdk_chan.sock_fd, &mmsg[sent], num - sent, 0);
+		if (ret <= 0) {
 #ifdef DEBUG_SDK_NETLINK
 			printf("netlink socket send failed\n");
 #endif
 			break;
 		}
+		sent += ret;
+	}
 
-		struct pollfd pollfd = {
-			sock_fd,
-			POLLIN,
-			0
-		};
-
-		if (poll(&pollfd, 1, 3000) <= 0) {	/* timeout:3s */
+	pollfd.fd = sdk_chan.sock_fd;
+	pollfd.events = POLLIN;
+	while (done < sent) {
+		pollfd.revents = 0;
+		if (poll(&pollfd, 1, SDK_NETLINK_TIMEOUT) <= 0) {
 #ifdef DEBUG_SDK_NETLINK
 			perror("poll():");
 #endif
 			break;
 		}
 
-		if (recvfrom(sock_fd,
-			     (void *)nlh,
-			     NLMSG_SPACE(SDK_MSG_HDRLEN + data_len),
-			     MSG_WAITALL,
-			     (struct sockaddr *)&src_addr, &fromlen) <= 0) {
+		nlh = (struct nlmsghdr *)msgs[done].data;
+		ret = recv(sdk_chan.sock_fd, nlh, iov[done].iov_len, MSG_DONTWAIT);
+		if (ret <= 0) {
 #ifdef DEBUG_SDK_NETLINK
 			printf("netlink socket receive failed\n");
 #endif
 			break;
 		}
-		msg_header = (struct sdk_msg_header *)NLMSG_DATA(nlh);
 
-		ret = msg_header->ret;
+		/* Skip a stray reply if the kernel echoes sequence numbers */
+		if (nlh->nlmsg_seq && nlh->nlmsg_seq != first_seq + done)
+			continue;
+
+		msg_header = (struct sdk_msg_header *)NLMSG_DATA(nlh);
+		msgs[done].ret = msg_header->ret;
 
 #ifdef DEBUG_SDK_NETLINK
-		if (ret != SDK_RET_SUCCESS)
-			printf("netlink socket status failed %d\n", ret);
+		if (msgs[done].ret != SDK_RET_SUCCESS)
+			printf("netlink socket status failed %d\n", msgs[done].ret);
 #endif
+		done++;
+	}
 
-	} while (0);
+	if (done < num)
+		sdk_chan_close();
+}
 
-	if (sock_fd > 0)
-		close(sock_fd);
+int nss_macsec_sdk_netlink_batch(struct nss_macsec_sdk_msg *msgs, int num,
+				 int netlink_key)
+{
+	int i, chunk, ok = 0;
+
+	pthread_mutex_lock(&sdk_chan.lock);
+
+	for (i = 0; i < num; i += chunk) {
+		chunk = num - i;
+		if (chunk > SDK_BATCH_SEND_MAX)
+			chunk = SDK_BATCH_SEND_MAX;
+
+		if (sdk_chan_open(netlink_key)) {
+			for (; i < num; i++)
+				msgs[i].ret = SDK_RET_UNKOWN_ERR;
+			break;
+		}
+
+		sdk_chan_xfer(&msgs[i], chunk);
+	}
 
+	pthread_mutex_unlock(&sdk_chan.lock);
+
+	for (i = 0; i < num; i++) {
+		if (msgs[i].ret == SDK_RET_SUCCESS)
+			ok++;
+	}
+	return ok;
+}
+
+void nss_macsec_sdk_netlink_close(void)
+{
+	pthread_mutex_lock(&sdk_chan.lock);
+	sdk_chan_close();
+	pthread_mutex_unlock(&sdk_chan.lock);
+}
+
+/*
+ * FAL calls that return data in their request buffer. They cannot be
+ * queued, since the caller reads the reply as soon as the call returns.
+ */
+static const unsigned char sdk_fal_cmd_has_output[] = {
+	[NSS_MACSEC_SECY_INTERRUPT_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_INTERRUPT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_MIB_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SA_MIB_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_MIB_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SA_MIB_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_MIB_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_REG_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_CTL_FILT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_PRC_LUT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_VALIDATE_FRAME_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_REPLAY_PROTECT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_ANTI_REPLAY_WINDOW_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_IN_USED_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_AN_ROLL_OVER_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_START_STOP_TIME_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SA_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SA_NEXT_PN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SAK_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SA_IN_USED_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SA_START_STOP_TIME_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_PN_THRESHOLD_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_REPLAY_PROTECT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_VALIDATE_FRAME_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_REG_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_DROP_SC_SA_INVLID_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_UNMATCHED_USE_SC_0_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_GCM_START_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_DROP_CLASS_MISS_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_DROP_KAY_PKT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_CTL_FILT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_CLASS_LUT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_AN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_AN_ROLL_OVER_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_IN_USED_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_TCI_7_2_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_CONFIDENTIALITY_OFFSET_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_PROTECT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_SCI_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_START_STOP_TIME_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SA_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SA_NEXT_PN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SA_IN_USED_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SA_START_STOP_TIME_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SAK_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_QTAG_PARSE_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_STAG_PARSE_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_PN_THRESHOLD_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_SC_SA_MAPPING_MODE_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_CONTROLLED_PORT_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_IP_VERSION_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_CIPHER_SUITE_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_MTU_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_ID_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_XPN_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SA_NEXT_XPN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SA_NEXT_XPN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SC_SSCI_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SC_SSCI_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_SA_KI_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_SA_KI_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_FLOW_CONTROL_EN_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_SPECIAL_PKT_CTRL_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_UDF_ETHTYPE_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_LOOPBACK_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_UDF_FILT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_UDF_FILT_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_UDF_UFILT_CFG_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_RX_UDF_UFILT_CFG_GET_CMD] = 1,
+	[NSS_MACSEC_SECY_TX_UDF_CFILT_CFG_GET_CMD] = 1,
+};
+
+static int sdk_msg_has_output(unsigned char *data)
+{
+	struct sdk_msg_header *msg_header =
+	    (struct sdk_msg_header *)SDK_MSG_HEADER(data);
+
+	if (msg_header->cmd_type != SDK_FAL_CMD)
+		return 1;
+
+	return msg_header->sub_type >= sizeof(sdk_fal_cmd_has_output) ||
+	       sdk_fal_cmd_has_output[msg_header->sub_type];
+}
+
+static void sdk_batch_flush(struct sdk_batch_queue *q)
+{
+	int i;
+
+	if (!q->num)
+		return;
+
+	nss_macsec_sdk_netlink_batch(q->msgs, q->num, q->netlink_key);
+
+	for (i = 0; i < q->num; i++) {
+		if (q->msgs[i].ret != SDK_RET_SUCCESS && q->failed_idx < 0) {
+			q->failed_idx = q->done + i;
+			q->failed_ret = q->msgs[i].ret;
+		}
+		free(q->msgs[i].data);
+	}
+
+	q->done += q->num;
+	q->num = 0;
+}
+
+static int sdk_batch_queue_msg(struct sdk_batch_queue *q, int msg_type,
+			       unsigned char *data, int data_len,
+			       int netlink_key)
+{
+	struct nss_macsec_sdk_msg *msg;
+	int size = NLMSG_SPACE(SDK_MSG_HDRLEN + data_len);
+
+	if (q->num && q->netlink_key != netlink_key)
+		sdk_batch_flush(q);
+	if (q->num == SDK_BATCH_QUEUE_MAX)
+		sdk_batch_flush(q);
+
+	msg = &q->msgs[q->num];
+	msg->data = malloc(size);
+	if (!msg->data)
+		return SDK_RET_UNKOWN_ERR;
+
+	memcpy(msg->data, data, size);
+	msg->msg_type = msg_type;
+	msg->data_len = data_len;
+	msg->ret = SDK_RET_UNKOWN_ERR;
+	q->netlink_key = netlink_key;
+	q->num++;
+
+	return SDK_RET_SUCCESS;
+}
+
+int nss_macsec_sdk_batch_begin(void)
+{
+	if (sdk_batch)
+		return SDK_RET_PARAM_ERR;
+
+	sdk_batch = calloc(1, sizeof(*sdk_batch));
+	if (!sdk_batch)
+		return SDK_RET_UNKOWN_ERR;
+
+	sdk_batch->failed_idx = -1;
+	sdk_batch->failed_ret = SDK_RET_SUCCESS;
+	return SDK_RET_SUCCESS;
+}
+
+int nss_macsec_sdk_batch_end(int *failed_idx)
+{
+	struct sdk_batch_queue *q = sdk_batch;
+	int ret;
+
+	if (!q)
+		return SDK_RET_PARAM_ERR;
+
+	sdk_batch_flush(q);
+
+	if (failed_idx)
+		*failed_idx = q->failed_idx;
+	ret = q->failed_ret;
+
+	free(q);
+	sdk_batch = NULL;
 	return ret;
 }
 
+int nss_macsec_sdk_netlink_msg(int msg_type, unsigned char *data, int data_len,
+			       int netlink_key)
+{
+	struct nss_macsec_sdk_msg msg;
+
+	if (sdk_batch) {
+		if (!sdk_msg_has_output(data))
+			return sdk_batch_queue_msg(sdk_batch, msg_type, data,
+						   data_len, netlink_key);
+
+		/* Getters see the effect of the calls queued before them */
+		sdk_batch_flush(sdk_batch);
+	}
+
+	msg.msg_type = msg_type;
+	msg.data = data;
+	msg.data_len = data_len;
+	msg.ret = SDK_RET_UNKOWN_ERR;
+
+	nss_macsec_sdk_netlink_batch(&msg, 1, netlink_key);
+	return msg.ret;
+}
+
 u32 nss_macsec_secy_interrupt_en_get(u32 secy_id, fal_interrupt_en_t *p_int_en)
 {
 	unsigned char
@@ -474,6 +783,150 @@ u32 nss_macsec_secy_rx_mib_get(u32 secy_id, fal_rx_mib_t *pmib)
 	return ret;
 }
 
+/*
+ * Largest MIB get command, every message of a snapshot uses a slot this big
+ */
+union sdk_mib_get_cmd {
+	struct nss_macsec_secy_tx_mib_get_cmd tx;
+	struct nss_macsec_secy_rx_mib_get_cmd rx;
+	struct nss_macsec_secy_tx_sc_mib_get_cmd tx_sc;
+	struct nss_macsec_secy_tx_sa_mib_get_cmd tx_sa;
+	struct nss_macsec_secy_rx_sa_mib_get_cmd rx_sa;
+};
+
+#define SDK_MIB_SLOT_SIZE NLMSG_ALIGN(SDK_MSG_SIZE(sizeof(union sdk_mib_get_cmd)))
+
+static void *sdk_mib_msg_init(struct nss_macsec_sdk_msg *msg,
+			      unsigned char *buf, u32 sub_type, int data_len)
+{
+	struct sdk_msg_header *msg_header =
+	    (struct sdk_msg_header *)SDK_MSG_HEADER(buf);
+
+	msg_header->version = SDK_MSG_VER;
+	msg_header->cmd_type = SDK_FAL_CMD;
+	msg_header->sub_type = sub_type;
+	msg_header->buf_len = data_len;
+
+	msg->msg_type = SDK_CALL_MSG;
+	msg->data = buf;
+	msg->data_len = data_len;
+	msg->ret = SDK_RET_UNKOWN_ERR;
+
+	return SDK_MSG_DATA(buf);
+}
+
+u32 nss_macsec_secy_mib_get_all(u32 secy_id, u32 sc_num,
+				fal_secy_mib_t *pmib)
+{
+	int num = 2 + sc_num * (1 + 2 * (FAL_AN_MAX + 1));
+	struct nss_macsec_sdk_msg *msgs;
+	unsigned char *bufs;
+	union sdk_mib_get_cmd *param;
+	u32 channel, an;
+	int i = 0, ret = SDK_RET_SUCCESS;
+
+	if (!pmib || sc_num > FAL_SECY_SC_MAX_NUM)
+		return SDK_RET_PARAM_ERR;
+
+	msgs = calloc(num, sizeof(*msgs));
+	bufs = calloc(num, SDK_MIB_SLOT_SIZE);
+	if (!msgs || !bufs) {
+		free(msgs);
+		free(bufs);
+		return SDK_RET_UNKOWN_ERR;
+	}
+
+	param = sdk_mib_msg_init(&msgs[i], bufs + i * SDK_MIB_SLOT_SIZE,
+				 NSS_MACSEC_SECY_TX_MIB_GET_CMD,
+				 sizeof(struct nss_macsec_secy_tx_mib_get_cmd));
+	param->tx.secy_id = secy_id;
+	i++;
+
+	param = sdk_mib_msg_init(&msgs[i], bufs + i * SDK_MIB_SLOT_SIZE,
+				 NSS_MACSEC_SECY_RX_MIB_GET_CMD,
+				 sizeof(struct nss_macsec_secy_rx_mib_get_cmd));
+	param->rx.secy_id = secy_id;
+	i++;
+
+	for (channel = 0; channel < sc_num; channel++) {
+		param = sdk_mib_msg_init(&msgs[i],
+			bufs + i * SDK_MIB_SLOT_SIZE,
+			NSS_MACSEC_SECY_TX_SC_MIB_GET_CMD,
+			sizeof(struct nss_macsec_secy_tx_sc_mib_get_cmd));
+		param->tx_sc.secy_id = secy_id;
+		param->tx_sc.channel = channel;
+		i++;
+
+		for (an = 0; an <= FAL_AN_MAX; an++) {
+			param = sdk_mib_msg_init(&msgs[i],
+				bufs + i * SDK_MIB_SLOT_SIZE,
+				NSS_MACSEC_SECY_TX_SA_MIB_GET_CMD,
+				sizeof(struct nss_macsec_secy_tx_sa_mib_get_cmd));
+			param->tx_sa.secy_id = secy_id;
+			param->tx_sa.channel = channel;
+			param->tx_sa.an = an;
+			i++;
+
+			param = sdk_mib_msg_init(&msgs[i],
+				bufs + i * SDK_MIB_SLOT_SIZE,
+				NSS_MACSEC_SECY_RX_SA_MIB_GET_CMD,
+				sizeof(struct nss_macsec_secy_rx_sa_mib_get_cmd));
+			param->rx_sa.secy_id = secy_id;
+			param->rx_sa.channel = channel;
+			param->rx_sa.an = an;
+			i++;
+		}
+	}
+
+	/* Like any getter, read after the calls queued before it */
+	if (sdk_batch)
+		sdk_batch_flush(sdk_batch);
+	nss_macsec_sdk_netlink_batch(msgs, num, NETLINK_SDK);
+
+	/* Counters that could not be read are reported as zero */
+	memset(pmib, 0, sizeof(*pmib));
+	pmib->sc_num = sc_num;
+	for (i = 0; i < num; i++) {
+		param = SDK_MSG_DATA(msgs[i].data);
+		if (msgs[i].ret != SDK_RET_SUCCESS) {
+			if (ret == SDK_RET_SUCCESS)
+				ret = msgs[i].ret;
+			continue;
+		}
+
+		switch (((struct sdk_msg_header *)
+			 SDK_MSG_HEADER(msgs[i].data))->sub_type) {
+		case NSS_MACSEC_SECY_TX_MIB_GET_CMD:
+			pmib->tx = param->tx.pmib;
+			break;
+		case NSS_MACSEC_SECY_RX_MIB_GET_CMD:
+			pmib->rx = param->rx.pmib;
+			break;
+		case NSS_MACSEC_SECY_TX_SC_MIB_GET_CMD:
+			if (param->tx_sc.channel < sc_num)
+				pmib->tx_sc[param->tx_sc.channel] =
+				    param->tx_sc.pmib;
+			break;
+		case NSS_MACSEC_SECY_TX_SA_MIB_GET_CMD:
+			if (param->tx_sa.channel < sc_num &&
+			    param->tx_sa.an <= FAL_AN_MAX)
+				pmib->tx_sa[param->tx_sa.channel]
+				    [param->tx_sa.an] = param->tx_sa.pmib;
+			break;
+		case NSS_MACSEC_SECY_RX_SA_MIB_GET_CMD:
+			if (param->rx_sa.channel < sc_num &&
+			    param->rx_sa.an <= FAL_AN_MAX)
+				pmib->rx_sa[param->rx_sa.channel]
+				    [param->rx_sa.an] = param->rx_sa.pmib;
+			break;
+		}
+	}
+
+	free(msgs);
+	free(bufs);
+	return ret;
+}
+
 u32 nss_macsec_secy_tx_mib_clear(u32 secy_id)
 {
 	unsigned char
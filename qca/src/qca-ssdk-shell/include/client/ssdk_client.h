@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2021-2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT
+ * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _SSDK_CLIENT_H_
+#define _SSDK_CLIENT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif                          /* __cplusplus */
+
+#include <stdint.h>
+
+/*
+ * Protocol of the "ssdk_sh -d" command socket. A request is a header
+ * followed by len bytes of shell command, exactly as it would be typed at
+ * the ssdk_sh prompt. The reply is a header carrying the command's return
+ * code followed by len bytes of payload:
+ *  - SSDK_CLIENT_FMT_TEXT: the text ssdk_sh would have printed;
+ *  - SSDK_CLIENT_FMT_BIN: the raw output parameters of the API, in
+ *    parameter order, each padded to a multiple of sizeof(unsigned long).
+ *    Shell-only commands return no binary payload.
+ */
+#define SSDK_CLIENT_SOCK_PATH   "/var/run/ssdk_sh.sock"
+#define SSDK_CLIENT_MAGIC       0x5344534b
+#define SSDK_CLIENT_FMT_TEXT    0
+#define SSDK_CLIENT_FMT_BIN     1
+#define SSDK_CLIENT_CMD_MAX     1024
+#define SSDK_CLIENT_REPLY_MAX   (1024 * 1024)
+
+    typedef struct
+    {
+        uint32_t magic;
+        uint32_t format;
+        int32_t  rtn;
+        uint32_t len;
+    } ssdk_client_hdr_t;
+
+    int
+    ssdk_client_open(const char *path);
+
+    void
+    ssdk_client_close(int fd);
+
+    int
+    ssdk_client_cmd(int fd, uint32_t format, const char *cmd, int32_t *rtn,
+                    void *buf, uint32_t *len);
+
+#ifdef __cplusplus
+}
+#endif                          /* __cplusplus */
+#endif                          /* _SSDK_CLIENT_H_ */
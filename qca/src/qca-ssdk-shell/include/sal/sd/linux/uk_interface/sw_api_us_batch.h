@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _SW_API_US_BATCH_H
+#define _SW_API_US_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif                          /* __cplusplus */
+
+#include "sw.h"
+#include "sw_api.h"
+
+/* Number of calls handed to the kernel per send */
+#define SW_UK_BATCH_MAX 32
+
+    /*
+     * One API invocation of a batch. value[] is laid out as for
+     * sw_uk_exec(): api id, pointer to rtn, then the parameters.
+     */
+    typedef struct
+    {
+        unsigned long value[SW_MAX_API_PARAM];
+        unsigned long rtn;
+    } sw_uk_call_t;
+
+    sw_error_t
+    sw_uk_if_batch(unsigned long *arg_val[], a_uint32_t num);
+
+    sw_error_t
+    sw_uk_call_set(sw_uk_call_t * call, a_uint32_t api_id, ...);
+
+    sw_error_t
+    sw_uk_exec_batch(sw_uk_call_t * call, a_uint32_t num);
+
+#ifdef IN_MIB
+#include "fal_mib.h"
+
+    sw_error_t
+    fal_get_mib_info_bulk(a_uint32_t dev_id, const fal_port_t * port_id,
+                          a_uint32_t num, fal_mib_info_t * mib_info,
+                          sw_error_t * port_rv);
+
+    sw_error_t
+    fal_get_xgmib_info_bulk(a_uint32_t dev_id, const fal_port_t * port_id,
+                            a_uint32_t num, fal_xgmib_info_t * mib_info,
+                            sw_error_t * port_rv);
+#endif
+
+#ifdef IN_FDB
+#include "fal_fdb.h"
+
+    sw_error_t
+    fal_fdb_entry_getnext_bulk(a_uint32_t dev_id, fal_fdb_entry_t * entry,
+                               a_uint32_t max, a_uint32_t * num);
+#endif
+
+#ifdef __cplusplus
+}
+#endif                          /* __cplusplus */
+#endif                          /* _SW_API_US_BATCH_H */
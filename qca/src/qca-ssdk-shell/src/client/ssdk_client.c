@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2021-2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT
+ * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Client side of the "ssdk_sh -d" command socket. It only depends on libc
+ * so that agents can link it without pulling in the SSDK user library.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ssdk_client.h"
+
+static int
+ssdk_client_xfer(int fd, void *buf, uint32_t len, int is_send)
+{
+    char *p = buf;
+    ssize_t ret;
+
+    while (len)
+    {
+        if (is_send)
+            ret = send(fd, p, len, MSG_NOSIGNAL);
+        else
+            ret = recv(fd, p, len, 0);
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+
+        p += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+int
+ssdk_client_open(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!path)
+        path = SSDK_CLIENT_SOCK_PATH;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void
+ssdk_client_close(int fd)
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+/*
+ * Run one command. On entry *len is the size of buf, on return it is the
+ * size of the payload the daemon sent; payload beyond the buffer is
+ * dropped. Returns 0 when a reply was received, -1 on a transport error,
+ * after which the connection should be closed.
+ */
+int
+ssdk_client_cmd(int fd, uint32_t format, const char *cmd, int32_t *rtn,
+                void *buf, uint32_t *len)
+{
+    ssdk_client_hdr_t hdr;
+    char drop[256];
+    uint32_t size, copy, left;
+
+    size = strlen(cmd);
+    if (size >= SSDK_CLIENT_CMD_MAX)
+        return -1;
+
+    hdr.magic  = SSDK_CLIENT_MAGIC;
+    hdr.format = format;
+    hdr.rtn    = 0;
+    hdr.len    = size;
+    if (ssdk_client_xfer(fd, &hdr, sizeof(hdr), 1) ||
+        ssdk_client_xfer(fd, (void *)cmd, size, 1))
+        return -1;
+
+    if (ssdk_client_xfer(fd, &hdr, sizeof(hdr), 0) ||
+        hdr.magic != SSDK_CLIENT_MAGIC)
+        return -1;
+
+    copy = (hdr.len < *len) ? hdr.len : *len;
+    if (ssdk_client_xfer(fd, buf, copy, 0))
+        return -1;
+
+    for (left = hdr.len - copy; left; left -= size)
+    {
+        size = (left < sizeof(drop)) ? left : sizeof(drop);
+        if (ssdk_client_xfer(fd, drop, size, 0))
+            return -1;
+    }
+
+    *rtn = hdr.rtn;
+    *len = hdr.len;
+    return 0;
+}
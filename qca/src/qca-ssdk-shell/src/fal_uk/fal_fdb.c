@@ -18,6 +18,7 @@
 #include "sw_ioctl.h"
 #include "fal_fdb.h"
 #include "fal_uk_if.h"
+#include "sw_api_us_batch.h"
 
 sw_error_t
 fal_fdb_entry_add(a_uint32_t dev_id, const fal_fdb_entry_t * entry)
@@ -73,6 +74,41 @@ fal_fdb_entry_getnext(a_uint32_t dev_id, fal_fdb_entry_t * entry)
     return rv;
 }
 
+/*
+ * Walk up to max FDB entries after entry[0] into entry[0..max-1]. Every
+ * step takes its key from the entry before it, so the walk cannot be
+ * batched; it still saves the caller a loop per entry and stops at the
+ * first error, with *num set to the entries filled.
+ */
+sw_error_t
+fal_fdb_entry_getnext_bulk(a_uint32_t dev_id, fal_fdb_entry_t * entry,
+                           a_uint32_t max, a_uint32_t * num)
+{
+    sw_error_t rv = SW_OK;
+    a_uint32_t i;
+
+    for (i = 0; i < max; i++)
+    {
+        if (i)
+        {
+            aos_mem_copy(&entry[i], &entry[i - 1], sizeof(fal_fdb_entry_t));
+        }
+
+        rv = sw_uk_exec(SW_API_FDB_NEXT, dev_id, &entry[i]);
+        if (SW_OK != rv)
+        {
+            break;
+        }
+    }
+
+    *num = i;
+    if (i && SW_NO_MORE == rv)
+    {
+        return SW_OK;
+    }
+    return rv;
+}
+
 sw_error_t
 fal_fdb_entry_search(a_uint32_t dev_id, fal_fdb_entry_t * entry)
 {
@@ -18,6 +18,7 @@
 #include "sw_ioctl.h"
 #include "fal_mib.h"
 #include "fal_uk_if.h"
+#include "sw_api_us_batch.h"
 
 sw_error_t
 fal_get_mib_info(a_uint32_t dev_id, fal_port_t port_id,
@@ -37,6 +38,87 @@ fal_get_xgmib_info(a_uint32_t dev_id, fal_port_t port_id,
     rv = sw_uk_exec(SW_API_PT_XGMIB_GET, dev_id, port_id, mib_Info);
     return rv;
 }
+
+/*
+ * Read the MIB of num ports with one batched transport call instead of one
+ * round trip per port. The result of each port is left in port_rv[].
+ */
+sw_error_t
+fal_get_mib_info_bulk(a_uint32_t dev_id, const fal_port_t * port_id,
+                      a_uint32_t num, fal_mib_info_t * mib_info,
+                      sw_error_t * port_rv)
+{
+    sw_uk_call_t call[SW_UK_BATCH_MAX];
+    a_uint32_t i, cnt;
+    sw_error_t rv;
+
+    while (num)
+    {
+        cnt = (num < SW_UK_BATCH_MAX) ? num : SW_UK_BATCH_MAX;
+        for (i = 0; i < cnt; i++)
+        {
+            sw_uk_call_set(&call[i], SW_API_PT_MIB_GET, dev_id,
+                           port_id[i], &mib_info[i]);
+        }
+
+        rv = sw_uk_exec_batch(call, cnt);
+        if (SW_OK != rv)
+        {
+            return rv;
+        }
+
+        for (i = 0; i < cnt; i++)
+        {
+            port_rv[i] = (sw_error_t)call[i].rtn;
+        }
+
+        port_id  += cnt;
+        mib_info += cnt;
+        port_rv  += cnt;
+        num      -= cnt;
+    }
+
+    return SW_OK;
+}
+
+sw_error_t
+fal_get_xgmib_info_bulk(a_uint32_t dev_id, const fal_port_t * port_id,
+                        a_uint32_t num, fal_xgmib_info_t * mib_info,
+                        sw_error_t * port_rv)
+{
+    sw_uk_call_t call[SW_UK_BATCH_MAX];
+    a_uint32_t i, cnt;
+    sw_error_t rv;
+
+    while (num)
+    {
+        cnt = (num < SW_UK_BATCH_MAX) ? num : SW_UK_BATCH_MAX;
+        for (i = 0; i < cnt; i++)
+        {
+            sw_uk_call_set(&call[i], SW_API_PT_XGMIB_GET, dev_id,
+                           port_id[i], &mib_info[i]);
+        }
+
+        rv = sw_uk_exec_batch(call, cnt);
+        if (SW_OK != rv)
+        {
+            return rv;
+        }
+
+        for (i = 0; i < cnt; i++)
+        {
+            port_rv[i] = (sw_error_t)call[i].rtn;
+        }
+
+        port_id  += cnt;
+        mib_info += cnt;
+        port_rv  += cnt;
+        num      -= cnt;
+    }
+
+    return SW_OK;
+}
+
 sw_error_t
 fal_mib_status_set(a_uint32_t dev_id, a_bool_t enable)
 {
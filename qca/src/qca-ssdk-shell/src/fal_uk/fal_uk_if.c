@@ -18,6 +18,7 @@
 #include "ssdk_init.h"
 #include "sw_api.h"
 #include "sw_api_us.h"
+#include "sw_api_us_batch.h"
 #include "api_access.h"
 
 sw_error_t
@@ -47,6 +48,72 @@ sw_uk_exec(a_uint32_t api_id, ...)
     return rtn;
 }
 
+sw_error_t
+sw_uk_call_set(sw_uk_call_t * call, a_uint32_t api_id, ...)
+{
+    va_list arg_ptr;
+    a_uint32_t nr_param = 0, i;
+
+    aos_mem_zero(call, sizeof(sw_uk_call_t));
+    call->rtn = SW_NOT_SUPPORTED;
+
+    if((nr_param = sw_api_param_nums(api_id)) == 0)
+    {
+        return SW_NOT_SUPPORTED;
+    }
+
+    call->value[0] = (unsigned long)api_id;
+    call->value[1] = (unsigned long)&call->rtn;
+
+    va_start(arg_ptr, api_id);
+    for (i = 0; i < nr_param; i++)
+    {
+        call->value[i + 2] = va_arg(arg_ptr, unsigned long);
+    }
+    va_end(arg_ptr);
+
+    return SW_OK;
+}
+
+/*
+ * Run num calls prepared with sw_uk_call_set() through the transport at
+ * once; each call's result is left in its rtn. Calls that could not be
+ * set up keep SW_NOT_SUPPORTED and are not sent.
+ */
+sw_error_t
+sw_uk_exec_batch(sw_uk_call_t * call, a_uint32_t num)
+{
+    unsigned long *value[SW_UK_BATCH_MAX];
+    a_uint32_t i, cnt;
+    sw_error_t rv;
+
+    while (num)
+    {
+        cnt = 0;
+        for (i = 0; i < num && cnt < SW_UK_BATCH_MAX; i++)
+        {
+            if (call[i].value[1])
+            {
+                value[cnt++] = call[i].value;
+            }
+        }
+
+        if (cnt)
+        {
+            rv = sw_uk_if_batch(value, cnt);
+            if (SW_OK != rv)
+            {
+                return rv;
+            }
+        }
+
+        call += i;
+        num  -= i;
+    }
+
+    return SW_OK;
+}
+
 sw_error_t
 ssdk_init(a_uint32_t dev_id, ssdk_init_cfg * cfg)
 {
@@ -23,6 +23,7 @@
 #include "sw.h"
 #include "sw_api.h"
 #include "sw_api_us.h"
+#include "sw_api_us_batch.h"
 
 #define MISC_CHR_DEV       10
 static int glb_socket_fd = 0;
@@ -34,6 +35,19 @@ sw_uk_if(unsigned long arg_val[SW_MAX_API_PARAM])
     return SW_OK;
 }
 
+sw_error_t
+sw_uk_if_batch(unsigned long *arg_val[], a_uint32_t num)
+{
+    a_uint32_t i;
+
+    /* ioctl has no way to carry several calls, issue them back to back */
+    for (i = 0; i < num; i++)
+    {
+        ioctl(glb_socket_fd, SIOCDEVPRIVATE, arg_val[i]);
+    }
+    return SW_OK;
+}
+
 #ifndef SHELL_DEV
 #define SHELL_DEV "/dev/switch_ssdk"
 #endif
@@ -12,16 +12,22 @@
  * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <sys/socket.h>
+#include <poll.h>
+#include <errno.h>
 #include <linux/types.h>
 #include <linux/netlink.h>
 #include "sw.h"
 #include "sw_api.h"
 #include "sw_api_us.h"
+#include "sw_api_us_batch.h"
 
-#define SSDK_SOCK_SEND_TRY_NUM 1000
-#define SSDK_SOCK_RCV_TRY_NUM 1000
+#define SSDK_SOCK_RCV_TIMEOUT_MS 10000
 #define SSDK_SOCK_FD_NUM 16
+#define SSDK_SOCK_MSG_SIZE NLMSG_SPACE(SW_MAX_PAYLOAD)
 typedef struct
 {
     a_uint32_t   ssdk_sock_pid;
@@ -31,6 +37,7 @@ ssdk_sock_t ssdk_sock[SSDK_SOCK_FD_NUM];
 
 static a_uint32_t ssdk_sock_prot = 0;
 static struct nlmsghdr *nl_hdr = NULL;
+static a_uint8_t *nl_batch = NULL;
 #if defined(API_LOCK)
 static aos_lock_t ssdk_sock_lock;
 #define SOCK_LOCKER_INIT    aos_lock_init(&ssdk_sock_lock)
@@ -81,61 +88,159 @@ ssdk_sock_find(a_uint32_t pid)
     return NULL;
 }
 
-sw_error_t
-sw_uk_if(a_uint32_t arg_val[SW_MAX_API_PARAM])
+/*
+ * Return the socket of the calling process, opening and binding it on the
+ * first call. The socket stays open for the life of the process.
+ */
+static sw_error_t
+ssdk_sock_get(a_uint32_t pid, a_int32_t *sock_fd)
 {
     struct sockaddr_nl src_addr;
-    struct sockaddr_nl dest_addr;
-    struct msghdr msg;
-    struct iovec  iov;
-    struct nlmsghdr *nlh;
-    ssdk_sock_t * sock;
-    a_int32_t     sock_fd;
-    a_uint32_t    curr_pid;
-    sw_error_t    rv = SW_OK;
-    a_uint32_t    i, j, flag;
+    ssdk_sock_t *sock;
+    a_int32_t fd;
 
-    curr_pid = getpid();
+    sock = ssdk_sock_find(pid);
+    if (sock)
+    {
+        *sock_fd = sock->ssdk_sock_fd;
+        return SW_OK;
+    }
 
-    SOCK_LOCKER_LOCK;
-    sock = ssdk_sock_find(curr_pid);
+    sock = ssdk_sock_alloc(pid);
     if (!sock)
     {
-        sock = ssdk_sock_alloc(curr_pid);
-        if (!sock)
-        {
-            SW_OUT_ON_ERROR(SW_NO_RESOURCE);
-        }
-
-        sock_fd = socket(PF_NETLINK, SOCK_RAW, ssdk_sock_prot);
-        aos_mem_set(&src_addr, 0, sizeof(src_addr));
-        src_addr.nl_family = AF_NETLINK;
-        src_addr.nl_pid    = curr_pid;
-        src_addr.nl_groups = 0;
-        bind(sock_fd, (struct sockaddr*)&src_addr, sizeof(src_addr));
+        return SW_NO_RESOURCE;
+    }
 
-        sock->ssdk_sock_fd  = sock_fd;
-        sock->ssdk_sock_pid = curr_pid;
+    fd = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, ssdk_sock_prot);
+    if (fd < 0)
+    {
+        return SW_NO_RESOURCE;
     }
-    else
+
+    aos_mem_set(&src_addr, 0, sizeof(src_addr));
+    src_addr.nl_family = AF_NETLINK;
+    src_addr.nl_pid    = pid;
+    src_addr.nl_groups = 0;
+    if (0 > bind(fd, (struct sockaddr*)&src_addr, sizeof(src_addr)))
     {
-        sock_fd = sock->ssdk_sock_fd;
+        close(fd);
+        return SW_NO_RESOURCE;
     }
 
-    aos_mem_set(&dest_addr, 0, sizeof(dest_addr));
-    dest_addr.nl_family = AF_NETLINK;
-    dest_addr.nl_pid    = 0;
-    dest_addr.nl_groups = 0;
+    sock->ssdk_sock_fd  = fd;
+    sock->ssdk_sock_pid = pid;
+    *sock_fd = fd;
+    return SW_OK;
+}
 
-    nlh = nl_hdr;
-    aos_mem_set(nlh, 0, NLMSG_SPACE(SW_MAX_PAYLOAD));
-    nlh->nlmsg_len   = NLMSG_SPACE(SW_MAX_PAYLOAD);
-    nlh->nlmsg_pid   = curr_pid;
+static void
+ssdk_msg_build(struct nlmsghdr *nlh, a_uint32_t pid, const void *arg_val)
+{
+    aos_mem_set(nlh, 0, NLMSG_HDRLEN);
+    nlh->nlmsg_len   = SSDK_SOCK_MSG_SIZE;
+    nlh->nlmsg_pid   = pid;
     nlh->nlmsg_flags = 0;
     aos_mem_copy(NLMSG_DATA(nlh), arg_val, SW_MAX_PAYLOAD);
+}
 
-    iov.iov_base    = (void *)nlh;
-    iov.iov_len     = nlh->nlmsg_len;
+/*
+ * Collect one reply per request sent. The kernel answers every request
+ * before sendmsg returns, so the wait only covers the reply being queued;
+ * it sleeps in poll() instead of spinning on a non-blocking recvmmsg().
+ * Replies are drained with recvmmsg() into the batch buffer, whose
+ * requests have already been consumed by the kernel at this point.
+ */
+static sw_error_t
+ssdk_sock_recv(a_int32_t sock_fd, a_uint32_t num)
+{
+    struct mmsghdr msgs[SW_UK_BATCH_MAX];
+    struct iovec   iov[SW_UK_BATCH_MAX];
+    struct pollfd  pfd;
+    a_uint32_t i, got = 0;
+    a_int32_t  ret;
+
+    if (num > SW_UK_BATCH_MAX)
+    {
+        return SW_BAD_PARAM;
+    }
+
+    aos_mem_set(msgs, 0, sizeof(msgs[0]) * num);
+    for (i = 0; i < num; i++)
+    {
+        iov[i].iov_base = (void *)(nl_batch + i * SSDK_SOCK_MSG_SIZE);
+        iov[i].iov_len  = SSDK_SOCK_MSG_SIZE;
+        msgs[i].msg_hdr.msg_iov    = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    pfd.fd     = sock_fd;
+    pfd.events = POLLIN;
+
+    while (got < num)
+    {
+        ret = recvmmsg(sock_fd, &msgs[got], num - got, MSG_DONTWAIT, NULL);
+        if (0 < ret)
+        {
+            got += ret;
+            continue;
+        }
+
+        if (0 > ret && EINTR == errno)
+        {
+            continue;
+        }
+
+        if (0 > ret && EAGAIN != errno && EWOULDBLOCK != errno)
+        {
+            return SW_FAIL;
+        }
+
+        ret = poll(&pfd, 1, SSDK_SOCK_RCV_TIMEOUT_MS);
+        if (0 == ret)
+        {
+            return SW_TIMEOUT;
+        }
+
+        if (0 > ret && EINTR != errno)
+        {
+            return SW_FAIL;
+        }
+    }
+
+    return SW_OK;
+}
+
+static void
+ssdk_dest_addr(struct sockaddr_nl *dest_addr)
+{
+    aos_mem_set(dest_addr, 0, sizeof(*dest_addr));
+    dest_addr->nl_family = AF_NETLINK;
+    dest_addr->nl_pid    = 0;
+    dest_addr->nl_groups = 0;
+}
+
+sw_error_t
+sw_uk_if(a_uint32_t arg_val[SW_MAX_API_PARAM])
+{
+    struct sockaddr_nl dest_addr;
+    struct msghdr msg;
+    struct iovec  iov;
+    a_int32_t     sock_fd;
+    a_uint32_t    curr_pid;
+    sw_error_t    rv = SW_OK;
+
+    curr_pid = getpid();
+
+    SOCK_LOCKER_LOCK;
+    rv = ssdk_sock_get(curr_pid, &sock_fd);
+    SW_OUT_ON_ERROR(rv);
+
+    ssdk_dest_addr(&dest_addr);
+    ssdk_msg_build(nl_hdr, curr_pid, arg_val);
+
+    iov.iov_base    = (void *)nl_hdr;
+    iov.iov_len     = nl_hdr->nlmsg_len;
 
     aos_mem_set(&msg, 0, sizeof(msg));
     msg.msg_name    = (void *)&dest_addr;
@@ -143,45 +248,83 @@ sw_uk_if(a_uint32_t arg_val[SW_MAX_API_PARAM])
     msg.msg_iov     = &iov;
     msg.msg_iovlen  = 1;
 
-    for (i = 0; i < SSDK_SOCK_SEND_TRY_NUM; i++)
+    while (0 > sendmsg(sock_fd, &msg, 0))
     {
-        if (0 < sendmsg(sock_fd, &msg, MSG_DONTWAIT))
+        if (EINTR != errno)
         {
-            break;
+            SW_OUT_ON_ERROR(SW_FAIL);
         }
     }
 
-    if (SSDK_SOCK_SEND_TRY_NUM <= i)
-    {
-        SW_OUT_ON_ERROR(SW_TIMEOUT);
-    }
+    rv = ssdk_sock_recv(sock_fd, 1);
+
+out:
+    SOCK_LOCKER_UNLOCK;
+    return rv;
+}
+
+sw_error_t
+sw_uk_if_batch(unsigned long *arg_val[], a_uint32_t num)
+{
+    struct sockaddr_nl dest_addr;
+    struct mmsghdr msgs[SW_UK_BATCH_MAX];
+    struct iovec   iov[SW_UK_BATCH_MAX];
+    struct nlmsghdr *nlh;
+    a_int32_t     sock_fd;
+    a_uint32_t    curr_pid;
+    a_uint32_t    i, cnt, sent;
+    a_int32_t     ret;
+    sw_error_t    rv = SW_OK;
+
+    curr_pid = getpid();
 
-    flag = 0;
-    aos_mem_set(nlh, 0, NLMSG_SPACE(SW_MAX_PAYLOAD));
-    for (i = 0; i < SSDK_SOCK_RCV_TRY_NUM; i++)
+    SOCK_LOCKER_LOCK;
+    rv = ssdk_sock_get(curr_pid, &sock_fd);
+    SW_OUT_ON_ERROR(rv);
+
+    ssdk_dest_addr(&dest_addr);
+
+    while (num)
     {
-        for (j = 0; j < 1000; j++)
-        {
-            if (0 < recvmsg(sock_fd, &msg, MSG_DONTWAIT))
-            {
-                flag = 1;
-                break;
-            }
-        }
+        cnt = (num < SW_UK_BATCH_MAX) ? num : SW_UK_BATCH_MAX;
 
-        if (flag)
+        aos_mem_set(msgs, 0, sizeof(msgs[0]) * cnt);
+        for (i = 0; i < cnt; i++)
         {
-            break;
+            nlh = (struct nlmsghdr *)(nl_batch + i * SSDK_SOCK_MSG_SIZE);
+            ssdk_msg_build(nlh, curr_pid, arg_val[i]);
+
+            iov[i].iov_base = (void *)nlh;
+            iov[i].iov_len  = nlh->nlmsg_len;
+            msgs[i].msg_hdr.msg_name    = (void *)&dest_addr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(dest_addr);
+            msgs[i].msg_hdr.msg_iov     = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
         }
-        else
+
+        /* Each message is a separate request, all handed over in one call */
+        sent = 0;
+        while (sent < cnt)
         {
-            aos_mdelay(10);
+            ret = sendmmsg(sock_fd, &msgs[sent], cnt - sent, 0);
+            if (0 > ret)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                /* Drain the replies of what did go out before failing */
+                ssdk_sock_recv(sock_fd, sent);
+                SW_OUT_ON_ERROR(SW_FAIL);
+            }
+            sent += ret;
         }
-    }
 
-    if (SSDK_SOCK_RCV_TRY_NUM <= i)
-    {
-        SW_OUT_ON_ERROR(SW_TIMEOUT);
+        rv = ssdk_sock_recv(sock_fd, cnt);
+        SW_OUT_ON_ERROR(rv);
+
+        arg_val += cnt;
+        num     -= cnt;
     }
 
 out:
@@ -194,10 +337,15 @@ sw_uk_init(a_uint32_t nl_prot)
 {
     if (!nl_hdr)
     {
-        nl_hdr = (struct nlmsghdr *)aos_mem_alloc(NLMSG_SPACE(SW_MAX_PAYLOAD));
+        nl_hdr = (struct nlmsghdr *)aos_mem_alloc(SSDK_SOCK_MSG_SIZE);
     }
 
-    if (!nl_hdr)
+    if (!nl_batch)
+    {
+        nl_batch = (a_uint8_t *)aos_mem_alloc(SSDK_SOCK_MSG_SIZE * SW_UK_BATCH_MAX);
+    }
+
+    if (!nl_hdr || !nl_batch)
     {
         return SW_NO_RESOURCE;
     }
@@ -223,6 +371,12 @@ sw_uk_cleanup(void)
         nl_hdr = NULL;
     }
 
+    if (nl_batch)
+    {
+        aos_mem_free(nl_batch);
+        nl_batch = NULL;
+    }
+
     return SW_OK;
 }
 
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Transport that completes every call with SW_OK without reaching the
+ * kernel (UK_STUB=TRUE). It lets the shell be built and timed on a host,
+ * e.g. "ssdk_sh run <cmd_file> <result_file>" to measure parsing cost.
+ */
+#include "sw.h"
+#include "sw_api.h"
+#include "sw_api_us.h"
+#include "sw_api_us_batch.h"
+
+sw_error_t
+sw_uk_if(unsigned long arg_val[SW_MAX_API_PARAM])
+{
+    *(unsigned long *)arg_val[1] = SW_OK;
+    return SW_OK;
+}
+
+sw_error_t
+sw_uk_if_batch(unsigned long *arg_val[], a_uint32_t num)
+{
+    a_uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        sw_uk_if(arg_val[i]);
+    }
+    return SW_OK;
+}
+
+sw_error_t
+sw_uk_init(a_uint32_t nl_prot)
+{
+    return SW_OK;
+}
+
+sw_error_t
+sw_uk_cleanup(void)
+{
+    return SW_OK;
+}
@@ -16,9 +16,21 @@
  */
 
 /*qca808x_start*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdarg.h>
 #include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include "shell.h"
 #include "shell_io.h"
 #include "shell_sw.h"
@@ -26,6 +38,10 @@
 #include "shell_config.h"
 #include "api_access.h"
 #include "fal_uk_if.h"
+#include "ssdk_client.h"
+
+#define SSDK_SH_DAEMON_CLIENTS_MAX 16
+#define SSDK_SH_DAEMON_IO_TIMEOUT_MS 1000
 
 a_ulong_t *ioctl_buf = NULL;
 ssdk_init_cfg init_cfg = def_init_cfg;
@@ -91,31 +107,87 @@ cmd_print(char *fmt, ...)
     va_end(args);
 }
 
-static sw_error_t
-cmd_input_parser(a_ulong_t *arg_val, a_uint32_t arg_index, sw_api_param_t *pp)
+/*
+ * What parsing and printing an api needs from its descriptors, resolved the
+ * first time the api is used: the descriptors themselves, the data type
+ * (converter) of each parameter and where each pointer parameter lives in
+ * ioctl_buf. Batch files run the same few apis thousands of times.
+ */
+typedef struct
 {
-    a_int16_t i;
-    a_ulong_t *pbuf;
+    sw_api_t api;
+    sw_data_type_t *data_type[SW_MAX_API_PARAM];
+    a_uint32_t buf_off[SW_MAX_API_PARAM];   /*in a_ulong_t from ioctl_buf*/
+    a_uint32_t out_len;                     /*bytes of pointer params*/
+} cmd_api_cache_t;
+
+static cmd_api_cache_t *cmd_api_cache[SW_API_MAX];
+
+static cmd_api_cache_t *
+cmd_api_cache_get(a_ulong_t api_id)
+{
+    cmd_api_cache_t *cache;
+    sw_api_param_t *pptmp;
     a_uint16_t rtn_size = sizeof(sw_error_t);
     a_uint16_t p_size = sizeof(a_ulong_t);
-    sw_api_param_t *pptmp = pp;
+    a_uint32_t i, off;
+
+    if (api_id >= SW_API_MAX)
+        return NULL;
 
-    pbuf = ioctl_buf + (rtn_size + p_size -1) / p_size;    /*reserve for return value */
+    if (cmd_api_cache[api_id])
+        return cmd_api_cache[api_id];
 
-    for (i = 0; i < arg_index; i++)
+    cache = malloc(sizeof(cmd_api_cache_t));
+    if (!cache)
+        return NULL;
+
+    cache->api.api_id = api_id;
+    if (sw_api_get(&cache->api) != SW_OK || cache->api.api_nr > SW_MAX_API_PARAM)
     {
-        pptmp = pp + i;
+        free(cache);
+        return NULL;
+    }
+
+    off = (rtn_size + p_size -1) / p_size;    /*reserve for return value */
+    for (i = 0; i < cache->api.api_nr; i++)
+    {
+        pptmp = cache->api.api_pp + i;
+        cache->data_type[i] = cmd_data_type_find(pptmp->data_type);
+        cache->buf_off[i] = off;
         if (pptmp->param_type & SW_PARAM_PTR)
-        {
-            pbuf += (pptmp->data_size + p_size -1) / p_size;
-        }
+            off += (pptmp->data_size + p_size -1) / p_size;
     }
-    if ((pbuf - ioctl_buf + (pptmp->data_size + p_size -1) / p_size) > (IOCTL_BUF_SIZE / p_size))
+    cache->out_len = (off - (rtn_size + p_size -1) / p_size) * p_size;
+
+    cmd_api_cache[api_id] = cache;
+    return cache;
+}
+
+static void
+cmd_api_cache_free(void)
+{
+    a_uint32_t i;
+
+    for (i = 0; i < SW_API_MAX; i++)
+    {
+        free(cmd_api_cache[i]);
+        cmd_api_cache[i] = NULL;
+    }
+}
+
+static sw_error_t
+cmd_input_parser(a_ulong_t *arg_val, a_uint32_t arg_index, cmd_api_cache_t *cache)
+{
+    a_uint16_t p_size = sizeof(a_ulong_t);
+    sw_api_param_t *pptmp = cache->api.api_pp + arg_index;
+
+    if ((cache->buf_off[arg_index] + (pptmp->data_size + p_size -1) / p_size) > (IOCTL_BUF_SIZE / p_size))
     {
         return SW_NO_RESOURCE;
     }
 
-    *arg_val = (a_ulong_t) pbuf;
+    *arg_val = (a_ulong_t) (ioctl_buf + cache->buf_off[arg_index]);
 
     return SW_OK;
 }
@@ -175,11 +247,10 @@ cmd_api_func(sw_api_func_t *fp, a_uint32_t nr_param, a_ulong_t * args)
 }
 
 static sw_error_t
-cmd_api_output(sw_api_param_t *pp, a_uint32_t nr_param, a_ulong_t * args)
+cmd_api_output(cmd_api_cache_t *cache, a_ulong_t * args)
 {
     a_uint16_t i;
     a_ulong_t *pbuf;
-    a_uint16_t rtn_size = sizeof(sw_error_t);
     a_uint16_t p_size = sizeof(a_ulong_t);
     sw_error_t rtn = (sw_error_t) (*ioctl_buf);
     sw_api_param_t *pptmp = NULL;
@@ -190,18 +261,18 @@ cmd_api_output(sw_api_param_t *pp, a_uint32_t nr_param, a_ulong_t * args)
         return rtn;
     }
 
-    pbuf = ioctl_buf + (rtn_size + p_size -1) / p_size;
-    for (i = 0; i < nr_param; i++)
+    for (i = 0; i < cache->api.api_nr; i++)
     {
-        pptmp = pp + i;
+        pptmp = cache->api.api_pp + i;
         if (pptmp->param_type & SW_PARAM_PTR)
         {
+            pbuf = ioctl_buf + cache->buf_off[i];
 
             if (pptmp->param_type & SW_PARAM_OUT)
             {
 
                 sw_data_type_t *data_type;
-                if (!(data_type = cmd_data_type_find(pptmp->data_type)))
+                if (!(data_type = cache->data_type[i]))
                     return SW_NO_SUCH;
 
                 if (data_type->show_func)
@@ -224,8 +295,6 @@ cmd_api_output(sw_api_param_t *pp, a_uint32_t nr_param, a_ulong_t * args)
                     (pptmp->data_size + p_size - 1) / p_size) > (IOCTL_BUF_SIZE / p_size))
                 return SW_NO_RESOURCE;
 
-            pbuf += (pptmp->data_size + p_size -1) / p_size;
-
         }
     }
     return SW_OK;
@@ -249,18 +318,19 @@ cmd_parse_api(char **cmd_str, a_ulong_t * arg_val)
     a_ulong_t *temp;
     void *pentry;
     sw_api_param_t *pptmp = NULL;
-    sw_api_t sw_api;
+    cmd_api_cache_t *cache;
     a_uint32_t ignorecnt = 0, jump = 0;
-    sw_api.api_id = arg_val[0];
-    SW_RTN_ON_ERROR(sw_api_get(&sw_api));
+
+    if (!(cache = cmd_api_cache_get(arg_val[0])))
+        return SW_NOT_SUPPORTED;
 
     /*set device id */
     arg_val[arg_start] = get_devid();
 
-    for (arg_index = reserve_index; arg_index < sw_api.api_nr; arg_index++)
+    for (arg_index = reserve_index; arg_index < cache->api.api_nr; arg_index++)
     {
         tmp_str = NULL;
-        pptmp = sw_api.api_pp + arg_index;
+        pptmp = cache->api.api_pp + arg_index;
 
         if (!(pptmp->param_type & SW_PARAM_IN))
         {
@@ -277,13 +347,13 @@ cmd_parse_api(char **cmd_str, a_ulong_t * arg_val)
         temp = &arg_val[arg_start + arg_index];
 
         sw_data_type_t *data_type;
-        if (!(data_type = cmd_data_type_find(pptmp->data_type)))
+        if (!(data_type = cache->data_type[arg_index]))
             return SW_NO_SUCH;
 
         pentry = temp;
         if (pptmp->param_type & SW_PARAM_PTR)
         {
-            if (cmd_input_parser(temp, arg_index, sw_api.api_pp) != SW_OK)
+            if (cmd_input_parser(temp, arg_index, cache) != SW_OK)
                 return SW_NO_RESOURCE;
 
             pentry = (void *) *temp;
@@ -387,20 +457,20 @@ sw_error_t
 cmd_exec_api(a_ulong_t *arg_val)
 {
     sw_error_t rv;
-    sw_api_t sw_api;
+    cmd_api_cache_t *cache;
 
-    sw_api.api_id = arg_val[0];
-    SW_RTN_ON_ERROR(sw_api_get(&sw_api));
+    if (!(cache = cmd_api_cache_get(arg_val[0])))
+        return SW_NOT_SUPPORTED;
 
     /*save cmd return value */
     arg_val[1] = (a_ulong_t) ioctl_buf;
     /*save set device id */
     arg_val[2] = get_devid();
 
-    rv = cmd_api_func(sw_api.api_fp, sw_api.api_nr, arg_val);
+    rv = cmd_api_func(cache->api.api_fp, cache->api.api_nr, arg_val);
     SW_RTN_ON_ERROR(rv);
 
-    rv = cmd_api_output(sw_api.api_pp, sw_api.api_nr, arg_val);
+    rv = cmd_api_output(cache, arg_val);
     SW_RTN_ON_ERROR(rv);
 
     return rv;
@@ -429,9 +499,138 @@ cmd_print_usage (int cmd_index, int cmd_index_sub)
         arg_val[3] = dbg_cmd_num or other
 */
 
-/*command string lookup*/
-a_uint32_t
-cmd_lookup(char **cmd_str, int *cmd_index, int *cmd_index_sub)
+/*
+ * Hash index over gcmd_des, built on the first lookup. Each entry is keyed
+ * by its command, sub-command (empty for two word commands) and action,
+ * compared case-insensitively; where keys repeat the first entry in table
+ * order is kept, as the linear scan would find it first.
+ */
+typedef struct
+{
+    a_uint16_t no;
+    a_uint16_t sub_no;
+} cmd_hash_t;
+
+#define CMD_HASH_EMPTY 0xffff
+
+static cmd_hash_t *cmd_hash = NULL;
+static a_uint32_t cmd_hash_mask = 0;
+
+static a_uint32_t
+cmd_hash_str(a_uint32_t h, const char *str)
+{
+    /*FNV-1a over the lower-cased string and its terminator*/
+    do
+    {
+        h ^= (a_uint8_t) tolower((a_uint8_t) *str);
+        h *= 16777619;
+    }
+    while (*str++);
+
+    return h;
+}
+
+static a_uint32_t
+cmd_hash_key(const char *name, const char *sub, const char *act)
+{
+    a_uint32_t h = 2166136261U;
+
+    h = cmd_hash_str(h, name);
+    h = cmd_hash_str(h, sub ? sub : "");
+    return cmd_hash_str(h, act) & cmd_hash_mask;
+}
+
+static int
+cmd_hash_match(a_uint32_t no, a_uint32_t sub_no,
+               const char *name, const char *sub, const char *act)
+{
+    if (strcasecmp(name, GCMD_NAME(no)) || strcasecmp(act, GCMD_SUB_ACT(no, sub_no)))
+        return 0;
+
+    if (!sub)
+        return GCMD_SUB_NAME(no, sub_no) == NULL;
+
+    return GCMD_SUB_NAME(no, sub_no) && !strcasecmp(sub, GCMD_SUB_NAME(no, sub_no));
+}
+
+static void
+cmd_lookup_init(void)
+{
+    a_uint32_t no, sub_no, count = 0, size = 64, h;
+
+    for (no = 0; GCMD_DESC_VALID(no); no++)
+    {
+        if (!GCMD_NAME(no))
+            continue;
+        for (sub_no = 0; GCMD_SUB_DESC_VALID(no, sub_no); sub_no++)
+            count++;
+    }
+
+    while (size < 2 * count)
+        size <<= 1;
+
+    if (!(cmd_hash = malloc(size * sizeof(cmd_hash_t))))
+        return;
+    memset(cmd_hash, 0xff, size * sizeof(cmd_hash_t));
+    cmd_hash_mask = size - 1;
+
+    for (no = 0; GCMD_DESC_VALID(no); no++)
+    {
+        if (!GCMD_NAME(no))
+            continue;
+
+        for (sub_no = 0; GCMD_SUB_DESC_VALID(no, sub_no); sub_no++)
+        {
+            if (!GCMD_SUB_ACT(no, sub_no))
+                continue;
+
+            h = cmd_hash_key(GCMD_NAME(no), GCMD_SUB_NAME(no, sub_no),
+                             GCMD_SUB_ACT(no, sub_no));
+            while (cmd_hash[h].no != CMD_HASH_EMPTY &&
+                   !cmd_hash_match(cmd_hash[h].no, cmd_hash[h].sub_no, GCMD_NAME(no),
+                                   GCMD_SUB_NAME(no, sub_no), GCMD_SUB_ACT(no, sub_no)))
+                h = (h + 1) & cmd_hash_mask;
+
+            if (cmd_hash[h].no == CMD_HASH_EMPTY)
+            {
+                cmd_hash[h].no = no;
+                cmd_hash[h].sub_no = sub_no;
+            }
+        }
+    }
+}
+
+static void
+cmd_lookup_free(void)
+{
+    free(cmd_hash);
+    cmd_hash = NULL;
+    cmd_hash_mask = 0;
+}
+
+static int
+cmd_hash_find(const char *name, const char *sub, const char *act,
+              a_uint32_t *no, a_uint32_t *sub_no)
+{
+    a_uint32_t h = cmd_hash_key(name, sub, act);
+
+    while (cmd_hash[h].no != CMD_HASH_EMPTY)
+    {
+        if (cmd_hash_match(cmd_hash[h].no, cmd_hash[h].sub_no, name, sub, act))
+        {
+            *no = cmd_hash[h].no;
+            *sub_no = cmd_hash[h].sub_no;
+            return 1;
+        }
+        h = (h + 1) & cmd_hash_mask;
+    }
+
+    return 0;
+}
+
+/*command string lookup, linear scan used when the index can't be built*/
+static a_uint32_t
+cmd_lookup_scan(char **cmd_str, int *cmd_index, int *cmd_index_sub)
 {
     a_uint32_t no, sub_no;
     a_uint32_t cmd_deepth = 0;
@@ -489,6 +688,46 @@ cmd_lookup(char **cmd_str, int *cmd_index, int *cmd_index_sub)
     return cmd_deepth;
 }
 
+/*command string lookup*/
+a_uint32_t
+cmd_lookup(char **cmd_str, int *cmd_index, int *cmd_index_sub)
+{
+    a_uint32_t no2 = 0, sub2 = 0, no3 = 0, sub3 = 0;
+    int found2, found3 = 0;
+
+    *cmd_index = GCMD_DESC_NO_MATCH;
+    *cmd_index_sub = GCMD_DESC_NO_MATCH;
+
+    if (cmd_str[0] == NULL || cmd_str[1] == NULL)
+        return 0;
+
+    if (!cmd_hash)
+        cmd_lookup_init();
+    if (!cmd_hash)
+        return cmd_lookup_scan(cmd_str, cmd_index, cmd_index_sub);
+
+    found2 = cmd_hash_find(cmd_str[0], NULL, cmd_str[1], &no2, &sub2);
+    if (cmd_str[2] != NULL)
+        found3 = cmd_hash_find(cmd_str[0], cmd_str[1], cmd_str[2], &no3, &sub3);
+
+    /*the table entry that comes first wins, as with the scan*/
+    if (found3 && (!found2 || no3 < no2 || (no3 == no2 && sub3 < sub2)))
+    {
+        *cmd_index = no3;
+        *cmd_index_sub = sub3;
+        return 3;
+    }
+
+    if (found2)
+    {
+        *cmd_index = no2;
+        *cmd_index_sub = sub2;
+        return 2;
+    }
+
+    return 0;
+}
+
 static a_ulong_t *
 cmd_parse(char *cmd_str, int *cmd_index, int *cmd_index_sub)
 {
@@ -578,7 +817,7 @@ cmd_parse(char *cmd_str, int *cmd_index, int *cmd_index_sub)
     return arg_val;
 }
 
-static int
+static sw_error_t
 cmd_exec(a_ulong_t *arg_val, int cmd_index, int cmd_index_sub)
 {
     a_uint32_t api_id = arg_val[0];
@@ -604,7 +843,7 @@ cmd_exec(a_ulong_t *arg_val, int cmd_index, int cmd_index_sub)
     else
         dprintf("\noperation done.\n\n");
 
-    return 0;
+    return rtn;
 }
 
 static sw_error_t
@@ -671,6 +910,8 @@ cmd_exit(void)
 {
     free(ioctl_buf);
     free(ioctl_argp);
+    cmd_api_cache_free();
+    cmd_lookup_free();
     ssdk_cleanup();
     flag = 0;
     return SW_OK;
@@ -682,12 +923,12 @@ cmd_run_one(char *cmd_str)
     a_ulong_t *arg_list;
     int cmd_index = 0, cmd_index_sub = 0;
 
-    if ((arg_list = cmd_parse(cmd_str, &cmd_index, &cmd_index_sub)) != NULL)
+    if ((arg_list = cmd_parse(cmd_str, &cmd_index, &cmd_index_sub)) == NULL)
     {
-        cmd_exec(arg_list, cmd_index, cmd_index_sub);
+        return SW_BAD_PARAM;
     }
 
-    return SW_OK;
+    return cmd_exec(arg_list, cmd_index, cmd_index_sub);
 }
 
 int
@@ -743,7 +984,10 @@ cmd_run_batch (char *cmd_str)
 
     size_t len = 0;
     ssize_t read;
+    a_uint32_t cmd_nr = 0;
+    struct timespec start, end;
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
     set_talk_mode(0);
     while ((read = getline(&line, &len, in_fd)) != -1)
     {
@@ -768,8 +1012,10 @@ cmd_run_batch (char *cmd_str)
             dprintf("%s\n", line);
         }
         cmd_run_one(line);
+        cmd_nr++;
     }
     set_talk_mode(1);
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
     if (line) free(line);
 
@@ -778,6 +1024,10 @@ cmd_run_batch (char *cmd_str)
     out_fd = 0;
     in_fd =0;
 
+    dprintf("run: %u commands in %ld ms\n", cmd_nr,
+            (long)((end.tv_sec - start.tv_sec) * 1000 +
+                   (end.tv_nsec - start.tv_nsec) / 1000000));
+
     return SW_OK;
 
 }
@@ -814,6 +1064,215 @@ cmd_args(char *cmd_str, int argc, const char *argv[])
     return SW_OK;
 }
 
+/*size of the output parameters an api leaves in ioctl_buf after the return value*/
+static a_uint32_t
+cmd_api_out_len(a_ulong_t api_id)
+{
+    a_uint16_t rtn_size = sizeof(sw_error_t);
+    a_uint16_t p_size = sizeof(a_ulong_t);
+    cmd_api_cache_t *cache = cmd_api_cache_get(api_id);
+
+    if (!cache)
+        return 0;
+
+    if (cache->out_len > IOCTL_BUF_SIZE - (rtn_size + p_size - 1) / p_size * p_size)
+        return 0;
+
+    return cache->out_len;
+}
+
+static int
+cmd_daemon_xfer(int fd, void *buf, a_uint32_t len, int is_send)
+{
+    char *p = buf;
+    ssize_t ret;
+
+    while (len)
+    {
+        if (is_send)
+            ret = send(fd, p, len, MSG_NOSIGNAL);
+        else
+            ret = recv(fd, p, len, 0);
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+
+        p += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+/*run one request of a daemon client, returns -1 when the client should be dropped*/
+static int
+cmd_daemon_serve(int fd)
+{
+    ssdk_client_hdr_t hdr;
+    char cmd_str[CMDSTR_BUF_SIZE];
+    char *text = NULL;
+    size_t text_len = 0;
+    void *data = NULL;
+    a_uint32_t len = 0;
+    a_uint16_t rtn_size = sizeof(sw_error_t);
+    a_uint16_t p_size = sizeof(a_ulong_t);
+    sw_error_t rtn;
+    int ret;
+
+    if (cmd_daemon_xfer(fd, &hdr, sizeof(hdr), 0) ||
+        hdr.magic != SSDK_CLIENT_MAGIC || hdr.len >= sizeof(cmd_str))
+        return -1;
+
+    if (cmd_daemon_xfer(fd, cmd_str, hdr.len, 0))
+        return -1;
+    cmd_str[hdr.len] = '\0';
+
+    /*whatever the command prints is the text reply*/
+    out_fd = open_memstream(&text, &text_len);
+    rtn = cmd_run_one(cmd_str);
+    if (out_fd)
+        fclose(out_fd);
+    out_fd = NULL;
+
+    if (hdr.format == SSDK_CLIENT_FMT_BIN)
+    {
+        if (rtn == SW_OK)
+        {
+            len = cmd_api_out_len(ioctl_argp[0]);
+            data = ioctl_buf + (rtn_size + p_size - 1) / p_size;
+        }
+    }
+    else if (text)
+    {
+        len = text_len;
+        data = text;
+    }
+
+    hdr.rtn = rtn;
+    hdr.len = len;
+    ret = cmd_daemon_xfer(fd, &hdr, sizeof(hdr), 1);
+    if (!ret)
+        ret = cmd_daemon_xfer(fd, data, len, 1);
+
+    free(text);
+    return ret;
+}
+
+/*accept only root peers, and bound how long a client can hold up the others*/
+static int
+cmd_daemon_client_ok(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    struct timeval tv;
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+        cred.uid != 0)
+        return 0;
+
+    tv.tv_sec = SSDK_SH_DAEMON_IO_TIMEOUT_MS / 1000;
+    tv.tv_usec = (SSDK_SH_DAEMON_IO_TIMEOUT_MS % 1000) * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+        return 0;
+
+    return 1;
+}
+
+/*
+ * Resident mode: keep the SSDK connection set up by cmd_init() and serve
+ * commands from local clients (see ssdk_client.h) until killed, so that
+ * agents don't fork an ssdk_sh per query. Requests are run one at a time;
+ * a client that stalls mid request is dropped after
+ * SSDK_SH_DAEMON_IO_TIMEOUT_MS. The socket is only reachable by root.
+ */
+static sw_error_t
+cmd_daemon(const char *path)
+{
+    struct pollfd pfd[SSDK_SH_DAEMON_CLIENTS_MAX + 1];
+    struct sockaddr_un addr;
+    int listen_fd, fd, nfd, i, ret;
+    mode_t mask;
+
+    signal(SIGPIPE, SIG_IGN);
+    set_talk_mode(0);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        dprintf("can't create socket %s\n", path);
+        return SW_FAIL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+    unlink(path);
+
+    mask = umask(0077);
+    ret = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+
+    if (ret < 0 || chmod(path, 0600) < 0 ||
+        listen(listen_fd, SSDK_SH_DAEMON_CLIENTS_MAX) < 0)
+    {
+        dprintf("can't listen on %s\n", path);
+        close(listen_fd);
+        return SW_FAIL;
+    }
+
+    pfd[0].fd = listen_fd;
+    pfd[0].events = POLLIN;
+    nfd = 1;
+
+    while (1)
+    {
+        if (poll(pfd, nfd, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (i = nfd - 1; i > 0; i--)
+        {
+            if (!pfd[i].revents)
+                continue;
+
+            if ((pfd[i].revents & POLLIN) && !cmd_daemon_serve(pfd[i].fd))
+                continue;
+
+            close(pfd[i].fd);
+            pfd[i] = pfd[--nfd];
+        }
+
+        if (pfd[0].revents & POLLIN)
+        {
+            fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd < 0)
+                continue;
+
+            if (nfd > SSDK_SH_DAEMON_CLIENTS_MAX || !cmd_daemon_client_ok(fd))
+            {
+                close(fd);
+                continue;
+            }
+
+            pfd[nfd].fd = fd;
+            pfd[nfd].events = POLLIN;
+            pfd[nfd].revents = 0;
+            nfd++;
+        }
+    }
+
+    for (i = 0; i < nfd; i++)
+        close(pfd[i].fd);
+    unlink(path);
+    return SW_FAIL;
+}
+
 int
 cmd_is_exit(char *cmd_str)
 {
@@ -851,6 +1310,13 @@ main(int argc, const char *argv[])
     char cmd_str[CMDSTR_BUF_SIZE];
     cmd_init();
 
+    if(argc > 1 && !strcmp(argv[1], "-d"))
+    {
+        cmd_daemon(argc > 2 ? argv[2] : SSDK_CLIENT_SOCK_PATH);
+        cmd_exit();
+        return 0;
+    }
+
     if(argc > 1)
     {
         memset(cmd_str, 0, sizeof(cmd_str));